@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    // The first two ports named loop://lines are the ends of one cable.
+    if (!sender.setup("loop://lines", 115200) || !receiver.setup("loop://lines", 115200))
+    {
+        ofLogError("ofApp::setup") << "Unable to open loop://lines.";
+        return;
+    }
+
+    receiver.registerAllEvents(this);
+    rateMicros = ofGetElapsedTimeMicros();
+}
+
+
+void ofApp::exit()
+{
+    receiver.unregisterAllEvents(this);
+}
+
+
+void ofApp::update()
+{
+    if (!sender.isOpen())
+    {
+        return;
+    }
+
+    std::string lines;
+
+    for (std::size_t i = 0; i < linesPerFrame; ++i)
+    {
+        lines += ofToString(nextLine++) + "\n";
+    }
+
+    sender.writeBytes(lines);
+
+    uint64_t now = ofGetElapsedTimeMicros();
+
+    if (now - rateMicros >= 1000000)
+    {
+        linesPerSecond = lineCount * 1000000.0 / (now - rateMicros);
+        lineCount = 0;
+        rateMicros = now;
+    }
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    if (!receiver.isOpen())
+    {
+        ofDrawBitmapStringHighlight("Unable to open loop://lines.", 20, 20);
+        return;
+    }
+
+    std::stringstream ss;
+    ss << "Port: " << receiver.port() << std::endl;
+    ss << "Lines per frame (+/-): " << linesPerFrame << std::endl;
+    ss << "Lines per second: " << static_cast<uint64_t>(linesPerSecond) << std::endl;
+    ss << "Lines out of order: " << errorCount << std::endl;
+
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+}
+
+
+void ofApp::keyPressed(int key)
+{
+    if (key == '+')
+    {
+        linesPerFrame *= 2;
+    }
+    else if (key == '-' && linesPerFrame > 1)
+    {
+        linesPerFrame /= 2;
+    }
+}
+
+
+void ofApp::onSerialBuffer(const ofxIO::SerialBufferEventArgs& args)
+{
+    if (args.buffer().toString() != ofToString(expectedLine))
+    {
+        errorCount++;
+    }
+
+    expectedLine++;
+    lineCount++;
+}
+
+
+void ofApp::onSerialError(const ofxIO::SerialBufferErrorEventArgs& args)
+{
+    ofLogError("ofApp::onSerialError") << args.exception().displayText();
+}
@@ -0,0 +1,53 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void exit() override;
+    void keyPressed(int key) override;
+
+    void onSerialBuffer(const ofxIO::SerialBufferEventArgs& args);
+    void onSerialError(const ofxIO::SerialBufferErrorEventArgs& args);
+
+    /// \brief Writes into one end of the cable.
+    ofxIO::SerialDevice sender;
+
+    /// \brief Frames the lines arriving at the other end.
+    ofxIO::BufferedSerialDevice receiver;
+
+    /// \brief The number of lines written each frame.
+    std::size_t linesPerFrame = 1000;
+
+    /// \brief The number of the next line to write.
+    uint64_t nextLine = 0;
+
+    /// \brief The number of the next line expected.
+    uint64_t expectedLine = 0;
+
+    /// \brief The number of lines received out of order.
+    std::size_t errorCount = 0;
+
+    /// \brief The lines received since the rate was last measured.
+    std::size_t lineCount = 0;
+
+    /// \brief The time the rate was last measured.
+    uint64_t rateMicros = 0;
+
+    /// \brief The lines received per second.
+    double linesPerSecond = 0;
+
+};
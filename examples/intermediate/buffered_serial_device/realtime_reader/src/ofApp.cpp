@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+LatencyProbe::LatencyProbe(std::size_t maxSamples):
+    _samples(maxSamples),
+    _sampleCount(0)
+{
+}
+
+
+std::vector<double> LatencyProbe::samples() const
+{
+    return std::vector<double>(_samples.begin(), _samples.begin() + _sampleCount);
+}
+
+
+void LatencyProbe::bytesRead(const uint8_t* data, std::size_t size)
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        _timestamp[_timestampSize++] = data[i];
+
+        if (_timestampSize == sizeof(_timestamp))
+        {
+            int64_t sent = 0;
+            std::memcpy(&sent, _timestamp, sizeof(sent));
+            _timestampSize = 0;
+
+            std::size_t index = _sampleCount;
+
+            if (index < _samples.size())
+            {
+                _samples[index] = (now - sent) / 1000.0;
+                _sampleCount = index + 1;
+            }
+        }
+    }
+}
+
+
+void ofApp::setup()
+{
+    normal = measure(ofx::IO::ThreadPolicy());
+    ofLogNotice("ofApp::setup") << "Default scheduler: " << toString(normal);
+
+    // Pin the reader to the last CPU and give it a real-time priority.
+    int cpu = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    realtime = measure(ofx::IO::ThreadPolicy::realtime(ofx::IO::ThreadPolicy::DEFAULT_REALTIME_PRIORITY, cpu));
+    ofLogNotice("ofApp::setup") << "Real-time policy: " << toString(realtime);
+}
+
+
+ofApp::Result ofApp::measure(const ofx::IO::ThreadPolicy& policy)
+{
+    Result result;
+
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::measure") << "Pseudo terminals are not available on Windows.";
+#else
+    // Open a pseudo terminal. The reader reads the slave end like a port.
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        ofLogError("ofApp::measure") << "Unable to open a pseudo terminal.";
+        if (master != -1) close(master);
+        return result;
+    }
+
+    std::string slaveName = ptsname(master);
+
+    try
+    {
+        auto port = std::make_shared<serial::Serial>(slaveName, 115200);
+
+        LatencyProbe probe(NUM_SAMPLES);
+
+        if (!probe.start(port, policy))
+        {
+            close(master);
+            return result;
+        }
+
+        // Keep every CPU busy so the scheduler has to choose.
+        std::atomic<bool> running(true);
+        std::vector<std::thread> load;
+
+        for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+        {
+            load.push_back(std::thread([&running]() {
+                volatile uint64_t spin = 0;
+                while (running) spin++;
+            }));
+        }
+
+        auto next = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < NUM_SAMPLES; ++i)
+        {
+            next += std::chrono::microseconds(SEND_INTERVAL_US);
+            std::this_thread::sleep_until(next);
+
+            int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+            if (write(master, &now, sizeof(now)) != sizeof(now))
+            {
+                ofLogError("ofApp::measure") << "Unable to write to the pseudo terminal.";
+                break;
+            }
+        }
+
+        // Let the last timestamps arrive.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        running = false;
+
+        for (auto& thread: load)
+        {
+            thread.join();
+        }
+
+        probe.stop();
+
+        std::vector<double> samples = probe.samples();
+
+        if (!samples.empty())
+        {
+            std::sort(samples.begin(), samples.end());
+
+            double sum = 0;
+
+            for (double sample: samples)
+            {
+                sum += sample;
+            }
+
+            result.valid = true;
+            result.count = samples.size();
+            result.mean = sum / samples.size();
+            result.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+            result.max = samples.back();
+        }
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("ofApp::measure") << exc.what();
+    }
+
+    close(master);
+#endif
+
+    return result;
+}
+
+
+std::string ofApp::toString(const Result& result)
+{
+    if (!result.valid)
+    {
+        return "no samples";
+    }
+
+    std::stringstream ss;
+    ss << result.count << " samples";
+    ss << ", mean " << ofToString(result.mean, 0) << " us";
+    ss << ", p99 " << ofToString(result.p99, 0) << " us";
+    ss << ", max " << ofToString(result.max, 0) << " us";
+    return ss.str();
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+    ofDrawBitmapStringHighlight("Reader wake-up latency under full CPU load", 20, 20);
+    ofDrawBitmapStringHighlight("Default scheduler: " + toString(normal), 20, 45);
+    ofDrawBitmapStringHighlight("Real-time policy:  " + toString(realtime), 20, 70);
+}
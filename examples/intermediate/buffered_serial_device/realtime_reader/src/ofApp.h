@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+/// \brief A reader thread that records how late each timestamp arrived.
+class LatencyProbe: public ofx::IO::SerialReaderThread
+{
+public:
+    LatencyProbe(std::size_t maxSamples);
+
+    /// \returns the recorded latencies in microseconds.
+    std::vector<double> samples() const;
+
+protected:
+    void bytesRead(const uint8_t* data, std::size_t size) override;
+
+private:
+    /// \brief The partially received timestamp.
+    uint8_t _timestamp[sizeof(int64_t)];
+
+    /// \brief The number of timestamp bytes received.
+    std::size_t _timestampSize = 0;
+
+    /// \brief The preallocated latencies in microseconds.
+    std::vector<double> _samples;
+
+    /// \brief The number of recorded latencies.
+    std::atomic<std::size_t> _sampleCount;
+
+};
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void draw() override;
+
+    /// \brief Reader latency statistics in microseconds.
+    struct Result
+    {
+        bool valid = false;
+        std::size_t count = 0;
+        double mean = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    /// \brief Run the benchmark with a reader thread policy.
+    Result measure(const ofx::IO::ThreadPolicy& policy);
+
+    static std::string toString(const Result& result);
+
+    enum
+    {
+        NUM_SAMPLES = 5000,
+        SEND_INTERVAL_US = 1000
+    };
+
+    Result normal;
+    Result realtime;
+
+};
@@ -0,0 +1,148 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    // This benchmark needs no hardware. It compresses a few typical payloads,
+    // COBS encodes them exactly as ofx::IO::PacketSerialDevice would, and
+    // reports the effective payload throughput at fixed baud rates assuming
+    // 10 bits on the wire per byte (8N1).
+
+    const std::size_t numPackets = 500;
+
+    std::vector<ofx::IO::ByteBuffer> telemetry;
+    std::vector<ofx::IO::ByteBuffer> samples;
+    std::vector<ofx::IO::ByteBuffer> noise;
+
+    for (std::size_t i = 0; i < numPackets; ++i)
+    {
+        std::stringstream ss;
+        ss << "{\"id\":" << i << ",\"temperature\":" << 20 + (i % 5);
+        ss << ",\"humidity\":" << 40 + (i % 3) << ",\"status\":\"ok\"}";
+        telemetry.push_back(ofx::IO::ByteBuffer(ss.str()));
+
+        std::vector<uint8_t> sample;
+
+        for (std::size_t j = 0; j < 128; ++j)
+        {
+            int16_t value = static_cast<int16_t>(1000 * std::sin((i + j) * 0.05));
+            sample.push_back(static_cast<uint8_t>(value & 0xFF));
+            sample.push_back(static_cast<uint8_t>(value >> 8));
+        }
+
+        samples.push_back(ofx::IO::ByteBuffer(sample));
+
+        std::vector<uint8_t> random;
+
+        for (std::size_t j = 0; j < 128; ++j)
+        {
+            random.push_back(static_cast<uint8_t>(ofRandom(256)));
+        }
+
+        noise.push_back(ofx::IO::ByteBuffer(random));
+    }
+
+    std::vector<std::shared_ptr<ofx::IO::AbstractPacketCompression>> compressions = {
+        nullptr,
+        std::make_shared<ofx::IO::LZ4Compression>(),
+        std::make_shared<ofx::IO::HeatshrinkCompression>()
+    };
+
+    for (auto& compression: compressions)
+    {
+        results.push_back(benchmark("telemetry", telemetry, compression));
+        results.push_back(benchmark("samples", samples, compression));
+        results.push_back(benchmark("noise", noise, compression));
+    }
+}
+
+
+BenchmarkResult ofApp::benchmark(const std::string& payloadName,
+                                 const std::vector<ofx::IO::ByteBuffer>& packets,
+                                 std::shared_ptr<ofx::IO::AbstractPacketCompression> compression)
+{
+    BenchmarkResult result;
+    result.payload = payloadName;
+    result.compression = compression != nullptr ? compression->name() : "none";
+
+    ofx::IO::COBSEncoding encoder;
+
+    uint64_t start = ofGetElapsedTimeMicros();
+
+    for (const auto& packet: packets)
+    {
+        ofx::IO::ByteBuffer encoded;
+
+        if (compression != nullptr)
+        {
+            // Mirror the flag byte framing used by PacketSerialDevice_.
+            std::vector<uint8_t> framed(1, ofx::IO::PacketSerialDevice::PACKET_FLAG_COMPRESSED);
+
+            if (!compression->compress(packet.getPtr(), packet.size(), framed))
+            {
+                framed.resize(1);
+                framed[0] = ofx::IO::PacketSerialDevice::PACKET_FLAG_RAW;
+                framed.insert(framed.end(), packet.getPtr(), packet.getPtr() + packet.size());
+            }
+
+            encoder.encode(ofx::IO::ByteBuffer(framed), encoded);
+        }
+        else
+        {
+            encoder.encode(packet, encoded);
+        }
+
+        result.payloadBytes += packet.size();
+        result.wireBytes += encoded.size() + 1; // Include the packet marker.
+    }
+
+    result.microsPerPacket = double(ofGetElapsedTimeMicros() - start) / packets.size();
+
+    ofLogNotice("ofApp::benchmark") << result.payload << " / " << result.compression << ": " << result.payloadBytes << " payload bytes, " << result.wireBytes << " wire bytes, " << result.microsPerPacket << " us/packet";
+
+    return result;
+}
+
+
+void ofApp::draw()
+{
+    ofBackground(0);
+    ofSetColor(255);
+
+    std::stringstream ss;
+
+    ss << "Effective payload throughput (bytes/s, 8N1)" << std::endl << std::endl;
+    ss << std::setw(10) << "payload" << std::setw(12) << "compression" << std::setw(8) << "ratio" << std::setw(10) << "us/pkt";
+
+    for (auto baudRate: baudRates)
+    {
+        ss << std::setw(10) << baudRate;
+    }
+
+    ss << std::endl;
+
+    for (const auto& result: results)
+    {
+        ss << std::setw(10) << result.payload;
+        ss << std::setw(12) << result.compression;
+        ss << std::setw(8) << std::setprecision(3) << double(result.payloadBytes) / result.wireBytes;
+        ss << std::setw(10) << std::setprecision(3) << result.microsPerPacket;
+
+        for (auto baudRate: baudRates)
+        {
+            double wireSeconds = result.wireBytes * 10.0 / baudRate;
+            ss << std::setw(10) << static_cast<uint64_t>(result.payloadBytes / wireSeconds);
+        }
+
+        ss << std::endl;
+    }
+
+    ofDrawBitmapString(ss.str(), ofVec2f(20, 20));
+}
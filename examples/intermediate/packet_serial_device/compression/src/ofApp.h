@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+struct BenchmarkResult
+{
+    std::string payload;
+    std::string compression;
+    std::size_t payloadBytes = 0;
+    std::size_t wireBytes = 0;
+    double microsPerPacket = 0;
+};
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void draw() override;
+
+    BenchmarkResult benchmark(const std::string& payloadName,
+                              const std::vector<ofx::IO::ByteBuffer>& packets,
+                              std::shared_ptr<ofx::IO::AbstractPacketCompression> compression);
+
+    std::vector<BenchmarkResult> results;
+
+    std::vector<uint32_t> baudRates = { 9600, 57600, 115200, 921600 };
+
+};
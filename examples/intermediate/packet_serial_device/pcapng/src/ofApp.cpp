@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+void ofApp::setup()
+{
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::setup") << "Pseudo terminals are not available on Windows.";
+#else
+    // Open a pseudo terminal. The device reads and writes the slave end.
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        ofLogError("ofApp::setup") << "Unable to open a pseudo terminal.";
+        return;
+    }
+
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (!device.setup(ptsname(master), 115200))
+    {
+        return;
+    }
+
+    device.registerAllEvents(this);
+
+    pcapng = std::make_shared<ofx::IO::COBSPcapngSerialTap>();
+
+    if (!pcapng->setup(ofToDataPath("packets.pcapng", true), device.port()))
+    {
+        return;
+    }
+
+    device.setTap(pcapng);
+
+    recording = true;
+    startMillis = ofGetElapsedTimeMillis();
+#endif
+}
+
+
+void ofApp::update()
+{
+#if !defined(TARGET_WIN32)
+    if (!recording)
+    {
+        return;
+    }
+
+    // Play the other side: send a packet and throw away the answers.
+    ofx::IO::ByteBuffer packet("frame " + ofToString(ofGetFrameNum()));
+    ofx::IO::ByteBuffer encoded;
+    encoder.encode(packet, encoded);
+    encoded.writeByte(0);
+
+    if (write(master, encoded.getPtr(), encoded.size()) != static_cast<ssize_t>(encoded.size()))
+    {
+        ofLogError("ofApp::update") << "Unable to write to the pseudo terminal.";
+    }
+
+    uint8_t buffer[256];
+
+    while (read(master, buffer, sizeof(buffer)) > 0)
+    {
+    }
+
+    if (ofGetElapsedTimeMillis() - startMillis > RECORD_MILLIS)
+    {
+        recording = false;
+        device.setTap(nullptr);
+        pcapng->close();
+
+        ofLogNotice("ofApp::update") << "Wrote " << pcapng->packetCount() << " packets, dropped " << pcapng->droppedBytes() << " bytes.";
+    }
+#endif
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    std::stringstream ss;
+    ss << (recording ? "Recording..." : "Done.") << std::endl;
+
+    if (pcapng != nullptr)
+    {
+        ss << pcapng->packetCount() << " packets written" << std::endl;
+        ss << pcapng->droppedBytes() << " bytes dropped";
+    }
+
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+}
+
+
+void ofApp::exit()
+{
+    device.unregisterAllEvents(this);
+
+#if !defined(TARGET_WIN32)
+    if (master != -1)
+    {
+        close(master);
+    }
+#endif
+}
+
+
+void ofApp::onSerialBuffer(const ofx::IO::SerialBufferEventArgs& args)
+{
+    // Answer each packet. The answers are recorded too.
+    ofx::IO::ByteBuffer answer("ack " + args.buffer().toString());
+    device.send(answer);
+}
+
+
+void ofApp::onSerialError(const ofx::IO::SerialBufferErrorEventArgs& args)
+{
+    ofLogError("ofApp::onSerialError") << args.exception().displayText();
+}
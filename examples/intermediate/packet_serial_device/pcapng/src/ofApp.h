@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void exit() override;
+
+    void onSerialBuffer(const ofx::IO::SerialBufferEventArgs& args);
+    void onSerialError(const ofx::IO::SerialBufferErrorEventArgs& args);
+
+    enum
+    {
+        RECORD_MILLIS = 5000
+    };
+
+    ofx::IO::PacketSerialDevice device;
+
+    std::shared_ptr<ofx::IO::COBSPcapngSerialTap> pcapng;
+
+    /// \brief Encodes the packets of the other side.
+    ofx::IO::COBSEncoding encoder;
+
+    /// \brief The pseudo terminal master the app sends packets to.
+    int master = -1;
+
+    /// \brief True while recording.
+    bool recording = false;
+
+    uint64_t startMillis = 0;
+
+};
@@ -0,0 +1,165 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+void ofApp::setup()
+{
+    // Join a running broker, or become the broker.
+    if (!reader.setup(ringName))
+    {
+        setupBroker();
+    }
+}
+
+
+void ofApp::setupBroker()
+{
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::setupBroker") << "Pseudo terminals are not available on Windows.";
+#else
+    // Open a pseudo terminal. The device reads and writes the slave end.
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        ofLogError("ofApp::setupBroker") << "Unable to open a pseudo terminal.";
+        return;
+    }
+
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (!device.setup(ptsname(master), 115200))
+    {
+        return;
+    }
+
+    broker = std::make_shared<ofx::IO::SerialBroker>();
+
+    if (!broker->setup(ringName, RING_SIZE))
+    {
+        return;
+    }
+
+    // Everything the device reads or writes is now published.
+    device.setTap(broker);
+    isBroker = true;
+#endif
+}
+
+
+void ofApp::update()
+{
+    uint8_t buffer[256];
+    std::size_t size = 0;
+
+    if (isBroker)
+    {
+#if !defined(TARGET_WIN32)
+        // Play the sensor.
+        std::string line = "sensor " + ofToString(ofGetFrameNum()) + " " + ofToString(ofNoise(ofGetElapsedTimef()), 3) + "\n";
+
+        if (write(master, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+        {
+            ofLogError("ofApp::update") << "Unable to write to the pseudo terminal.";
+        }
+#endif
+        // The broker reads its device as usual; the tap publishes the bytes.
+        while (device.available() > 0)
+        {
+            size = device.readBytes(buffer, sizeof(buffer));
+            partialLine.append(buffer, buffer + size);
+        }
+    }
+    else
+    {
+        while ((size = reader.readBytes(buffer, sizeof(buffer))) > 0)
+        {
+            partialLine.append(buffer, buffer + size);
+        }
+    }
+
+    std::size_t end = 0;
+
+    while ((end = partialLine.find('\n')) != std::string::npos)
+    {
+        lines.push_back(partialLine.substr(0, end));
+        partialLine.erase(0, end + 1);
+
+        if (lines.size() > MAX_LINES)
+        {
+            lines.pop_front();
+        }
+    }
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    std::string status;
+
+    if (isBroker)
+    {
+        status = "Broker: " + ofToString(broker->frameCount()) + " frames published";
+    }
+    else if (reader.isOpen())
+    {
+        status = "Reader: " + ofToString(reader.overrunCount()) + " overruns";
+
+        if (reader.isBrokerClosed())
+        {
+            status += ", broker closed";
+        }
+    }
+    else
+    {
+        status = "Unable to start.";
+    }
+
+    ofDrawBitmapStringHighlight(status, 20, 20);
+
+    for (std::size_t i = 0; i < lines.size(); ++i)
+    {
+        ofDrawBitmapStringHighlight(lines[i], 20, 60 + i * 25);
+    }
+}
+
+
+void ofApp::exit()
+{
+    device.setTap(nullptr);
+
+    if (broker)
+    {
+        broker->close();
+    }
+
+#if !defined(TARGET_WIN32)
+    if (master != -1)
+    {
+        close(master);
+    }
+#endif
+}
+
+
+void ofApp::keyPressed(int key)
+{
+    if (key == ' ' && !isBroker)
+    {
+        // Fall behind the broker.
+        ofSleepMillis(1000);
+    }
+}
@@ -0,0 +1,55 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void exit() override;
+    void keyPressed(int key) override;
+
+    /// \brief Become the broker of the sensor.
+    void setupBroker();
+
+    enum
+    {
+        /// \brief The size of the shared ring.
+        RING_SIZE = 64 * 1024,
+        /// \brief The number of lines shown.
+        MAX_LINES = 10
+    };
+
+    /// \brief The name of the shared ring.
+    const std::string ringName = "sensor";
+
+    /// \brief True if this copy of the app owns the device.
+    bool isBroker = false;
+
+    ofx::IO::SerialDevice device;
+
+    std::shared_ptr<ofx::IO::SerialBroker> broker;
+
+    ofx::IO::SerialBrokerReader reader;
+
+    /// \brief The pseudo terminal master that plays the sensor.
+    int master = -1;
+
+    /// \brief The partial line being read.
+    std::string partialLine;
+
+    /// \brief The last lines read.
+    std::deque<std::string> lines;
+
+};
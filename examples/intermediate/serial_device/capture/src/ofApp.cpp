@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+void ofApp::setup()
+{
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::setup") << "Pseudo terminals are not available on Windows.";
+#else
+    // Open a pseudo terminal. The device reads and writes the slave end.
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        ofLogError("ofApp::setup") << "Unable to open a pseudo terminal.";
+        return;
+    }
+
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (!device.setup(ptsname(master), 115200))
+    {
+        return;
+    }
+
+    log = std::make_shared<ofx::IO::SerialCaptureLog>();
+
+    if (!log->setup(ofToDataPath("capture", true), FILE_SIZE, MAX_FILES))
+    {
+        return;
+    }
+
+    device.setTap(log);
+
+    recording = true;
+    startMillis = ofGetElapsedTimeMillis();
+#endif
+}
+
+
+void ofApp::update()
+{
+#if !defined(TARGET_WIN32)
+    if (!recording)
+    {
+        return;
+    }
+
+    // Play the other side: send a line and throw away the answers.
+    std::string line = "frame " + ofToString(ofGetFrameNum()) + "\n";
+
+    if (write(master, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+    {
+        ofLogError("ofApp::update") << "Unable to write to the pseudo terminal.";
+    }
+
+    uint8_t buffer[256];
+
+    while (read(master, buffer, sizeof(buffer)) > 0)
+    {
+    }
+
+    // Answer everything that arrived. Both directions are recorded.
+    while (device.available() > 0)
+    {
+        device.readBytes(buffer, sizeof(buffer));
+        device.writeBytes(std::string("ack\n"));
+    }
+
+    if (ofGetElapsedTimeMillis() - startMillis > RECORD_MILLIS)
+    {
+        recording = false;
+        device.setTap(nullptr);
+        log->close();
+        summarize();
+    }
+#endif
+}
+
+
+void ofApp::summarize()
+{
+    std::vector<std::string> files = ofx::IO::SerialCaptureLog::listFiles(ofToDataPath("capture", true));
+
+    ofx::IO::SerialCaptureReader reader;
+
+    if (!reader.setup(files))
+    {
+        summary.push_back("Unable to read the recording.");
+        return;
+    }
+
+    ofx::IO::SerialCaptureReader::Record record;
+
+    std::size_t records = 0;
+    std::size_t rxBytes = 0;
+    std::size_t txBytes = 0;
+    uint64_t first = 0;
+    uint64_t last = 0;
+
+    while (reader.next(record))
+    {
+        if (records++ == 0)
+        {
+            first = record.timestampNanos;
+        }
+
+        last = record.timestampNanos;
+
+        if (record.direction == ofx::IO::AbstractSerialTap::DIRECTION_RX)
+        {
+            rxBytes += record.size;
+        }
+        else
+        {
+            txBytes += record.size;
+        }
+    }
+
+    summary.push_back(ofToString(files.size()) + " files, " + ofToString(records) + " records");
+    summary.push_back("Read " + ofToString(rxBytes) + " bytes, wrote " + ofToString(txBytes) + " bytes");
+    summary.push_back("Recorded over " + ofToString((last - first) / 1000000.0, 1) + " ms");
+    summary.push_back(ofToString(log->droppedBytes()) + " bytes dropped");
+
+    for (const auto& line: summary)
+    {
+        ofLogNotice("ofApp::summarize") << line;
+    }
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    if (recording)
+    {
+        ofDrawBitmapStringHighlight("Recording...", 20, 20);
+        return;
+    }
+
+    for (std::size_t i = 0; i < summary.size(); ++i)
+    {
+        ofDrawBitmapStringHighlight(summary[i], 20, 20 + i * 25);
+    }
+}
+
+
+void ofApp::exit()
+{
+#if !defined(TARGET_WIN32)
+    if (master != -1)
+    {
+        close(master);
+    }
+#endif
+}
@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void exit() override;
+
+    /// \brief Read the recording back and summarize it.
+    void summarize();
+
+    enum
+    {
+        RECORD_MILLIS = 2000,
+        FILE_SIZE = 1024 * 1024,
+        MAX_FILES = 4
+    };
+
+    ofx::IO::SerialDevice device;
+
+    std::shared_ptr<ofx::IO::SerialCaptureLog> log;
+
+    /// \brief The pseudo terminal master the app sends lines to.
+    int master = -1;
+
+    /// \brief True while recording.
+    bool recording = false;
+
+    uint64_t startMillis = 0;
+
+    /// \brief The summary of the recording.
+    std::vector<std::string> summary;
+
+};
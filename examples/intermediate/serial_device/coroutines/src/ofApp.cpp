@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    for (std::size_t i = 0; i < NUM_CABLES; ++i)
+    {
+        auto cable = std::make_unique<Cable>();
+
+        // The first two ports with the same loop:// name are one cable.
+        std::string portName = "loop://instrument" + ofToString(i);
+
+        if (!cable->hostDevice.setup(portName, 115200)
+         || !cable->instrumentDevice.setup(portName, 115200)
+         || !cable->host.setup(loop, cable->hostDevice, '\n')
+         || !cable->instrument.setup(loop, cable->instrumentDevice, '\n'))
+        {
+            ofLogError("ofApp::setup") << "Unable to open " << portName << ".";
+            continue;
+        }
+
+        loop.spawn(instrument(cable->instrument));
+        loop.spawn(poll(cable->host));
+        cables.push_back(std::move(cable));
+    }
+}
+
+
+void ofApp::update()
+{
+    // Resume everything whose read, write or sleep completed, without waiting.
+    loop.runOnce();
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    std::stringstream ss;
+    ss << "Instruments: " << cables.size() << std::endl;
+    ss << "Coroutines: " << loop.taskCount() << std::endl;
+    ss << "Instrument latency (+/-): " << latencyMillis << " ms" << std::endl;
+    ss << "Timeout: " << TIMEOUT_MILLIS << " ms" << std::endl;
+    ss << "Replies: " << replyCount << std::endl;
+    ss << "Timeouts: " << timeoutCount << std::endl;
+    ss << "Late replies skipped: " << lateCount << std::endl;
+
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+}
+
+
+void ofApp::keyPressed(int key)
+{
+    if (key == '+')
+    {
+        latencyMillis *= 2;
+    }
+    else if (key == '-' && latencyMillis > 1)
+    {
+        latencyMillis /= 2;
+    }
+}
+
+
+ofxIO::SerialTask<> ofApp::instrument(ofxIO::AsyncSerialDevice& port)
+{
+    while (port.isOpen())
+    {
+        ofxIO::ByteBuffer request = co_await port.readFrame();
+
+        if (request.size() == 0)
+        {
+            // The port closed.
+            break;
+        }
+
+        co_await loop.sleep(static_cast<uint32_t>(ofRandom(2 * latencyMillis)));
+
+        // Reply with the number of the query.
+        co_await port.write(request.toString().substr(4) + "\n");
+    }
+}
+
+
+ofxIO::SerialTask<> ofApp::poll(ofxIO::AsyncSerialDevice& port)
+{
+    while (port.isOpen())
+    {
+        if (co_await query(port, nextQuery++))
+        {
+            replyCount++;
+        }
+        else
+        {
+            timeoutCount++;
+        }
+    }
+}
+
+
+ofxIO::SerialTask<bool> ofApp::query(ofxIO::AsyncSerialDevice& port, uint64_t number)
+{
+    std::string expected = ofToString(number);
+
+    co_await port.write("get " + expected + "\n");
+
+    for (;;)
+    {
+        ofxIO::AsyncSerialDevice::ReadResult reply = co_await port.readUntil('\n', TIMEOUT_MILLIS);
+
+        if (!reply)
+        {
+            co_return false;
+        }
+
+        if (reply.buffer.toString() == expected)
+        {
+            co_return true;
+        }
+
+        // A reply to a query that already timed out.
+        lateCount++;
+    }
+}
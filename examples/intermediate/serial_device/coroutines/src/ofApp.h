@@ -0,0 +1,75 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+#if !defined(__cpp_impl_coroutine) || !defined(__cpp_lib_coroutine)
+#error "This example needs C++20 coroutines, e.g. -std=c++20."
+#endif
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void keyPressed(int key) override;
+
+    /// \brief Answer queries like a slow instrument.
+    ofxIO::SerialTask<> instrument(ofxIO::AsyncSerialDevice& port);
+
+    /// \brief Query an instrument forever.
+    ofxIO::SerialTask<> poll(ofxIO::AsyncSerialDevice& port);
+
+    /// \brief Send one query and wait for its reply.
+    /// \returns true if the right reply came in time.
+    ofxIO::SerialTask<bool> query(ofxIO::AsyncSerialDevice& port, uint64_t number);
+
+    enum
+    {
+        /// \brief The number of cables.
+        NUM_CABLES = 8,
+
+        /// \brief The longest time a query waits for its reply.
+        TIMEOUT_MILLIS = 100
+    };
+
+    /// \brief One cable between a host and an instrument.
+    struct Cable
+    {
+        ofxIO::SerialDevice hostDevice;
+        ofxIO::SerialDevice instrumentDevice;
+        ofxIO::AsyncSerialDevice host;
+        ofxIO::AsyncSerialDevice instrument;
+    };
+
+    /// \brief Runs all coroutines. Declared first, so it is destroyed last.
+    ofxIO::SerialEventLoop loop;
+
+    std::vector<std::unique_ptr<Cable>> cables;
+
+    /// \brief The mean time an instrument takes to reply.
+    uint32_t latencyMillis = 20;
+
+    /// \brief The number of the next query.
+    uint64_t nextQuery = 0;
+
+    /// \brief The replies that came in time.
+    uint64_t replyCount = 0;
+
+    /// \brief The queries that timed out.
+    uint64_t timeoutCount = 0;
+
+    /// \brief The replies to earlier queries that were skipped.
+    uint64_t lateCount = 0;
+
+};
@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+static int64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void ofApp::setup()
+{
+    for (std::size_t size: { 64, 256, 1024, 4096 })
+    {
+        Result estimate = measure(size, true);
+        Result accumulate = measure(size, false);
+
+        std::stringstream ss;
+        ss << std::setw(4) << size << " bytes | estimate: " << toString(estimate);
+        ss << " | accumulate: " << toString(accumulate);
+
+        lines.push_back(ss.str());
+        ofLogNotice("ofApp::setup") << lines.back();
+    }
+}
+
+
+ofApp::Result ofApp::measure(std::size_t size, bool estimate)
+{
+    Result result;
+    result.size = size;
+
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::measure") << "Pseudo terminals are not available on Windows.";
+#else
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        ofLogError("ofApp::measure") << "Unable to open a pseudo terminal.";
+        if (master != -1) close(master);
+        return result;
+    }
+
+    try
+    {
+        serial::Serial port(ptsname(master), 115200, serial::Timeout::simpleTimeout(1000));
+
+        std::vector<uint8_t> block(size, 'x');
+        std::vector<uint8_t> buffer(size);
+        std::vector<double> delays;
+
+        for (std::size_t i = 0; i < NUM_READS; ++i)
+        {
+            std::atomic<int64_t> lastByteTime(0);
+
+            std::thread writer([&]() {
+                for (std::size_t offset = 0; offset < size; offset += BURST_SIZE)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(BURST_INTERVAL_US));
+
+                    std::size_t count = std::min<std::size_t>(BURST_SIZE, size - offset);
+
+                    if (write(master, block.data() + offset, count) != ssize_t(count))
+                    {
+                        break;
+                    }
+                }
+
+                lastByteTime = nowNanos();
+            });
+
+            std::size_t received = 0;
+
+            if (estimate)
+            {
+                // The previous strategy: once readable, sleep for the nominal
+                // transmit time of everything still missing, then read.
+                while (received < size && port.waitReadable(1000))
+                {
+                    std::size_t available = port.available();
+
+                    if (available + received < size)
+                    {
+                        port.waitByteTimes(size - (available + received));
+                    }
+
+                    received += port.read(buffer.data() + received, std::min(port.available(), size - received));
+                }
+            }
+            else
+            {
+                received = port.read(buffer.data(), size);
+            }
+
+            int64_t returned = nowNanos();
+
+            writer.join();
+
+            if (received == size)
+            {
+                delays.push_back((returned - lastByteTime) / 1000.0);
+            }
+        }
+
+        if (!delays.empty())
+        {
+            std::sort(delays.begin(), delays.end());
+            result.median = delays[delays.size() / 2];
+            result.p99 = delays[std::min(delays.size() - 1, delays.size() * 99 / 100)];
+            result.max = delays.back();
+        }
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("ofApp::measure") << exc.what();
+    }
+
+    close(master);
+#endif
+
+    return result;
+}
+
+
+std::string ofApp::toString(const Result& result)
+{
+    std::stringstream ss;
+    ss << "median " << ofToString(result.median, 0) << " us";
+    ss << ", p99 " << ofToString(result.p99, 0) << " us";
+    ss << ", max " << ofToString(result.max, 0) << " us";
+    return ss.str();
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+    ofDrawBitmapStringHighlight("Delay between the last byte and the read returning", 20, 20);
+
+    for (std::size_t i = 0; i < lines.size(); ++i)
+    {
+        ofDrawBitmapStringHighlight(lines[i], 20, 45 + i * 25);
+    }
+}
@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void draw() override;
+
+    /// \brief Read delay statistics in microseconds.
+    struct Result
+    {
+        std::size_t size = 0;
+        double median = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    /// \brief Measure fixed size reads.
+    /// \param size The number of bytes per read.
+    /// \param estimate True to sleep for the estimated byte time first.
+    Result measure(std::size_t size, bool estimate);
+
+    static std::string toString(const Result& result);
+
+    enum
+    {
+        NUM_READS = 100,
+        BURST_SIZE = 64,
+        BURST_INTERVAL_US = 250
+    };
+
+    std::vector<std::string> lines;
+
+};
@@ -0,0 +1,22 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+// Echo every byte as soon as it arrives. Unlike the basic Echo sketch there
+// is no delay in the loop, so the measured time is dominated by the host.
+void setup()
+{
+  Serial.begin(115200);
+}
+
+
+void loop()
+{
+  if (Serial.available() > 0)
+  {
+      Serial.write(Serial.read());
+  }
+}
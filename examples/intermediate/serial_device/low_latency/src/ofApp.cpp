@@ -0,0 +1,149 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    // 1. Upload the `LatencyEcho.ino` sketch (in this example's `Arduino/`
+    // folder) to an Arduino-compatible board.
+    //
+    // 2. Run this app.
+
+    std::vector<ofx::IO::SerialDeviceInfo> devicesInfo = ofx::IO::SerialDeviceUtils::listDevices();
+
+    if (devicesInfo.empty())
+    {
+        ofLogNotice("ofApp::setup") << "No devices connected.";
+        return;
+    }
+
+    ofx::IO::SerialDevice::Settings settings;
+    settings.portName = devicesInfo[0].port();
+    settings.baudRate = 115200;
+
+    if (!device.setup(settings))
+    {
+        ofLogNotice("ofApp::setup") << "Unable to setup " << devicesInfo[0];
+        return;
+    }
+
+    // Give boards that reset when the port is opened time to start.
+    ofSleepMillis(2000);
+
+    normal = measure(false);
+    lowLatency = measure(true);
+
+    ofLogNotice("ofApp::setup") << "Normal:      " << toString(normal);
+    ofLogNotice("ofApp::setup") << "Low latency: " << toString(lowLatency);
+
+    if (lowLatency.supported && lowLatency.mean > 0)
+    {
+        ofLogNotice("ofApp::setup") << "Mean round trip improved " << ofToString(normal.mean / lowLatency.mean, 1) << "x.";
+    }
+
+    device.setLowLatency(false);
+}
+
+
+ofApp::Result ofApp::measure(bool enabled)
+{
+    Result result;
+    result.supported = device.setLowLatency(enabled);
+
+    device.flushInput();
+
+    std::vector<double> samples;
+    samples.reserve(NUM_PINGS);
+
+    for (std::size_t i = 0; i < NUM_PINGS; ++i)
+    {
+        uint8_t ping = uint8_t(i);
+        uint8_t pong = 0;
+        bool received = false;
+
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::milliseconds(PING_TIMEOUT_MS);
+
+        device.writeByte(ping);
+
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            if (device.available() > 0 && device.readByte(pong) == 1)
+            {
+                received = (pong == ping);
+                break;
+            }
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        if (received)
+        {
+            samples.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+        }
+        else
+        {
+            result.lost++;
+            device.flushInput();
+        }
+    }
+
+    if (!samples.empty())
+    {
+        std::sort(samples.begin(), samples.end());
+
+        double sum = 0;
+
+        for (double sample: samples)
+        {
+            sum += sample;
+        }
+
+        result.mean = sum / samples.size();
+        result.median = samples[samples.size() / 2];
+        result.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+        result.max = samples.back();
+    }
+
+    return result;
+}
+
+
+std::string ofApp::toString(const Result& result)
+{
+    std::stringstream ss;
+    ss << "mean " << ofToString(result.mean, 0) << " us";
+    ss << ", median " << ofToString(result.median, 0) << " us";
+    ss << ", p99 " << ofToString(result.p99, 0) << " us";
+    ss << ", max " << ofToString(result.max, 0) << " us";
+    ss << ", lost " << result.lost;
+
+    if (!result.supported)
+    {
+        ss << " (not supported)";
+    }
+
+    return ss.str();
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    if (!device.isOpen())
+    {
+        ofDrawBitmapStringHighlight("No device. See Console.", 20, 20);
+        return;
+    }
+
+    ofDrawBitmapStringHighlight("Round trip of " + ofToString(NUM_PINGS) + " pings on " + device.port(), 20, 20);
+    ofDrawBitmapStringHighlight("Normal:      " + toString(normal), 20, 45);
+    ofDrawBitmapStringHighlight("Low latency: " + toString(lowLatency), 20, 70);
+}
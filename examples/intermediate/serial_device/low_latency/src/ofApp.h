@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void draw() override;
+
+    /// \brief Round trip statistics in microseconds.
+    struct Result
+    {
+        bool supported = false;
+        std::size_t lost = 0;
+        double mean = 0;
+        double median = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    /// \brief Measure the round trip time of single byte pings.
+    Result measure(bool lowLatency);
+
+    static std::string toString(const Result& result);
+
+    enum
+    {
+        NUM_PINGS = 500,
+        PING_TIMEOUT_MS = 500
+    };
+
+    ofx::IO::SerialDevice device;
+
+    Result normal;
+    Result lowLatency;
+
+};
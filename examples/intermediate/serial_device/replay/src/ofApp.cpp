@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#include "Poco/File.h"
+
+
+void ofApp::setup()
+{
+    path = ofToDataPath("replay", true);
+
+    if (!record())
+    {
+        return;
+    }
+
+    // Parse the whole recording without waiting for its timing.
+    device.setup(path, ofx::IO::ReplaySerialDevice::SPEED_UNLIMITED);
+
+    uint64_t start = ofGetElapsedTimeMicros();
+    std::size_t bytes = 0;
+    std::size_t count = 0;
+
+    while (!device.isFinished())
+    {
+        std::size_t offset = buffer.size();
+        buffer.resize(offset + device.available());
+        bytes += device.readBytes(buffer.data() + offset, buffer.size() - offset);
+        count += decode();
+    }
+
+    uint64_t micros = std::max<uint64_t>(ofGetElapsedTimeMicros() - start, 1);
+
+    benchmark = "Decoded " + ofToString(count) + " packets, " + ofToString(bytes) + " bytes in " + ofToString(micros / 1000.0, 1) + " ms (" + ofToString(bytes / double(micros), 1) + " MB/s)";
+
+    ofLogNotice("ofApp::setup") << benchmark;
+
+    // Now play it back as it was recorded.
+    device.setup(path, 1);
+}
+
+
+void ofApp::update()
+{
+    std::size_t offset = buffer.size();
+    buffer.resize(offset + device.available());
+    device.readBytes(buffer.data() + offset, buffer.size() - offset);
+    packets += decode();
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    std::stringstream ss;
+    ss << benchmark << std::endl;
+    ss << "Playing at " << (device.speed() == ofx::IO::ReplaySerialDevice::SPEED_UNLIMITED ? "unlimited" : ofToString(device.speed())) << " speed" << std::endl;
+    ss << packets << " / " << PACKET_COUNT << " packets" << (device.isFinished() ? ", finished" : "");
+
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+}
+
+
+void ofApp::keyPressed(int key)
+{
+    if (key == '0' || key == '1' || key == '2')
+    {
+        device.setup(path, key - '0');
+        buffer.clear();
+        packets = 0;
+    }
+}
+
+
+bool ofApp::record()
+{
+    // Start from an empty recording.
+    for (const auto& file: ofx::IO::SerialCaptureLog::listFiles(path))
+    {
+        Poco::File(file).remove();
+    }
+
+    ofx::IO::SerialCaptureLog log;
+
+    if (!log.setup(path))
+    {
+        return false;
+    }
+
+    ofx::IO::ByteBuffer packet;
+    ofx::IO::ByteBuffer encoded;
+
+    for (std::size_t i = 0; i < PACKET_COUNT; ++i)
+    {
+        packet.clear();
+
+        for (std::size_t j = 0; j < PACKET_SIZE; ++j)
+        {
+            packet.writeByte(static_cast<uint8_t>(i + j));
+        }
+
+        encoded.clear();
+        encoder.encode(packet, encoded);
+        encoded.writeByte(0);
+
+        log.tap(ofx::IO::AbstractSerialTap::DIRECTION_RX,
+                i * PACKET_INTERVAL_NANOS,
+                encoded.getPtr(),
+                encoded.size());
+    }
+
+    return true;
+}
+
+
+std::size_t ofApp::decode()
+{
+    std::size_t count = 0;
+    auto begin = buffer.begin();
+    auto end = std::find(begin, buffer.end(), 0);
+
+    while (end != buffer.end())
+    {
+        ofx::IO::ByteBuffer decoded;
+        encoder.decode(ofx::IO::ByteBuffer(&*begin, end - begin), decoded);
+        ++count;
+
+        begin = end + 1;
+        end = std::find(begin, buffer.end(), 0);
+    }
+
+    buffer.erase(buffer.begin(), begin);
+    return count;
+}
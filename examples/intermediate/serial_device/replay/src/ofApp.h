@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void keyPressed(int key) override;
+
+    /// \brief Write a recording of COBS packets.
+    bool record();
+
+    /// \brief Decode the complete packets in the buffer.
+    /// \returns the number of packets decoded.
+    std::size_t decode();
+
+    enum
+    {
+        PACKET_COUNT = 10000,
+        PACKET_SIZE = 64,
+        PACKET_INTERVAL_NANOS = 1000000
+    };
+
+    ofx::IO::ReplaySerialDevice device;
+
+    ofx::IO::COBSEncoding encoder;
+
+    /// \brief Received bytes that do not form a packet yet.
+    std::vector<uint8_t> buffer;
+
+    /// \brief The path of the recording.
+    std::string path;
+
+    /// \brief The result of the benchmark.
+    std::string benchmark;
+
+    /// \brief The packets decoded during playback.
+    std::size_t packets = 0;
+
+};
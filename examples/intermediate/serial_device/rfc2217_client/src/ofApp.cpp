@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    // The settings are sent to the server when the port opens.
+    if (!device.setup(PORT_NAME, 115200))
+    {
+        ofLogError("ofApp::setup") << "Unable to open " << PORT_NAME << ".";
+    }
+}
+
+
+void ofApp::update()
+{
+    if (!device.isOpen())
+    {
+        return;
+    }
+
+    try
+    {
+        uint8_t buffer[256];
+
+        while (device.available() > 0)
+        {
+            std::size_t count = device.readBytes(buffer, std::min<std::size_t>(device.available(), sizeof(buffer)));
+            line.append(reinterpret_cast<const char*>(buffer), count);
+        }
+
+        std::size_t end = line.find('\n');
+
+        if (end != std::string::npos)
+        {
+            roundTripMicros = ofGetElapsedTimeMicros() - sentMicros;
+            answer = ofTrim(line.substr(0, end));
+            line.erase(0, end + 1);
+        }
+
+        if (ofGetElapsedTimeMicros() - sentMicros > 1000000)
+        {
+            std::string text = "frame " + ofToString(ofGetFrameNum()) + "\n";
+            sentMicros = ofGetElapsedTimeMicros();
+            device.writeBytes(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        }
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("ofApp::update") << exc.what();
+        device.serial()->close();
+    }
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    std::stringstream ss;
+
+    if (device.isOpen())
+    {
+        ss << PORT_NAME << ", " << device.baudRate() << " baud" << std::endl;
+        ss << "Answer: " << answer << std::endl;
+        ss << "Round trip: " << roundTripMicros << " us" << std::endl;
+        ss << "DTR " << dtr << " RTS " << rts << std::endl;
+        ss << "CTS " << device.isClearToSend() << " DSR " << device.isDataSetReady();
+        ss << " RI " << device.isRingIndicated() << " CD " << device.isCarrierDetected() << std::endl;
+        ss << std::endl;
+        ss << "b: baud rate, d: DTR, r: RTS";
+    }
+    else
+    {
+        ss << PORT_NAME << " is not open.";
+    }
+
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+}
+
+
+void ofApp::keyPressed(int key)
+{
+    if (!device.isOpen())
+    {
+        return;
+    }
+
+    // None of these wait for the server's answer.
+    if (key == 'b')
+    {
+        device.serial()->setBaudrate(device.baudRate() == 115200 ? 9600 : 115200);
+    }
+    else if (key == 'd')
+    {
+        dtr = !dtr;
+        device.setDataTerminalReady(dtr);
+    }
+    else if (key == 'r')
+    {
+        rts = !rts;
+        device.setRequestToSend(rts);
+    }
+}
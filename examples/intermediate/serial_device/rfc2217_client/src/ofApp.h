@@ -0,0 +1,42 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void keyPressed(int key) override;
+
+    /// \brief The remote port.
+    const std::string PORT_NAME = "rfc2217://localhost:2217";
+
+    ofx::IO::SerialDevice device;
+
+    /// \brief The partial answer.
+    std::string line;
+
+    /// \brief The last answer.
+    std::string answer;
+
+    /// \brief When the last line was sent.
+    uint64_t sentMicros = 0;
+
+    /// \brief The round trip time of the last answer.
+    uint64_t roundTripMicros = 0;
+
+    bool dtr = true;
+    bool rts = true;
+
+};
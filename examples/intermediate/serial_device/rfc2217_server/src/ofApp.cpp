@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+void ofApp::setup()
+{
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::setup") << "Pseudo terminals are not available on Windows.";
+#else
+    std::vector<ofx::IO::SerialDevice*> devices = { &device, &rawDevice };
+
+    for (auto* shared: devices)
+    {
+        // Open a pseudo terminal. The device is the slave end.
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+        if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+        {
+            ofLogError("ofApp::setup") << "Unable to open a pseudo terminal.";
+            return;
+        }
+
+        fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+        if (!shared->setup(ptsname(master), 9600))
+        {
+            return;
+        }
+
+        masters.push_back(master);
+        lines.push_back("");
+    }
+
+    server.addDevice(&device, RFC2217_PORT);
+    server.addDevice(&rawDevice, RAW_PORT, ofx::IO::RFC2217Server::MODE_RAW);
+    server.start();
+#endif
+}
+
+
+void ofApp::update()
+{
+#if !defined(TARGET_WIN32)
+    // Play the other side: answer each line in upper case.
+    for (std::size_t i = 0; i < masters.size(); ++i)
+    {
+        char buffer[256];
+        ssize_t count = 0;
+
+        while ((count = read(masters[i], buffer, sizeof(buffer))) > 0)
+        {
+            lines[i].append(buffer, count);
+        }
+
+        std::size_t end = 0;
+
+        while ((end = lines[i].find_first_of("\r\n")) != std::string::npos)
+        {
+            std::string answer = ofToUpper(lines[i].substr(0, end)) + "\r\n";
+            lines[i].erase(0, end + 1);
+
+            if (write(masters[i], answer.data(), answer.size()) != static_cast<ssize_t>(answer.size()))
+            {
+                ofLogError("ofApp::update") << "Unable to write to the pseudo terminal.";
+            }
+        }
+    }
+#endif
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    std::stringstream ss;
+
+    if (server.isRunning())
+    {
+        ss << "RFC 2217 on port " << server.port(0) << ", " << device.baudRate() << " baud" << std::endl;
+        ss << "Raw bridge on port " << server.port(1) << std::endl;
+        ss << server.clientCount() << " clients" << std::endl;
+        ss << server.splicedBytes() << " bytes spliced, " << server.copiedBytes() << " bytes copied";
+    }
+    else
+    {
+        ss << "The server is not running.";
+    }
+
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+}
+
+
+void ofApp::exit()
+{
+    server.close();
+
+#if !defined(TARGET_WIN32)
+    for (int master: masters)
+    {
+        close(master);
+    }
+#endif
+}
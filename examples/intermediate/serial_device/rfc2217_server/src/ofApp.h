@@ -0,0 +1,42 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void exit() override;
+
+    enum
+    {
+        RFC2217_PORT = 2217,
+        RAW_PORT = 2218
+    };
+
+    /// \brief The device shared over RFC 2217.
+    ofx::IO::SerialDevice device;
+
+    /// \brief The device shared as a raw bridge.
+    ofx::IO::SerialDevice rawDevice;
+
+    ofx::IO::RFC2217Server server;
+
+    /// \brief The pseudo terminal masters the app answers on.
+    std::vector<int> masters;
+
+    /// \brief The partial lines received on each master.
+    std::vector<std::string> lines;
+
+};
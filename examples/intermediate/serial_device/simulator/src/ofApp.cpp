@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    ofx::IO::SerialSimulator::Settings settings;
+    settings.baudRate = 9600;
+    settings.echo = true;
+
+    if (!simulator.setup(settings))
+    {
+        return;
+    }
+
+    if (!device.setup(simulator.openPort()))
+    {
+        ofLogError("ofApp::setup") << "Unable to open " << simulator.portName() << ".";
+        return;
+    }
+
+    device.serial()->setFlowcontrol(serial::flowcontrol_hardware);
+}
+
+
+void ofApp::update()
+{
+    if (!device.isOpen())
+    {
+        return;
+    }
+
+    uint8_t buffer[256];
+
+    while (device.available() > 0)
+    {
+        std::size_t size = device.readBytes(buffer, sizeof(buffer));
+        echo.append(buffer, buffer + size);
+    }
+
+    if (!sentLine.empty() && echo.size() >= sentLine.size())
+    {
+        roundTripMicros = ofGetElapsedTimeMicros() - sentMicros;
+
+        if (echo.compare(0, sentLine.size(), sentLine) != 0)
+        {
+            errorCount++;
+        }
+
+        sentLine.clear();
+        echo.clear();
+    }
+
+    // Bytes lost on a noisy line never arrive; give up after a second.
+    if (!sentLine.empty() && ofGetElapsedTimeMicros() - sentMicros > 1000000)
+    {
+        errorCount++;
+        sentLine.clear();
+        echo.clear();
+    }
+
+    if (sentLine.empty())
+    {
+        sentLine = "frame " + ofToString(ofGetFrameNum(), 10, '0') + " at 9600 baud\n";
+        sentMicros = ofGetElapsedTimeMicros();
+        device.writeBytes(sentLine);
+    }
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    if (!device.isOpen())
+    {
+        ofDrawBitmapStringHighlight("Unable to start the simulator.", 20, 20);
+        return;
+    }
+
+    ofx::IO::SerialSimulator::Statistics statistics = simulator.statistics();
+
+    std::stringstream ss;
+    ss << "Port: " << simulator.portName() << std::endl;
+    ss << "Round trip: " << roundTripMicros / 1000.0 << " ms" << std::endl;
+    ss << "Bad echoes: " << errorCount << std::endl;
+    ss << "Corrupted bytes: " << statistics.corruptedBytes << std::endl;
+    ss << "Dropped bytes: " << statistics.droppedBytes << std::endl;
+    ss << "Noise (n): " << (noisy ? "on" : "off") << std::endl;
+    ss << "CTS (c): " << (clearToSend ? "high" : "low") << std::endl;
+
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+}
+
+
+void ofApp::keyPressed(int key)
+{
+    if (key == 'n')
+    {
+        noisy = !noisy;
+
+        ofx::IO::SerialSimulator::Impairments impairments;
+
+        if (noisy)
+        {
+            impairments.bitErrorRate = 0.0005;
+            impairments.dropRate = 0.001;
+            impairments.burstRate = 0.0005;
+        }
+
+        simulator.setImpairments(impairments, impairments);
+    }
+    else if (key == 'c')
+    {
+        clearToSend = !clearToSend;
+        simulator.setClearToSend(clearToSend);
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void keyPressed(int key) override;
+
+    ofx::IO::SerialSimulator simulator;
+
+    ofx::IO::SerialDevice device;
+
+    /// \brief The line waiting for its echo, or empty.
+    std::string sentLine;
+
+    /// \brief The echo received so far.
+    std::string echo;
+
+    /// \brief The time the line was sent.
+    uint64_t sentMicros = 0;
+
+    /// \brief The round trip of the last line.
+    uint64_t roundTripMicros = 0;
+
+    /// \brief The number of echoes that did not match.
+    std::size_t errorCount = 0;
+
+    /// \brief True while the line is noisy.
+    bool noisy = false;
+
+    /// \brief The CTS level set on the simulated device.
+    bool clearToSend = true;
+
+};
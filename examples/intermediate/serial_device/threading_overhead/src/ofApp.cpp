@@ -0,0 +1,101 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+void ofApp::setup()
+{
+    // Alternate the runs so that neither mode benefits from a warm cache.
+    measure(ofx::IO::SerialDevice::THREADING_MULTI);
+    multi = measure(ofx::IO::SerialDevice::THREADING_MULTI);
+    single = measure(ofx::IO::SerialDevice::THREADING_SINGLE);
+
+    ofLogNotice("ofApp::setup") << "Multi:  read " << ofToString(multi.read, 0) << " ns, write " << ofToString(multi.write, 0) << " ns";
+    ofLogNotice("ofApp::setup") << "Single: read " << ofToString(single.read, 0) << " ns, write " << ofToString(single.write, 0) << " ns";
+}
+
+
+ofApp::Result ofApp::measure(ofx::IO::SerialDevice::ThreadingMode mode)
+{
+    Result result;
+
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::measure") << "Pseudo terminals are not available on Windows.";
+#else
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        ofLogError("ofApp::measure") << "Unable to open a pseudo terminal.";
+        if (master != -1) close(master);
+        return result;
+    }
+
+    ofx::IO::SerialDevice device;
+
+    ofx::IO::SerialDevice::Settings settings;
+    settings.portName = ptsname(master);
+    settings.baudRate = 115200;
+    settings.threadingMode = mode;
+
+    if (device.setup(settings))
+    {
+        uint8_t byte = 0;
+
+        // Non-blocking reads of an empty port.
+        auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < NUM_CALLS; ++i)
+        {
+            device.readBytes(&byte, 1);
+        }
+
+        result.read = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / NUM_CALLS;
+
+        // Single byte writes, drained from the other end.
+        fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+        std::atomic<bool> draining(true);
+
+        std::thread drain([&]() {
+            uint8_t buffer[4096];
+            while (draining) read(master, buffer, sizeof(buffer));
+        });
+
+        start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < NUM_CALLS; ++i)
+        {
+            device.writeByte(byte);
+        }
+
+        result.write = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / NUM_CALLS;
+
+        draining = false;
+        drain.join();
+    }
+
+    close(master);
+#endif
+
+    return result;
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+    ofDrawBitmapStringHighlight("Per-call cost of 1 byte reads and writes", 20, 20);
+    ofDrawBitmapStringHighlight("THREADING_MULTI:  read " + ofToString(multi.read, 0) + " ns, write " + ofToString(multi.write, 0) + " ns", 20, 45);
+    ofDrawBitmapStringHighlight("THREADING_SINGLE: read " + ofToString(single.read, 0) + " ns, write " + ofToString(single.write, 0) + " ns", 20, 70);
+}
@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void draw() override;
+
+    /// \brief Per-call cost in nanoseconds.
+    struct Result
+    {
+        double read = 0;
+        double write = 0;
+    };
+
+    /// \brief Measure single byte reads and writes.
+    /// \param mode The threading mode of the device.
+    Result measure(ofx::IO::SerialDevice::ThreadingMode mode);
+
+    enum
+    {
+        NUM_CALLS = 200000
+    };
+
+    Result multi;
+    Result single;
+
+};
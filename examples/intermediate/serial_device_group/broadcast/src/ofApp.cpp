@@ -0,0 +1,123 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+void ofApp::setup()
+{
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::setup") << "Pseudo terminals are not available on Windows.";
+#else
+    std::vector<ofx::IO::SerialDevice*> members;
+
+    for (std::size_t i = 0; i < NUM_DEVICES; ++i)
+    {
+        // Open a pseudo terminal. The group writes to the slave end.
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+        if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+        {
+            ofLogError("ofApp::setup") << "Unable to open a pseudo terminal.";
+            if (master != -1) close(master);
+            break;
+        }
+
+        // Drain the master without blocking.
+        fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+        std::unique_ptr<ofx::IO::SerialDevice> device(new ofx::IO::SerialDevice());
+
+        if (!device->setup(ptsname(master), 115200))
+        {
+            close(master);
+            break;
+        }
+
+        masters.push_back(master);
+        members.push_back(device.get());
+        devices.push_back(std::move(device));
+    }
+
+    group.setup(members);
+
+    for (std::size_t i = 0; i < PACKET_SIZE; ++i)
+    {
+        packet.writeByte(static_cast<uint8_t>(i));
+    }
+#endif
+}
+
+
+void ofApp::update()
+{
+#if !defined(TARGET_WIN32)
+    if (group.size() == 0)
+    {
+        return;
+    }
+
+    const ofx::IO::SerialDeviceGroup::WriteResult& result = group.broadcast(packet);
+
+    if (!result.ok())
+    {
+        for (const auto& port: result.ports)
+        {
+            if (!port.result.ok())
+            {
+                ofLogError("ofApp::update") << port.result.message();
+            }
+        }
+    }
+
+    startSkew = result.startSkewNanos;
+    endSkew = result.endSkewNanos;
+    maxStartSkew = std::max(maxStartSkew, startSkew);
+
+    // Throw away what the devices received.
+    uint8_t buffer[4096];
+
+    for (int master: masters)
+    {
+        while (read(master, buffer, sizeof(buffer)) > 0)
+        {
+        }
+    }
+#endif
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    std::stringstream ss;
+    ss << "Broadcasting " << PACKET_SIZE << " bytes to " << group.size() << " devices";
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+    ofDrawBitmapStringHighlight("Start skew: " + ofToString(startSkew / 1000.0, 1) + " us", 20, 45);
+    ofDrawBitmapStringHighlight("End skew:   " + ofToString(endSkew / 1000.0, 1) + " us", 20, 70);
+    ofDrawBitmapStringHighlight("Worst start skew: " + ofToString(maxStartSkew / 1000.0, 1) + " us", 20, 95);
+}
+
+
+void ofApp::exit()
+{
+    group.close();
+    devices.clear();
+
+#if !defined(TARGET_WIN32)
+    for (int master: masters)
+    {
+        close(master);
+    }
+#endif
+}
@@ -0,0 +1,46 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void exit() override;
+
+    enum
+    {
+        NUM_DEVICES = 16,
+        PACKET_SIZE = 512
+    };
+
+    /// \brief The devices, one per pseudo terminal.
+    std::vector<std::unique_ptr<ofx::IO::SerialDevice>> devices;
+
+    /// \brief The pseudo terminal masters the app drains.
+    std::vector<int> masters;
+
+    ofx::IO::PacketSerialDeviceGroup group;
+
+    /// \brief The packet sent every frame.
+    ofx::IO::ByteBuffer packet;
+
+    /// \brief The skew of the last broadcast in nanoseconds.
+    int64_t startSkew = 0;
+    int64_t endSkew = 0;
+
+    /// \brief The worst skew so far in nanoseconds.
+    int64_t maxStartSkew = 0;
+
+};
@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofApp.h"
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+
+void ofApp::setup()
+{
+#if defined(TARGET_WIN32)
+    ofLogError("ofApp::setup") << "Pseudo terminals are not available on Windows.";
+#else
+    std::vector<ofx::IO::SerialDevice::Settings> settings;
+
+    for (std::size_t i = 0; i < NUM_DEVICES; ++i)
+    {
+        // Open a pseudo terminal. The manager reads the slave end like a port.
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+        if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0)
+        {
+            ofLogError("ofApp::setup") << "Unable to open a pseudo terminal.";
+            if (master != -1) close(master);
+            break;
+        }
+
+        masters.push_back(master);
+
+        ofx::IO::SerialDevice::Settings deviceSettings;
+        deviceSettings.portName = ptsname(master);
+        deviceSettings.baudRate = 115200;
+        settings.push_back(deviceSettings);
+    }
+
+    bufferCounts.resize(settings.size(), 0);
+
+    manager.registerAllEvents(this);
+
+    uint64_t start = ofGetElapsedTimeMillis();
+    std::size_t opened = manager.setup(settings, NUM_WORKERS);
+    setupMillis = ofGetElapsedTimeMillis() - start;
+
+    ofLogNotice("ofApp::setup") << "Opened " << opened << " of " << settings.size() << " devices in " << setupMillis << " ms.";
+
+    // The ports are opened concurrently, so the total is close to the
+    // slowest port rather than the sum of all of them.
+    for (const auto& result: manager.setupResults())
+    {
+        ofLogVerbose("ofApp::setup") << result.portName << (result.success ? " opened in " : " failed after ") << result.micros << " us.";
+    }
+#endif
+}
+
+
+void ofApp::update()
+{
+#if !defined(TARGET_WIN32)
+    if (masters.empty())
+    {
+        return;
+    }
+
+    std::string line = "frame " + ofToString(ofGetFrameNum()) + "\n";
+
+    for (std::size_t i = 0; i < ACTIVE_DEVICES; ++i)
+    {
+        int master = masters[std::rand() % masters.size()];
+
+        if (write(master, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+        {
+            ofLogError("ofApp::update") << "Unable to write to a pseudo terminal.";
+        }
+    }
+#endif
+}
+
+
+void ofApp::draw()
+{
+    ofBackgroundGradient(ofColor::white, ofColor::black);
+
+    std::stringstream ss;
+    ss << manager.openCount() << " devices opened in " << setupMillis << " ms, ";
+    ss << manager.workerCount() << " reactor threads";
+    ofDrawBitmapStringHighlight(ss.str(), 20, 20);
+
+    for (std::size_t i = 0; i < bufferCounts.size(); ++i)
+    {
+        int x = 20 + (i % 4) * 150;
+        int y = 50 + (i / 4) * 25;
+        ofDrawBitmapStringHighlight(ofToString(i) + ": " + ofToString(bufferCounts[i]), x, y);
+    }
+}
+
+
+void ofApp::exit()
+{
+    manager.unregisterAllEvents(this);
+    manager.close();
+
+#if !defined(TARGET_WIN32)
+    for (int master: masters)
+    {
+        close(master);
+    }
+#endif
+}
+
+
+void ofApp::onSerialBuffer(const ofx::IO::SerialBufferEventArgs& args)
+{
+    std::size_t index = manager.index(args.device());
+
+    if (index < bufferCounts.size())
+    {
+        bufferCounts[index]++;
+    }
+}
+
+
+void ofApp::onSerialError(const ofx::IO::SerialBufferErrorEventArgs& args)
+{
+    ofLogError("ofApp::onSerialError") << args.device().port() << ": " << args.exception().displayText();
+}
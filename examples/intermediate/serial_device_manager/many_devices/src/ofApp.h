@@ -0,0 +1,44 @@
+//
+// Copyright (c) 2014 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxSerial.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void exit() override;
+
+    void onSerialBuffer(const ofx::IO::SerialBufferEventArgs& args);
+    void onSerialError(const ofx::IO::SerialBufferErrorEventArgs& args);
+
+    enum
+    {
+        NUM_DEVICES = 48,
+        NUM_WORKERS = 2,
+        /// \brief The number of devices written to each frame.
+        ACTIVE_DEVICES = 4
+    };
+
+    ofx::IO::SerialDeviceManager manager;
+
+    /// \brief The pseudo terminal masters the app writes to.
+    std::vector<int> masters;
+
+    /// \brief The number of buffers received from each device.
+    std::vector<uint64_t> bufferCounts;
+
+    /// \brief The time taken to open all devices.
+    uint64_t setupMillis = 0;
+
+};
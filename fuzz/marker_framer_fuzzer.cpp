@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include <cstdlib>
+#include <vector>
+#include "ofx/IO/SerialFraming.h"
+
+
+namespace {
+
+
+/// \brief A frame or an overflow, in the order it was reported.
+struct FrameEvent
+{
+    bool overflow;
+    std::vector<uint8_t> bytes;
+
+    bool operator == (const FrameEvent& other) const
+    {
+        return overflow == other.overflow && bytes == other.bytes;
+    }
+};
+
+
+/// \brief The byte at a time framer of BufferedSerialDevice::processBytes()
+/// before MarkerFramer, kept as the reference.
+void referenceProcess(uint8_t marker,
+                      std::size_t maxBufferSize,
+                      std::vector<uint8_t>& buffer,
+                      const uint8_t* data,
+                      std::size_t size,
+                      std::vector<FrameEvent>& events)
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (data[i] == marker)
+        {
+            // Send the buffer if there are any bytes.
+            if (buffer.size() > 0)
+            {
+                events.push_back({ false, buffer });
+            }
+
+            buffer.clear();
+        }
+        else
+        {
+            if (buffer.size() + 1 >= maxBufferSize)
+            {
+                // Send the overflow;
+                events.push_back({ true, buffer });
+                buffer.clear();
+            }
+
+            buffer.push_back(data[i]);
+        }
+    }
+}
+
+
+} // namespace
+
+
+// Input: marker, maximum buffer size, chunk size, then the stream.
+//
+// The stream is framed in chunks, so that markers and overflows fall across
+// calls, by MarkerFramer and by the reference framer. Both must report the
+// same frames and overflows in the same order, and keep the same partial
+// frame.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size)
+{
+    if (size < 3)
+    {
+        return 0;
+    }
+
+    const uint8_t marker = data[0];
+    const std::size_t maxBufferSize = 2 + data[1];
+    const std::size_t chunkSize = 1 + data[2];
+
+    data += 3;
+    size -= 3;
+
+    ofx::IO::ByteBuffer buffer;
+    std::vector<FrameEvent> events;
+
+    std::vector<uint8_t> referenceBuffer;
+    std::vector<FrameEvent> referenceEvents;
+
+    for (std::size_t offset = 0; offset < size; offset += chunkSize)
+    {
+        const std::size_t count = std::min(chunkSize, size - offset);
+
+        ofx::IO::MarkerFramer::process(marker,
+                                       maxBufferSize,
+                                       buffer,
+                                       data + offset,
+                                       count,
+                                       [&](const ofx::IO::ByteBuffer& frame)
+                                       {
+                                           events.push_back({ false, std::vector<uint8_t>(frame.getPtr(), frame.getPtr() + frame.size()) });
+                                       },
+                                       [&](const ofx::IO::ByteBuffer& frame)
+                                       {
+                                           events.push_back({ true, std::vector<uint8_t>(frame.getPtr(), frame.getPtr() + frame.size()) });
+                                       });
+
+        referenceProcess(marker,
+                         maxBufferSize,
+                         referenceBuffer,
+                         data + offset,
+                         count,
+                         referenceEvents);
+
+        if (events != referenceEvents)
+        {
+            std::abort();
+        }
+
+        events.clear();
+        referenceEvents.clear();
+    }
+
+    if (std::vector<uint8_t>(buffer.getPtr(), buffer.getPtr() + buffer.size()) != referenceBuffer)
+    {
+        std::abort();
+    }
+
+    return 0;
+}
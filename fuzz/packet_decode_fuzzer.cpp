@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include <cstdlib>
+#include <cstring>
+#include "ofx/IO/PacketSerialDevice.h"
+
+
+namespace {
+
+
+enum
+{
+    /// \brief Selects the SLIP device rather than COBS.
+    OPTION_SLIP = 0x01,
+    /// \brief Selects the compression stage, see compressionFor().
+    OPTION_COMPRESSION_SHIFT = 1,
+    OPTION_COMPRESSION_MASK = 0x03
+};
+
+
+std::shared_ptr<ofx::IO::AbstractPacketCompression> compressionFor(uint8_t options)
+{
+    static const std::shared_ptr<ofx::IO::AbstractPacketCompression> compressions[] =
+    {
+        nullptr,
+        std::make_shared<ofx::IO::LZ4Compression>(),
+        std::make_shared<ofx::IO::HeatshrinkCompression>(),
+        std::make_shared<ofx::IO::HeatshrinkCompression>(12, 6)
+    };
+
+    return compressions[(options >> OPTION_COMPRESSION_SHIFT) & OPTION_COMPRESSION_MASK];
+}
+
+
+} // namespace
+
+
+// Input: an options byte, then one received frame without its marker.
+//
+// The frame is decoded as a COBS or SLIP packet device would decode it, with
+// no compression, LZ4 or heatshrink. The frame is also compressed and
+// decompressed, which must give it back unchanged.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size)
+{
+    static ofx::IO::COBSPacketSerialDevice cobs;
+    static ofx::IO::SLIPPacketSerialDevice slip;
+
+    if (size < 1)
+    {
+        return 0;
+    }
+
+    const uint8_t options = data[0];
+    std::shared_ptr<ofx::IO::AbstractPacketCompression> compression = compressionFor(options);
+
+    ofx::IO::ByteBuffer frame(data + 1, size - 1);
+    ofx::IO::ByteBuffer packet;
+
+    if (options & OPTION_SLIP)
+    {
+        slip.setCompression(compression);
+        slip.decode(frame, packet);
+    }
+    else
+    {
+        cobs.setCompression(compression);
+        cobs.decode(frame, packet);
+    }
+
+    if (compression != nullptr)
+    {
+        std::vector<uint8_t> compressed;
+
+        if (compression->compress(frame.getPtr(), frame.size(), compressed))
+        {
+            std::vector<uint8_t> decompressed;
+
+            if (!compression->decompress(compressed.data(),
+                                         compressed.size(),
+                                         decompressed,
+                                         frame.size()) ||
+                decompressed.size() != frame.size() ||
+                std::memcmp(decompressed.data(), frame.getPtr(), frame.size()) != 0)
+            {
+                std::abort();
+            }
+        }
+    }
+
+    return 0;
+}
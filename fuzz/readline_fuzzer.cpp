@@ -0,0 +1,66 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include <cstdlib>
+#include <string>
+#include "serial/serial.h"
+
+
+// Input: a size limit, an EOL length, the EOL, then the bytes to read.
+//
+// The bytes are written to a loop:// port, which reads back what it writes,
+// and read with readline() and then readlines(). Reads do not wait, so they
+// stop at the size limit or when the bytes run out.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size)
+{
+    if (size < 2)
+    {
+        return 0;
+    }
+
+    // Limits near SIZE_MAX check that size is only a limit.
+    const std::size_t limit = data[0] == 0xFF ? std::string::npos : data[0];
+    const std::size_t eolLength = std::min<std::size_t>(1 + data[1] % 4, size - 2);
+
+    std::string eol(reinterpret_cast<const char*>(data + 2), eolLength);
+
+    data += 2 + eolLength;
+    size -= 2 + eolLength;
+
+    serial::Serial port("loop://",
+                        9600,
+                        serial::Timeout(0, 0, 0, 0, 0),
+                        serial::eightbits,
+                        serial::parity_none,
+                        serial::stopbits_one,
+                        serial::flowcontrol_none,
+                        serial::threading_single);
+
+    // A loop:// port holds 1 MiB, larger inputs are cut short.
+    size = port.write(data, size);
+
+    std::string line = port.readline(limit, eol);
+
+    if (line.size() > limit)
+    {
+        std::abort();
+    }
+
+    std::size_t total = line.size();
+
+    for (const std::string& next: port.readlines(limit, eol))
+    {
+        total += next.size();
+    }
+
+    if (total > size || (limit == std::string::npos && total != size))
+    {
+        std::abort();
+    }
+
+    return 0;
+}
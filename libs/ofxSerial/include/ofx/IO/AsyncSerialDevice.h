@@ -0,0 +1,707 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+
+// Coroutines need C++20, e.g. -std=c++20. Without them this header is empty.
+#if defined(__cpp_impl_coroutine) && defined(__cpp_lib_coroutine)
+
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "ofx/IO/BufferedSerialDevice.h"
+#include "ofx/IO/ByteBuffer.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+class SerialEventLoop;
+class AsyncSerialDevice;
+
+
+/// \brief The part of a task's promise that does not depend on its result.
+class SerialTaskPromiseBase
+{
+public:
+    /// \brief Resumes whoever awaited the task, or ends a spawned task.
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            SerialTaskPromiseBase& promise = handle.promise();
+
+            if (promise.loop != nullptr)
+            {
+                // A spawned task has no one to return to.
+                SerialEventLoop* loop = promise.loop;
+                std::exception_ptr exception = promise.exception;
+                void* address = handle.address();
+                handle.destroy();
+                finished(loop, address, exception);
+                return std::noop_coroutine();
+            }
+
+            if (promise.continuation)
+            {
+                return promise.continuation;
+            }
+
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        exception = std::current_exception();
+    }
+
+    /// \brief The coroutine awaiting the task.
+    std::coroutine_handle<> continuation;
+
+    /// \brief The exception that ended the task.
+    std::exception_ptr exception;
+
+    /// \brief The loop of a spawned task, or nullptr.
+    SerialEventLoop* loop = nullptr;
+
+private:
+    /// \brief Tell the loop that a spawned task ended.
+    static void finished(SerialEventLoop* loop,
+                         void* address,
+                         std::exception_ptr exception);
+
+};
+
+
+/// \brief A coroutine run by a SerialEventLoop.
+///
+/// A task starts when it is awaited, or when it is passed to
+/// SerialEventLoop::spawn(). Awaiting a task returns its result or rethrows
+/// the exception that ended it.
+///
+/// \tparam T The type of the result.
+template<typename T = void>
+class SerialTask
+{
+public:
+    class promise_type: public SerialTaskPromiseBase
+    {
+    public:
+        SerialTask get_return_object()
+        {
+            return SerialTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        template<typename U>
+        void return_value(U&& value)
+        {
+            result.emplace(std::forward<U>(value));
+        }
+
+        std::optional<T> result;
+    };
+
+    SerialTask()
+    {
+    }
+
+    SerialTask(SerialTask&& other) noexcept:
+        _handle(std::exchange(other._handle, nullptr))
+    {
+    }
+
+    SerialTask& operator = (SerialTask&& other) noexcept
+    {
+        std::swap(_handle, other._handle);
+        return *this;
+    }
+
+    SerialTask(const SerialTask&) = delete;
+    SerialTask& operator = (const SerialTask&) = delete;
+
+    /// \brief Destroy the coroutine if it did not finish.
+    ~SerialTask()
+    {
+        if (_handle)
+        {
+            _handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return _handle.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        _handle.promise().continuation = awaiting;
+        return _handle;
+    }
+
+    T await_resume()
+    {
+        if (_handle.promise().exception)
+        {
+            std::rethrow_exception(_handle.promise().exception);
+        }
+
+        return std::move(*_handle.promise().result);
+    }
+
+private:
+    explicit SerialTask(std::coroutine_handle<promise_type> handle): _handle(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> _handle;
+
+    friend class SerialEventLoop;
+
+};
+
+
+template<>
+class SerialTask<void>
+{
+public:
+    class promise_type: public SerialTaskPromiseBase
+    {
+    public:
+        SerialTask get_return_object()
+        {
+            return SerialTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_void()
+        {
+        }
+    };
+
+    SerialTask()
+    {
+    }
+
+    SerialTask(SerialTask&& other) noexcept:
+        _handle(std::exchange(other._handle, nullptr))
+    {
+    }
+
+    SerialTask& operator = (SerialTask&& other) noexcept
+    {
+        std::swap(_handle, other._handle);
+        return *this;
+    }
+
+    SerialTask(const SerialTask&) = delete;
+    SerialTask& operator = (const SerialTask&) = delete;
+
+    /// \brief Destroy the coroutine if it did not finish.
+    ~SerialTask()
+    {
+        if (_handle)
+        {
+            _handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return _handle.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        _handle.promise().continuation = awaiting;
+        return _handle;
+    }
+
+    void await_resume()
+    {
+        if (_handle.promise().exception)
+        {
+            std::rethrow_exception(_handle.promise().exception);
+        }
+    }
+
+private:
+    explicit SerialTask(std::coroutine_handle<promise_type> handle): _handle(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> _handle;
+
+    friend class SerialEventLoop;
+
+};
+
+
+/// \brief Runs serial coroutines on one thread.
+///
+/// The loop waits on the ports of its AsyncSerialDevices with epoll, or
+/// poll() where there is no epoll, and on the earliest timeout, then
+/// resumes the coroutines whose reads, writes or sleeps completed. Nothing
+/// blocks and no thread is created, so thousands of request and response
+/// sequences over many ports run as plain coroutines:
+///
+///     SerialTask<> query(AsyncSerialDevice& device)
+///     {
+///         co_await device.write("status?\n");
+///         auto reply = co_await device.readUntil('\n', 100);
+///     }
+///
+/// Everything about a loop, its devices and its tasks happens on the thread
+/// that runs it, except stop(). Use run() from a thread of its own, or call
+/// runOnce() from ofApp::update().
+///
+/// Ports that have no descriptor, e.g. ReplaySerialDevice::openPort(),
+/// can't be used. The loop needs C++20 and is not available on Windows.
+class SerialEventLoop
+{
+public:
+    /// \brief Something that happens at a time, e.g. a timeout.
+    class Timer
+    {
+    public:
+        /// \brief Cancel the timer.
+        virtual ~Timer();
+
+        /// \brief Called by the loop when the time came.
+        virtual void expire() = 0;
+
+    private:
+        /// \brief The loop the timer is armed on, or nullptr.
+        SerialEventLoop* _loop = nullptr;
+
+        /// \brief The position of the timer in the loop.
+        std::multimap<uint64_t, Timer*>::iterator _position;
+
+        friend class SerialEventLoop;
+    };
+
+    /// \brief The awaitable returned by sleep().
+    class SleepAwaiter: public Timer
+    {
+    public:
+        SleepAwaiter(SerialEventLoop& loop, uint32_t millis);
+        SleepAwaiter(const SleepAwaiter&) = delete;
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() noexcept;
+        void expire() override;
+
+    private:
+        SerialEventLoop& _loop;
+        uint32_t _millis = 0;
+        std::coroutine_handle<> _handle;
+    };
+
+    SerialEventLoop();
+
+    /// \brief Destroy the tasks that did not finish.
+    ~SerialEventLoop();
+
+    /// \brief Start a task that runs on its own.
+    ///
+    /// The task starts with the next turn of the loop. An exception that
+    /// ends it is logged.
+    ///
+    /// \param task The task.
+    template<typename T>
+    void spawn(SerialTask<T> task)
+    {
+        auto handle = std::exchange(task._handle, nullptr);
+
+        if (handle)
+        {
+            handle.promise().loop = this;
+            _tasks.insert(handle.address());
+            schedule(handle);
+        }
+    }
+
+    /// \brief Run until stop() is called or every spawned task ended.
+    void run();
+
+    /// \brief Run one turn of the loop.
+    /// \param timeoutMillis The longest time to wait for something to
+    ///        happen, 0 to only handle what already happened.
+    /// \returns the number of coroutines resumed.
+    std::size_t runOnce(uint32_t timeoutMillis = 0);
+
+    /// \brief Make run() return. Can be called from any thread.
+    void stop();
+
+    /// \returns the number of spawned tasks that did not end yet.
+    std::size_t taskCount() const;
+
+    /// \brief Wait without blocking the loop.
+    ///
+    /// co_await loop.sleep(0) lets every other ready coroutine run first.
+    ///
+    /// \param millis The time to wait.
+    SleepAwaiter sleep(uint32_t millis);
+
+    /// \brief Resume a coroutine on the current or next turn of the loop.
+    void schedule(std::coroutine_handle<> handle);
+
+    /// \brief Expire a timer on the first turn after a time.
+    /// \param timer The timer, armed again if it was armed.
+    /// \param deadlineNanos The monotonic time, see AbstractSerialTap::now().
+    void arm(Timer& timer, uint64_t deadlineNanos);
+
+    /// \brief Cancel a timer if it is armed.
+    void disarm(Timer& timer);
+
+private:
+    /// \brief Run one turn, waiting up to timeoutMillis, or forever if -1.
+    std::size_t turn(int64_t timeoutMillis);
+
+    /// \brief Resume everything that is ready.
+    std::size_t resumeReady();
+
+    /// \brief Start waiting on the port of a device.
+    bool watch(AsyncSerialDevice* device);
+
+    /// \brief Stop waiting on the port of a device.
+    void unwatch(AsyncSerialDevice* device);
+
+    /// \brief Tell the loop whether a device wants to read.
+    void setReading(AsyncSerialDevice* device, bool reading);
+
+    /// \brief The coroutines to resume.
+    std::deque<std::coroutine_handle<>> _ready;
+
+    /// \brief The armed timers by deadline.
+    std::multimap<uint64_t, Timer*> _timers;
+
+    /// \brief The spawned tasks that did not end.
+    std::unordered_set<void*> _tasks;
+
+    /// \brief The devices waited on.
+    std::vector<AsyncSerialDevice*> _devices;
+
+    /// \brief The epoll instance, or -1.
+    int _epoll = -1;
+
+    /// \brief Wakes the loop from stop().
+    int _wakePipe[2] = { -1, -1 };
+
+    /// \brief Asks run() to return.
+    std::atomic<bool> _stopping;
+
+    friend class SerialTaskPromiseBase;
+    friend class AsyncSerialDevice;
+
+};
+
+
+/// \brief Awaitable reads and writes on a SerialDevice.
+///
+/// Reads take bytes from the port only while a coroutine waits for them,
+/// and keep at most maxBufferSize bytes that were not read yet; the rest
+/// stay in the port. Reads complete in the order they were awaited, and so
+/// do writes.
+///
+/// Frames end with a marker byte, like those of BufferedSerialDevice. A
+/// frame that does not fit into maxBufferSize bytes is dropped and counted
+/// by overflowCount().
+///
+/// Once the port fails or the device is closed, waiting reads complete as
+/// closed and writes with the bytes written so far.
+class AsyncSerialDevice
+{
+public:
+    /// \brief The result of readUntil().
+    struct ReadResult
+    {
+        enum Status
+        {
+            /// \brief The buffer holds the bytes before the marker.
+            READ_OK,
+            /// \brief No marker arrived in time. The bytes stay buffered.
+            READ_TIMEOUT,
+            /// \brief The port failed or the device was closed.
+            READ_CLOSED
+        };
+
+        Status status = READ_CLOSED;
+
+        ByteBuffer buffer;
+
+        explicit operator bool() const
+        {
+            return status == READ_OK;
+        }
+    };
+
+    /// \brief A read waiting for a marker.
+    class ReadAwaiter: public SerialEventLoop::Timer
+    {
+    public:
+        /// \param timeoutMillis The longest time to wait, or -1 for ever.
+        ReadAwaiter(AsyncSerialDevice& device,
+                    uint8_t marker,
+                    bool skipEmpty,
+                    int64_t timeoutMillis);
+
+        ReadAwaiter(const ReadAwaiter&) = delete;
+
+        /// \brief Stop waiting if the coroutine is destroyed while waiting.
+        ~ReadAwaiter();
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        void expire() override;
+
+    protected:
+        AsyncSerialDevice& _device;
+        uint8_t _marker = 0;
+        bool _skipEmpty = false;
+        int64_t _timeoutMillis = -1;
+        bool _waiting = false;
+        std::coroutine_handle<> _handle;
+        ReadResult _result;
+
+        friend class AsyncSerialDevice;
+    };
+
+    /// \brief The awaitable returned by readFrame().
+    class FrameAwaiter: public ReadAwaiter
+    {
+    public:
+        using ReadAwaiter::ReadAwaiter;
+
+        /// \returns the frame, or an empty buffer if the port closed.
+        ByteBuffer await_resume();
+    };
+
+    /// \brief The awaitable returned by readUntil().
+    class UntilAwaiter: public ReadAwaiter
+    {
+    public:
+        using ReadAwaiter::ReadAwaiter;
+
+        ReadResult await_resume();
+    };
+
+    /// \brief The awaitable returned by write().
+    class WriteAwaiter
+    {
+    public:
+        WriteAwaiter(AsyncSerialDevice& device,
+                     const uint8_t* data,
+                     std::size_t size);
+
+        WriteAwaiter(const WriteAwaiter&) = delete;
+
+        /// \brief Stop waiting if the coroutine is destroyed while waiting.
+        ~WriteAwaiter();
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+
+        /// \returns the number of bytes written, less than the size only
+        ///          if the port failed or the device was closed.
+        std::size_t await_resume() noexcept;
+
+    private:
+        AsyncSerialDevice& _device;
+        const uint8_t* _data = nullptr;
+        std::size_t _size = 0;
+        std::size_t _written = 0;
+
+        /// \brief The bytes not written yet, copied when the write waits.
+        std::vector<uint8_t> _pending;
+
+        /// \brief The number of pending bytes written.
+        std::size_t _pendingOffset = 0;
+
+        bool _waiting = false;
+        std::coroutine_handle<> _handle;
+
+        friend class AsyncSerialDevice;
+    };
+
+    AsyncSerialDevice();
+
+    /// \brief Detach from the device.
+    ~AsyncSerialDevice();
+
+    AsyncSerialDevice(const AsyncSerialDevice&) = delete;
+    AsyncSerialDevice& operator = (const AsyncSerialDevice&) = delete;
+
+    /// \brief Read and write an open device from a loop.
+    ///
+    /// The timeouts of the port are set to zero, so no call blocks the loop.
+    /// The device must outlive this object and should not be read by
+    /// anything else.
+    ///
+    /// \param loop The loop that waits on the port.
+    /// \param device The open device.
+    /// \param marker The byte that ends each frame.
+    /// \param maxBufferSize The most bytes kept that were not read yet.
+    /// \returns true if the port can be waited on.
+    bool setup(SerialEventLoop& loop,
+               SerialDevice& device,
+               uint8_t marker = BufferedSerialDevice::DEFAULT_MARKER,
+               std::size_t maxBufferSize = BufferedSerialDevice::DEFAULT_MAX_BUFFER_SIZE);
+
+    /// \brief Detach from the device, which stays open.
+    void close();
+
+    /// \returns true until the port fails or the device is closed.
+    bool isOpen() const;
+
+    /// \brief Read the next frame, without its marker.
+    ///
+    /// Empty frames are skipped. Use readUntil() to give up after a time.
+    FrameAwaiter readFrame();
+
+    /// \brief Read up to the next marker.
+    /// \param marker The byte to wait for, left out of the result.
+    /// \param timeoutMillis The longest time to wait.
+    UntilAwaiter readUntil(uint8_t marker, uint32_t timeoutMillis);
+
+    /// \brief Write bytes.
+    ///
+    /// The bytes are copied if the write has to wait, so they only need to
+    /// stay valid until it is awaited.
+    WriteAwaiter write(const uint8_t* data, std::size_t size);
+    WriteAwaiter write(const std::string& data);
+    WriteAwaiter write(const ByteBuffer& data);
+
+    /// \returns the number of frames dropped for not fitting the buffer.
+    uint64_t overflowCount() const;
+
+    /// \returns the device, or nullptr.
+    SerialDevice* device();
+
+    enum
+    {
+        /// \brief The most bytes a blocked write waits for the line to
+        ///        send before trying again.
+        WRITE_RETRY_BYTES = 256
+    };
+
+private:
+    /// \brief Retries the blocked writes.
+    struct WriteTimer: public SerialEventLoop::Timer
+    {
+        AsyncSerialDevice* device = nullptr;
+
+        void expire() override;
+    };
+
+    /// \brief Take the bytes up to a marker from the buffer.
+    /// \returns true if the read completed.
+    bool take(ReadAwaiter& reader);
+
+    /// \brief Read from the port after the loop found it readable.
+    void onReadable();
+
+    /// \brief Complete the waiting reads the buffer can satisfy.
+    void serveReads();
+
+    /// \brief Write what the port takes for the waiting writes.
+    void serveWrites();
+
+    /// \brief Try the first waiting write again once the line had time to
+    ///        send some bytes.
+    void retryWrites();
+
+    /// \brief Tell the loop whether bytes are wanted from the port.
+    void updateReading();
+
+    /// \brief Complete everything waiting and stop reading the port.
+    /// \param message The reason logged, if not empty.
+    void fail(const std::string& message);
+
+    /// \brief Stop waiting for a read, e.g. after a timeout.
+    void cancel(ReadAwaiter& reader);
+
+    SerialEventLoop* _loop = nullptr;
+
+    SerialDevice* _device = nullptr;
+
+    /// \brief The descriptor of the port.
+    int _fd = -1;
+
+    /// \brief True while the loop waits for the port to become readable.
+    bool _reading = false;
+
+    /// \brief False once the port failed or the device was closed.
+    bool _open = false;
+
+    uint8_t _marker = BufferedSerialDevice::DEFAULT_MARKER;
+
+    /// \brief Bytes not read yet, from _begin to _end.
+    std::vector<uint8_t> _buffer;
+    std::size_t _begin = 0;
+    std::size_t _end = 0;
+
+    /// \brief Bytes after _begin the first reader already searched.
+    std::size_t _scanned = 0;
+
+    /// \brief The waiting reads, in order.
+    std::deque<ReadAwaiter*> _readers;
+
+    /// \brief The waiting writes, in order.
+    std::deque<WriteAwaiter*> _writers;
+
+    WriteTimer _writeTimer;
+
+    uint64_t _overflowCount = 0;
+
+    friend class SerialEventLoop;
+
+};
+
+
+} } // namespace ofx::IO
+
+
+#endif
@@ -11,6 +11,7 @@
 #include "ofEvents.h"
 #include "ofx/IO/SerialDevice.h"
 #include "ofx/IO/SerialEvents.h"
+#include "ofx/IO/SerialReaderThread.h"
 
 
 namespace ofx {
@@ -44,6 +45,24 @@ public:
 
     void setMaximumBufferSize(std::size_t size);
 
+    /// \brief Read the device on a dedicated thread.
+    ///
+    /// The thread moves incoming bytes into a lock-free ring buffer that is
+    /// framed and dispatched on the next update. Events are still delivered
+    /// on the main thread. Call this after setup().
+    ///
+    /// \param policy The scheduling policy of the reader thread.
+    /// \param capacity The ring buffer capacity in bytes.
+    /// \returns true if the thread was started.
+    bool startReaderThread(const ThreadPolicy& policy = ThreadPolicy(),
+                           std::size_t capacity = SerialRingBuffer::DEFAULT_CAPACITY);
+
+    /// \brief Stop the reader thread and return to reading on update.
+    void stopReaderThread();
+
+    /// \returns true if the reader thread is running.
+    bool isReaderThreadRunning() const;
+
     /// \brief Register a class to receive notifications for all events.
     /// \param listener a pointer to the listener class.
     /// \param order the event order.
@@ -78,6 +97,10 @@ public:
     };
 
 protected:
+    /// \brief Split bytes into buffers at the marker and emit events.
+    /// \param data The received bytes.
+    /// \param size The number of received bytes.
+    void processBytes(const uint8_t* data, std::size_t size);
 
     /// \brief The buffer boundary marker.
     uint8_t _marker = DEFAULT_MARKER;
@@ -88,6 +111,12 @@ protected:
     /// \brief The maximum size of the boundary.
     std::size_t _maxBufferSize = DEFAULT_MAX_BUFFER_SIZE;
 
+    /// \brief The optional reader thread.
+    SerialReaderThread _readerThread;
+
+    /// \brief The buffer each update reads into.
+    std::vector<uint8_t> _updateBuffer;
+
     enum
     {
         UPDATE_BUFFER_SIZE = 2048
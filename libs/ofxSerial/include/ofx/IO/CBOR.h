@@ -0,0 +1,215 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <string>
+#include "ofx/IO/ByteBuffer.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief An allocation-free CBOR (RFC 7049) encoder.
+///
+/// The writer encodes directly into a caller supplied buffer. If an item does
+/// not fit, nothing more is written and ok() returns false.
+///
+///     uint8_t scratch[64];
+///     CBORWriter writer(scratch, sizeof(scratch));
+///     writer.beginMap(2);
+///     writer.writeText("x").writeInt(-12);
+///     writer.writeText("on").writeBool(true);
+///
+///     if (writer.ok()) device.send(writer.data(), writer.size());
+class CBORWriter
+{
+public:
+    /// \brief Create a writer.
+    /// \param buffer The buffer to encode into.
+    /// \param capacity The size of the buffer in bytes.
+    CBORWriter(uint8_t* buffer, std::size_t capacity);
+
+    CBORWriter& writeUnsigned(uint64_t value);
+    CBORWriter& writeInt(int64_t value);
+    CBORWriter& writeBool(bool value);
+    CBORWriter& writeNull();
+    CBORWriter& writeFloat(float value);
+    CBORWriter& writeDouble(double value);
+    CBORWriter& writeText(const char* text);
+    CBORWriter& writeText(const char* text, std::size_t length);
+    CBORWriter& writeText(const std::string& text);
+    CBORWriter& writeBytes(const uint8_t* data, std::size_t size);
+    CBORWriter& writeTag(uint64_t tag);
+
+    /// \brief Begin an array. The next count items are its elements.
+    CBORWriter& beginArray(std::size_t count);
+
+    /// \brief Begin a map. The next 2 * count items are its keys and values.
+    CBORWriter& beginMap(std::size_t count);
+
+    /// \brief Discard everything written so far.
+    void reset();
+
+    /// \returns false if an item did not fit in the buffer.
+    bool ok() const;
+
+    /// \returns the encoded bytes.
+    const uint8_t* data() const;
+
+    /// \returns the number of encoded bytes.
+    std::size_t size() const;
+
+private:
+    void writeHead(uint8_t majorType, uint64_t value);
+    void writeRaw(const uint8_t* data, std::size_t size);
+    bool reserve(std::size_t size);
+
+    /// \brief The output buffer.
+    uint8_t* _buffer = nullptr;
+
+    /// \brief The output buffer size.
+    std::size_t _capacity = 0;
+
+    /// \brief The number of bytes written.
+    std::size_t _size = 0;
+
+    /// \brief True if all items fit.
+    bool _ok = true;
+
+};
+
+
+/// \brief A streaming CBOR (RFC 7049) pull parser.
+///
+/// The reader never allocates or copies. Strings are returned as pointers
+/// into the packet, so they are only valid for as long as the packet is.
+///
+///     CBORReader reader(args.buffer());
+///
+///     while (reader.next() != CBORReader::TYPE_END)
+///     {
+///         if (reader.type() == CBORReader::TYPE_TEXT) ...
+///     }
+class CBORReader
+{
+public:
+    enum Type
+    {
+        TYPE_UNSIGNED,
+        TYPE_NEGATIVE,
+        TYPE_BYTES,
+        TYPE_TEXT,
+        TYPE_ARRAY,
+        TYPE_MAP,
+        TYPE_TAG,
+        TYPE_BOOL,
+        TYPE_NULL,
+        TYPE_UNDEFINED,
+        TYPE_SIMPLE,
+        TYPE_FLOAT,
+        /// \brief The end of an indefinite length array or map.
+        TYPE_BREAK,
+        /// \brief No more data.
+        TYPE_END,
+        /// \brief The data is malformed or unsupported.
+        TYPE_ERROR
+    };
+
+    /// \brief Create a reader.
+    /// \param data The encoded bytes.
+    /// \param size The number of encoded bytes.
+    CBORReader(const uint8_t* data, std::size_t size);
+
+    /// \brief Create a reader over a decoded packet.
+    /// \param buffer The encoded bytes.
+    explicit CBORReader(const ByteBuffer& buffer);
+
+    /// \brief Advance to the next item.
+    ///
+    /// Arrays and maps are not skipped. Their elements follow as the next
+    /// items.
+    ///
+    /// \returns the type of the item.
+    Type next();
+
+    /// \brief Advance past the current item, including any elements.
+    /// \returns false if the data is malformed.
+    bool skip();
+
+    /// \returns the type of the current item.
+    Type type() const;
+
+    /// \returns the value of an unsigned or negative integer.
+    uint64_t uintValue() const;
+
+    /// \returns the value of an unsigned or negative integer.
+    int64_t intValue() const;
+
+    /// \returns the value of a float or integer.
+    double doubleValue() const;
+
+    /// \returns the value of a bool.
+    bool boolValue() const;
+
+    /// \returns the value of a tag or simple value.
+    uint64_t tagValue() const;
+
+    /// \returns a pointer to the bytes of a byte or text string.
+    const uint8_t* bytes() const;
+
+    /// \returns the text of a text string. Not null terminated.
+    const char* text() const;
+
+    /// \returns the length of a string, or the number of elements of an
+    /// array or map. Maps count key / value pairs.
+    std::size_t length() const;
+
+    /// \returns true if the current array or map has indefinite length.
+    bool isIndefinite() const;
+
+    /// \returns true if the current text equals the given text.
+    bool textEquals(const char* text) const;
+
+    /// \returns the number of bytes consumed so far.
+    std::size_t offset() const;
+
+private:
+    bool readHead(uint8_t& majorType, uint8_t& info, uint64_t& value);
+    Type error();
+
+    /// \brief The encoded bytes.
+    const uint8_t* _data = nullptr;
+
+    /// \brief The number of encoded bytes.
+    std::size_t _size = 0;
+
+    /// \brief The read position.
+    std::size_t _offset = 0;
+
+    /// \brief The current item type.
+    Type _type = TYPE_END;
+
+    /// \brief The current item value or length.
+    uint64_t _value = 0;
+
+    /// \brief The current float value.
+    double _double = 0;
+
+    /// \brief The current string.
+    const uint8_t* _bytes = nullptr;
+
+    /// \brief True if the current container has indefinite length.
+    bool _indefinite = false;
+
+};
+
+
+} } // namespace ofx::IO
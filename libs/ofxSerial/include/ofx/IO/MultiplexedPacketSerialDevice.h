@@ -0,0 +1,506 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "ofx/IO/PacketSerialDevice.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief A logical channel carried over a MultiplexedPacketSerialDevice_.
+///
+/// Each packet on the wire is prefixed with a single channel id byte before
+/// it is encoded. Channels with a higher priority are always transmitted
+/// first. Channels that share a priority are served by deficit round robin
+/// in proportion to their weight.
+class SerialChannel
+{
+public:
+    SerialChannel(uint8_t id, int priority, std::size_t weight):
+        _id(id),
+        _priority(priority),
+        _weight(weight > 0 ? weight : 1)
+    {
+    }
+
+    /// \returns the channel id sent as the first byte of each packet.
+    uint8_t id() const
+    {
+        return _id;
+    }
+
+    /// \returns the transmit priority. Higher values are sent first.
+    int priority() const
+    {
+        return _priority;
+    }
+
+    /// \returns the relative share of bandwidth among equal priorities.
+    std::size_t weight() const
+    {
+        return _weight;
+    }
+
+    /// \returns the number of packets waiting to be transmitted.
+    std::size_t queuedPackets() const
+    {
+        return _queue.size();
+    }
+
+    /// \returns the number of framed bytes waiting to be transmitted.
+    std::size_t queuedBytes() const
+    {
+        return _queuedBytes;
+    }
+
+    /// \brief Register a class to receive notifications for all events.
+    /// \param listener a pointer to the listener class.
+    /// \param order the event order.
+    /// \tparam ListenerClass The listener class type.
+    template<class ListenerClass>
+    void registerAllEvents(ListenerClass* listener, int order = OF_EVENT_ORDER_AFTER_APP)
+    {
+        ofAddListener(events.onSerialBuffer, listener, &ListenerClass::onSerialBuffer, order);
+        ofAddListener(events.onSerialError, listener, &ListenerClass::onSerialError, order);
+    }
+
+    /// \brief Unregister a class to receive notifications for all events.
+    /// \param listener a pointer to the listener class.
+    /// \param order the event order.
+    /// \tparam ListenerClass The listener class type.
+    template<class ListenerClass>
+    void unregisterAllEvents(ListenerClass* listener, int order = OF_EVENT_ORDER_AFTER_APP)
+    {
+        ofRemoveListener(events.onSerialBuffer, listener, &ListenerClass::onSerialBuffer, order);
+        ofRemoveListener(events.onSerialError, listener, &ListenerClass::onSerialError, order);
+    }
+
+    /// \brief The decoded packets received on this channel.
+    SerialEvents events;
+
+private:
+    template<typename, uint8_t, std::size_t> friend class MultiplexedPacketSerialDevice_;
+
+    /// \brief The channel id.
+    uint8_t _id = 0;
+
+    /// \brief The transmit priority.
+    int _priority = 0;
+
+    /// \brief The round robin weight.
+    std::size_t _weight = 1;
+
+    /// \brief The round robin deficit in bytes.
+    std::size_t _deficit = 0;
+
+    /// \brief The number of queued framed bytes.
+    std::size_t _queuedBytes = 0;
+
+    /// \brief Framed packets (channel id + payload) waiting to be sent.
+    std::deque<ByteBuffer> _queue;
+
+};
+
+
+/// \brief Carries several independent channels over one packet serial link.
+///
+/// Outgoing packets are queued per channel and transmitted after the app's
+/// update. Only about maxLatency worth of wire time is kept in the driver's
+/// output buffer, judged by outWaiting() and by the bytes written and the
+/// time passed since. The rest stays queued, so a bulk transfer on a low
+/// priority channel delays a packet queued on a higher priority channel by
+/// at most the bytes in flight plus one packet, not by everything written
+/// before it. A transmit budget can limit each update further.
+///
+/// Packets are only sent through channels. The untagged packet API of
+/// PacketSerialDevice_ is not exposed.
+template<typename Encoder, uint8_t PacketMarker = 0, std::size_t BufferSize = 8192>
+class MultiplexedPacketSerialDevice_: protected PacketSerialDevice_<Encoder, PacketMarker, BufferSize>
+{
+public:
+    typedef PacketSerialDevice_<Encoder, PacketMarker, BufferSize> BaseType;
+
+    MultiplexedPacketSerialDevice_()
+    {
+        ofAddListener(this->packetEvents.onSerialBuffer, this, &MultiplexedPacketSerialDevice_::onPacketBuffer);
+        ofAddListener(this->packetEvents.onSerialError, this, &MultiplexedPacketSerialDevice_::onPacketError);
+        ofAddListener(ofEvents().update, this, &MultiplexedPacketSerialDevice_::updateChannels, OF_EVENT_ORDER_AFTER_APP);
+    }
+
+    /// \Brief destroy the MultiplexedPacketSerialDevice.
+    virtual ~MultiplexedPacketSerialDevice_()
+    {
+        ofRemoveListener(ofEvents().update, this, &MultiplexedPacketSerialDevice_::updateChannels, OF_EVENT_ORDER_AFTER_APP);
+        ofRemoveListener(this->packetEvents.onSerialError, this, &MultiplexedPacketSerialDevice_::onPacketError);
+        ofRemoveListener(this->packetEvents.onSerialBuffer, this, &MultiplexedPacketSerialDevice_::onPacketBuffer);
+    }
+
+    using BaseType::setup;
+    using BaseType::setCompression;
+    using BaseType::getCompression;
+
+    using BaseType::port;
+    using BaseType::baudRate;
+    using BaseType::dataBits;
+    using BaseType::stopBits;
+    using BaseType::timeout;
+    using BaseType::isClearToSend;
+    using BaseType::isDataSetReady;
+    using BaseType::isRingIndicated;
+    using BaseType::isCarrierDetected;
+    using BaseType::isOpen;
+    using BaseType::setDataTerminalReady;
+    using BaseType::getPortName;
+
+    using BaseType::startReaderThread;
+    using BaseType::stopReaderThread;
+    using BaseType::isReaderThreadRunning;
+
+    using BaseType::flush;
+    using BaseType::flushInput;
+    using BaseType::flushOutput;
+
+    using BaseType::setTap;
+    using BaseType::tap;
+
+    /// \brief Add a channel or replace the parameters of an existing one.
+    /// \param id The channel id.
+    /// \param priority The transmit priority. Higher values are sent first.
+    /// \param weight The share of bandwidth relative to channels with the same priority.
+    /// \returns the channel.
+    SerialChannel& addChannel(uint8_t id, int priority = 0, std::size_t weight = 1)
+    {
+        SerialChannel* existing = channel(id);
+
+        if (existing != nullptr)
+        {
+            existing->_priority = priority;
+            existing->_weight = weight > 0 ? weight : 1;
+        }
+        else
+        {
+            _channels.push_back(std::make_shared<SerialChannel>(id, priority, weight));
+            existing = _channels.back().get();
+        }
+
+        std::stable_sort(_channels.begin(),
+                         _channels.end(),
+                         [](const std::shared_ptr<SerialChannel>& a,
+                            const std::shared_ptr<SerialChannel>& b)
+                         {
+                             return a->priority() > b->priority();
+                         });
+
+        return *existing;
+    }
+
+    /// \brief Remove a channel, dropping any packets queued on it.
+    ///
+    /// It is safe to remove a channel from one of its own listeners.
+    ///
+    /// \param id The channel id.
+    void removeChannel(uint8_t id)
+    {
+        _channels.erase(std::remove_if(_channels.begin(),
+                                       _channels.end(),
+                                       [id](const std::shared_ptr<SerialChannel>& c)
+                                       {
+                                           return c->id() == id;
+                                       }),
+                        _channels.end());
+    }
+
+    /// \param id The channel id.
+    /// \returns the channel with the given id or nullptr if it does not exist.
+    SerialChannel* channel(uint8_t id)
+    {
+        for (auto& c: _channels)
+        {
+            if (c->id() == id)
+            {
+                return c.get();
+            }
+        }
+
+        return nullptr;
+    }
+
+    /// \brief Queue a packet for transmission on a channel.
+    /// \param id The channel id.
+    /// \param buffer The packet payload.
+    /// \returns false if the channel does not exist.
+    bool send(uint8_t id, const ByteBuffer& buffer)
+    {
+        SerialChannel* c = channel(id);
+
+        if (c == nullptr)
+        {
+            ofLogWarning("MultiplexedPacketSerialDevice_::send") << "Unknown channel: " << static_cast<int>(id);
+            return false;
+        }
+
+        ByteBuffer framed;
+        framed.reserve(buffer.size() + 1);
+        framed.writeByte(id);
+        framed.writeBytes(buffer.getPtr(), buffer.size());
+
+        c->_queuedBytes += framed.size();
+        c->_queue.push_back(std::move(framed));
+        return true;
+    }
+
+    /// \brief Set how much data may wait in the driver's output buffer.
+    ///
+    /// Packets are held in their channels while more than this much wire
+    /// time is in flight. A packet is never split, so the limit can be
+    /// exceeded by one packet.
+    ///
+    /// \param maxLatencyMicros The wire time kept in flight, or 0 to write
+    ///        every queued packet on each update.
+    void setMaxLatency(uint64_t maxLatencyMicros)
+    {
+        _maxLatencyMicros = maxLatencyMicros;
+    }
+
+    /// \returns the wire time kept in flight in microseconds, or 0.
+    uint64_t getMaxLatency() const
+    {
+        return _maxLatencyMicros;
+    }
+
+    /// \brief Set the maximum number of bytes transmitted per update.
+    /// \param bytesPerUpdate The byte budget. 0 leaves only the latency limit.
+    void setTransmitBudget(std::size_t bytesPerUpdate)
+    {
+        _transmitBudget = bytesPerUpdate;
+    }
+
+    /// \returns the maximum number of bytes transmitted per update.
+    std::size_t getTransmitBudget() const
+    {
+        return _transmitBudget;
+    }
+
+    /// \brief Transmit queued packets according to priority and weight.
+    ///
+    /// This is called automatically after each app update.
+    void flushChannels()
+    {
+        std::size_t budget = _transmitBudget > 0 ? _transmitBudget : std::numeric_limits<std::size_t>::max();
+        budget = std::min(budget, transmitRoom());
+
+        auto first = _channels.begin();
+
+        while (first != _channels.end() && budget > 0)
+        {
+            // Channels are sorted by priority, so [first, last) is one level.
+            auto last = first;
+
+            while (last != _channels.end() && (*last)->priority() == (*first)->priority())
+            {
+                ++last;
+            }
+
+            budget = flushPriorityLevel(first, last, budget);
+            first = last;
+        }
+    }
+
+    void updateChannels(ofEventArgs& args)
+    {
+        if (BaseType::isOpen())
+        {
+            flushChannels();
+        }
+    }
+
+    void onPacketBuffer(const SerialBufferEventArgs& args)
+    {
+        const ByteBuffer& packet = args.buffer();
+
+        if (packet.size() == 0)
+        {
+            return;
+        }
+
+        uint8_t id = packet.getPtr()[0];
+
+        // Keep the channel alive if a listener removes it.
+        std::shared_ptr<SerialChannel> c = findChannel(id);
+
+        if (c != nullptr)
+        {
+            ByteBuffer payload(packet.getPtr() + 1, packet.size() - 1);
+            SerialBufferEventArgs evt(args.device(), payload);
+            ofNotifyEvent(c->events.onSerialBuffer, evt, this);
+        }
+        else
+        {
+            ofLogVerbose("MultiplexedPacketSerialDevice_::onPacketBuffer") << "Dropping packet for unknown channel: " << static_cast<int>(id);
+        }
+    }
+
+    void onPacketError(const SerialBufferErrorEventArgs& args)
+    {
+        // A framing error can not be attributed to a channel, so every
+        // channel is told about it. Listeners may add or remove channels.
+        std::vector<std::shared_ptr<SerialChannel>> channels = _channels;
+
+        for (auto& c: channels)
+        {
+            ofNotifyEvent(c->events.onSerialError, args, this);
+        }
+    }
+
+    enum
+    {
+        /// \brief The number of bytes credited per unit of weight per round.
+        DEFAULT_QUANTUM = 256,
+        /// \brief The default wire time kept in flight, in microseconds.
+        DEFAULT_MAX_LATENCY_MICROS = 5000,
+        /// \brief Never keep fewer bytes in flight than this.
+        MIN_BYTES_IN_FLIGHT = 16
+    };
+
+private:
+    typedef typename std::vector<std::shared_ptr<SerialChannel>>::iterator ChannelIterator;
+
+    /// \returns the channel with the given id or nullptr if it does not exist.
+    std::shared_ptr<SerialChannel> findChannel(uint8_t id) const
+    {
+        for (auto& c: _channels)
+        {
+            if (c->id() == id)
+            {
+                return c;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /// \returns the number of bytes that may be written before the bytes in
+    ///          flight exceed the latency limit.
+    std::size_t transmitRoom() const
+    {
+        uint64_t byteTime = BaseType::byteTime();
+
+        if (_maxLatencyMicros == 0 || byteTime == 0)
+        {
+            // Without a line speed there is nothing to pace against.
+            return std::numeric_limits<std::size_t>::max();
+        }
+
+        std::size_t maxBytesInFlight = std::max<std::size_t>(_maxLatencyMicros * 1000 / byteTime,
+                                                             MIN_BYTES_IN_FLIGHT);
+
+        // Drivers that don't report their output buffer, e.g. remote ports,
+        // are paced by wire time alone.
+        uint64_t now = AbstractSerialTap::now();
+        std::size_t inFlight = _wireClearNanos > now ? (_wireClearNanos - now) / byteTime : 0;
+
+        try
+        {
+            inFlight = std::max(inFlight, BaseType::outWaiting());
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogVerbose("MultiplexedPacketSerialDevice_::transmitRoom") << exc.what();
+        }
+
+        return inFlight < maxBytesInFlight ? maxBytesInFlight - inFlight : 0;
+    }
+
+    /// \brief Account for the wire time of a packet that was written.
+    void addWireTime(std::size_t size)
+    {
+        // The encoding adds about one byte plus the marker.
+        uint64_t now = AbstractSerialTap::now();
+        _wireClearNanos = std::max(_wireClearNanos, now) + uint64_t(size + 2) * BaseType::byteTime();
+    }
+
+    /// \brief Serve one priority level by deficit round robin.
+    /// \returns the remaining budget.
+    std::size_t flushPriorityLevel(ChannelIterator first,
+                                   ChannelIterator last,
+                                   std::size_t budget)
+    {
+        bool pending = true;
+
+        while (pending && budget > 0)
+        {
+            pending = false;
+
+            for (auto iter = first; iter != last && budget > 0; ++iter)
+            {
+                SerialChannel& c = **iter;
+
+                if (c._queue.empty())
+                {
+                    c._deficit = 0;
+                    continue;
+                }
+
+                c._deficit += c._weight * DEFAULT_QUANTUM;
+
+                while (!c._queue.empty() && c._queue.front().size() <= c._deficit && budget > 0)
+                {
+                    const ByteBuffer& framed = c._queue.front();
+                    std::size_t size = framed.size();
+
+                    BaseType::send(framed);
+                    addWireTime(size);
+
+                    c._deficit -= size;
+                    c._queuedBytes -= size;
+                    budget -= std::min(size, budget);
+                    c._queue.pop_front();
+                }
+
+                if (c._queue.empty())
+                {
+                    c._deficit = 0;
+                }
+                else
+                {
+                    pending = true;
+                }
+            }
+        }
+
+        return budget;
+    }
+
+    /// \brief The channels sorted by descending priority.
+    std::vector<std::shared_ptr<SerialChannel>> _channels;
+
+    /// \brief The number of bytes sent per update, or 0 for no limit.
+    std::size_t _transmitBudget = 0;
+
+    /// \brief The wire time kept in flight, or 0 for no limit.
+    uint64_t _maxLatencyMicros = DEFAULT_MAX_LATENCY_MICROS;
+
+    /// \brief The time the line will have sent every byte written so far.
+    uint64_t _wireClearNanos = 0;
+
+};
+
+
+typedef MultiplexedPacketSerialDevice_<COBSEncoding> MultiplexedPacketSerialDevice;
+typedef MultiplexedPacketSerialDevice_<SLIPEncoding, SLIPEncoding::END> SLIPMultiplexedPacketSerialDevice;
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief An optional compression stage for packet serial devices.
+///
+/// Implementations must be stateless between packets so that each packet can
+/// be decompressed on its own.
+class AbstractPacketCompression
+{
+public:
+    virtual ~AbstractPacketCompression()
+    {
+    }
+
+    /// \brief Compress a packet.
+    /// \param data The uncompressed bytes.
+    /// \param size The number of uncompressed bytes.
+    /// \param compressed The compressed bytes are appended here.
+    /// \returns false if the data could not be made smaller.
+    virtual bool compress(const uint8_t* data,
+                          std::size_t size,
+                          std::vector<uint8_t>& compressed) const = 0;
+
+    /// \brief Decompress a packet.
+    /// \param data The compressed bytes.
+    /// \param size The number of compressed bytes.
+    /// \param decompressed The decompressed bytes are appended here.
+    /// \param maxSize The maximum number of bytes to decompress.
+    /// \returns false if the data is invalid or would exceed maxSize.
+    virtual bool decompress(const uint8_t* data,
+                            std::size_t size,
+                            std::vector<uint8_t>& decompressed,
+                            std::size_t maxSize) const = 0;
+
+    /// \returns the name of the compression format.
+    virtual std::string name() const = 0;
+
+};
+
+
+/// \brief LZ4 block format compression.
+///
+/// Packets are compatible with LZ4_compress_default() and
+/// LZ4_decompress_safe(). Suited to host to host links.
+class LZ4Compression: public AbstractPacketCompression
+{
+public:
+    virtual ~LZ4Compression();
+
+    bool compress(const uint8_t* data,
+                  std::size_t size,
+                  std::vector<uint8_t>& compressed) const override;
+
+    bool decompress(const uint8_t* data,
+                    std::size_t size,
+                    std::vector<uint8_t>& decompressed,
+                    std::size_t maxSize) const override;
+
+    std::string name() const override;
+
+private:
+    enum
+    {
+        MIN_MATCH = 4,
+        LAST_LITERALS = 5,
+        MATCH_FIND_LIMIT = 12,
+        MAX_OFFSET = 65535,
+        HASH_BITS = 12
+    };
+
+};
+
+
+/// \brief heatshrink compatible LZSS compression.
+///
+/// Packets can be decoded by a heatshrink decoder configured with the same
+/// window and lookahead sizes, which makes this suitable for microcontroller
+/// peers with little RAM.
+class HeatshrinkCompression: public AbstractPacketCompression
+{
+public:
+    /// \brief Create a heatshrink compatible compressor.
+    /// \param windowBits The base-2 log of the window size (4 - 15).
+    /// \param lookaheadBits The base-2 log of the lookahead size (3 - windowBits - 1).
+    HeatshrinkCompression(uint8_t windowBits = DEFAULT_WINDOW_BITS,
+                          uint8_t lookaheadBits = DEFAULT_LOOKAHEAD_BITS);
+
+    virtual ~HeatshrinkCompression();
+
+    bool compress(const uint8_t* data,
+                  std::size_t size,
+                  std::vector<uint8_t>& compressed) const override;
+
+    bool decompress(const uint8_t* data,
+                    std::size_t size,
+                    std::vector<uint8_t>& decompressed,
+                    std::size_t maxSize) const override;
+
+    std::string name() const override;
+
+    /// \returns the base-2 log of the window size.
+    uint8_t windowBits() const;
+
+    /// \returns the base-2 log of the lookahead size.
+    uint8_t lookaheadBits() const;
+
+    enum
+    {
+        DEFAULT_WINDOW_BITS = 8,
+        DEFAULT_LOOKAHEAD_BITS = 4
+    };
+
+private:
+    /// \brief The base-2 log of the window size.
+    uint8_t _windowBits = DEFAULT_WINDOW_BITS;
+
+    /// \brief The base-2 log of the lookahead size.
+    uint8_t _lookaheadBits = DEFAULT_LOOKAHEAD_BITS;
+
+};
+
+
+} } // namespace ofx::IO
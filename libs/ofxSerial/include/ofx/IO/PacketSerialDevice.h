@@ -8,9 +8,12 @@
 #pragma once
 
 
+#include <memory>
+#include <mutex>
 #include "ofx/IO/SerialEvents.h"
 #include "ofx/IO/BufferedSerialDevice.h"
 #include "ofx/IO/COBSEncoding.h"
+#include "ofx/IO/PacketCompression.h"
 #include "ofx/IO/SLIPEncoding.h"
 
 
@@ -35,14 +38,58 @@ public:
 
     using BufferedSerialDevice::setup;
 
+    /// \brief Send a packet.
+    ///
+    /// Packets may be sent from any thread. Sends share the device's scratch
+    /// buffers, so each one waits for the one before it.
+    ///
+    /// \param buffer The packet payload.
     void send(const ByteBuffer& buffer)
     {
-        ByteBuffer encoded;
-        _encoder.encode(buffer, encoded);
-        BufferedSerialDevice::writeBytes(encoded);
-        BufferedSerialDevice::writeByte(PacketMarker);
+        std::unique_lock<std::mutex> lock(_sendMutex);
+        sendLocked(buffer);
     }
 
+    /// \brief Send a packet from raw bytes, such as a CBORWriter's output.
+    ///
+    /// The bytes are staged in a reused buffer rather than a new ByteBuffer.
+    ///
+    /// \param data The packet payload.
+    /// \param size The number of payload bytes.
+    void send(const uint8_t* data, std::size_t size)
+    {
+        std::unique_lock<std::mutex> lock(_sendMutex);
+        _unencoded.clear();
+        _unencoded.writeBytes(data, size);
+        sendLocked(_unencoded);
+    }
+
+    /// \brief Set the compression stage used for each packet.
+    ///
+    /// When compression is enabled every packet starts with a flag byte that
+    /// tells the receiver whether the payload was compressed. Payloads that
+    /// do not get smaller are sent raw. Both ends of the link must use the
+    /// same compression. Decompressed packets are limited to BufferSize bytes.
+    ///
+    /// \param compression The compression to use, or nullptr to disable it.
+    void setCompression(std::shared_ptr<AbstractPacketCompression> compression)
+    {
+        _compression = compression;
+    }
+
+    /// \returns the compression stage or nullptr if compression is disabled.
+    std::shared_ptr<AbstractPacketCompression> getCompression() const
+    {
+        return _compression;
+    }
+
+    enum
+    {
+        /// \brief Flag byte values used when compression is enabled.
+        PACKET_FLAG_RAW = 0x00,
+        PACKET_FLAG_COMPRESSED = 0x01
+    };
+
     using BufferedSerialDevice::port;
     using BufferedSerialDevice::baudRate;
     using BufferedSerialDevice::dataBits;
@@ -58,9 +105,16 @@ public:
 
 	
 
+    using BufferedSerialDevice::startReaderThread;
+    using BufferedSerialDevice::stopReaderThread;
+    using BufferedSerialDevice::isReaderThreadRunning;
+
     using BufferedSerialDevice::flush;
     using BufferedSerialDevice::flushInput;
     using BufferedSerialDevice::flushOutput;
+
+    using BufferedSerialDevice::setTap;
+    using BufferedSerialDevice::tap;
     
     /// \brief Register a class to receive notifications for all events.
     /// \param listener a pointer to the listener class.
@@ -84,17 +138,59 @@ public:
     /// \brief The SerialEvents that the user can subscribe to.
     SerialEvents packetEvents;
 
-    void onSerialBuffer(const SerialBufferEventArgs& args)
+    /// \brief The outcome of decode().
+    enum DecodeResult
     {
-        ByteBuffer decoded;
+        /// \brief The frame held a packet.
+        DECODE_OK,
+        /// \brief The frame decoded to nothing and is ignored.
+        DECODE_EMPTY,
+        /// \brief The payload is not valid for the compression stage.
+        DECODE_INVALID
+    };
 
-        std::size_t size = _encoder.decode(args.buffer(), decoded);
+    /// \brief Decode a received frame into a packet.
+    ///
+    /// This is what the device does with each frame between markers. It
+    /// does not touch the port, so any bytes can be decoded, e.g. in tests.
+    ///
+    /// \param frame The frame, without the marker.
+    /// \param packet Set to the packet.
+    /// \returns the outcome.
+    DecodeResult decode(const ByteBuffer& frame, ByteBuffer& packet)
+    {
+        packet.clear();
 
-        if (size > 0)
+        if (_compression == nullptr)
         {
-            SerialBufferEventArgs evt(args.device(), decoded);
+            return _encoder.decode(frame, packet) > 0 ? DECODE_OK : DECODE_EMPTY;
+        }
+
+        _decoded.clear();
+
+        if (_encoder.decode(frame, _decoded) == 0)
+        {
+            return DECODE_EMPTY;
+        }
+
+        return decompress(_decoded, packet) ? DECODE_OK : DECODE_INVALID;
+    }
+
+    void onSerialBuffer(const SerialBufferEventArgs& args)
+    {
+        DecodeResult result = decode(args.buffer(), _packet);
+
+        if (result == DECODE_OK)
+        {
+            SerialBufferEventArgs evt(args.device(), _packet);
             ofNotifyEvent(packetEvents.onSerialBuffer, evt, this);
         }
+        else if (result == DECODE_INVALID)
+        {
+            Poco::Exception exception("Invalid " + _compression->name() + " packet.");
+            SerialBufferErrorEventArgs evt(args.device(), _decoded, exception);
+            ofNotifyEvent(packetEvents.onSerialError, evt, this);
+        }
     }
 
     void onSerialError(const SerialBufferErrorEventArgs& args)
@@ -104,9 +200,86 @@ public:
     }
 
 private:
+    /// \brief Encode and write a packet, with _sendMutex held.
+    void sendLocked(const ByteBuffer& buffer)
+    {
+        _encoded.clear();
+
+        if (_compression != nullptr)
+        {
+            _encoder.encode(compress(buffer), _encoded);
+        }
+        else
+        {
+            _encoder.encode(buffer, _encoded);
+        }
+
+        _encoded.writeByte(PacketMarker);
+        BufferedSerialDevice::writeBytes(_encoded);
+    }
+
+    /// \brief Prefix the flag byte and compress the payload if it helps.
+    ByteBuffer compress(const ByteBuffer& buffer) const
+    {
+        std::vector<uint8_t> packet;
+        packet.reserve(buffer.size() + 1);
+        packet.push_back(PACKET_FLAG_COMPRESSED);
+
+        if (!_compression->compress(buffer.getPtr(), buffer.size(), packet))
+        {
+            packet.resize(1);
+            packet[0] = PACKET_FLAG_RAW;
+            packet.insert(packet.end(), buffer.getPtr(), buffer.getPtr() + buffer.size());
+        }
+
+        return ByteBuffer(packet.data(), packet.size());
+    }
+
+    /// \brief Remove the flag byte and decompress the payload if needed.
+    bool decompress(const ByteBuffer& packet, ByteBuffer& decompressed) const
+    {
+        const uint8_t* data = packet.getPtr();
+
+        if (data[0] == PACKET_FLAG_RAW)
+        {
+            decompressed.writeBytes(data + 1, packet.size() - 1);
+            return true;
+        }
+        else if (data[0] == PACKET_FLAG_COMPRESSED)
+        {
+            std::vector<uint8_t> payload;
+
+            if (_compression->decompress(data + 1, packet.size() - 1, payload, BufferSize))
+            {
+                decompressed.writeBytes(payload.data(), payload.size());
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     /// \brief The encoder used to encode and decode byte buffers.
     Encoder _encoder;
 
+    /// \brief The optional compression stage.
+    std::shared_ptr<AbstractPacketCompression> _compression = nullptr;
+
+    /// \brief Serializes sends, which share _unencoded and _encoded.
+    std::mutex _sendMutex;
+
+    /// \brief A reused staging buffer for raw packets.
+    ByteBuffer _unencoded;
+
+    /// \brief A reused buffer for encoded packets.
+    ByteBuffer _encoded;
+
+    /// \brief A reused buffer for decoded, still compressed packets.
+    ByteBuffer _decoded;
+
+    /// \brief A reused buffer for received packets.
+    ByteBuffer _packet;
+
 };
 
 
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include "ofx/IO/SerialDeviceGroup.h"
+#include "ofx/IO/COBSEncoding.h"
+#include "ofx/IO/SLIPEncoding.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Broadcasts packets to a group of devices at the same moment.
+///
+/// Packets are framed the same way as by PacketSerialDevice_, so each
+/// device can be read with a matching packet serial device. A packet sent
+/// to every device is encoded only once.
+template<typename Encoder, uint8_t PacketMarker = 0>
+class PacketSerialDeviceGroup_: public SerialDeviceGroup
+{
+public:
+    /// \brief Send the same packet to every device.
+    /// \param buffer The unencoded packet.
+    /// \returns the outcome, valid until the next write.
+    const WriteResult& broadcast(const ByteBuffer& buffer)
+    {
+        _encoded.clear();
+        _encoder.encode(buffer, _encoded);
+        _encoded.writeByte(PacketMarker);
+        return writeAll(_encoded.getPtr(), _encoded.size());
+    }
+
+    /// \brief Send the same packet to every device.
+    /// \param data The unencoded packet.
+    /// \param size The size of the packet.
+    /// \returns the outcome, valid until the next write.
+    const WriteResult& broadcast(const uint8_t* data, std::size_t size)
+    {
+        _unencoded.clear();
+        _unencoded.writeBytes(data, size);
+        return broadcast(_unencoded);
+    }
+
+    /// \brief Send a different packet to each device, e.g. slices of a frame.
+    /// \param slices One unencoded packet per device, in the order of setup().
+    /// \returns the outcome, valid until the next write.
+    const WriteResult& broadcast(const std::vector<ByteBuffer>& slices)
+    {
+        _encodedSlices.resize(slices.size());
+
+        for (std::size_t i = 0; i < slices.size(); ++i)
+        {
+            _encodedSlices[i].clear();
+            _encoder.encode(slices[i], _encodedSlices[i]);
+            _encodedSlices[i].writeByte(PacketMarker);
+        }
+
+        return writeEach(_encodedSlices);
+    }
+
+private:
+    Encoder _encoder;
+
+    ByteBuffer _unencoded;
+
+    ByteBuffer _encoded;
+
+    std::vector<ByteBuffer> _encodedSlices;
+
+};
+
+
+typedef PacketSerialDeviceGroup_<COBSEncoding> PacketSerialDeviceGroup;
+typedef PacketSerialDeviceGroup_<COBSEncoding> COBSPacketSerialDeviceGroup;
+typedef PacketSerialDeviceGroup_<SLIPEncoding, SLIPEncoding::END> SLIPPacketSerialDeviceGroup;
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ofx/IO/SerialDevice.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Shares serial devices over TCP.
+///
+/// Each device gets a listening TCP port that accepts one client at a
+/// time. All ports are served by one epoll loop on a background thread.
+///
+/// In MODE_RFC2217 clients speak Telnet with the Com Port Control Option
+/// (RFC 2217), e.g. pyserial's `rfc2217://host:port` URLs. Baud rate,
+/// data bits, parity, stop bits, flow control, break, DTR and RTS
+/// requests are applied to the device and modem line changes are sent
+/// back. Data is escaped, so it passes through the device's read and
+/// write path and its tap.
+///
+/// In MODE_RAW the socket carries the bytes unchanged, like a plain TCP
+/// serial bridge. Bytes are moved between the port and the socket with
+/// splice(2) through a pipe, without copies into user space, and fall
+/// back to read and write where the port does not support splicing. Taps
+/// do not see spliced bytes.
+///
+/// While a device is served nothing else may read from it. The server is
+/// only available on Linux.
+class RFC2217Server
+{
+public:
+    /// \brief The protocol spoken on a port.
+    enum Mode
+    {
+        /// \brief Telnet with the Com Port Control Option.
+        MODE_RFC2217,
+        /// \brief Unchanged bytes.
+        MODE_RAW
+    };
+
+    RFC2217Server();
+
+    /// \brief Stop serving.
+    virtual ~RFC2217Server();
+
+    /// \brief Share a device. Only call while stopped.
+    /// \param device The open device. It must outlive the server.
+    /// \param port The TCP port, or 0 to pick a free one.
+    /// \param mode The protocol spoken on the port.
+    /// \param address The local address to listen on.
+    /// \returns true if the port is listening.
+    bool addDevice(SerialDevice* device,
+                   uint16_t port,
+                   Mode mode = MODE_RFC2217,
+                   const std::string& address = "0.0.0.0");
+
+    /// \brief Start serving on a background thread.
+    /// \returns true if the server started.
+    bool start();
+
+    /// \brief Disconnect all clients and stop serving.
+    ///
+    /// The ports keep listening, so the server can be started again.
+    void stop();
+
+    /// \brief Stop serving and close all ports.
+    void close();
+
+    /// \returns true while serving.
+    bool isRunning() const;
+
+    /// \returns the number of shared devices.
+    std::size_t size() const;
+
+    /// \param index The index of a device.
+    /// \returns the TCP port of the device.
+    uint16_t port(std::size_t index) const;
+
+    /// \returns the number of connected clients.
+    std::size_t clientCount() const;
+
+    /// \returns the number of bytes moved with splice(2).
+    uint64_t splicedBytes() const;
+
+    /// \returns the number of bytes copied through user space.
+    uint64_t copiedBytes() const;
+
+    enum
+    {
+        /// \brief How often the modem lines are checked.
+        MODEM_POLL_INTERVAL_MS = 100,
+        /// \brief The size of the copy buffers of each port.
+        BUFFER_SIZE = 4096,
+        /// \brief The most bytes moved by one splice call.
+        SPLICE_SIZE = 65536
+    };
+
+private:
+    struct Endpoint;
+    struct Port;
+
+    /// \brief The event loop.
+    void run();
+
+    /// \brief Handle an event of an endpoint.
+    void handle(Endpoint* endpoint, uint32_t events);
+
+    /// \brief Accept a client on a port.
+    void accept(Port& port);
+
+    /// \brief Disconnect the client of a port.
+    void disconnect(Port& port);
+
+    /// \brief Move bytes in MODE_RAW.
+    /// \returns false if the client is gone.
+    bool pumpRaw(Port& port);
+
+    /// \brief Move bytes in MODE_RFC2217.
+    /// \returns false if the client is gone.
+    bool pumpTelnet(Port& port);
+
+    /// \brief Handle bytes received from a MODE_RFC2217 client.
+    void parse(Port& port, const uint8_t* data, std::size_t size);
+
+    /// \brief Handle a Telnet option negotiation.
+    void negotiate(Port& port, uint8_t command, uint8_t option);
+
+    /// \brief Handle a com port subnegotiation.
+    void subnegotiate(Port& port);
+
+    /// \brief Queue a com port answer for the client.
+    void reply(Port& port, uint8_t command, const uint8_t* value, std::size_t size);
+
+    /// \brief Send changed modem lines to the clients that asked for them.
+    void pollModemState();
+
+    /// \returns the modem lines of a port as RFC 2217 modem state bits.
+    uint8_t readModemState(Port& port);
+
+    /// \brief Update the epoll interest of a port's descriptors.
+    void updateInterest(Port& port);
+
+    /// \brief The shared devices.
+    std::vector<std::unique_ptr<Port>> _ports;
+
+    /// \brief The epoll instance.
+    int _epoll = -1;
+
+    /// \brief Wakes the loop on stop().
+    int _wakeFd = -1;
+
+    /// \brief The loop thread.
+    std::thread _thread;
+
+    /// \brief True while the loop should run.
+    std::atomic<bool> _running;
+
+    /// \brief The number of connected clients.
+    std::atomic<std::size_t> _clientCount;
+
+    /// \brief The number of spliced bytes.
+    std::atomic<uint64_t> _splicedBytes;
+
+    /// \brief The number of copied bytes.
+    std::atomic<uint64_t> _copiedBytes;
+
+};
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,154 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ofx/IO/AbstractTypes.h"
+#include "ofx/IO/SerialCapture.h"
+#include "ofx/IO/SerialDevice.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Plays back a recording made with SerialCaptureLog.
+///
+/// The bytes the recorded device read become available to readBytes()
+/// at their recorded times, scaled by the speed, or all at once. Bytes
+/// written to the device are counted and discarded. Together with a
+/// fixed recording this makes parser benchmarks and timing bugs
+/// reproducible without hardware.
+///
+/// openPort() plays a recording through a serial::Serial instead, so any
+/// SerialDevice, e.g. a PacketSerialDevice, can be set up with it.
+class ReplaySerialDevice:
+    public virtual AbstractBufferedByteSource,
+    public virtual AbstractByteSink
+{
+public:
+    ReplaySerialDevice();
+
+    virtual ~ReplaySerialDevice();
+
+    /// \brief Start playing a recording.
+    /// \param paths The files of the recording, e.g. from SerialCaptureLog::listFiles().
+    /// \param speed The playback speed, 1 for the recorded timing or
+    ///        SPEED_UNLIMITED to make every byte available at once.
+    /// \returns true if the recording could be opened.
+    bool setup(const std::vector<std::string>& paths, double speed = 1);
+
+    /// \brief Start playing a recording.
+    /// \param basePath The path passed to SerialCaptureLog::setup().
+    /// \param speed The playback speed.
+    /// \returns true if the recording could be opened.
+    bool setup(const std::string& basePath, double speed = 1);
+
+    /// \brief Stop playing and close the recording.
+    void close();
+
+    /// \brief Start again from the beginning of the recording.
+    void rewind();
+
+    /// \brief Change the playback speed from now on.
+    /// \param speed The playback speed.
+    void setSpeed(double speed);
+
+    /// \returns the playback speed.
+    double speed() const;
+
+    /// \returns true once every recorded byte was read.
+    bool isFinished() const;
+
+    /// \returns the number of bytes written to the device.
+    uint64_t bytesWritten() const;
+
+    /// \returns the nanoseconds until recorded bytes are due, 0 if some are
+    ///          available, or the largest value once the recording ended.
+    uint64_t nanosUntilAvailable() const;
+
+    /// \brief Wait until recorded bytes are due.
+    /// \param timeoutMillis The longest time to wait.
+    /// \returns true if there is something to read.
+    bool waitReadable(uint32_t timeoutMillis);
+
+    /// \brief Create a port that plays a recording.
+    ///
+    /// Use it with SerialDevice::setup(std::shared_ptr<serial::Serial>).
+    /// The port honours the read timeouts, discards written bytes and
+    /// reports CTS, DSR and CD high. It has no descriptor to poll, so it
+    /// can't be added to a SerialDeviceManager.
+    ///
+    /// \param basePath The path passed to SerialCaptureLog::setup().
+    /// \param speed The playback speed.
+    /// \param threadingMode How the port may be shared between threads.
+    /// \returns the open port, or nullptr if the recording can't be opened.
+    static std::shared_ptr<serial::Serial> openPort(const std::string& basePath,
+                                                    double speed = 1,
+                                                    SerialDevice::ThreadingMode threadingMode = SerialDevice::THREADING_MULTI);
+
+    std::size_t readBytes(uint8_t* buffer, std::size_t size) override;
+    std::size_t readByte(uint8_t& data) override;
+    std::size_t available() const override;
+
+    std::size_t writeByte(uint8_t data) override;
+    std::size_t writeBytes(const uint8_t* buffer, std::size_t size) override;
+    std::size_t writeBytes(const std::vector<uint8_t>& buffer) override;
+    std::size_t writeBytes(const std::string& buffer) override;
+    std::size_t writeBytes(const AbstractByteSource& buffer) override;
+
+    /// \brief Make every recorded byte available at once.
+    static constexpr double SPEED_UNLIMITED = 0;
+
+private:
+    class Backend;
+
+    /// \brief Move the records that are due into the pending bytes.
+    void advance() const;
+
+    /// \brief Find the next received record.
+    /// \returns false at the end of the recording.
+    bool nextRecord() const;
+
+    /// \returns the playback position in recorded nanoseconds.
+    uint64_t position() const;
+
+    /// \brief The recording.
+    mutable SerialCaptureReader _reader;
+
+    /// \brief The next record to play.
+    mutable SerialCaptureReader::Record _record;
+
+    /// \brief True if _record is valid.
+    mutable bool _hasRecord = false;
+
+    /// \brief The bytes that are due but not read yet.
+    mutable std::vector<uint8_t> _pending;
+
+    /// \brief The offset of the first unread pending byte.
+    mutable std::size_t _pendingOffset = 0;
+
+    /// \brief The playback speed.
+    double _speed = 1;
+
+    /// \brief The recorded time at the last speed change.
+    uint64_t _baseTimestamp = 0;
+
+    /// \brief The real time at the last speed change.
+    uint64_t _baseNanos = 0;
+
+    /// \brief The number of bytes written.
+    uint64_t _bytesWritten = 0;
+
+};
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,239 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "ofx/IO/AbstractTypes.h"
+#include "ofx/IO/SerialTap.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Publishes the traffic of a device to other processes.
+///
+/// Only one process can open a serial port. The broker is a tap on the
+/// device of the process that owns it and copies every read and write into
+/// a ring of frames in POSIX shared memory. Any number of processes follow
+/// the ring with a SerialBrokerReader, each at its own position.
+///
+/// The broker never waits for readers. A reader that falls a whole ring
+/// behind loses the oldest frames and counts an overrun. Readers map the
+/// ring read only, so they cannot disturb the broker or each other.
+///
+/// Frames other than tapped bytes, e.g. decoded packets, can be published
+/// with publish(). Each frame keeps its direction and timestamp.
+///
+/// Use SerialDevice::setTap() to publish a device. Not available on
+/// Windows.
+class SerialBroker: public AbstractSerialTap
+{
+public:
+    SerialBroker();
+
+    /// \brief Close and remove the shared memory.
+    virtual ~SerialBroker();
+
+    /// \brief Create the shared memory.
+    ///
+    /// An existing ring of the same name, e.g. left behind by a crashed
+    /// broker, is replaced.
+    ///
+    /// \param name The name of the ring, e.g. "sensor". It becomes the
+    ///        POSIX shared memory object "/sensor".
+    /// \param capacity The minimum size of the ring in bytes.
+    /// \returns true if the ring was created.
+    bool setup(const std::string& name, std::size_t capacity = DEFAULT_CAPACITY);
+
+    /// \brief Mark the ring closed for readers and remove it.
+    void close();
+
+    /// \returns true while publishing.
+    bool isOpen() const;
+
+    void tap(Direction direction,
+             uint64_t timestampNanos,
+             const uint8_t* data,
+             std::size_t size) override;
+
+    /// \brief Publish a frame.
+    /// \param direction The direction of the frame.
+    /// \param timestampNanos The monotonic time of the frame, see now().
+    /// \param data The frame.
+    /// \param size The size of the frame, at most maximumFrameSize().
+    /// \returns true if the frame was published.
+    bool publish(Direction direction,
+                 uint64_t timestampNanos,
+                 const uint8_t* data,
+                 std::size_t size);
+
+    /// \returns the largest frame that fits into the ring.
+    std::size_t maximumFrameSize() const;
+
+    /// \returns the number of frames published.
+    uint64_t frameCount() const;
+
+    /// \returns the number of bytes not published because their frame was
+    ///          larger than maximumFrameSize().
+    uint64_t droppedBytes() const;
+
+    /// \returns the name of the ring.
+    std::string name() const;
+
+    enum
+    {
+        /// \brief The default size of the ring.
+        DEFAULT_CAPACITY = 4 * 1024 * 1024
+    };
+
+private:
+    struct Ring;
+
+    /// \brief The shared memory.
+    Ring* _ring = nullptr;
+
+    /// \brief Serializes taps from different threads.
+    std::mutex _mutex;
+
+    /// \brief The name of the ring.
+    std::string _name;
+
+    /// \brief The number of published frames.
+    std::atomic<uint64_t> _frameCount;
+
+    /// \brief The number of dropped bytes.
+    std::atomic<uint64_t> _droppedBytes;
+
+    friend class SerialBrokerReader;
+
+};
+
+
+/// \brief Follows the ring of a SerialBroker in another process.
+///
+/// The reader has the read interface of a SerialDevice. By default it
+/// returns the bytes the device received, in order. Frames can also be
+/// read one at a time, without copies, with peek() and next().
+///
+/// A reader belongs to one thread.
+class SerialBrokerReader: public virtual AbstractBufferedByteSource
+{
+public:
+    /// \brief The directions a reader follows.
+    enum Filter
+    {
+        /// \brief The bytes the device received.
+        FILTER_RX = 1 << AbstractSerialTap::DIRECTION_RX,
+        /// \brief The bytes the device sent.
+        FILTER_TX = 1 << AbstractSerialTap::DIRECTION_TX,
+        /// \brief Both directions.
+        FILTER_ALL = FILTER_RX | FILTER_TX
+    };
+
+    /// \brief A frame in the ring.
+    struct Frame
+    {
+        /// \brief Whether the device read or wrote the frame.
+        AbstractSerialTap::Direction direction;
+
+        /// \brief The monotonic time of the frame.
+        uint64_t timestampNanos;
+
+        /// \brief The unread part of the frame, in shared memory.
+        const uint8_t* data;
+
+        /// \brief The number of unread bytes.
+        std::size_t size;
+    };
+
+    SerialBrokerReader();
+
+    virtual ~SerialBrokerReader();
+
+    /// \brief Attach to a ring.
+    ///
+    /// Reading starts with the next frame the broker publishes.
+    ///
+    /// \param name The name passed to SerialBroker::setup().
+    /// \param filter The directions to return.
+    /// \returns true if the ring exists.
+    bool setup(const std::string& name, Filter filter = FILTER_RX);
+
+    /// \brief Detach from the ring.
+    void close();
+
+    /// \returns true while attached to a ring.
+    bool isOpen() const;
+
+    /// \returns true if the broker closed the ring.
+    bool isBrokerClosed() const;
+
+    std::size_t readBytes(uint8_t* buffer, std::size_t size) override;
+    std::size_t readByte(uint8_t& data) override;
+    std::size_t available() const override;
+
+    /// \brief Wait until there is something to read.
+    /// \param timeoutMillis The longest time to wait.
+    /// \returns true if there is something to read.
+    bool waitReadable(uint32_t timeoutMillis);
+
+    /// \brief Get the unread part of the next frame without copying it.
+    ///
+    /// The data stays in shared memory, where the broker may overwrite it
+    /// once the reader is a whole ring behind. next() tells whether that
+    /// happened.
+    ///
+    /// \param frame Set to the frame.
+    /// \returns false if there is no frame to read.
+    bool peek(Frame& frame);
+
+    /// \brief Move past the frame returned by peek().
+    /// \returns false if the frame was overwritten while in use, in which
+    ///          case its data must be discarded.
+    bool next();
+
+    /// \returns the number of times the reader fell a whole ring behind.
+    uint64_t overrunCount() const;
+
+    /// \brief Skip everything published so far.
+    void skipToEnd();
+
+private:
+    /// \brief Find the frame at the read position, skipping filtered ones.
+    /// \returns false if there is none.
+    bool current(Frame& frame) const;
+
+    /// \returns true if the frame at the position was not overwritten.
+    bool isValid(uint64_t position) const;
+
+    /// \brief Continue with the oldest frame after an overrun.
+    void resync() const;
+
+    /// \brief The shared memory.
+    SerialBroker::Ring* _ring = nullptr;
+
+    /// \brief The directions to return.
+    Filter _filter = FILTER_RX;
+
+    /// \brief The ring position of the frame being read.
+    mutable uint64_t _position = 0;
+
+    /// \brief The number of bytes read from that frame.
+    mutable std::size_t _frameOffset = 0;
+
+    /// \brief The number of overruns.
+    mutable uint64_t _overrunCount = 0;
+
+};
+
+
+} } // namespace ofx::IO
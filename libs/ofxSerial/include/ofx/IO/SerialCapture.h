@@ -0,0 +1,299 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Poco/SharedMemory.h"
+#include "ofx/IO/SerialTap.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Records serial traffic into rotating memory-mapped files.
+///
+/// Each file is created at its full size, mapped and touched once, so
+/// recording a read or write is a memcpy into the mapping under a short
+/// lock. A background thread prepares the next file the same way while the
+/// current one fills, so a full file is swapped for the prepared one without
+/// touching the file system. The same thread unmaps full files and removes
+/// the oldest ones, keeping maxFiles files plus the prepared one, which holds
+/// no records until it is used and is removed by close().
+///
+/// Files are named `<basePath>.<sequence>.scap`. Each starts with a
+/// FileHeader followed by records. A record is a RecordHeader followed by
+/// its payload, padded to RECORD_ALIGNMENT bytes. A record with a size of
+/// zero ends the file. All fields use the byte order of the machine that
+/// recorded them.
+///
+/// Use SerialDevice::setTap() to record a device and SerialCaptureReader
+/// to read the files back.
+class SerialCaptureLog: public AbstractSerialTap
+{
+public:
+    /// \brief The header at the start of each file.
+    struct FileHeader
+    {
+        /// \brief Always MAGIC.
+        char magic[8];
+
+        /// \brief The format version, VERSION.
+        uint32_t version;
+
+        /// \brief The size of this header in bytes.
+        uint32_t headerSize;
+
+        /// \brief The size of the file in bytes.
+        uint64_t capacity;
+
+        /// \brief The position of the file in the rotation.
+        uint64_t sequence;
+
+        /// \brief AbstractSerialTap::now() when the file was created.
+        uint64_t startNanos;
+
+        /// \brief Microseconds since the Unix epoch when the file was created.
+        int64_t startWallMicros;
+
+        uint8_t reserved[16];
+    };
+
+    /// \brief The header of each record.
+    struct RecordHeader
+    {
+        /// \brief The payload size in bytes, written last.
+        uint32_t size;
+
+        /// \brief An AbstractSerialTap::Direction.
+        uint8_t direction;
+
+        uint8_t reserved[3];
+
+        /// \brief The time the bytes were transferred.
+        uint64_t timestampNanos;
+    };
+
+    SerialCaptureLog();
+
+    /// \brief Close the current file.
+    virtual ~SerialCaptureLog();
+
+    /// \brief Start recording.
+    /// \param basePath The path of the files without the sequence suffix.
+    /// \param fileSize The size of each file in bytes.
+    /// \param maxFiles The number of files kept, or 0 to keep all of them.
+    /// \returns true if the first file was created.
+    bool setup(const std::string& basePath,
+               std::size_t fileSize = DEFAULT_FILE_SIZE,
+               std::size_t maxFiles = DEFAULT_MAX_FILES);
+
+    /// \brief Stop recording and unmap the current file.
+    void close();
+
+    /// \returns true while recording.
+    bool isOpen() const;
+
+    void tap(Direction direction,
+             uint64_t timestampNanos,
+             const uint8_t* data,
+             std::size_t size) override;
+
+    /// \returns the number of bytes lost because a file could not be created.
+    uint64_t droppedBytes() const;
+
+    /// \brief List the files of a recording.
+    /// \param basePath The path passed to setup().
+    /// \returns the paths of the files, oldest first.
+    static std::vector<std::string> listFiles(const std::string& basePath);
+
+    /// \brief Get the path of a file in the rotation.
+    /// \param basePath The path passed to setup().
+    /// \param sequence The position of the file in the rotation.
+    /// \returns the path of the file.
+    static std::string filePath(const std::string& basePath, uint64_t sequence);
+
+    /// \brief The first bytes of every file.
+    static const char MAGIC[8];
+
+    enum
+    {
+        /// \brief The current format version.
+        VERSION = 1,
+        /// \brief The alignment of records within a file.
+        RECORD_ALIGNMENT = 8,
+        /// \brief The default size of each file.
+        DEFAULT_FILE_SIZE = 64 * 1024 * 1024,
+        /// \brief The default number of files kept.
+        DEFAULT_MAX_FILES = 8,
+        /// \brief The smallest useful file.
+        MIN_FILE_SIZE = 4096
+    };
+
+private:
+    /// \brief Start writing the file after the current one. Call with the
+    ///        mutex held.
+    bool openFile();
+
+    /// \brief Create, map and touch a file.
+    /// \param sequence The position of the file in the rotation.
+    /// \param memory Set to the mapping.
+    /// \returns true if the file was created.
+    bool createFile(uint64_t sequence, Poco::SharedMemory& memory) const;
+
+    /// \brief Remove the files that fell out of the rotation.
+    /// \param sequence The position of the newest file.
+    void removeOldFiles(uint64_t sequence) const;
+
+    /// \brief Prepare files and release old ones until close().
+    void prepareFiles();
+
+    /// \brief Stop the file thread and remove an unused prepared file.
+    void stopPreparing();
+
+    /// \brief The path passed to setup().
+    std::string _basePath;
+
+    /// \brief The size of each file.
+    std::size_t _fileSize = DEFAULT_FILE_SIZE;
+
+    /// \brief The number of files kept.
+    std::size_t _maxFiles = DEFAULT_MAX_FILES;
+
+    /// \brief The position of the current file in the rotation.
+    uint64_t _sequence = 0;
+
+    /// \brief The mapping of the current file.
+    Poco::SharedMemory _memory;
+
+    /// \brief The start of the current file, or nullptr if closed.
+    uint8_t* _begin = nullptr;
+
+    /// \brief The offset of the next record.
+    std::size_t _offset = 0;
+
+    /// \brief The number of dropped bytes.
+    std::atomic<uint64_t> _droppedBytes;
+
+    /// \brief Serializes reads and writes tapped on different threads.
+    mutable std::mutex _mutex;
+
+    /// \brief Prepares the next file and releases old ones.
+    std::thread _thread;
+
+    /// \brief Guards the members below, shared with the file thread.
+    std::mutex _spareMutex;
+
+    /// \brief Wakes the file thread.
+    std::condition_variable _spareCondition;
+
+    /// \brief True when the file thread should end.
+    bool _stopping = false;
+
+    /// \brief True when the file thread should prepare _spareSequence.
+    bool _spareWanted = false;
+
+    /// \brief True when _spare is the mapped file _spareSequence.
+    bool _spareReady = false;
+
+    /// \brief The position of the prepared file in the rotation.
+    uint64_t _spareSequence = 0;
+
+    /// \brief The mapping of the prepared file.
+    Poco::SharedMemory _spare;
+
+    /// \brief Mappings of full files, released by the file thread.
+    std::vector<Poco::SharedMemory> _retired;
+
+};
+
+
+/// \brief Iterates the records of files written by SerialCaptureLog.
+class SerialCaptureReader
+{
+public:
+    /// \brief A recorded read or write.
+    struct Record
+    {
+        /// \brief Whether the bytes were read or written.
+        AbstractSerialTap::Direction direction = AbstractSerialTap::DIRECTION_RX;
+
+        /// \brief The time the bytes were transferred.
+        uint64_t timestampNanos = 0;
+
+        /// \brief The bytes, valid until the reader moves to the next file.
+        const uint8_t* data = nullptr;
+
+        /// \brief The number of bytes.
+        std::size_t size = 0;
+    };
+
+    SerialCaptureReader();
+
+    virtual ~SerialCaptureReader();
+
+    /// \brief Open one capture file.
+    /// \param path The path of the file.
+    /// \returns true if the file is a valid capture file.
+    bool setup(const std::string& path);
+
+    /// \brief Open the files of a rotated recording in order.
+    /// \param paths The paths, e.g. from SerialCaptureLog::listFiles().
+    /// \returns true if the first file is a valid capture file.
+    bool setup(const std::vector<std::string>& paths);
+
+    /// \brief Close the current file.
+    void close();
+
+    /// \brief Read the next record.
+    /// \param record Set to the next record.
+    /// \returns false at the end of the last file.
+    bool next(Record& record);
+
+    /// \brief Start again from the first record of the first file.
+    /// \returns true if the first file could be opened.
+    bool rewind();
+
+    /// \returns the header of the current file.
+    const SerialCaptureLog::FileHeader& header() const;
+
+private:
+    /// \brief Map a file and check its header.
+    bool openFile(std::size_t index);
+
+    /// \brief The files to read.
+    std::vector<std::string> _paths;
+
+    /// \brief The index of the current file.
+    std::size_t _pathIndex = 0;
+
+    /// \brief The mapping of the current file.
+    Poco::SharedMemory _memory;
+
+    /// \brief The start of the current file, or nullptr if closed.
+    const uint8_t* _begin = nullptr;
+
+    /// \brief The size of the current file.
+    std::size_t _size = 0;
+
+    /// \brief The offset of the next record.
+    std::size_t _offset = 0;
+
+    /// \brief The header of the current file.
+    SerialCaptureLog::FileHeader _header;
+
+};
+
+
+} } // namespace ofx::IO
@@ -9,6 +9,7 @@
 
 
 #include <stdint.h>
+#include <future>
 #include "Poco/Path.h"
 #include "serial/serial.h"
 #include "ofJson.h"
@@ -16,6 +17,7 @@
 #include "ofMath.h"
 #include "ofx/IO/AbstractTypes.h"
 #include "ofx/IO/SerialDeviceUtils.h"
+#include "ofx/IO/SerialTap.h"
 
 
 namespace ofx {
@@ -64,6 +66,18 @@ public:
         FLOW_CTRL_UNKNOWN = -1
     };
 
+    /// \brief How the device may be shared between threads.
+    ///
+    /// THREADING_SINGLE skips the locks taken around every read and write.
+    /// Reads and writes may still happen on two different threads, e.g. a
+    /// BufferedSerialDevice reader thread and the main thread, but never two
+    /// reads or two writes at the same time.
+    enum ThreadingMode
+    {
+        THREADING_MULTI = serial::threading_multi,
+        THREADING_SINGLE = serial::threading_single
+    };
+
     class Settings
     {
     public:
@@ -168,6 +182,23 @@ public:
                 ofLogWarning("Settings::fromJSON") << "Invalid flow control: " << flowControl << ". Using default.";
             }
 
+            settings.lowLatency = json.value("low_latency", false);
+
+            std::string threadingMode = json.value("threading_mode", "multi");
+
+            if (threadingMode == "multi")
+            {
+                settings.threadingMode = THREADING_MULTI;
+            }
+            else if (threadingMode == "single")
+            {
+                settings.threadingMode = THREADING_SINGLE;
+            }
+            else
+            {
+                ofLogWarning("Settings::fromJSON") << "Invalid threading mode: " << threadingMode << ". Using default.";
+            }
+
 //            ofJson timeout = json["timeout"];
 //
 //            if (!timeout.is_null())
@@ -202,6 +233,26 @@ public:
         FlowControl flowControl = FLOW_CTRL_NONE;
         Timeout timeout = DEFAULT_TIMEOUT;
 
+        /// \brief Request low latency mode.
+        /// \sa SerialDevice::setLowLatency()
+        bool lowLatency = false;
+
+        /// \brief How the device may be shared between threads.
+        ThreadingMode threadingMode = THREADING_MULTI;
+
+    };
+
+    /// \brief The outcome of setupAsync() or setupAll().
+    struct SetupResult
+    {
+        /// \brief The port that was opened.
+        std::string portName;
+
+        /// \brief True if the port was opened.
+        bool success = false;
+
+        /// \brief The time taken to open and configure the port.
+        uint64_t micros = 0;
     };
 
     SerialDevice();
@@ -210,6 +261,24 @@ public:
 
     bool setup(const Settings& settings);
 
+    /// \brief Open the port on another thread.
+    ///
+    /// Opening and configuring a port can block for hundreds of milliseconds
+    /// on some USB drivers. Do not use the device until the future is ready.
+    ///
+    /// \param settings The settings of the port.
+    /// \returns the outcome and timing of the setup.
+    std::future<SetupResult> setupAsync(const Settings& settings);
+
+    /// \brief Open many ports concurrently.
+    /// \param devices The devices to set up.
+    /// \param settings The settings of each device.
+    /// \param threadCount The maximum number of ports opened at once.
+    /// \returns the outcome and timing of each setup.
+    static std::vector<SetupResult> setupAll(const std::vector<SerialDevice*>& devices,
+                                             const std::vector<Settings>& settings,
+                                             std::size_t threadCount = DEFAULT_SETUP_THREADS);
+
     /// \brief Connect to the first listed device.
     bool setup(uint32_t baudRate = DEFAULT_BAUD_RATE,
                DataBits dataBits = DATA_BITS_EIGHT,
@@ -234,11 +303,40 @@ public:
                FlowControl flowControl = FLOW_CTRL_NONE,
                Timeout timeout = DEFAULT_TIMEOUT);
 
+    /// \brief Use a port created elsewhere.
+    ///
+    /// This is how ports with a custom serial::SerialBackend, e.g. the
+    /// ports of a SerialSimulator, are used.
+    ///
+    /// \param serial The port. It is opened if it is not open yet.
+    /// \returns true if the port is open.
+    bool setup(std::shared_ptr<serial::Serial> serial);
 
     std::size_t readBytes(uint8_t* buffer, std::size_t size) override;
     std::size_t readByte(uint8_t& data) override;
     std::size_t available() const override;
 
+    /// \returns the number of bytes written but not yet transmitted.
+    std::size_t outWaiting() const;
+
+    /// \returns the time needed to transmit one byte in nanoseconds.
+    uint32_t byteTime() const;
+
+    /// \brief Read like readBytes(), but report errors instead of throwing.
+    ///
+    /// Nothing is allocated unless the result's message() is requested.
+    ///
+    /// \param buffer The buffer to read into.
+    /// \param size The maximum number of bytes to read.
+    /// \returns the number of bytes read and the outcome of the read.
+    serial::IOResult tryReadBytes(uint8_t* buffer, std::size_t size);
+
+    /// \brief Write like writeBytes(), but report errors instead of throwing.
+    /// \param buffer The bytes to write.
+    /// \param size The number of bytes to write.
+    /// \returns the number of bytes written and the outcome of the write.
+    serial::IOResult tryWriteBytes(const uint8_t* buffer, std::size_t size);
+
     std::size_t writeByte(uint8_t data) override;
     std::size_t writeBytes(const uint8_t* buffer, std::size_t size) override;
     std::size_t writeBytes(const std::vector<uint8_t>& buffer) override;
@@ -266,6 +364,33 @@ public:
     Timeout timeout() const;
     OF_DEPRECATED_MSG("Use timeout() instead", Timeout getTimeout() const);
 
+    /// \brief Enable or disable low latency mode.
+    ///
+    /// On Linux this sets ASYNC_LOW_LATENCY and lowers the latency timer of
+    /// FTDI adapters from 16 ms to 1 ms. The original values are restored
+    /// when the device is closed.
+    ///
+    /// \param lowLatency True to enable low latency mode.
+    /// \returns true if the device supports any of the low latency settings.
+    bool setLowLatency(bool lowLatency);
+
+    /// \returns true if low latency mode was requested.
+    bool lowLatency() const;
+
+    /// \returns the threading mode chosen in setup().
+    ThreadingMode threadingMode() const;
+
+    /// \brief Copy every byte read or written to a tap, e.g. a capture log.
+    ///
+    /// Set the tap before reading or writing from other threads, e.g.
+    /// before starting a reader thread.
+    ///
+    /// \param tap The tap, or nullptr to remove it.
+    void setTap(std::shared_ptr<AbstractSerialTap> tap);
+
+    /// \returns the tap, or nullptr.
+    std::shared_ptr<AbstractSerialTap> tap() const;
+
 
     void flush();
     void flushInput();
@@ -293,6 +418,12 @@ public:
         DEFAULT_BAUD_RATE = 9600
     };
 
+    enum
+    {
+        /// \brief The default number of ports opened at once by setupAll().
+        DEFAULT_SETUP_THREADS = 16
+    };
+
     enum
     {
         /// \brief The default read timeout.  0 is a non-blocking timeout.
@@ -308,9 +439,23 @@ public:
     static const Timeout DEFAULT_TIMEOUT;
 
 protected:
+    /// \brief Pass transferred bytes to the tap, if any.
+    void tapBytes(AbstractSerialTap::Direction direction,
+                  const uint8_t* data,
+                  std::size_t size)
+    {
+        if (_tap != nullptr && size > 0)
+        {
+            _tap->tap(direction, AbstractSerialTap::now(), data, size);
+        }
+    }
+
     /// \brief A pointer to the underlying serial object.
     std::shared_ptr<serial::Serial> _serial;
 
+    /// \brief The optional tap.
+    std::shared_ptr<AbstractSerialTap> _tap;
+
 };
 
 
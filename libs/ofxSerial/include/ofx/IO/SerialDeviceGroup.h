@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ofx/IO/ByteBuffer.h"
+#include "ofx/IO/SerialDevice.h"
+#include "ofx/IO/ThreadPolicy.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Writes to a group of devices at the same moment.
+///
+/// Writing to each device in turn delays the last device by the time it
+/// takes to write to all the others. The group keeps one writer thread per
+/// device. A write wakes them all, holds them at a shared barrier until
+/// every thread is ready and then lets them write at once, so that an LED
+/// wall or similar updates everywhere together.
+///
+/// Every write blocks until all devices were written to and records when
+/// each write started and finished, so the skew between ports can be
+/// checked against the byte time.
+class SerialDeviceGroup
+{
+public:
+    /// \brief The outcome of the write to one device.
+    struct PortResult
+    {
+        /// \brief The number of bytes written and any error.
+        serial::IOResult result;
+
+        /// \brief When the write started, relative to the earliest start.
+        int64_t startNanos = 0;
+
+        /// \brief When the write returned, relative to the earliest start.
+        int64_t endNanos = 0;
+    };
+
+    /// \brief The outcome of a group write.
+    struct WriteResult
+    {
+        /// \brief The outcome for each device, in the order of setup().
+        std::vector<PortResult> ports;
+
+        /// \brief The time between the first and last write starting.
+        int64_t startSkewNanos = 0;
+
+        /// \brief The time between the first and last write returning.
+        int64_t endSkewNanos = 0;
+
+        /// \returns true if every device was written to without error.
+        bool ok() const;
+    };
+
+    SerialDeviceGroup();
+
+    /// \brief Stop the writer threads.
+    virtual ~SerialDeviceGroup();
+
+    /// \brief Start a writer thread for each device.
+    /// \param devices The open devices. They must outlive the group.
+    /// \param policy The scheduling policy of the writer threads.
+    void setup(const std::vector<SerialDevice*>& devices,
+               const ThreadPolicy& policy = ThreadPolicy());
+
+    /// \brief Stop the writer threads.
+    void close();
+
+    /// \returns the number of devices.
+    std::size_t size() const;
+
+    /// \brief Write the same bytes to every device.
+    /// \param data The bytes to write.
+    /// \param size The number of bytes.
+    /// \returns the outcome, valid until the next write.
+    const WriteResult& writeAll(const uint8_t* data, std::size_t size);
+
+    /// \brief Write a different slice to each device.
+    ///
+    /// If there is not exactly one slice per device nothing is written, and
+    /// every device reports an io_error with EINVAL.
+    ///
+    /// \param slices One slice per device, in the order of setup().
+    /// \returns the outcome, valid until the next write.
+    const WriteResult& writeEach(const std::vector<ByteBuffer>& slices);
+
+    /// \returns the outcome of the last write.
+    const WriteResult& lastResult() const;
+
+private:
+    void threadedFunction(std::size_t index);
+
+    /// \brief Release the writers and wait for them to finish.
+    const WriteResult& run();
+
+    /// \brief The devices written to.
+    std::vector<SerialDevice*> _devices;
+
+    /// \brief The scheduling policy of the writers.
+    ThreadPolicy _policy;
+
+    /// \brief The writer threads.
+    std::vector<std::thread> _threads;
+
+    /// \brief The bytes of a writeAll().
+    const uint8_t* _data = nullptr;
+
+    /// \brief The number of bytes of a writeAll().
+    std::size_t _size = 0;
+
+    /// \brief The slices of a writeEach(), or nullptr.
+    const std::vector<ByteBuffer>* _slices = nullptr;
+
+    /// \brief The outcome, filled in by the writers.
+    WriteResult _result;
+
+    /// \brief Absolute write times, filled in by the writers.
+    std::vector<int64_t> _starts;
+    std::vector<int64_t> _ends;
+
+    /// \brief Incremented for every write.
+    uint64_t _generation = 0;
+
+    /// \brief The number of writers yet to reach the barrier.
+    std::atomic<std::size_t> _arrived;
+
+    /// \brief The number of writers yet to finish.
+    std::size_t _remaining = 0;
+
+    /// \brief True while the writers should run.
+    bool _running = false;
+
+    /// \brief Protects the generation, remaining count and running flag.
+    std::mutex _mutex;
+
+    /// \brief Wakes the writers.
+    std::condition_variable _start;
+
+    /// \brief Signals that all writers finished.
+    std::condition_variable _done;
+
+};
+
+
+} } // namespace ofx::IO
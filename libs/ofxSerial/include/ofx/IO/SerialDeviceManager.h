@@ -0,0 +1,230 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ofEvents.h"
+#include "ofx/IO/BufferedSerialDevice.h"
+#include "ofx/IO/SerialEvents.h"
+#include "ofx/IO/SerialRingBuffer.h"
+#include "ofx/IO/ThreadPolicy.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Services many buffered serial devices from a shared event loop.
+///
+/// Each BufferedSerialDevice registers its own update listener and checks
+/// its port every frame, so the cost of an idle installation grows with the
+/// number of ports. The SerialDeviceManager opens all of its devices in
+/// parallel, waits on every port at once from one reactor thread, or a few
+/// worker threads sharded by device, and queues the devices that received
+/// data. Each update then frames only those devices and emits their buffers
+/// in one batch on the main thread.
+///
+/// Buffers and errors from all devices are emitted on the manager's events.
+/// SerialBufferEventArgs::device() identifies the device and index() turns
+/// it into a position in the settings passed to setup().
+class SerialDeviceManager
+{
+public:
+    /// \brief Create a manager.
+    /// \param marker The buffer boundary marker of every device.
+    /// \param maxBufferSize The maximum buffer size of every device.
+    SerialDeviceManager(uint8_t marker = BufferedSerialDevice::DEFAULT_MARKER,
+                        std::size_t maxBufferSize = BufferedSerialDevice::DEFAULT_MAX_BUFFER_SIZE);
+
+    /// \brief Stop the workers and close all devices.
+    virtual ~SerialDeviceManager();
+
+    /// \brief Open devices in parallel and start servicing them.
+    ///
+    /// Devices that fail to open are kept, closed, so that indices always
+    /// match the settings.
+    ///
+    /// \param settings The settings of each device.
+    /// \param workerCount The number of reactor threads, at least one.
+    /// \param policy The scheduling policy of the reactor threads.
+    /// \param capacity The ring buffer capacity of each device in bytes.
+    /// \returns the number of devices that were opened.
+    std::size_t setup(const std::vector<SerialDevice::Settings>& settings,
+                      std::size_t workerCount = 1,
+                      const ThreadPolicy& policy = ThreadPolicy(),
+                      std::size_t capacity = DEFAULT_CAPACITY);
+
+    /// \brief Stop the workers and close all devices.
+    void close();
+
+    /// \brief Emit the buffers received since the last update.
+    void update(ofEventArgs& args);
+
+    /// \returns the number of devices, open or not.
+    std::size_t size() const;
+
+    /// \returns the number of open devices.
+    std::size_t openCount() const;
+
+    /// \returns the number of reactor threads.
+    std::size_t workerCount() const;
+
+    /// \returns the outcome and open time of each device's setup.
+    const std::vector<SerialDevice::SetupResult>& setupResults() const;
+
+    /// \brief Get a device, e.g. to write to it.
+    /// \param index The index of the device's settings.
+    /// \returns the device.
+    BufferedSerialDevice& device(std::size_t index);
+
+    /// \brief Get a device.
+    /// \param index The index of the device's settings.
+    /// \returns the device.
+    const BufferedSerialDevice& device(std::size_t index) const;
+
+    /// \brief Find the index of a device, e.g. from event arguments.
+    /// \param device The device.
+    /// \returns the index of the device or NO_INDEX if it is not managed.
+    std::size_t index(const BufferedSerialDevice& device) const;
+
+    /// \param index The index of the device.
+    /// \returns the number of bytes dropped because the device's ring was full.
+    uint64_t overflowCount(std::size_t index) const;
+
+    /// \brief Register a class to receive notifications for all events.
+    /// \param listener a pointer to the listener class.
+    /// \param order the event order.
+    /// \tparam ListenerClass The listener class type.
+    template<class ListenerClass>
+    void registerAllEvents(ListenerClass* listener, int order = OF_EVENT_ORDER_AFTER_APP)
+    {
+        ofAddListener(events.onSerialBuffer, listener, &ListenerClass::onSerialBuffer, order);
+        ofAddListener(events.onSerialError, listener, &ListenerClass::onSerialError, order);
+    }
+
+    /// \brief Unregister a class to receive notifications for all events.
+    /// \param listener a pointer to the listener class.
+    /// \param order the event order.
+    /// \tparam ListenerClass The listener class type.
+    template<class ListenerClass>
+    void unregisterAllEvents(ListenerClass* listener, int order = OF_EVENT_ORDER_AFTER_APP)
+    {
+        ofRemoveListener(events.onSerialBuffer, listener, &ListenerClass::onSerialBuffer, order);
+        ofRemoveListener(events.onSerialError, listener, &ListenerClass::onSerialError, order);
+    }
+
+    void onSerialBuffer(const SerialBufferEventArgs& args);
+    void onSerialError(const SerialBufferErrorEventArgs& args);
+
+    /// \brief The buffers and errors of all devices.
+    SerialEvents events;
+
+    enum : std::size_t
+    {
+        /// \brief The default ring buffer capacity of each device.
+        DEFAULT_CAPACITY = 16384,
+        /// \brief How often the workers check for stop requests.
+        WAKE_INTERVAL_MS = 50,
+        /// \brief The largest single read.
+        READ_BUFFER_SIZE = 4096,
+        /// \brief Returned by index() for devices that are not managed.
+        NO_INDEX = static_cast<std::size_t>(-1)
+    };
+
+private:
+    /// \brief A device framed by the manager instead of its own update.
+    class Device: public BufferedSerialDevice
+    {
+    public:
+        Device(uint8_t marker, std::size_t maxBufferSize);
+
+        using BufferedSerialDevice::processBytes;
+
+        /// \brief Emit an error on the device's events.
+        void notifyError(const std::string& message);
+
+        /// \brief Bytes read by the worker, drained on update.
+        std::unique_ptr<SerialRingBuffer> ring;
+
+        /// \brief True while the device is queued for the next update.
+        std::atomic<bool> pending;
+
+        /// \brief Set by the worker after the device failed.
+        std::atomic<bool> failed;
+
+        /// \brief True once the failure has been emitted.
+        bool failureNotified = false;
+
+        /// \brief The failure, written by the worker before failed is set.
+        std::string error;
+
+        /// \brief The number of dropped bytes.
+        std::atomic<uint64_t> overflowCount;
+
+    };
+
+    /// \brief Service every workerCount-th device, starting at worker.
+    void threadedFunction(std::size_t worker, std::size_t workerCount);
+
+    /// \brief Read whatever a device has and queue it for the next update.
+    /// \returns false if the device failed.
+    bool service(std::size_t index, std::vector<uint8_t>& buffer);
+
+    /// \brief Record a device failure. Only called by its worker.
+    void fail(std::size_t index, const std::string& message);
+
+    /// \brief Queue a device for the next update. Never allocates.
+    void markReady(std::size_t index);
+
+    /// \brief The managed devices, in the order of their settings.
+    std::vector<std::unique_ptr<Device>> _devices;
+
+    /// \brief The outcome of each device's setup.
+    std::vector<SerialDevice::SetupResult> _setupResults;
+
+    /// \brief Maps devices back to their index.
+    std::map<const BufferedSerialDevice*, std::size_t> _indices;
+
+    /// \brief The buffer boundary marker of every device.
+    uint8_t _marker;
+
+    /// \brief The maximum buffer size of every device.
+    std::size_t _maxBufferSize;
+
+    /// \brief The scheduling policy of the workers.
+    ThreadPolicy _policy;
+
+    /// \brief The reactor threads.
+    std::vector<std::thread> _workers;
+
+    /// \brief True while the workers should run.
+    std::atomic<bool> _running;
+
+    /// \brief The devices queued by the workers, reserved for all devices.
+    std::vector<std::size_t> _ready;
+
+    /// \brief The devices being emitted by update.
+    std::vector<std::size_t> _readyUpdate;
+
+    /// \brief Protects the ready queue.
+    std::mutex _readyMutex;
+
+    /// \brief The buffer update drains rings into.
+    std::vector<uint8_t> _updateBuffer;
+
+};
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cstring>
+#include "ofx/IO/ByteBuffer.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Splits a byte stream into frames ending with a marker byte.
+///
+/// This is the framing of BufferedSerialDevice, without a device or events,
+/// so it can be fed any bytes, e.g. from a test or a recording. All state is
+/// in the partial frame passed in. Bytes are scanned with memchr and copied
+/// in runs rather than one at a time.
+///
+/// Empty frames are skipped. A frame that would grow past maxBufferSize - 1
+/// bytes is passed to the overflow handler and dropped, and the next byte
+/// starts a new frame, as BufferedSerialDevice always did.
+class MarkerFramer
+{
+public:
+    /// \brief Frame bytes.
+    /// \param marker The byte ending each frame.
+    /// \param maxBufferSize The limit of a frame, see above.
+    /// \param buffer The partial frame, kept between calls.
+    /// \param data The bytes to frame.
+    /// \param size The number of bytes.
+    /// \param onFrame Called as onFrame(buffer) for each complete frame.
+    /// \param onOverflow Called as onOverflow(buffer) before a frame is dropped.
+    /// \tparam FrameHandler The type of onFrame.
+    /// \tparam OverflowHandler The type of onOverflow.
+    template<typename FrameHandler, typename OverflowHandler>
+    static void process(uint8_t marker,
+                        std::size_t maxBufferSize,
+                        ByteBuffer& buffer,
+                        const uint8_t* data,
+                        std::size_t size,
+                        FrameHandler&& onFrame,
+                        OverflowHandler&& onOverflow)
+    {
+        const uint8_t* end = data + size;
+
+        while (data < end)
+        {
+            const uint8_t* found = static_cast<const uint8_t*>(std::memchr(data, marker, end - data));
+            const uint8_t* runEnd = found != nullptr ? found : end;
+
+            append(maxBufferSize, buffer, data, runEnd - data, onOverflow);
+
+            if (found == nullptr)
+            {
+                return;
+            }
+
+            if (buffer.size() > 0)
+            {
+                onFrame(static_cast<const ByteBuffer&>(buffer));
+            }
+
+            buffer.clear();
+            data = found + 1;
+        }
+    }
+
+private:
+    /// \brief Append bytes without a marker to the partial frame.
+    template<typename OverflowHandler>
+    static void append(std::size_t maxBufferSize,
+                       ByteBuffer& buffer,
+                       const uint8_t* data,
+                       std::size_t size,
+                       OverflowHandler& onOverflow)
+    {
+        while (size > 0)
+        {
+            std::size_t count = 1;
+
+            if (buffer.size() + 1 >= maxBufferSize)
+            {
+                onOverflow(static_cast<const ByteBuffer&>(buffer));
+                buffer.clear();
+            }
+            else
+            {
+                count = std::min(size, maxBufferSize - 1 - buffer.size());
+            }
+
+            buffer.writeBytes(data, count);
+            data += count;
+            size -= count;
+        }
+    }
+
+};
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,366 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include "ofx/IO/ByteBuffer.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief The byte order of a message field on the wire.
+enum ByteOrder
+{
+    BYTE_ORDER_LITTLE,
+    BYTE_ORDER_BIG
+};
+
+
+/// \brief The byte order of the host.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+static const ByteOrder BYTE_ORDER_NATIVE = BYTE_ORDER_BIG;
+#else
+static const ByteOrder BYTE_ORDER_NATIVE = BYTE_ORDER_LITTLE;
+#endif
+
+
+/// \brief Describes one fixed position field of a packed message.
+///
+/// Offsets are counted from the first byte after the message id.
+///
+/// \tparam Offset The byte offset of the field.
+/// \tparam T The field type. Must be trivially copyable.
+/// \tparam Order The byte order of the field on the wire.
+template<std::size_t Offset, typename T, ByteOrder Order = BYTE_ORDER_LITTLE>
+struct MessageField
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Message fields must be trivially copyable.");
+
+    typedef T ValueType;
+
+    /// \brief The offset of the field in the message body.
+    static constexpr std::size_t OFFSET = Offset;
+
+    /// \brief The size of the field in bytes.
+    static constexpr std::size_t SIZE = sizeof(T);
+
+    /// \brief The offset of the first byte after the field.
+    static constexpr std::size_t END = Offset + sizeof(T);
+
+    /// \brief Read the field from a message body.
+    /// \param body A pointer to the first byte after the message id.
+    /// \returns the field value in host byte order.
+    static T read(const uint8_t* body)
+    {
+        T value;
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(&value);
+
+        if (Order == BYTE_ORDER_NATIVE)
+        {
+            std::memcpy(bytes, body + Offset, sizeof(T));
+        }
+        else
+        {
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+            {
+                bytes[i] = body[Offset + sizeof(T) - 1 - i];
+            }
+        }
+
+        return value;
+    }
+
+    /// \brief Write the field into a message body.
+    /// \param body A pointer to the first byte after the message id.
+    /// \param value The field value in host byte order.
+    static void write(uint8_t* body, const T& value)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+
+        if (Order == BYTE_ORDER_NATIVE)
+        {
+            std::memcpy(body + Offset, bytes, sizeof(T));
+        }
+        else
+        {
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+            {
+                body[Offset + sizeof(T) - 1 - i] = bytes[i];
+            }
+        }
+    }
+
+};
+
+
+/// \brief Describes a packed message identified by its first byte.
+///
+/// \tparam Id The message id carried in the first byte of the packet.
+/// \tparam Fields The MessageField types that make up the message body.
+template<uint8_t Id, typename... Fields>
+struct MessageLayout
+{
+private:
+    static constexpr std::size_t bodySize()
+    {
+        std::size_t ends[] = { 0, Fields::END... };
+        std::size_t size = 0;
+
+        for (std::size_t end: ends)
+        {
+            size = end > size ? end : size;
+        }
+
+        return size;
+    }
+
+public:
+    /// \brief The message id.
+    static constexpr uint8_t ID = Id;
+
+    /// \brief The size of the fixed body in bytes.
+    static constexpr std::size_t BODY_SIZE = bodySize();
+
+    /// \brief The size of the id and fixed body in bytes.
+    static constexpr std::size_t SIZE = BODY_SIZE + 1;
+
+};
+
+
+/// \brief A read-only view of a message that reads fields in place.
+///
+/// The view does not own or copy the packet. It is only valid for as long as
+/// the underlying buffer, e.g. for the duration of an onSerialBuffer event.
+template<typename Layout>
+class MessageView
+{
+public:
+    MessageView(const uint8_t* data, std::size_t size):
+        _data(data),
+        _size(size)
+    {
+    }
+
+    /// \returns true if the packet has the layout's id and is large enough.
+    bool isValid() const
+    {
+        return _data != nullptr
+            && _size >= Layout::SIZE
+            && _data[0] == Layout::ID;
+    }
+
+    /// \returns the value of a field in host byte order.
+    /// \tparam Field The MessageField to read.
+    template<typename Field>
+    typename Field::ValueType get() const
+    {
+        static_assert(Field::END <= Layout::BODY_SIZE, "Field is outside of the message layout.");
+        return Field::read(_data + 1);
+    }
+
+    /// \returns a pointer to any bytes following the fixed body.
+    const uint8_t* tail() const
+    {
+        return _data + Layout::SIZE;
+    }
+
+    /// \returns the number of bytes following the fixed body.
+    std::size_t tailSize() const
+    {
+        return _size - Layout::SIZE;
+    }
+
+    /// \returns a pointer to the whole packet, including the id.
+    const uint8_t* data() const
+    {
+        return _data;
+    }
+
+    /// \returns the size of the whole packet, including the id.
+    std::size_t size() const
+    {
+        return _size;
+    }
+
+private:
+    /// \brief The packet.
+    const uint8_t* _data = nullptr;
+
+    /// \brief The packet size.
+    std::size_t _size = 0;
+
+};
+
+
+/// \brief Builds a message in a fixed size buffer without allocating.
+template<typename Layout>
+class MessageWriter
+{
+public:
+    MessageWriter()
+    {
+        _data.fill(0);
+        _data[0] = Layout::ID;
+    }
+
+    /// \brief Set the value of a field.
+    /// \tparam Field The MessageField to write.
+    template<typename Field>
+    MessageWriter& set(const typename Field::ValueType& value)
+    {
+        static_assert(Field::END <= Layout::BODY_SIZE, "Field is outside of the message layout.");
+        Field::write(_data.data() + 1, value);
+        return *this;
+    }
+
+    /// \returns the message bytes, including the id.
+    const uint8_t* data() const
+    {
+        return _data.data();
+    }
+
+    /// \returns the message size, including the id.
+    std::size_t size() const
+    {
+        return _data.size();
+    }
+
+    /// \returns the message as a ByteBuffer ready to send.
+    ByteBuffer toByteBuffer() const
+    {
+        return ByteBuffer(_data.data(), _data.size());
+    }
+
+private:
+    /// \brief The message bytes.
+    std::array<uint8_t, Layout::SIZE> _data;
+
+};
+
+
+/// \brief Dispatches packets to typed handlers by message id.
+///
+/// The id to handler table is built at compile time, so dispatch is a single
+/// indexed load. The handler must provide an overload of
+/// `void onMessage(const MessageView<Layout>&)` for each layout.
+///
+///     typedef MessageField<0, int16_t> X;
+///     typedef MessageLayout<1, X> Position;
+///
+///     void onSerialBuffer(const SerialBufferEventArgs& args)
+///     {
+///         MessageDispatcher<ofApp, Position>::dispatch(*this, args.buffer());
+///     }
+///
+/// \tparam Handler The handler type.
+/// \tparam Layouts The MessageLayout types to dispatch.
+template<typename Handler, typename... Layouts>
+class MessageDispatcher
+{
+public:
+    typedef bool (*Thunk)(Handler&, const uint8_t*, std::size_t);
+
+    /// \brief Dispatch a packet to the handler.
+    /// \param handler The handler.
+    /// \param data The packet, starting with the message id.
+    /// \param size The packet size.
+    /// \returns false if the id is unknown or the packet is too short.
+    static bool dispatch(Handler& handler, const uint8_t* data, std::size_t size)
+    {
+        if (size == 0)
+        {
+            return false;
+        }
+
+        Thunk thunk = TABLE[data[0]];
+        return thunk != nullptr && thunk(handler, data, size);
+    }
+
+    /// \brief Dispatch a packet to the handler.
+    /// \param handler The handler.
+    /// \param buffer The packet, starting with the message id.
+    /// \returns false if the id is unknown or the packet is too short.
+    static bool dispatch(Handler& handler, const ByteBuffer& buffer)
+    {
+        return dispatch(handler, buffer.getPtr(), buffer.size());
+    }
+
+private:
+    template<typename Layout>
+    static bool thunk(Handler& handler, const uint8_t* data, std::size_t size)
+    {
+        if (size < Layout::SIZE)
+        {
+            return false;
+        }
+
+        handler.onMessage(MessageView<Layout>(data, size));
+        return true;
+    }
+
+    static constexpr Thunk lookup(std::size_t id)
+    {
+        Thunk thunks[] = { nullptr, &thunk<Layouts>... };
+        std::size_t ids[] = { 256, static_cast<std::size_t>(Layouts::ID)... };
+
+        for (std::size_t i = 1; i < sizeof(ids) / sizeof(ids[0]); ++i)
+        {
+            if (ids[i] == id)
+            {
+                return thunks[i];
+            }
+        }
+
+        return nullptr;
+    }
+
+    static constexpr bool uniqueIds()
+    {
+        std::size_t ids[] = { 256, static_cast<std::size_t>(Layouts::ID)... };
+
+        for (std::size_t i = 1; i < sizeof(ids) / sizeof(ids[0]); ++i)
+        {
+            for (std::size_t j = i + 1; j < sizeof(ids) / sizeof(ids[0]); ++j)
+            {
+                if (ids[i] == ids[j])
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    static_assert(uniqueIds(), "Message layouts must have unique ids.");
+
+    typedef std::array<Thunk, 256> Table;
+
+    template<std::size_t... Ids>
+    static constexpr Table makeTable(std::index_sequence<Ids...>)
+    {
+        return {{ lookup(Ids)... }};
+    }
+
+    static constexpr Table TABLE = makeTable(std::make_index_sequence<256>());
+
+};
+
+
+template<typename Handler, typename... Layouts>
+constexpr typename MessageDispatcher<Handler, Layouts...>::Table MessageDispatcher<Handler, Layouts...>::TABLE;
+
+
+} } // namespace ofx::IO
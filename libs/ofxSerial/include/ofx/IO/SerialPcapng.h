@@ -0,0 +1,250 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ofx/IO/ByteBuffer.h"
+#include "ofx/IO/COBSEncoding.h"
+#include "ofx/IO/SLIPEncoding.h"
+#include "ofx/IO/SerialFraming.h"
+#include "ofx/IO/SerialRingBuffer.h"
+#include "ofx/IO/SerialTap.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Streams serial traffic into a pcapng file for Wireshark.
+///
+/// The file has one interface per direction, interface 0 for received and
+/// interface 1 for sent bytes, with the LINKTYPE_USER0 link type and
+/// nanosecond timestamps. Each tapped read or write becomes one packet.
+///
+/// The tap only copies the bytes into a ring buffer. A writer thread
+/// formats the blocks and writes them through a large file buffer, so the
+/// I/O thread never waits for the disk. Bytes that do not fit into the
+/// ring buffer are dropped and counted.
+///
+/// Use SerialDevice::setTap() to record a device.
+class PcapngSerialTap: public AbstractSerialTap
+{
+public:
+    PcapngSerialTap();
+
+    /// \brief Stop the writer and close the file.
+    virtual ~PcapngSerialTap();
+
+    /// \brief Start writing a file.
+    /// \param path The path of the file, usually ending in `.pcapng`.
+    /// \param name The name of the interfaces, e.g. the port name.
+    /// \param bufferSize The size of the ring buffer in bytes.
+    /// \returns true if the file was created.
+    bool setup(const std::string& path,
+               const std::string& name = "",
+               std::size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+    /// \brief Write the remaining bytes and close the file.
+    void close();
+
+    /// \returns true while writing.
+    bool isOpen() const;
+
+    void tap(Direction direction,
+             uint64_t timestampNanos,
+             const uint8_t* data,
+             std::size_t size) override;
+
+    /// \returns the number of bytes lost because the ring buffer was full.
+    uint64_t droppedBytes() const;
+
+    /// \returns the number of packets written.
+    uint64_t packetCount() const;
+
+    enum
+    {
+        /// \brief The link type of the interfaces.
+        LINKTYPE_USER0 = 147,
+        /// \brief The default size of the ring buffer.
+        DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024,
+        /// \brief The size of the file buffer.
+        FILE_BUFFER_SIZE = 1024 * 1024
+    };
+
+protected:
+    /// \brief Turn tapped bytes into packets. Called on the writer thread.
+    ///
+    /// The default writes the bytes as one packet.
+    ///
+    /// \param direction Whether the bytes were read or written.
+    /// \param timestampNanos The time of the transfer.
+    /// \param data The bytes.
+    /// \param size The number of bytes.
+    virtual void process(Direction direction,
+                         uint64_t timestampNanos,
+                         const uint8_t* data,
+                         std::size_t size);
+
+    /// \brief Forget the state of process(). Called before writing starts.
+    virtual void reset();
+
+    /// \brief Write an enhanced packet block. Only call from process().
+    /// \param direction The interface of the packet.
+    /// \param timestampNanos The time of the packet.
+    /// \param data The packet.
+    /// \param size The size of the packet.
+    /// \param comment An optional comment shown by Wireshark.
+    void writePacket(Direction direction,
+                     uint64_t timestampNanos,
+                     const uint8_t* data,
+                     std::size_t size,
+                     const std::string& comment = "");
+
+private:
+    /// \brief The header of each chunk in the ring buffer.
+    struct Chunk
+    {
+        uint64_t timestampNanos;
+        uint32_t size;
+        uint32_t direction;
+    };
+
+    /// \brief The writer thread.
+    void run();
+
+    /// \brief Process the chunks in the ring buffer.
+    void drain();
+
+    /// \brief Write the section header block.
+    void writeSectionHeader();
+
+    /// \brief Write an interface description block.
+    void writeInterface(const std::string& name);
+
+    /// \brief Write a block. The body is padded and framed by its length.
+    void writeBlock(uint32_t type, const std::vector<uint8_t>& body);
+
+    /// \brief The file.
+    std::ofstream _file;
+
+    /// \brief The storage of the file buffer.
+    std::vector<char> _fileBuffer;
+
+    /// \brief The chunks waiting for the writer thread.
+    std::unique_ptr<SerialRingBuffer> _ring;
+
+    /// \brief Serializes taps from different threads.
+    std::mutex _tapMutex;
+
+    /// \brief The chunk being processed on the writer thread.
+    std::vector<uint8_t> _chunk;
+
+    /// \brief A reused buffer for block bodies.
+    std::vector<uint8_t> _body;
+
+    /// \brief The offset from tap timestamps to the Unix epoch.
+    uint64_t _epochOffsetNanos = 0;
+
+    /// \brief The writer thread.
+    std::thread _thread;
+
+    /// \brief Wakes the writer thread on close().
+    std::mutex _mutex;
+    std::condition_variable _condition;
+
+    /// \brief True while the writer thread should run.
+    std::atomic<bool> _running;
+
+    /// \brief The number of dropped bytes.
+    std::atomic<uint64_t> _droppedBytes;
+
+    /// \brief The number of written packets.
+    std::atomic<uint64_t> _packetCount;
+
+};
+
+
+/// \brief Streams the packets of a PacketSerialDevice_ into a pcapng file.
+///
+/// The bytes of each direction are split at the packet marker and decoded
+/// with the same encoder as PacketSerialDevice_, so Wireshark shows one
+/// packet per frame. Compressed packets are shown as sent, flag byte
+/// included. Frames that fail to decode are written as they arrived with
+/// a comment. Like PacketSerialDevice_, frames are limited to BufferSize
+/// bytes. The bytes of a longer frame are written with an "Overflow"
+/// comment as they overflow, so a stream without markers can't grow the
+/// frame without bound.
+template<typename Encoder, uint8_t PacketMarker = 0, std::size_t BufferSize = 8192>
+class PacketPcapngSerialTap_: public PcapngSerialTap
+{
+public:
+    /// \brief Stop the writer before the encoder is destroyed.
+    virtual ~PacketPcapngSerialTap_()
+    {
+        close();
+    }
+
+protected:
+    void process(Direction direction,
+                 uint64_t timestampNanos,
+                 const uint8_t* data,
+                 std::size_t size) override
+    {
+        MarkerFramer::process(PacketMarker, BufferSize, _frames[direction], data, size,
+            [&](const ByteBuffer& frame)
+            {
+                _decoded.clear();
+
+                if (_encoder.decode(frame, _decoded) > 0)
+                {
+                    writePacket(direction, timestampNanos, _decoded.getPtr(), _decoded.size());
+                }
+                else
+                {
+                    writePacket(direction, timestampNanos, frame.getPtr(), frame.size(), "Undecodable frame");
+                }
+            },
+            [&](const ByteBuffer& frame)
+            {
+                writePacket(direction, timestampNanos, frame.getPtr(), frame.size(), "Overflow");
+            });
+    }
+
+    void reset() override
+    {
+        _frames[DIRECTION_RX].clear();
+        _frames[DIRECTION_TX].clear();
+    }
+
+private:
+    /// \brief The encoder used to decode frames.
+    Encoder _encoder;
+
+    /// \brief The incomplete frame of each direction.
+    ByteBuffer _frames[2];
+
+    /// \brief A reused buffer for decoded packets.
+    ByteBuffer _decoded;
+
+};
+
+
+typedef PacketPcapngSerialTap_<COBSEncoding> PacketPcapngSerialTap;
+typedef PacketPcapngSerialTap_<COBSEncoding> COBSPcapngSerialTap;
+typedef PacketPcapngSerialTap_<SLIPEncoding, SLIPEncoding::END> SLIPPcapngSerialTap;
+
+
+} } // namespace ofx::IO
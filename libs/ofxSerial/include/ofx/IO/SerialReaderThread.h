@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "serial/serial.h"
+#include "ofx/IO/SerialRingBuffer.h"
+#include "ofx/IO/SerialTap.h"
+#include "ofx/IO/ThreadPolicy.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Reads a serial port on its own thread into a ring buffer.
+///
+/// The reader blocks until the port is readable and moves whatever arrived
+/// into a SerialRingBuffer that another thread drains. Every buffer is
+/// allocated before the thread starts and, if the policy asks for it,
+/// locked in memory, so the read loop never allocates or page-faults.
+class SerialReaderThread
+{
+public:
+    SerialReaderThread();
+
+    /// \brief Stop the thread.
+    virtual ~SerialReaderThread();
+
+    /// \brief Start reading a port.
+    /// \param serial The open port. The reader keeps it alive until stopped.
+    /// \param policy The scheduling policy of the reader thread.
+    /// \param capacity The ring buffer capacity in bytes.
+    /// \returns true if the thread was started.
+    bool start(std::shared_ptr<serial::Serial> serial,
+               const ThreadPolicy& policy = ThreadPolicy(),
+               std::size_t capacity = SerialRingBuffer::DEFAULT_CAPACITY);
+
+    /// \brief Stop the thread and release the port.
+    void stop();
+
+    /// \brief Copy every byte read to a tap. Call before start().
+    /// \param tap The tap, or nullptr to remove it.
+    void setTap(std::shared_ptr<AbstractSerialTap> tap);
+
+    /// \returns true if the thread is running.
+    bool isRunning() const;
+
+    /// \returns the ring buffer filled by the thread.
+    SerialRingBuffer& ring();
+
+    /// \returns the number of bytes dropped because the ring buffer was full.
+    uint64_t overflowCount() const;
+
+    /// \brief Take the error that stopped the thread, if any.
+    /// \param message Set to the error message.
+    /// \returns true if the thread stopped because of an error.
+    bool takeError(std::string& message);
+
+    enum
+    {
+        /// \brief How often the thread checks for stop requests.
+        WAKE_INTERVAL_MS = 50,
+        /// \brief The largest single read.
+        READ_BUFFER_SIZE = 4096
+    };
+
+protected:
+    /// \brief Called on the reader thread after bytes were read.
+    ///
+    /// The bytes have already been written to the ring buffer. Overrides
+    /// must not block or allocate.
+    ///
+    /// \param data The bytes read.
+    /// \param size The number of bytes read.
+    virtual void bytesRead(const uint8_t* data, std::size_t size);
+
+private:
+    void threadedFunction();
+
+    /// \brief The port being read.
+    std::shared_ptr<serial::Serial> _serial;
+
+    /// \brief The scheduling policy of the reader thread.
+    ThreadPolicy _policy;
+
+    /// \brief The optional tap.
+    std::shared_ptr<AbstractSerialTap> _tap;
+
+    /// \brief The buffered bytes.
+    std::unique_ptr<SerialRingBuffer> _ring;
+
+    /// \brief The read buffer.
+    std::vector<uint8_t> _readBuffer;
+
+    /// \brief The number of dropped bytes.
+    std::atomic<uint64_t> _overflowCount;
+
+    /// \brief True while the thread should run.
+    std::atomic<bool> _running;
+
+    /// \brief The error that stopped the thread, if any.
+    std::string _error;
+
+    /// \brief Protects the error.
+    mutable std::mutex _errorMutex;
+
+    /// \brief The reader thread.
+    std::thread _thread;
+
+};
+
+
+} } // namespace ofx::IO
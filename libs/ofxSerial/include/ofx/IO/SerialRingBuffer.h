@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief A lock-free single producer, single consumer byte ring buffer.
+///
+/// One thread may write while another reads without locks or allocation.
+/// The storage is allocated once, in the constructor, and its capacity is
+/// rounded up to a power of two.
+class SerialRingBuffer
+{
+public:
+    /// \brief Create a ring buffer.
+    /// \param capacity The minimum capacity in bytes.
+    explicit SerialRingBuffer(std::size_t capacity = DEFAULT_CAPACITY):
+        _storage(roundUp(capacity)),
+        _mask(_storage.size() - 1)
+    {
+    }
+
+    /// \brief Write bytes. Only call from the producer thread.
+    /// \param data The bytes to write.
+    /// \param size The number of bytes to write.
+    /// \returns the number of bytes written, less than size if full.
+    std::size_t write(const uint8_t* data, std::size_t size)
+    {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        std::size_t tail = _tail.load(std::memory_order_acquire);
+
+        size = std::min(size, _storage.size() - (head - tail));
+
+        std::size_t offset = head & _mask;
+        std::size_t first = std::min(size, _storage.size() - offset);
+
+        std::memcpy(_storage.data() + offset, data, first);
+        std::memcpy(_storage.data(), data + first, size - first);
+
+        _head.store(head + size, std::memory_order_release);
+        return size;
+    }
+
+    /// \brief Read bytes. Only call from the consumer thread.
+    /// \param data The buffer to read into.
+    /// \param size The size of the buffer.
+    /// \returns the number of bytes read.
+    std::size_t read(uint8_t* data, std::size_t size)
+    {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        std::size_t head = _head.load(std::memory_order_acquire);
+
+        size = std::min(size, head - tail);
+
+        std::size_t offset = tail & _mask;
+        std::size_t first = std::min(size, _storage.size() - offset);
+
+        std::memcpy(data, _storage.data() + offset, first);
+        std::memcpy(data + first, _storage.data(), size - first);
+
+        _tail.store(tail + size, std::memory_order_release);
+        return size;
+    }
+
+    /// \returns the number of bytes available to read.
+    std::size_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    /// \returns the number of bytes that can be written.
+    std::size_t free() const
+    {
+        return _storage.size() - size();
+    }
+
+    /// \returns the capacity in bytes.
+    std::size_t capacity() const
+    {
+        return _storage.size();
+    }
+
+    /// \brief Discard all bytes. Only call from the consumer thread.
+    void clear()
+    {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /// \returns a pointer to the storage, e.g. to lock it in memory.
+    uint8_t* storage()
+    {
+        return _storage.data();
+    }
+
+    enum
+    {
+        DEFAULT_CAPACITY = 65536
+    };
+
+private:
+    static std::size_t roundUp(std::size_t capacity)
+    {
+        std::size_t size = 1;
+
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+
+        return size;
+    }
+
+    /// \brief The storage.
+    std::vector<uint8_t> _storage;
+
+    /// \brief The capacity - 1, used to wrap indices.
+    std::size_t _mask = 0;
+
+    /// \brief The total number of bytes written.
+    std::atomic<std::size_t> _head { 0 };
+
+    /// \brief Keeps the head and tail on separate cache lines.
+    uint8_t _padding[64 - sizeof(std::atomic<std::size_t>)];
+
+    /// \brief The total number of bytes read.
+    std::atomic<std::size_t> _tail { 0 };
+
+};
+
+
+} } // namespace ofx::IO
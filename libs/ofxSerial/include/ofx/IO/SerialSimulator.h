@@ -0,0 +1,288 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ofx/IO/SerialDevice.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Simulates a serial device at wire speed on a pseudo terminal.
+///
+/// A pseudo terminal moves bytes at memory speed. The simulator sits
+/// between the application and the simulated device and moves the bytes at
+/// the rate of a real line, one byte time apart, using the same byte time
+/// as a hardware port with these settings. Bytes the application writes
+/// wait in the pseudo terminal until the line takes them, like bytes in the
+/// output buffer of a driver.
+///
+/// Bytes can be corrupted and dropped on the way, at random or in bursts.
+/// Bytes are cut to the configured data bits.
+///
+/// Pseudo terminals have no modem lines. Ports opened with openPort()
+/// exchange them with the simulator instead, and follow hardware flow
+/// control: nothing is sent to the application while it drops RTS, and
+/// nothing is taken from it while the simulator drops CTS. Ports opened by
+/// name, e.g. in another process, only carry data.
+///
+/// The simulated device is played through write() and read(), or echoes
+/// everything it receives. Not available on Windows.
+class SerialSimulator
+{
+public:
+    /// \brief Damage done to the bytes in one direction.
+    struct Impairments
+    {
+        /// \brief The probability that a data bit is flipped.
+        double bitErrorRate = 0;
+
+        /// \brief The probability that a byte is lost.
+        double dropRate = 0;
+
+        /// \brief The probability that a byte starts an error burst.
+        double burstRate = 0;
+
+        /// \brief The number of bytes replaced with noise by a burst.
+        std::size_t burstLength = 8;
+    };
+
+    /// \brief The simulated line.
+    struct Settings
+    {
+        uint32_t baudRate = 115200;
+        SerialDevice::DataBits dataBits = SerialDevice::DATA_BITS_EIGHT;
+        SerialDevice::Parity parity = SerialDevice::PAR_NONE;
+        SerialDevice::StopBits stopBits = SerialDevice::STOP_ONE;
+
+        /// \brief Damage done to the bytes the application receives.
+        Impairments toApplication;
+
+        /// \brief Damage done to the bytes the application sends.
+        Impairments fromApplication;
+
+        /// \brief Send every received byte back to the application.
+        bool echo = false;
+
+        /// \brief The seed of the impairments, for repeatable runs.
+        uint32_t seed = 1;
+    };
+
+    /// \brief Counts of the simulated traffic.
+    struct Statistics
+    {
+        /// \brief Bytes delivered to the application.
+        uint64_t bytesToApplication = 0;
+
+        /// \brief Bytes taken from the application.
+        uint64_t bytesFromApplication = 0;
+
+        /// \brief Bytes corrupted by bit errors or bursts.
+        uint64_t corruptedBytes = 0;
+
+        /// \brief Bytes lost.
+        uint64_t droppedBytes = 0;
+    };
+
+    SerialSimulator();
+
+    /// \brief Stop the simulation and close the pseudo terminal.
+    ~SerialSimulator();
+
+    /// \brief Create the pseudo terminal and start the simulation.
+    /// \param settings The simulated line.
+    /// \returns true if the simulation started.
+    bool setup(const Settings& settings);
+
+    /// \brief Stop the simulation and close the pseudo terminal.
+    void close();
+
+    /// \returns true while simulating.
+    bool isOpen() const;
+
+    /// \returns the name of the port, e.g. for SerialDevice::setup().
+    std::string portName() const;
+
+    /// \brief Create a port that also carries the simulated modem lines.
+    ///
+    /// Use it with SerialDevice::setup(std::shared_ptr<serial::Serial>).
+    /// The port is opened with the simulated settings.
+    ///
+    /// \param threadingMode How the port may be shared between threads.
+    /// \returns the open port, or nullptr.
+    std::shared_ptr<serial::Serial> openPort(SerialDevice::ThreadingMode threadingMode = SerialDevice::THREADING_MULTI);
+
+    /// \brief Queue bytes for the simulated device to send.
+    /// \param buffer The bytes.
+    /// \param size The number of bytes.
+    void write(const uint8_t* buffer, std::size_t size);
+
+    /// \brief Queue bytes for the simulated device to send.
+    void write(const std::string& buffer);
+
+    /// \returns the number of bytes queued but not yet sent.
+    std::size_t outWaiting() const;
+
+    /// \brief Take the bytes the simulated device received.
+    /// \param buffer The buffer to read into.
+    /// \param size The size of the buffer.
+    /// \returns the number of bytes read.
+    std::size_t read(uint8_t* buffer, std::size_t size);
+
+    /// \returns the number of received bytes waiting to be read.
+    std::size_t available() const;
+
+    /// \brief Wait until the simulated device received something.
+    /// \param timeoutMillis The longest time to wait.
+    /// \returns true if there is something to read.
+    bool waitReadable(uint32_t timeoutMillis);
+
+    /// \brief Change the damage done to the bytes while running.
+    void setImpairments(const Impairments& toApplication,
+                        const Impairments& fromApplication);
+
+    void setClearToSend(bool level = true);
+    void setDataSetReady(bool level = true);
+    void setRingIndicator(bool level = true);
+    void setCarrierDetect(bool level = true);
+
+    /// \returns the RTS level set by the application.
+    bool isRequestToSend() const;
+
+    /// \returns the DTR level set by the application.
+    bool isDataTerminalReady() const;
+
+    /// \returns the time the simulated line needs for one byte.
+    uint32_t byteTime() const;
+
+    /// \returns the counts of the simulated traffic.
+    Statistics statistics() const;
+
+private:
+    class Backend;
+
+    /// \brief The modem lines, shared with the ports from openPort().
+    struct Lines;
+
+    /// \brief Bytes moving in one direction.
+    struct Direction
+    {
+        /// \brief The impairments of this direction.
+        Impairments impairments;
+
+        /// \brief The time the line finished the last byte.
+        uint64_t clockNanos = 0;
+
+        /// \brief The number of data bits before the next bit error.
+        uint64_t bitsUntilError = 0;
+
+        /// \brief The number of bytes before the next drop.
+        uint64_t bytesUntilDrop = 0;
+
+        /// \brief The number of bytes before the next burst.
+        uint64_t bytesUntilBurst = 0;
+
+        /// \brief The number of bytes left in the current burst.
+        std::size_t burstLeft = 0;
+    };
+
+    /// \brief The simulation thread.
+    void run();
+
+    /// \brief Move the bytes that crossed the line since the last call.
+    /// \returns the time of the next byte, or 0 if the line is idle.
+    uint64_t sendToApplication(uint64_t now);
+    uint64_t receiveFromApplication(uint64_t now);
+
+    /// \brief Damage bytes that crossed the line in place.
+    /// \returns the number of bytes left after drops.
+    std::size_t impair(Direction& direction, uint8_t* data, std::size_t size);
+
+    /// \brief Draw the number of trials before the next event.
+    uint64_t nextEvent(double probability);
+
+    /// \brief Wake the simulation thread.
+    void wake();
+
+    /// \returns true if hardware flow control holds the direction back.
+    bool isHeld(bool toApplication) const;
+
+    /// \brief The simulated line.
+    Settings _settings;
+
+    /// \brief The time the line needs for one byte.
+    uint32_t _byteTime = 0;
+
+    /// \brief The mask of the data bits.
+    uint8_t _dataMask = 0xFF;
+
+    /// \brief The pseudo terminal master.
+    int _master = -1;
+
+    /// \brief The slave, kept open so the master never hangs up.
+    int _slave = -1;
+
+    /// \brief Wakes the simulation thread.
+    int _wakePipe[2] = { -1, -1 };
+
+    /// \brief The name of the slave.
+    std::string _portName;
+
+    /// \brief The simulation thread.
+    std::thread _thread;
+
+    /// \brief Asks the thread to stop.
+    std::atomic<bool> _stopping;
+
+    /// \brief Guards everything below.
+    mutable std::mutex _mutex;
+
+    /// \brief Signalled when bytes were received.
+    std::condition_variable _condition;
+
+    /// \brief Bytes to send to the application, from _toApplicationOffset.
+    std::vector<uint8_t> _toApplication;
+    std::size_t _toApplicationOffset = 0;
+
+    /// \brief Bytes sent, waiting for room in the pseudo terminal.
+    std::vector<uint8_t> _toPty;
+
+    /// \brief Bytes received from the application.
+    std::vector<uint8_t> _received;
+
+    /// \brief Bytes to the application.
+    Direction _rx;
+
+    /// \brief Bytes from the application.
+    Direction _tx;
+
+    /// \brief True while the application side has bytes to take.
+    bool _txBusy = false;
+
+    /// \brief The generator of the impairments.
+    std::mt19937 _random;
+
+    /// \brief The counts of the simulated traffic.
+    Statistics _statistics;
+
+    /// \brief The modem lines.
+    std::shared_ptr<Lines> _lines;
+
+};
+
+
+} } // namespace ofx::IO
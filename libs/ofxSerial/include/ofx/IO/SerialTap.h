@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <stdint.h>
+#include <chrono>
+#include <cstddef>
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Receives a copy of every byte a SerialDevice reads or writes.
+///
+/// Taps are called on the thread that did the I/O, e.g. a reader thread,
+/// right after the bytes were transferred. They must not block; anything
+/// slow belongs on another thread.
+class AbstractSerialTap
+{
+public:
+    /// \brief The direction of the bytes, as seen from the application.
+    enum Direction
+    {
+        DIRECTION_RX = 0,
+        DIRECTION_TX = 1
+    };
+
+    virtual ~AbstractSerialTap()
+    {
+    }
+
+    /// \brief Called after bytes were read or written.
+    /// \param direction Whether the bytes were read or written.
+    /// \param timestampNanos The monotonic time of the transfer, see now().
+    /// \param data The bytes.
+    /// \param size The number of bytes.
+    virtual void tap(Direction direction,
+                     uint64_t timestampNanos,
+                     const uint8_t* data,
+                     std::size_t size) = 0;
+
+    /// \returns the monotonic time used for tap timestamps, in nanoseconds.
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+};
+
+
+} } // namespace ofx::IO
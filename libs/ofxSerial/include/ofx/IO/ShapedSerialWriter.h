@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ofx/IO/ByteBuffer.h"
+#include "ofx/IO/SerialDevice.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Writes to a SerialDevice no faster than the wire can carry.
+///
+/// A plain write hands everything to the operating system at once, so a
+/// large burst fills the driver's output buffer and any later write waits
+/// behind it. The ShapedSerialWriter keeps only enough bytes in flight to
+/// cover the maximum latency and holds the rest in a priority queue, so an
+/// urgent message is delayed by at most the message in progress plus the
+/// in-flight bytes.
+///
+/// Messages are written whole and in order of priority, then submission.
+/// They are never interleaved, so packet framing is preserved.
+class ShapedSerialWriter
+{
+public:
+    ShapedSerialWriter();
+
+    /// \brief Stop the writer thread.
+    virtual ~ShapedSerialWriter();
+
+    /// \brief Start shaping writes to a device.
+    /// \param device The open device to write to. It must outlive the writer.
+    /// \param maxLatencyMicros The amount of data kept in flight, in time.
+    void setup(SerialDevice& device,
+               uint64_t maxLatencyMicros = DEFAULT_MAX_LATENCY_MICROS);
+
+    /// \brief Stop the writer thread, dropping any queued messages.
+    void close();
+
+    /// \brief Queue a message.
+    /// \param data The message bytes.
+    /// \param size The number of bytes.
+    /// \param priority Higher priorities are written first.
+    /// \returns false if the writer is not running.
+    bool write(const uint8_t* data, std::size_t size, int priority = PRIORITY_NORMAL);
+
+    /// \brief Queue a message.
+    /// \param buffer The message bytes.
+    /// \param priority Higher priorities are written first.
+    /// \returns false if the writer is not running.
+    bool write(const ByteBuffer& buffer, int priority = PRIORITY_NORMAL);
+
+    /// \returns the number of bytes waiting in the queue.
+    std::size_t queuedBytes() const;
+
+    /// \returns the number of bytes allowed in the output buffer.
+    std::size_t maxBytesInFlight() const;
+
+    enum
+    {
+        PRIORITY_LOW = -100,
+        PRIORITY_NORMAL = 0,
+        PRIORITY_URGENT = 100
+    };
+
+    enum
+    {
+        /// \brief The default amount of data in flight, in microseconds.
+        DEFAULT_MAX_LATENCY_MICROS = 5000,
+        /// \brief Never keep fewer bytes in flight than this.
+        MIN_BYTES_IN_FLIGHT = 16,
+        /// \brief The wait before trying again when the port takes nothing
+        ///        or its line speed is unknown, in microseconds.
+        RETRY_MICROS = 1000
+    };
+
+private:
+    struct Message
+    {
+        int priority = PRIORITY_NORMAL;
+        uint64_t sequence = 0;
+        std::vector<uint8_t> data;
+
+        bool operator < (const Message& other) const
+        {
+            if (priority != other.priority)
+            {
+                return priority < other.priority;
+            }
+
+            return sequence > other.sequence;
+        }
+    };
+
+    void threadedFunction();
+
+    /// \brief Wait without holding up close().
+    /// \param nanos The time to wait.
+    void waitFor(uint64_t nanos);
+
+    /// \brief The device written to.
+    SerialDevice* _device = nullptr;
+
+    /// \brief The number of bytes allowed in the output buffer.
+    std::size_t _maxBytesInFlight = MIN_BYTES_IN_FLIGHT;
+
+    /// \brief The queued messages, a heap with the next message first.
+    std::vector<Message> _queue;
+
+    /// \brief The number of queued bytes.
+    std::size_t _queuedBytes = 0;
+
+    /// \brief The submission counter used to keep equal priorities in order.
+    uint64_t _sequence = 0;
+
+    /// \brief True while the writer thread should run.
+    std::atomic<bool> _running;
+
+    /// \brief Protects the queue.
+    mutable std::mutex _mutex;
+
+    /// \brief Signals queued messages or shutdown.
+    std::condition_variable _condition;
+
+    /// \brief The writer thread.
+    std::thread _thread;
+
+};
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <string>
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief Real-time scheduling settings for a serial reader thread.
+///
+/// For control links the worst case wake-up latency of the reader matters
+/// more than its average. A real-time scheduler keeps the reader from
+/// waiting behind ordinary threads, pinning it to a CPU avoids migrations,
+/// and locking its buffers in memory avoids page faults.
+///
+/// Real-time scheduling and memory locking usually need privileges, e.g.
+/// CAP_SYS_NICE and CAP_IPC_LOCK or matching rtprio and memlock limits in
+/// /etc/security/limits.conf on Linux.
+class ThreadPolicy
+{
+public:
+    enum Scheduler
+    {
+        /// \brief The operating system's default time sharing scheduler.
+        SCHEDULER_DEFAULT,
+        /// \brief First in, first out real-time scheduling (SCHED_FIFO).
+        SCHEDULER_FIFO,
+        /// \brief Round robin real-time scheduling (SCHED_RR).
+        SCHEDULER_ROUND_ROBIN
+    };
+
+    /// \brief The scheduler.
+    Scheduler scheduler = SCHEDULER_DEFAULT;
+
+    /// \brief The real-time priority, 1 (lowest) to 99 (highest) on Linux.
+    ///
+    /// Ignored by the default scheduler.
+    int priority = DEFAULT_REALTIME_PRIORITY;
+
+    /// \brief The CPU to pin the thread to, or CPU_ANY.
+    int cpu = CPU_ANY;
+
+    /// \brief True to lock the thread's buffers in memory.
+    bool lockMemory = false;
+
+    /// \brief Create a real-time policy.
+    /// \param priority The real-time priority.
+    /// \param cpu The CPU to pin the thread to, or CPU_ANY.
+    /// \returns a SCHED_FIFO policy with locked memory.
+    static ThreadPolicy realtime(int priority = DEFAULT_REALTIME_PRIORITY,
+                                 int cpu = CPU_ANY);
+
+    /// \brief Apply the scheduler and CPU affinity to the calling thread.
+    /// \param errorMessage Set to a description of any setting that failed.
+    /// \returns true if every setting was applied.
+    bool applyToCurrentThread(std::string& errorMessage) const;
+
+    /// \brief Lock a memory region so it can not be paged out.
+    ///
+    /// The region is also touched so that every page is resident.
+    ///
+    /// \param data The start of the region.
+    /// \param size The size of the region in bytes.
+    /// \returns true if the region was locked.
+    static bool lock(void* data, std::size_t size);
+
+    /// \brief Unlock a region locked with lock().
+    /// \param data The start of the region.
+    /// \param size The size of the region in bytes.
+    static void unlock(void* data, std::size_t size);
+
+    /// \brief Touch the calling thread's stack so it is resident.
+    ///
+    /// Call this once at the start of a real-time thread.
+    ///
+    /// \param size The number of stack bytes to touch.
+    static void prefaultStack(std::size_t size = DEFAULT_PREFAULT_STACK_SIZE);
+
+    enum
+    {
+        /// \brief Run on any CPU.
+        CPU_ANY = -1,
+        /// \brief A priority above most kernel threads but below watchdogs.
+        DEFAULT_REALTIME_PRIORITY = 80,
+        /// \brief The default amount of stack to prefault.
+        DEFAULT_PREFAULT_STACK_SIZE = 64 * 1024
+    };
+
+};
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,917 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/AsyncSerialDevice.h"
+
+
+#if defined(__cpp_impl_coroutine) && defined(__cpp_lib_coroutine)
+
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <thread>
+#include "ofLog.h"
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief The most events handled per wait.
+static const int MAX_EVENTS = 64;
+
+/// \brief The shortest time a blocked write waits before trying again.
+static const uint64_t MIN_WRITE_RETRY_NANOS = 1000000;
+
+
+void SerialTaskPromiseBase::finished(SerialEventLoop* loop,
+                                     void* address,
+                                     std::exception_ptr exception)
+{
+    loop->_tasks.erase(address);
+
+    if (exception)
+    {
+        try
+        {
+            std::rethrow_exception(exception);
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogError("SerialEventLoop::spawn") << "A task ended with an exception: " << exc.what();
+        }
+        catch (...)
+        {
+            ofLogError("SerialEventLoop::spawn") << "A task ended with an unknown exception.";
+        }
+    }
+}
+
+
+SerialEventLoop::Timer::~Timer()
+{
+    if (_loop != nullptr)
+    {
+        _loop->disarm(*this);
+    }
+}
+
+
+SerialEventLoop::SleepAwaiter::SleepAwaiter(SerialEventLoop& loop, uint32_t millis):
+    _loop(loop),
+    _millis(millis)
+{
+}
+
+
+bool SerialEventLoop::SleepAwaiter::await_ready() const noexcept
+{
+    // Even sleep(0) waits for the next turn.
+    return false;
+}
+
+
+void SerialEventLoop::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    _handle = handle;
+    _loop.arm(*this, AbstractSerialTap::now() + uint64_t(_millis) * 1000000);
+}
+
+
+void SerialEventLoop::SleepAwaiter::await_resume() noexcept
+{
+}
+
+
+void SerialEventLoop::SleepAwaiter::expire()
+{
+    _loop.schedule(_handle);
+}
+
+
+SerialEventLoop::SerialEventLoop(): _stopping(false)
+{
+#if !defined(_WIN32)
+    if (::pipe(_wakePipe) != 0)
+    {
+        ofLogError("SerialEventLoop::SerialEventLoop") << "Unable to create the wake pipe: " << std::strerror(errno);
+        _wakePipe[0] = _wakePipe[1] = -1;
+    }
+    else
+    {
+        for (int fd: _wakePipe)
+        {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+#endif
+
+#if defined(__linux__)
+    _epoll = ::epoll_create1(EPOLL_CLOEXEC);
+
+    if (_epoll == -1)
+    {
+        ofLogError("SerialEventLoop::SerialEventLoop") << "Unable to create the event loop: " << std::strerror(errno);
+    }
+    else if (_wakePipe[0] != -1)
+    {
+        // The wake pipe is the only descriptor without a device.
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        ::epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakePipe[0], &event);
+    }
+#endif
+}
+
+
+SerialEventLoop::~SerialEventLoop()
+{
+    _ready.clear();
+
+    // Destroying a task destroys its awaiters, which leave their devices
+    // and timers.
+    std::vector<void*> tasks(_tasks.begin(), _tasks.end());
+    _tasks.clear();
+
+    for (void* address: tasks)
+    {
+        std::coroutine_handle<>::from_address(address).destroy();
+    }
+
+    std::vector<AsyncSerialDevice*> devices = _devices;
+
+    for (AsyncSerialDevice* device: devices)
+    {
+        device->close();
+    }
+
+    _ready.clear();
+
+#if !defined(_WIN32)
+    for (int fd: { _epoll, _wakePipe[0], _wakePipe[1] })
+    {
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+    }
+#endif
+}
+
+
+void SerialEventLoop::run()
+{
+    _stopping = false;
+
+    while (!_stopping && !_tasks.empty())
+    {
+        turn(-1);
+    }
+}
+
+
+std::size_t SerialEventLoop::runOnce(uint32_t timeoutMillis)
+{
+    return turn(timeoutMillis);
+}
+
+
+void SerialEventLoop::stop()
+{
+    _stopping = true;
+
+#if !defined(_WIN32)
+    if (_wakePipe[1] != -1)
+    {
+        uint8_t byte = 0;
+        ssize_t result = ::write(_wakePipe[1], &byte, 1);
+        (void)result;
+    }
+#endif
+}
+
+
+std::size_t SerialEventLoop::taskCount() const
+{
+    return _tasks.size();
+}
+
+
+SerialEventLoop::SleepAwaiter SerialEventLoop::sleep(uint32_t millis)
+{
+    return SleepAwaiter(*this, millis);
+}
+
+
+void SerialEventLoop::schedule(std::coroutine_handle<> handle)
+{
+    _ready.push_back(handle);
+}
+
+
+void SerialEventLoop::arm(Timer& timer, uint64_t deadlineNanos)
+{
+    disarm(timer);
+    timer._position = _timers.emplace(deadlineNanos, &timer);
+    timer._loop = this;
+}
+
+
+void SerialEventLoop::disarm(Timer& timer)
+{
+    if (timer._loop == this)
+    {
+        _timers.erase(timer._position);
+        timer._loop = nullptr;
+    }
+}
+
+
+std::size_t SerialEventLoop::turn(int64_t timeoutMillis)
+{
+    // Coroutines that are already ready run without waiting.
+    if (!_ready.empty() || _stopping)
+    {
+        timeoutMillis = 0;
+    }
+
+    if (!_timers.empty())
+    {
+        uint64_t now = AbstractSerialTap::now();
+        uint64_t first = _timers.begin()->first;
+        int64_t untilFirst = first <= now ? 0 : int64_t((first - now + 999999) / 1000000);
+
+        if (timeoutMillis < 0 || untilFirst < timeoutMillis)
+        {
+            timeoutMillis = untilFirst;
+        }
+    }
+
+    int timeout = timeoutMillis > INT_MAX ? INT_MAX : int(timeoutMillis);
+
+#if defined(__linux__)
+    if (_epoll != -1)
+    {
+        epoll_event events[MAX_EVENTS];
+        int count = ::epoll_wait(_epoll, events, MAX_EVENTS, timeout);
+
+        if (count < 0 && errno != EINTR)
+        {
+            ofLogError("SerialEventLoop::turn") << "Unable to wait: " << std::strerror(errno);
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            AsyncSerialDevice* device = static_cast<AsyncSerialDevice*>(events[i].data.ptr);
+
+            if (device != nullptr)
+            {
+                device->onReadable();
+            }
+            else
+            {
+                uint8_t buffer[64];
+                while (::read(_wakePipe[0], buffer, sizeof(buffer)) > 0);
+            }
+        }
+    }
+#elif !defined(_WIN32)
+    std::vector<pollfd> fds;
+    std::vector<AsyncSerialDevice*> devices;
+
+    pollfd fd;
+    fd.fd = _wakePipe[0];
+    fd.events = POLLIN;
+    fd.revents = 0;
+    fds.push_back(fd);
+
+    for (AsyncSerialDevice* device: _devices)
+    {
+        if (device->_reading)
+        {
+            fd.fd = device->_fd;
+            fds.push_back(fd);
+            devices.push_back(device);
+        }
+    }
+
+    int count = ::poll(fds.data(), fds.size(), timeout);
+
+    if (count < 0 && errno != EINTR)
+    {
+        ofLogError("SerialEventLoop::turn") << "Unable to wait: " << std::strerror(errno);
+    }
+
+    if (count > 0)
+    {
+        if (fds[0].revents != 0)
+        {
+            uint8_t buffer[64];
+            while (::read(_wakePipe[0], buffer, sizeof(buffer)) > 0);
+        }
+
+        for (std::size_t i = 0; i < devices.size(); ++i)
+        {
+            if (fds[i + 1].revents != 0)
+            {
+                devices[i]->onReadable();
+            }
+        }
+    }
+#else
+    if (timeout != 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout < 0 ? 1 : timeout));
+    }
+#endif
+
+    uint64_t now = AbstractSerialTap::now();
+
+    while (!_timers.empty() && _timers.begin()->first <= now)
+    {
+        Timer* timer = _timers.begin()->second;
+        _timers.erase(_timers.begin());
+        timer->_loop = nullptr;
+        timer->expire();
+    }
+
+    return resumeReady();
+}
+
+
+std::size_t SerialEventLoop::resumeReady()
+{
+    // Only what is ready now; what they schedule runs on the next turn.
+    std::size_t count = _ready.size();
+
+    for (std::size_t i = 0; i < count && !_ready.empty(); ++i)
+    {
+        std::coroutine_handle<> handle = _ready.front();
+        _ready.pop_front();
+        handle.resume();
+    }
+
+    return count;
+}
+
+
+bool SerialEventLoop::watch(AsyncSerialDevice* device)
+{
+#if defined(__linux__)
+    epoll_event event;
+    event.events = 0;
+    event.data.ptr = device;
+
+    if (_epoll == -1 || ::epoll_ctl(_epoll, EPOLL_CTL_ADD, device->_fd, &event) != 0)
+    {
+        ofLogError("SerialEventLoop::watch") << "Unable to wait on the port: " << std::strerror(errno);
+        return false;
+    }
+#elif defined(_WIN32)
+    ofLogError("SerialEventLoop::watch") << "Serial coroutines are not available on Windows.";
+    return false;
+#endif
+
+    _devices.push_back(device);
+    return true;
+}
+
+
+void SerialEventLoop::unwatch(AsyncSerialDevice* device)
+{
+    auto iter = std::find(_devices.begin(), _devices.end(), device);
+
+    if (iter == _devices.end())
+    {
+        return;
+    }
+
+    _devices.erase(iter);
+    device->_reading = false;
+
+#if defined(__linux__)
+    epoll_event event;
+    ::epoll_ctl(_epoll, EPOLL_CTL_DEL, device->_fd, &event);
+#endif
+}
+
+
+void SerialEventLoop::setReading(AsyncSerialDevice* device, bool reading)
+{
+    device->_reading = reading;
+
+#if defined(__linux__)
+    epoll_event event;
+    event.events = reading ? uint32_t(EPOLLIN) : 0u;
+    event.data.ptr = device;
+    ::epoll_ctl(_epoll, EPOLL_CTL_MOD, device->_fd, &event);
+#endif
+}
+
+
+AsyncSerialDevice::ReadAwaiter::ReadAwaiter(AsyncSerialDevice& device,
+                                            uint8_t marker,
+                                            bool skipEmpty,
+                                            int64_t timeoutMillis):
+    _device(device),
+    _marker(marker),
+    _skipEmpty(skipEmpty),
+    _timeoutMillis(timeoutMillis)
+{
+}
+
+
+AsyncSerialDevice::ReadAwaiter::~ReadAwaiter()
+{
+    if (_waiting)
+    {
+        _device.cancel(*this);
+    }
+}
+
+
+bool AsyncSerialDevice::ReadAwaiter::await_ready()
+{
+    if (!_device._open)
+    {
+        _result.status = ReadResult::READ_CLOSED;
+        return true;
+    }
+
+    // Reads complete in order.
+    return _device._readers.empty() && _device.take(*this);
+}
+
+
+void AsyncSerialDevice::ReadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    _handle = handle;
+    _waiting = true;
+    _device._readers.push_back(this);
+
+    if (_timeoutMillis >= 0)
+    {
+        _device._loop->arm(*this, AbstractSerialTap::now() + uint64_t(_timeoutMillis) * 1000000);
+    }
+
+    _device.updateReading();
+}
+
+
+void AsyncSerialDevice::ReadAwaiter::expire()
+{
+    _result.status = ReadResult::READ_TIMEOUT;
+    _device.cancel(*this);
+    _device._loop->schedule(_handle);
+}
+
+
+ByteBuffer AsyncSerialDevice::FrameAwaiter::await_resume()
+{
+    return std::move(_result.buffer);
+}
+
+
+AsyncSerialDevice::ReadResult AsyncSerialDevice::UntilAwaiter::await_resume()
+{
+    return std::move(_result);
+}
+
+
+AsyncSerialDevice::WriteAwaiter::WriteAwaiter(AsyncSerialDevice& device,
+                                              const uint8_t* data,
+                                              std::size_t size):
+    _device(device),
+    _data(data),
+    _size(size)
+{
+}
+
+
+AsyncSerialDevice::WriteAwaiter::~WriteAwaiter()
+{
+    if (_waiting)
+    {
+        auto& writers = _device._writers;
+        writers.erase(std::find(writers.begin(), writers.end(), this));
+
+        if (writers.empty())
+        {
+            _device._loop->disarm(_device._writeTimer);
+        }
+    }
+}
+
+
+bool AsyncSerialDevice::WriteAwaiter::await_ready()
+{
+    if (!_device._open || _size == 0)
+    {
+        return true;
+    }
+
+    // Writes complete in order.
+    if (!_device._writers.empty())
+    {
+        return false;
+    }
+
+    serial::IOResult result = _device._device->tryWriteBytes(_data, _size);
+    _written = result.bytes;
+
+    if (result.status != serial::io_ok)
+    {
+        _device.fail(result.message());
+        return true;
+    }
+
+    return _written == _size;
+}
+
+
+void AsyncSerialDevice::WriteAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    _pending.assign(_data + _written, _data + _size);
+    _handle = handle;
+    _waiting = true;
+    _device._writers.push_back(this);
+
+    if (_device._writers.size() == 1)
+    {
+        _device.retryWrites();
+    }
+}
+
+
+std::size_t AsyncSerialDevice::WriteAwaiter::await_resume() noexcept
+{
+    return _written;
+}
+
+
+void AsyncSerialDevice::WriteTimer::expire()
+{
+    device->serveWrites();
+}
+
+
+AsyncSerialDevice::AsyncSerialDevice()
+{
+    _writeTimer.device = this;
+}
+
+
+AsyncSerialDevice::~AsyncSerialDevice()
+{
+    close();
+}
+
+
+bool AsyncSerialDevice::setup(SerialEventLoop& loop,
+                              SerialDevice& device,
+                              uint8_t marker,
+                              std::size_t maxBufferSize)
+{
+    close();
+
+    if (!device.isOpen() || device.serial() == nullptr)
+    {
+        ofLogError("AsyncSerialDevice::setup") << "The device is not open.";
+        return false;
+    }
+
+    _fd = device.serial()->getFd();
+
+    if (_fd == -1)
+    {
+        ofLogError("AsyncSerialDevice::setup") << "The port " << device.port() << " has no descriptor to wait on.";
+        return false;
+    }
+
+    _loop = &loop;
+    _device = &device;
+
+    if (!loop.watch(this))
+    {
+        _loop = nullptr;
+        _device = nullptr;
+        _fd = -1;
+        return false;
+    }
+
+    serial::Timeout timeout(0, 0, 0, 0, 0);
+    device.serial()->setTimeout(timeout);
+
+    _marker = marker;
+    _buffer.assign(std::max<std::size_t>(maxBufferSize, 1), 0);
+    _begin = 0;
+    _end = 0;
+    _scanned = 0;
+    _overflowCount = 0;
+    _open = true;
+    return true;
+}
+
+
+void AsyncSerialDevice::close()
+{
+    if (_loop == nullptr)
+    {
+        return;
+    }
+
+    fail("");
+
+    _loop = nullptr;
+    _device = nullptr;
+    _fd = -1;
+    _buffer.clear();
+    _begin = 0;
+    _end = 0;
+}
+
+
+bool AsyncSerialDevice::isOpen() const
+{
+    return _open;
+}
+
+
+AsyncSerialDevice::FrameAwaiter AsyncSerialDevice::readFrame()
+{
+    return FrameAwaiter(*this, _marker, true, -1);
+}
+
+
+AsyncSerialDevice::UntilAwaiter AsyncSerialDevice::readUntil(uint8_t marker,
+                                                             uint32_t timeoutMillis)
+{
+    return UntilAwaiter(*this, marker, false, timeoutMillis);
+}
+
+
+AsyncSerialDevice::WriteAwaiter AsyncSerialDevice::write(const uint8_t* data,
+                                                         std::size_t size)
+{
+    return WriteAwaiter(*this, data, size);
+}
+
+
+AsyncSerialDevice::WriteAwaiter AsyncSerialDevice::write(const std::string& data)
+{
+    return WriteAwaiter(*this, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+}
+
+
+AsyncSerialDevice::WriteAwaiter AsyncSerialDevice::write(const ByteBuffer& data)
+{
+    return WriteAwaiter(*this, data.getPtr(), data.size());
+}
+
+
+uint64_t AsyncSerialDevice::overflowCount() const
+{
+    return _overflowCount;
+}
+
+
+SerialDevice* AsyncSerialDevice::device()
+{
+    return _device;
+}
+
+
+bool AsyncSerialDevice::take(ReadAwaiter& reader)
+{
+    for (;;)
+    {
+        const uint8_t* begin = _buffer.data() + _begin;
+        std::size_t size = _end - _begin;
+        const uint8_t* found = static_cast<const uint8_t*>(std::memchr(begin + _scanned, reader._marker, size - _scanned));
+
+        if (found == nullptr)
+        {
+            _scanned = size;
+
+            // A full buffer without a marker can't become a frame.
+            if (size == _buffer.size())
+            {
+                _overflowCount++;
+                _begin = 0;
+                _end = 0;
+                _scanned = 0;
+            }
+
+            return false;
+        }
+
+        std::size_t length = found - begin;
+
+        if (length > 0 || !reader._skipEmpty)
+        {
+            reader._result.status = ReadResult::READ_OK;
+            reader._result.buffer = ByteBuffer(begin, length);
+        }
+
+        _begin += length + 1;
+        _scanned = 0;
+
+        if (_begin == _end)
+        {
+            _begin = 0;
+            _end = 0;
+        }
+
+        if (reader._result.status == ReadResult::READ_OK)
+        {
+            return true;
+        }
+    }
+}
+
+
+void AsyncSerialDevice::onReadable()
+{
+    if (!_open)
+    {
+        return;
+    }
+
+    std::size_t capacity = _buffer.size();
+
+    // While the buffer is full only a hang up is reported.
+    if (_end - _begin == capacity)
+    {
+        fail("The port " + _device->port() + " hung up.");
+        return;
+    }
+
+    if (_end == capacity)
+    {
+        std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+        _end -= _begin;
+        _begin = 0;
+    }
+
+    serial::IOResult result = _device->tryReadBytes(_buffer.data() + _end, capacity - _end);
+    _end += result.bytes;
+
+    if (result.status != serial::io_ok)
+    {
+        fail(result.message());
+        return;
+    }
+
+    if (result.bytes == 0)
+    {
+        fail("The port " + _device->port() + " is readable but returned no data (device disconnected?).");
+        return;
+    }
+
+    serveReads();
+    updateReading();
+}
+
+
+void AsyncSerialDevice::serveReads()
+{
+    while (!_readers.empty())
+    {
+        ReadAwaiter* reader = _readers.front();
+
+        if (!take(*reader))
+        {
+            break;
+        }
+
+        _readers.pop_front();
+        reader->_waiting = false;
+        _loop->disarm(*reader);
+        _loop->schedule(reader->_handle);
+    }
+}
+
+
+void AsyncSerialDevice::serveWrites()
+{
+    while (!_writers.empty())
+    {
+        WriteAwaiter* writer = _writers.front();
+
+        serial::IOResult result = _device->tryWriteBytes(writer->_pending.data() + writer->_pendingOffset,
+                                                         writer->_pending.size() - writer->_pendingOffset);
+        writer->_pendingOffset += result.bytes;
+        writer->_written += result.bytes;
+
+        if (result.status != serial::io_ok)
+        {
+            fail(result.message());
+            return;
+        }
+
+        if (writer->_pendingOffset < writer->_pending.size())
+        {
+            retryWrites();
+            return;
+        }
+
+        _writers.pop_front();
+        writer->_waiting = false;
+        _loop->schedule(writer->_handle);
+    }
+}
+
+
+void AsyncSerialDevice::retryWrites()
+{
+    WriteAwaiter* writer = _writers.front();
+    std::size_t bytes = std::min<std::size_t>(writer->_pending.size() - writer->_pendingOffset, WRITE_RETRY_BYTES);
+    uint64_t delay = std::max<uint64_t>(uint64_t(_device->byteTime()) * bytes, MIN_WRITE_RETRY_NANOS);
+    _loop->arm(_writeTimer, AbstractSerialTap::now() + delay);
+}
+
+
+void AsyncSerialDevice::updateReading()
+{
+    bool reading = _open && !_readers.empty() && _end - _begin < _buffer.size();
+
+    if (reading != _reading)
+    {
+        _loop->setReading(this, reading);
+    }
+}
+
+
+void AsyncSerialDevice::fail(const std::string& message)
+{
+    if (!message.empty())
+    {
+        ofLogError("AsyncSerialDevice") << message;
+    }
+
+    _open = false;
+
+    if (_loop == nullptr)
+    {
+        return;
+    }
+
+    for (ReadAwaiter* reader: _readers)
+    {
+        reader->_waiting = false;
+        reader->_result.status = ReadResult::READ_CLOSED;
+        _loop->disarm(*reader);
+        _loop->schedule(reader->_handle);
+    }
+
+    for (WriteAwaiter* writer: _writers)
+    {
+        writer->_waiting = false;
+        _loop->schedule(writer->_handle);
+    }
+
+    _readers.clear();
+    _writers.clear();
+    _scanned = 0;
+    _loop->disarm(_writeTimer);
+    _loop->unwatch(this);
+}
+
+
+void AsyncSerialDevice::cancel(ReadAwaiter& reader)
+{
+    if (!_readers.empty() && _readers.front() == &reader)
+    {
+        _scanned = 0;
+    }
+
+    _readers.erase(std::find(_readers.begin(), _readers.end(), &reader));
+    reader._waiting = false;
+    _loop->disarm(reader);
+
+    // The next read may already be in the buffer.
+    serveReads();
+    updateReading();
+}
+
+
+} } // namespace ofx::IO
+
+
+#endif
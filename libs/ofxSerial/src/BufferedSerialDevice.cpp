@@ -7,7 +7,7 @@
 
 #include "ofx/IO/BufferedSerialDevice.h"
 #include "ofx/IO/SerialEvents.h"
-#include "Poco/Buffer.h"
+#include "ofx/IO/SerialFraming.h"
 
 
 namespace ofx {
@@ -20,7 +20,8 @@ const uint8_t BufferedSerialDevice::DEFAULT_MARKER = '\n';
 BufferedSerialDevice::BufferedSerialDevice(uint8_t marker,
                                            std::size_t maxBufferSize):
     _marker(marker),
-    _maxBufferSize(maxBufferSize)
+    _maxBufferSize(maxBufferSize),
+    _updateBuffer(UPDATE_BUFFER_SIZE)
 {
     ofAddListener(ofEvents().update, this, &BufferedSerialDevice::update);
 }
@@ -28,59 +29,50 @@ BufferedSerialDevice::BufferedSerialDevice(uint8_t marker,
 
 BufferedSerialDevice::~BufferedSerialDevice()
 {
+    _readerThread.stop();
     ofRemoveListener(ofEvents().update, this, &BufferedSerialDevice::update);
 }
 
 
 void BufferedSerialDevice::update(ofEventArgs& args)
 {
-    if (!isOpen()) return;
+    std::string error;
 
-    Poco::Buffer<uint8_t> buffer(UPDATE_BUFFER_SIZE);
+    if (_readerThread.takeError(error))
+    {
+        Poco::Exception exc(error);
+        SerialBufferErrorEventArgs args(*this, _buffer, exc);
+        ofNotifyEvent(events.onSerialError, args, this);
+    }
+
+    if (!isOpen()) return;
 
     try
     {
-        while (available())
+        if (_readerThread.isRunning())
         {
-            std::size_t nBytes = _serial->read(buffer.begin(),
-                                               UPDATE_BUFFER_SIZE);
+            std::size_t nBytes = 0;
 
-            for (std::size_t i = 0; i < nBytes; ++i)
+            while ((nBytes = _readerThread.ring().read(_updateBuffer.data(), _updateBuffer.size())) > 0)
             {
-                if (buffer[i] == _marker)
-                {
-                    // Send the buffer if there are any bytes.
-                    if (_buffer.size() > 0)
-                    {
-                        SerialBufferEventArgs args(*this, _buffer);
-                        ofNotifyEvent(events.onSerialBuffer, args, this);
-                    }
-
-                    _buffer.reserve(_maxBufferSize);
-                    _buffer.clear();
-                }
-                else
+                processBytes(_updateBuffer.data(), nBytes);
+            }
+        }
+        else
+        {
+            while (available())
+            {
+                serial::IOResult result = tryReadBytes(_updateBuffer.data(),
+                                                       _updateBuffer.size());
+
+                processBytes(_updateBuffer.data(), result.bytes);
+
+                if (!result.ok())
                 {
-                    if (_buffer.size() + 1 >= _maxBufferSize)
-                    {
-                        // Send the overflow;
-                        std::stringstream ss;
-                        ss << "maxBufferSize exceeded: ";
-                        ss << _maxBufferSize;
-
-                        Poco::Exception exception(ss.str());
-
-                        SerialBufferErrorEventArgs args(*this,
-                                                        _buffer,
-                                                        exception);
-
-                        ofNotifyEvent(events.onSerialError, args, this);
-
-                        _buffer.reserve(_maxBufferSize);
-                        _buffer.clear();
-                    }
-                    
-                    _buffer.writeByte(buffer[i]);
+                    Poco::Exception exc(result.message());
+                    SerialBufferErrorEventArgs args(*this, _buffer, exc);
+                    ofNotifyEvent(events.onSerialError, args, this);
+                    break;
                 }
             }
         }
@@ -105,6 +97,52 @@ void BufferedSerialDevice::update(ofEventArgs& args)
 }
 
 
+void BufferedSerialDevice::processBytes(const uint8_t* data, std::size_t size)
+{
+    MarkerFramer::process(_marker, _maxBufferSize, _buffer, data, size,
+        [this](const ByteBuffer& buffer)
+        {
+            SerialBufferEventArgs args(*this, buffer);
+            ofNotifyEvent(events.onSerialBuffer, args, this);
+        },
+        [this](const ByteBuffer& buffer)
+        {
+            // Send the overflow;
+            std::stringstream ss;
+            ss << "maxBufferSize exceeded: ";
+            ss << _maxBufferSize;
+
+            Poco::Exception exception(ss.str());
+
+            SerialBufferErrorEventArgs args(*this,
+                                            buffer,
+                                            exception);
+
+            ofNotifyEvent(events.onSerialError, args, this);
+        });
+}
+
+
+bool BufferedSerialDevice::startReaderThread(const ThreadPolicy& policy,
+                                             std::size_t capacity)
+{
+    _readerThread.setTap(_tap);
+    return _readerThread.start(_serial, policy, capacity);
+}
+
+
+void BufferedSerialDevice::stopReaderThread()
+{
+    _readerThread.stop();
+}
+
+
+bool BufferedSerialDevice::isReaderThreadRunning() const
+{
+    return _readerThread.isRunning();
+}
+
+
 void BufferedSerialDevice::setMarker(uint8_t marker)
 {
     _marker = marker;
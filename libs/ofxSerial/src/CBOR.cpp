@@ -0,0 +1,642 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/CBOR.h"
+#include <cmath>
+#include <cstring>
+
+
+namespace ofx {
+namespace IO {
+
+
+namespace {
+
+
+enum
+{
+    MAJOR_UNSIGNED = 0,
+    MAJOR_NEGATIVE = 1,
+    MAJOR_BYTES = 2,
+    MAJOR_TEXT = 3,
+    MAJOR_ARRAY = 4,
+    MAJOR_MAP = 5,
+    MAJOR_TAG = 6,
+    MAJOR_SIMPLE = 7
+};
+
+
+enum
+{
+    INFO_UINT8 = 24,
+    INFO_UINT16 = 25,
+    INFO_UINT32 = 26,
+    INFO_UINT64 = 27,
+    INFO_INDEFINITE = 31
+};
+
+
+enum
+{
+    SIMPLE_FALSE = 20,
+    SIMPLE_TRUE = 21,
+    SIMPLE_NULL = 22,
+    SIMPLE_UNDEFINED = 23
+};
+
+
+enum
+{
+    /// \brief The maximum nesting depth accepted by CBORReader::skip().
+    MAX_SKIP_DEPTH = 32
+};
+
+
+double halfToDouble(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    double value = 0;
+
+    if (exponent == 0)
+    {
+        value = std::ldexp(mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        value = std::ldexp(mantissa + 1024, exponent - 25);
+    }
+    else
+    {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+
+    return (half & 0x8000) ? -value : value;
+}
+
+
+} // namespace
+
+
+CBORWriter::CBORWriter(uint8_t* buffer, std::size_t capacity):
+    _buffer(buffer),
+    _capacity(capacity)
+{
+}
+
+
+CBORWriter& CBORWriter::writeUnsigned(uint64_t value)
+{
+    writeHead(MAJOR_UNSIGNED, value);
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::writeInt(int64_t value)
+{
+    if (value < 0)
+    {
+        writeHead(MAJOR_NEGATIVE, ~static_cast<uint64_t>(value));
+    }
+    else
+    {
+        writeHead(MAJOR_UNSIGNED, static_cast<uint64_t>(value));
+    }
+
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::writeBool(bool value)
+{
+    writeHead(MAJOR_SIMPLE, value ? SIMPLE_TRUE : SIMPLE_FALSE);
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::writeNull()
+{
+    writeHead(MAJOR_SIMPLE, SIMPLE_NULL);
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::writeFloat(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    if (reserve(5))
+    {
+        _buffer[_size++] = (MAJOR_SIMPLE << 5) | INFO_UINT32;
+
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            _buffer[_size++] = static_cast<uint8_t>(bits >> shift);
+        }
+    }
+
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::writeDouble(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    if (reserve(9))
+    {
+        _buffer[_size++] = (MAJOR_SIMPLE << 5) | INFO_UINT64;
+
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            _buffer[_size++] = static_cast<uint8_t>(bits >> shift);
+        }
+    }
+
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::writeText(const char* text)
+{
+    return writeText(text, std::strlen(text));
+}
+
+
+CBORWriter& CBORWriter::writeText(const char* text, std::size_t length)
+{
+    writeHead(MAJOR_TEXT, length);
+    writeRaw(reinterpret_cast<const uint8_t*>(text), length);
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::writeText(const std::string& text)
+{
+    return writeText(text.data(), text.size());
+}
+
+
+CBORWriter& CBORWriter::writeBytes(const uint8_t* data, std::size_t size)
+{
+    writeHead(MAJOR_BYTES, size);
+    writeRaw(data, size);
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::writeTag(uint64_t tag)
+{
+    writeHead(MAJOR_TAG, tag);
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::beginArray(std::size_t count)
+{
+    writeHead(MAJOR_ARRAY, count);
+    return *this;
+}
+
+
+CBORWriter& CBORWriter::beginMap(std::size_t count)
+{
+    writeHead(MAJOR_MAP, count);
+    return *this;
+}
+
+
+void CBORWriter::reset()
+{
+    _size = 0;
+    _ok = true;
+}
+
+
+bool CBORWriter::ok() const
+{
+    return _ok;
+}
+
+
+const uint8_t* CBORWriter::data() const
+{
+    return _buffer;
+}
+
+
+std::size_t CBORWriter::size() const
+{
+    return _size;
+}
+
+
+void CBORWriter::writeHead(uint8_t majorType, uint64_t value)
+{
+    uint8_t head = static_cast<uint8_t>(majorType << 5);
+
+    if (value < INFO_UINT8)
+    {
+        if (reserve(1))
+        {
+            _buffer[_size++] = head | static_cast<uint8_t>(value);
+        }
+
+        return;
+    }
+
+    uint8_t info = INFO_UINT64;
+    std::size_t count = 8;
+
+    if (value <= 0xFF)
+    {
+        info = INFO_UINT8;
+        count = 1;
+    }
+    else if (value <= 0xFFFF)
+    {
+        info = INFO_UINT16;
+        count = 2;
+    }
+    else if (value <= 0xFFFFFFFF)
+    {
+        info = INFO_UINT32;
+        count = 4;
+    }
+
+    if (reserve(count + 1))
+    {
+        _buffer[_size++] = head | info;
+
+        while (count-- > 0)
+        {
+            _buffer[_size++] = static_cast<uint8_t>(value >> (count * 8));
+        }
+    }
+}
+
+
+void CBORWriter::writeRaw(const uint8_t* data, std::size_t size)
+{
+    if (size > 0 && reserve(size))
+    {
+        std::memcpy(_buffer + _size, data, size);
+        _size += size;
+    }
+}
+
+
+bool CBORWriter::reserve(std::size_t size)
+{
+    if (_ok && size <= _capacity - _size)
+    {
+        return true;
+    }
+
+    _ok = false;
+    return false;
+}
+
+
+CBORReader::CBORReader(const uint8_t* data, std::size_t size):
+    _data(data),
+    _size(size)
+{
+}
+
+
+CBORReader::CBORReader(const ByteBuffer& buffer):
+    CBORReader(buffer.getPtr(), buffer.size())
+{
+}
+
+
+CBORReader::Type CBORReader::next()
+{
+    if (_type == TYPE_ERROR)
+    {
+        return _type;
+    }
+
+    _bytes = nullptr;
+    _indefinite = false;
+    _value = 0;
+    _double = 0;
+
+    if (_offset >= _size)
+    {
+        _type = TYPE_END;
+        return _type;
+    }
+
+    uint8_t majorType = 0;
+    uint8_t info = 0;
+
+    if (!readHead(majorType, info, _value))
+    {
+        return error();
+    }
+
+    switch (majorType)
+    {
+        case MAJOR_UNSIGNED:
+            _type = TYPE_UNSIGNED;
+            break;
+        case MAJOR_NEGATIVE:
+            _type = TYPE_NEGATIVE;
+            break;
+        case MAJOR_BYTES:
+        case MAJOR_TEXT:
+            // Chunked strings would require copying to reassemble.
+            if (_indefinite || _value > _size - _offset)
+            {
+                return error();
+            }
+
+            _type = majorType == MAJOR_BYTES ? TYPE_BYTES : TYPE_TEXT;
+            _bytes = _data + _offset;
+            _offset += static_cast<std::size_t>(_value);
+            break;
+        case MAJOR_ARRAY:
+            _type = TYPE_ARRAY;
+            break;
+        case MAJOR_MAP:
+            _type = TYPE_MAP;
+            break;
+        case MAJOR_TAG:
+            _type = TYPE_TAG;
+            break;
+        case MAJOR_SIMPLE:
+            if (_indefinite)
+            {
+                _type = TYPE_BREAK;
+            }
+            else if (info == INFO_UINT16)
+            {
+                _type = TYPE_FLOAT;
+                _double = halfToDouble(static_cast<uint16_t>(_value));
+            }
+            else if (info == INFO_UINT32)
+            {
+                uint32_t bits = static_cast<uint32_t>(_value);
+                float value;
+                std::memcpy(&value, &bits, sizeof(value));
+                _type = TYPE_FLOAT;
+                _double = value;
+            }
+            else if (info == INFO_UINT64)
+            {
+                std::memcpy(&_double, &_value, sizeof(_double));
+                _type = TYPE_FLOAT;
+            }
+            else if (_value == SIMPLE_FALSE || _value == SIMPLE_TRUE)
+            {
+                _type = TYPE_BOOL;
+            }
+            else if (_value == SIMPLE_NULL)
+            {
+                _type = TYPE_NULL;
+            }
+            else if (_value == SIMPLE_UNDEFINED)
+            {
+                _type = TYPE_UNDEFINED;
+            }
+            else
+            {
+                _type = TYPE_SIMPLE;
+            }
+            break;
+    }
+
+    return _type;
+}
+
+
+bool CBORReader::skip()
+{
+    std::size_t depth = 0;
+
+    // Each entry counts the items left in an enclosing container, or is
+    // SIZE_MAX for an indefinite container that ends with a break.
+    uint64_t remaining[MAX_SKIP_DEPTH];
+
+    do
+    {
+        if (_type == TYPE_ERROR || _type == TYPE_END)
+        {
+            return false;
+        }
+
+        if (_type == TYPE_BREAK)
+        {
+            if (depth == 0 || remaining[depth - 1] != UINT64_MAX)
+            {
+                error();
+                return false;
+            }
+
+            --depth;
+        }
+        else
+        {
+            if (depth > 0 && remaining[depth - 1] != UINT64_MAX)
+            {
+                --remaining[depth - 1];
+            }
+
+            if (_type == TYPE_ARRAY || _type == TYPE_MAP || _type == TYPE_TAG)
+            {
+                if (depth == MAX_SKIP_DEPTH)
+                {
+                    error();
+                    return false;
+                }
+
+                if (_type == TYPE_TAG)
+                {
+                    remaining[depth++] = 1;
+                }
+                else if (_indefinite)
+                {
+                    remaining[depth++] = UINT64_MAX;
+                }
+                else if (_type == TYPE_MAP)
+                {
+                    // Guard against overflow from hostile lengths.
+                    remaining[depth++] = _value > UINT64_MAX / 4 ? UINT64_MAX - 1 : _value * 2;
+                }
+                else
+                {
+                    remaining[depth++] = _value;
+                }
+            }
+        }
+
+        while (depth > 0 && remaining[depth - 1] == 0)
+        {
+            --depth;
+        }
+
+        if (depth > 0)
+        {
+            next();
+        }
+    }
+    while (depth > 0);
+
+    return true;
+}
+
+
+CBORReader::Type CBORReader::type() const
+{
+    return _type;
+}
+
+
+uint64_t CBORReader::uintValue() const
+{
+    return _value;
+}
+
+
+int64_t CBORReader::intValue() const
+{
+    if (_type == TYPE_NEGATIVE)
+    {
+        return static_cast<int64_t>(~_value);
+    }
+
+    return static_cast<int64_t>(_value);
+}
+
+
+double CBORReader::doubleValue() const
+{
+    if (_type == TYPE_UNSIGNED)
+    {
+        return static_cast<double>(_value);
+    }
+    else if (_type == TYPE_NEGATIVE)
+    {
+        return -1.0 - static_cast<double>(_value);
+    }
+
+    return _double;
+}
+
+
+bool CBORReader::boolValue() const
+{
+    return _type == TYPE_BOOL && _value == SIMPLE_TRUE;
+}
+
+
+uint64_t CBORReader::tagValue() const
+{
+    return _value;
+}
+
+
+const uint8_t* CBORReader::bytes() const
+{
+    return _bytes;
+}
+
+
+const char* CBORReader::text() const
+{
+    return reinterpret_cast<const char*>(_bytes);
+}
+
+
+std::size_t CBORReader::length() const
+{
+    return static_cast<std::size_t>(_value);
+}
+
+
+bool CBORReader::isIndefinite() const
+{
+    return _indefinite;
+}
+
+
+bool CBORReader::textEquals(const char* text) const
+{
+    std::size_t length = std::strlen(text);
+
+    return _type == TYPE_TEXT
+        && _value == length
+        && std::memcmp(_bytes, text, length) == 0;
+}
+
+
+std::size_t CBORReader::offset() const
+{
+    return _offset;
+}
+
+
+bool CBORReader::readHead(uint8_t& majorType, uint8_t& info, uint64_t& value)
+{
+    uint8_t head = _data[_offset++];
+
+    majorType = head >> 5;
+    info = head & 0x1F;
+    value = 0;
+
+    if (info < INFO_UINT8)
+    {
+        value = info;
+        return true;
+    }
+
+    if (info == INFO_INDEFINITE)
+    {
+        _indefinite = true;
+
+        return majorType == MAJOR_BYTES
+            || majorType == MAJOR_TEXT
+            || majorType == MAJOR_ARRAY
+            || majorType == MAJOR_MAP
+            || majorType == MAJOR_SIMPLE;
+    }
+
+    if (info > INFO_UINT64)
+    {
+        return false;
+    }
+
+    std::size_t count = std::size_t(1) << (info - INFO_UINT8);
+
+    if (count > _size - _offset)
+    {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        value = (value << 8) | _data[_offset++];
+    }
+
+    return true;
+}
+
+
+CBORReader::Type CBORReader::error()
+{
+    _type = TYPE_ERROR;
+    _bytes = nullptr;
+    _value = 0;
+    return _type;
+}
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,474 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/PacketCompression.h"
+#include <algorithm>
+#include <cstring>
+
+
+namespace ofx {
+namespace IO {
+
+
+namespace {
+
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+
+inline void writeLength(std::size_t length, std::vector<uint8_t>& out)
+{
+    while (length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+
+inline bool readLength(const uint8_t* data,
+                       std::size_t size,
+                       std::size_t& ip,
+                       std::size_t& length)
+{
+    uint8_t b = 0;
+
+    do
+    {
+        if (ip >= size)
+        {
+            return false;
+        }
+
+        b = data[ip++];
+        length += b;
+    }
+    while (b == 255);
+
+    return true;
+}
+
+
+/// \brief Writes bits most significant bit first, as heatshrink expects.
+class BitWriter
+{
+public:
+    BitWriter(std::vector<uint8_t>& out): _out(out)
+    {
+    }
+
+    void write(uint32_t value, uint8_t count)
+    {
+        while (count > 0)
+        {
+            --count;
+            _current = static_cast<uint8_t>((_current << 1) | ((value >> count) & 1));
+
+            if (++_bits == 8)
+            {
+                _out.push_back(_current);
+                _current = 0;
+                _bits = 0;
+            }
+        }
+    }
+
+    void finish()
+    {
+        if (_bits > 0)
+        {
+            _out.push_back(static_cast<uint8_t>(_current << (8 - _bits)));
+            _current = 0;
+            _bits = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& _out;
+    uint8_t _current = 0;
+    uint8_t _bits = 0;
+
+};
+
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, std::size_t size): _data(data), _size(size)
+    {
+    }
+
+    /// \returns false if fewer than count bits remain.
+    bool read(uint8_t count, uint32_t& value)
+    {
+        if ((_size - _byte) * 8 - _bit < count)
+        {
+            return false;
+        }
+
+        value = 0;
+
+        while (count-- > 0)
+        {
+            value = (value << 1) | ((_data[_byte] >> (7 - _bit)) & 1);
+
+            if (++_bit == 8)
+            {
+                _bit = 0;
+                ++_byte;
+            }
+        }
+
+        return true;
+    }
+
+private:
+    const uint8_t* _data = nullptr;
+    std::size_t _size = 0;
+    std::size_t _byte = 0;
+    uint8_t _bit = 0;
+
+};
+
+
+} // namespace
+
+
+LZ4Compression::~LZ4Compression()
+{
+}
+
+
+bool LZ4Compression::compress(const uint8_t* data,
+                              std::size_t size,
+                              std::vector<uint8_t>& compressed) const
+{
+    std::size_t start = compressed.size();
+    std::size_t anchor = 0;
+
+    if (size > MATCH_FIND_LIMIT)
+    {
+        int32_t table[1 << HASH_BITS];
+        std::fill(table, table + (1 << HASH_BITS), -1);
+
+        std::size_t limit = size - MATCH_FIND_LIMIT;
+        std::size_t matchEnd = size - LAST_LITERALS;
+        std::size_t i = 0;
+
+        while (i < limit)
+        {
+            uint32_t sequence = read32(data + i);
+            uint32_t hash = (sequence * 2654435761U) >> (32 - HASH_BITS);
+            int32_t ref = table[hash];
+            table[hash] = static_cast<int32_t>(i);
+
+            if (ref < 0
+            ||  i - ref > MAX_OFFSET
+            ||  read32(data + ref) != sequence)
+            {
+                ++i;
+                continue;
+            }
+
+            std::size_t matchLength = MIN_MATCH;
+
+            while (i + matchLength < matchEnd && data[ref + matchLength] == data[i + matchLength])
+            {
+                ++matchLength;
+            }
+
+            std::size_t literalLength = i - anchor;
+            std::size_t matchCode = matchLength - MIN_MATCH;
+            std::size_t offset = i - ref;
+
+            compressed.push_back(static_cast<uint8_t>((std::min<std::size_t>(literalLength, 15) << 4)
+                                                      | std::min<std::size_t>(matchCode, 15)));
+
+            if (literalLength >= 15)
+            {
+                writeLength(literalLength - 15, compressed);
+            }
+
+            compressed.insert(compressed.end(), data + anchor, data + i);
+            compressed.push_back(static_cast<uint8_t>(offset & 0xFF));
+            compressed.push_back(static_cast<uint8_t>(offset >> 8));
+
+            if (matchCode >= 15)
+            {
+                writeLength(matchCode - 15, compressed);
+            }
+
+            i += matchLength;
+            anchor = i;
+        }
+    }
+
+    std::size_t literalLength = size - anchor;
+
+    compressed.push_back(static_cast<uint8_t>(std::min<std::size_t>(literalLength, 15) << 4));
+
+    if (literalLength >= 15)
+    {
+        writeLength(literalLength - 15, compressed);
+    }
+
+    compressed.insert(compressed.end(), data + anchor, data + size);
+
+    return compressed.size() - start < size;
+}
+
+
+bool LZ4Compression::decompress(const uint8_t* data,
+                                std::size_t size,
+                                std::vector<uint8_t>& decompressed,
+                                std::size_t maxSize) const
+{
+    std::size_t start = decompressed.size();
+    std::size_t ip = 0;
+
+    while (ip < size)
+    {
+        uint8_t token = data[ip++];
+        std::size_t literalLength = token >> 4;
+
+        if (literalLength == 15 && !readLength(data, size, ip, literalLength))
+        {
+            return false;
+        }
+
+        if (literalLength > size - ip
+        ||  decompressed.size() - start + literalLength > maxSize)
+        {
+            return false;
+        }
+
+        decompressed.insert(decompressed.end(), data + ip, data + ip + literalLength);
+        ip += literalLength;
+
+        // The last sequence has no match.
+        if (ip == size)
+        {
+            return true;
+        }
+
+        if (size - ip < 2)
+        {
+            return false;
+        }
+
+        std::size_t offset = data[ip] | (data[ip + 1] << 8);
+        ip += 2;
+
+        std::size_t matchLength = token & 0x0F;
+
+        if (matchLength == 15 && !readLength(data, size, ip, matchLength))
+        {
+            return false;
+        }
+
+        matchLength += MIN_MATCH;
+
+        if (offset == 0
+        ||  offset > decompressed.size() - start
+        ||  decompressed.size() - start + matchLength > maxSize)
+        {
+            return false;
+        }
+
+        // Matches may overlap their own output, so copy byte by byte.
+        std::size_t from = decompressed.size() - offset;
+
+        for (std::size_t i = 0; i < matchLength; ++i)
+        {
+            decompressed.push_back(decompressed[from + i]);
+        }
+    }
+
+    // A valid block always ends with a literal-only sequence.
+    return false;
+}
+
+
+std::string LZ4Compression::name() const
+{
+    return "lz4";
+}
+
+
+HeatshrinkCompression::HeatshrinkCompression(uint8_t windowBits,
+                                             uint8_t lookaheadBits):
+    _windowBits(std::min<uint8_t>(std::max<uint8_t>(windowBits, 4), 15)),
+    _lookaheadBits(std::min<uint8_t>(std::max<uint8_t>(lookaheadBits, 3), _windowBits - 1))
+{
+}
+
+
+HeatshrinkCompression::~HeatshrinkCompression()
+{
+}
+
+
+bool HeatshrinkCompression::compress(const uint8_t* data,
+                                     std::size_t size,
+                                     std::vector<uint8_t>& compressed) const
+{
+    std::size_t start = compressed.size();
+    std::size_t windowSize = std::size_t(1) << _windowBits;
+    std::size_t maxMatch = std::size_t(1) << _lookaheadBits;
+
+    // A back-reference only pays off when it is shorter than the literals
+    // it replaces.
+    std::size_t breakEven = (1 + _windowBits + _lookaheadBits) / 9;
+
+    BitWriter writer(compressed);
+
+    std::size_t i = 0;
+
+    while (i < size)
+    {
+        std::size_t bestLength = 0;
+        std::size_t bestOffset = 0;
+        std::size_t first = i > windowSize ? i - windowSize : 0;
+        std::size_t limit = std::min(maxMatch, size - i);
+
+        for (std::size_t candidate = i; candidate-- > first;)
+        {
+            std::size_t length = 0;
+
+            while (length < limit && data[candidate + length] == data[i + length])
+            {
+                ++length;
+            }
+
+            if (length > bestLength)
+            {
+                bestLength = length;
+                bestOffset = i - candidate;
+
+                if (length == limit)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (bestLength > breakEven)
+        {
+            writer.write(0, 1);
+            writer.write(static_cast<uint32_t>(bestOffset - 1), _windowBits);
+            writer.write(static_cast<uint32_t>(bestLength - 1), _lookaheadBits);
+            i += bestLength;
+        }
+        else
+        {
+            writer.write(1, 1);
+            writer.write(data[i], 8);
+            ++i;
+        }
+
+        // Give up early on incompressible data.
+        if (compressed.size() - start >= size)
+        {
+            return false;
+        }
+    }
+
+    writer.finish();
+
+    return compressed.size() - start < size;
+}
+
+
+bool HeatshrinkCompression::decompress(const uint8_t* data,
+                                       std::size_t size,
+                                       std::vector<uint8_t>& decompressed,
+                                       std::size_t maxSize) const
+{
+    std::size_t start = decompressed.size();
+
+    BitReader reader(data, size);
+
+    uint32_t tag = 0;
+
+    // Trailing padding bits are too short to form a token, which ends the
+    // loop the same way it does in the heatshrink decoder.
+    while (reader.read(1, tag))
+    {
+        if (tag == 1)
+        {
+            uint32_t byte = 0;
+
+            if (!reader.read(8, byte))
+            {
+                break;
+            }
+
+            if (decompressed.size() - start + 1 > maxSize)
+            {
+                return false;
+            }
+
+            decompressed.push_back(static_cast<uint8_t>(byte));
+        }
+        else
+        {
+            uint32_t index = 0;
+            uint32_t count = 0;
+
+            if (!reader.read(_windowBits, index) || !reader.read(_lookaheadBits, count))
+            {
+                break;
+            }
+
+            std::size_t offset = index + 1;
+            std::size_t length = count + 1;
+
+            if (offset > decompressed.size() - start
+            ||  decompressed.size() - start + length > maxSize)
+            {
+                return false;
+            }
+
+            std::size_t from = decompressed.size() - offset;
+
+            for (std::size_t i = 0; i < length; ++i)
+            {
+                decompressed.push_back(decompressed[from + i]);
+            }
+        }
+    }
+
+    return true;
+}
+
+
+std::string HeatshrinkCompression::name() const
+{
+    return "heatshrink";
+}
+
+
+uint8_t HeatshrinkCompression::windowBits() const
+{
+    return _windowBits;
+}
+
+
+uint8_t HeatshrinkCompression::lookaheadBits() const
+{
+    return _lookaheadBits;
+}
+
+
+} } // namespace ofx::IO
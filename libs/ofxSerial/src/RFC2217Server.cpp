@@ -0,0 +1,1324 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/RFC2217Server.h"
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include "serial/rfc2217.h"
+#include "ofLog.h"
+
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+
+namespace ofx {
+namespace IO {
+
+
+/// \brief A descriptor registered with epoll.
+struct RFC2217Server::Endpoint
+{
+    enum Kind
+    {
+        KIND_LISTENER,
+        KIND_SERIAL,
+        KIND_CLIENT
+    };
+
+    Port* port = nullptr;
+
+    Kind kind = KIND_LISTENER;
+
+    int fd = -1;
+
+    /// \brief The registered epoll events.
+    uint32_t events = 0;
+};
+
+
+/// \brief A shared device and its client.
+struct RFC2217Server::Port
+{
+    /// \brief Bytes on their way in one direction.
+    struct Flow
+    {
+        /// \brief The pipe used for splicing, or -1.
+        int pipe[2] = { -1, -1 };
+
+        /// \brief The number of bytes in the pipe.
+        std::size_t piped = 0;
+
+        /// \brief False once splicing failed.
+        bool splice = true;
+
+        /// \brief Bytes copied through user space.
+        std::vector<uint8_t> buffer;
+
+        /// \brief The offset of the first unwritten byte in the buffer.
+        std::size_t offset = 0;
+
+        bool pending() const
+        {
+            return piped > 0 || offset < buffer.size();
+        }
+
+        /// \brief Forget the queued bytes, keeping the pipe.
+        void clear()
+        {
+            piped = 0;
+            splice = true;
+            buffer.clear();
+            offset = 0;
+        }
+    };
+
+    /// \brief The state of the Telnet parser.
+    enum ParseState
+    {
+        PARSE_DATA,
+        PARSE_IAC,
+        PARSE_OPTION,
+        PARSE_SUBNEGOTIATION,
+        PARSE_SUBNEGOTIATION_IAC
+    };
+
+    SerialDevice* device = nullptr;
+
+    /// \brief The device's timeout from before the client connected.
+    serial::Timeout timeout;
+
+    Mode mode = MODE_RFC2217;
+
+    uint16_t tcpPort = 0;
+
+    Endpoint listener;
+    Endpoint serial;
+    Endpoint client;
+
+    /// \brief Bytes from the device to the client.
+    Flow toClient;
+
+    /// \brief Bytes from the client to the device.
+    Flow toSerial;
+
+    ParseState parseState = PARSE_DATA;
+
+    /// \brief The negotiation command being parsed.
+    uint8_t command = 0;
+
+    /// \brief The subnegotiation being parsed.
+    std::vector<uint8_t> subnegotiation;
+
+    /// \brief The options enabled on our side.
+    std::bitset<256> local;
+
+    /// \brief The options enabled on the client's side.
+    std::bitset<256> remote;
+
+    /// \brief True while the client asked to stop receiving.
+    bool suspended = false;
+
+    /// \brief The modem lines the client wants to hear about.
+    uint8_t modemStateMask = 0xFF;
+
+    /// \brief The line state events the client wants to hear about.
+    uint8_t lineStateMask = 0;
+
+    /// \brief The modem lines last sent to the client.
+    uint8_t modemState = 0;
+
+    /// \brief False once the modem lines could not be read.
+    bool modemSupported = true;
+
+    /// \brief The last break, DTR and RTS requests.
+    bool breakState = false;
+    bool dtrState = true;
+    bool rtsState = true;
+};
+
+
+#if defined(__linux__)
+
+
+namespace {
+
+
+/// \brief Each flow moves at most this many chunks per event.
+const int MAX_TRANSFERS_PER_EVENT = 16;
+
+
+/// \brief The most bytes of a subnegotiation that are kept.
+const std::size_t MAX_SUBNEGOTIATION_SIZE = 256;
+
+
+void closeFd(int& fd)
+{
+    if (fd != -1)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+
+void closePipe(int pipe[2])
+{
+    closeFd(pipe[0]);
+    closeFd(pipe[1]);
+}
+
+
+/// \brief Write to a descriptor without raising SIGPIPE on sockets.
+ssize_t writeFd(int fd, const uint8_t* data, std::size_t size, bool socket)
+{
+    return socket ? ::send(fd, data, size, MSG_NOSIGNAL) : ::write(fd, data, size);
+}
+
+
+bool wouldBlock()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+
+/// \brief Check a read that returned no bytes.
+/// \returns false if the input is closed or failed.
+bool endOfInput(ssize_t count, bool socket)
+{
+    // Ports read with VMIN and VTIME of zero return zero when they are
+    // empty. They report a hangup through epoll instead.
+    return count < 0 ? wouldBlock() : !socket;
+}
+
+
+/// \brief Move bytes between a port and a socket.
+///
+/// Bytes are spliced through the flow's pipe. If either side cannot
+/// splice, the flow falls back to read and write.
+///
+/// \param fromSocket True if the bytes go from the socket to the port.
+/// \returns false if either side closed or failed.
+template<typename Flow>
+bool transfer(Flow& flow,
+              int from,
+              int to,
+              bool fromSocket,
+              std::atomic<uint64_t>& spliced,
+              std::atomic<uint64_t>& copied)
+{
+    for (int i = 0; i < MAX_TRANSFERS_PER_EVENT; ++i)
+    {
+        // First write what is queued.
+        if (flow.piped > 0)
+        {
+            ssize_t count = ::splice(flow.pipe[0], nullptr, to, nullptr, flow.piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+            if (count > 0)
+            {
+                flow.piped -= count;
+                spliced += count;
+                continue;
+            }
+
+            if (count < 0 && errno == EINVAL)
+            {
+                // The destination cannot splice. Copy out what the pipe holds.
+                flow.splice = false;
+                flow.buffer.resize(flow.piped);
+                flow.offset = 0;
+
+                if (::read(flow.pipe[0], flow.buffer.data(), flow.piped) != static_cast<ssize_t>(flow.piped))
+                {
+                    return false;
+                }
+
+                flow.piped = 0;
+                continue;
+            }
+
+            return count < 0 && wouldBlock();
+        }
+
+        if (flow.offset < flow.buffer.size())
+        {
+            ssize_t count = writeFd(to, flow.buffer.data() + flow.offset, flow.buffer.size() - flow.offset, !fromSocket);
+
+            if (count > 0)
+            {
+                flow.offset += count;
+                copied += count;
+                continue;
+            }
+
+            return count < 0 && wouldBlock();
+        }
+
+        flow.buffer.clear();
+        flow.offset = 0;
+
+        // Then read more.
+        if (flow.splice)
+        {
+            ssize_t count = ::splice(from, nullptr, flow.pipe[1], nullptr, RFC2217Server::SPLICE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+            if (count > 0)
+            {
+                flow.piped = count;
+                continue;
+            }
+
+            if (count < 0 && errno == EINVAL)
+            {
+                flow.splice = false;
+                continue;
+            }
+
+            return endOfInput(count, fromSocket);
+        }
+
+        flow.buffer.resize(RFC2217Server::BUFFER_SIZE);
+        ssize_t count = ::read(from, flow.buffer.data(), flow.buffer.size());
+
+        if (count > 0)
+        {
+            flow.buffer.resize(count);
+            continue;
+        }
+
+        flow.buffer.clear();
+        return endOfInput(count, fromSocket);
+    }
+
+    return true;
+}
+
+
+}
+
+
+#endif
+
+
+RFC2217Server::RFC2217Server():
+    _running(false),
+    _clientCount(0),
+    _splicedBytes(0),
+    _copiedBytes(0)
+{
+}
+
+
+RFC2217Server::~RFC2217Server()
+{
+    close();
+}
+
+
+bool RFC2217Server::addDevice(SerialDevice* device,
+                              uint16_t port,
+                              Mode mode,
+                              const std::string& address)
+{
+#if defined(__linux__)
+    if (_thread.joinable())
+    {
+        ofLogError("RFC2217Server::addDevice") << "Devices can only be added while stopped.";
+        return false;
+    }
+
+    if (device == nullptr || !device->isOpen())
+    {
+        ofLogError("RFC2217Server::addDevice") << "The device is not open.";
+        return false;
+    }
+
+    sockaddr_in socketAddress;
+    std::memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sin_family = AF_INET;
+    socketAddress.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, address.c_str(), &socketAddress.sin_addr) != 1)
+    {
+        ofLogError("RFC2217Server::addDevice") << "Invalid address: " << address;
+        return false;
+    }
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    socklen_t size = sizeof(socketAddress);
+
+    if (fd == -1
+     || ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+     || ::bind(fd, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0
+     || ::listen(fd, 4) != 0
+     || ::getsockname(fd, reinterpret_cast<sockaddr*>(&socketAddress), &size) != 0)
+    {
+        ofLogError("RFC2217Server::addDevice") << "Unable to listen on " << address << ":" << port << ": " << std::strerror(errno);
+        closeFd(fd);
+        return false;
+    }
+
+    std::unique_ptr<Port> shared(new Port());
+    shared->device = device;
+    shared->mode = mode;
+    shared->tcpPort = ntohs(socketAddress.sin_port);
+    shared->listener.port = shared.get();
+    shared->listener.kind = Endpoint::KIND_LISTENER;
+    shared->listener.fd = fd;
+    shared->serial.port = shared.get();
+    shared->serial.kind = Endpoint::KIND_SERIAL;
+    shared->client.port = shared.get();
+    shared->client.kind = Endpoint::KIND_CLIENT;
+
+    _ports.push_back(std::move(shared));
+    return true;
+#else
+    ofLogError("RFC2217Server::addDevice") << "The RFC 2217 server is only available on Linux.";
+    return false;
+#endif
+}
+
+
+bool RFC2217Server::start()
+{
+#if defined(__linux__)
+    if (_thread.joinable())
+    {
+        return true;
+    }
+
+    _epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    _wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (_epoll == -1 || _wakeFd == -1)
+    {
+        ofLogError("RFC2217Server::start") << "Unable to create the event loop: " << std::strerror(errno);
+        closeFd(_epoll);
+        closeFd(_wakeFd);
+        return false;
+    }
+
+    // The wake descriptor is the only one without an endpoint.
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    ::epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakeFd, &event);
+
+    for (auto& port: _ports)
+    {
+        event.events = EPOLLIN;
+        event.data.ptr = &port->listener;
+        ::epoll_ctl(_epoll, EPOLL_CTL_ADD, port->listener.fd, &event);
+    }
+
+    _running = true;
+    _thread = std::thread(&RFC2217Server::run, this);
+    return true;
+#else
+    ofLogError("RFC2217Server::start") << "The RFC 2217 server is only available on Linux.";
+    return false;
+#endif
+}
+
+
+void RFC2217Server::stop()
+{
+#if defined(__linux__)
+    if (!_thread.joinable())
+    {
+        return;
+    }
+
+    _running = false;
+
+    uint64_t value = 1;
+
+    if (::write(_wakeFd, &value, sizeof(value)) != sizeof(value))
+    {
+        ofLogWarning("RFC2217Server::stop") << "Unable to wake the event loop.";
+    }
+
+    _thread.join();
+
+    for (auto& port: _ports)
+    {
+        disconnect(*port);
+    }
+
+    closeFd(_epoll);
+    closeFd(_wakeFd);
+#endif
+}
+
+
+void RFC2217Server::close()
+{
+    stop();
+
+#if defined(__linux__)
+    for (auto& port: _ports)
+    {
+        closeFd(port->listener.fd);
+    }
+#endif
+
+    _ports.clear();
+}
+
+
+bool RFC2217Server::isRunning() const
+{
+    return _running;
+}
+
+
+std::size_t RFC2217Server::size() const
+{
+    return _ports.size();
+}
+
+
+uint16_t RFC2217Server::port(std::size_t index) const
+{
+    return _ports[index]->tcpPort;
+}
+
+
+std::size_t RFC2217Server::clientCount() const
+{
+    return _clientCount;
+}
+
+
+uint64_t RFC2217Server::splicedBytes() const
+{
+    return _splicedBytes;
+}
+
+
+uint64_t RFC2217Server::copiedBytes() const
+{
+    return _copiedBytes;
+}
+
+
+#if defined(__linux__)
+
+
+void RFC2217Server::run()
+{
+    epoll_event events[64];
+
+    auto nextModemPoll = std::chrono::steady_clock::now();
+
+    while (_running)
+    {
+        int count = ::epoll_wait(_epoll, events, 64, MODEM_POLL_INTERVAL_MS);
+
+        if (count < 0 && errno != EINTR)
+        {
+            ofLogError("RFC2217Server::run") << "epoll_wait failed: " << std::strerror(errno);
+            break;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (events[i].data.ptr != nullptr)
+            {
+                handle(static_cast<Endpoint*>(events[i].data.ptr), events[i].events);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        if (now >= nextModemPoll)
+        {
+            pollModemState();
+            nextModemPoll = now + std::chrono::milliseconds(MODEM_POLL_INTERVAL_MS);
+        }
+    }
+}
+
+
+void RFC2217Server::handle(Endpoint* endpoint, uint32_t events)
+{
+    Port& port = *endpoint->port;
+
+    if (endpoint->kind == Endpoint::KIND_LISTENER)
+    {
+        accept(port);
+        return;
+    }
+
+    // The client may have been disconnected by an earlier event.
+    if (port.client.fd == -1)
+    {
+        return;
+    }
+
+    bool connected = (events & (EPOLLHUP | EPOLLERR)) == 0;
+
+    if (connected)
+    {
+        connected = port.mode == MODE_RAW ? pumpRaw(port) : pumpTelnet(port);
+    }
+
+    if (connected)
+    {
+        updateInterest(port);
+    }
+    else
+    {
+        disconnect(port);
+    }
+}
+
+
+void RFC2217Server::accept(Port& port)
+{
+    int fd = ::accept4(port.listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd == -1)
+    {
+        return;
+    }
+
+    if (port.client.fd != -1 || port.device->serial() == nullptr || port.device->serial()->getFd() == -1)
+    {
+        // One client per port, and only while the device is open.
+        ::close(fd);
+        return;
+    }
+
+    if (port.mode == MODE_RAW
+     && (::pipe2(port.toClient.pipe, O_NONBLOCK | O_CLOEXEC) != 0
+      || ::pipe2(port.toSerial.pipe, O_NONBLOCK | O_CLOEXEC) != 0))
+    {
+        ofLogError("RFC2217Server::accept") << "Unable to create pipes: " << std::strerror(errno);
+        closePipe(port.toClient.pipe);
+        closePipe(port.toSerial.pipe);
+        ::close(fd);
+        return;
+    }
+
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    if (port.mode == MODE_RFC2217)
+    {
+        // Writes must not block the loop while the device is busy.
+        port.timeout = port.device->serial()->getTimeout();
+        serial::Timeout timeout = port.timeout;
+        timeout.write_timeout_constant = 0;
+        timeout.write_timeout_multiplier = 0;
+        port.device->serial()->setTimeout(timeout);
+    }
+
+    port.client.fd = fd;
+    port.client.events = 0;
+    port.serial.fd = port.device->serial()->getFd();
+    port.serial.events = 0;
+
+    port.toClient.clear();
+    port.toSerial.clear();
+    port.parseState = Port::PARSE_DATA;
+    port.subnegotiation.clear();
+    port.suspended = false;
+    port.modemStateMask = 0xFF;
+    port.lineStateMask = 0;
+    port.modemState = 0;
+
+    epoll_event event;
+    event.events = 0;
+    event.data.ptr = &port.client;
+    ::epoll_ctl(_epoll, EPOLL_CTL_ADD, port.client.fd, &event);
+    event.data.ptr = &port.serial;
+    ::epoll_ctl(_epoll, EPOLL_CTL_ADD, port.serial.fd, &event);
+
+    if (port.mode == MODE_RFC2217)
+    {
+        // Offer binary transmission, no go-aheads and com port control in
+        // both directions. Answers that agree need no reply.
+        static const uint8_t options[] = {
+            serial::rfc2217::option_binary,
+            serial::rfc2217::option_suppress_go_ahead,
+            serial::rfc2217::option_com_port
+        };
+
+        port.local.reset();
+        port.remote.reset();
+
+        for (uint8_t option: options)
+        {
+            const uint8_t request[] = {
+                serial::rfc2217::telnet_iac, serial::rfc2217::telnet_will, option,
+                serial::rfc2217::telnet_iac, serial::rfc2217::telnet_do, option
+            };
+
+            port.toClient.buffer.insert(port.toClient.buffer.end(), request, request + sizeof(request));
+            port.local.set(option);
+            port.remote.set(option);
+        }
+
+        // Clients wait for a first modem state before reporting any lines.
+        port.modemState = readModemState(port);
+        uint8_t state = port.modemState & port.modemStateMask;
+        reply(port, serial::rfc2217::notify_modemstate, &state, 1);
+    }
+
+    ++_clientCount;
+
+    if (port.mode == MODE_RAW ? pumpRaw(port) : pumpTelnet(port))
+    {
+        updateInterest(port);
+    }
+    else
+    {
+        disconnect(port);
+    }
+}
+
+
+void RFC2217Server::disconnect(Port& port)
+{
+    if (port.client.fd == -1)
+    {
+        return;
+    }
+
+    ::epoll_ctl(_epoll, EPOLL_CTL_DEL, port.client.fd, nullptr);
+    ::epoll_ctl(_epoll, EPOLL_CTL_DEL, port.serial.fd, nullptr);
+
+    closeFd(port.client.fd);
+    port.serial.fd = -1;
+
+    closePipe(port.toClient.pipe);
+    closePipe(port.toSerial.pipe);
+
+    if (port.mode == MODE_RFC2217 && port.device->serial() != nullptr)
+    {
+        port.device->serial()->setTimeout(port.timeout);
+    }
+
+    --_clientCount;
+}
+
+
+bool RFC2217Server::pumpRaw(Port& port)
+{
+    return transfer(port.toSerial, port.client.fd, port.serial.fd, true, _splicedBytes, _copiedBytes)
+        && transfer(port.toClient, port.serial.fd, port.client.fd, false, _splicedBytes, _copiedBytes);
+}
+
+
+bool RFC2217Server::pumpTelnet(Port& port)
+{
+    uint8_t buffer[BUFFER_SIZE];
+
+    // From the client to the device. Replies are queued for the client.
+    for (int i = 0; i < MAX_TRANSFERS_PER_EVENT; ++i)
+    {
+        Port::Flow& flow = port.toSerial;
+
+        if (flow.pending())
+        {
+            serial::IOResult result = port.device->tryWriteBytes(flow.buffer.data() + flow.offset, flow.buffer.size() - flow.offset);
+
+            if (!result.ok())
+            {
+                ofLogError("RFC2217Server::pumpTelnet") << "Unable to write to " << port.device->port() << ": " << result.message();
+                return false;
+            }
+
+            flow.offset += result.bytes;
+            _copiedBytes += result.bytes;
+
+            if (flow.pending())
+            {
+                break;
+            }
+        }
+
+        flow.buffer.clear();
+        flow.offset = 0;
+
+        ssize_t count = ::recv(port.client.fd, buffer, sizeof(buffer), 0);
+
+        if (count <= 0)
+        {
+            if (count < 0 && wouldBlock())
+            {
+                break;
+            }
+
+            return false;
+        }
+
+        parse(port, buffer, count);
+    }
+
+    // From the device to the client, escaping IAC bytes.
+    for (int i = 0; i < MAX_TRANSFERS_PER_EVENT; ++i)
+    {
+        Port::Flow& flow = port.toClient;
+
+        if (flow.pending())
+        {
+            ssize_t count = writeFd(port.client.fd, flow.buffer.data() + flow.offset, flow.buffer.size() - flow.offset, true);
+
+            if (count < 0)
+            {
+                if (wouldBlock())
+                {
+                    break;
+                }
+
+                return false;
+            }
+
+            flow.offset += count;
+
+            if (flow.pending())
+            {
+                break;
+            }
+        }
+
+        flow.buffer.clear();
+        flow.offset = 0;
+
+        if (port.suspended)
+        {
+            break;
+        }
+
+        std::size_t available = 0;
+
+        try
+        {
+            available = std::min<std::size_t>(port.device->available(), sizeof(buffer));
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogError("RFC2217Server::pumpTelnet") << "Unable to read from " << port.device->port() << ": " << exc.what();
+            return false;
+        }
+
+        if (available == 0)
+        {
+            break;
+        }
+
+        serial::IOResult result = port.device->tryReadBytes(buffer, available);
+
+        if (!result.ok())
+        {
+            ofLogError("RFC2217Server::pumpTelnet") << "Unable to read from " << port.device->port() << ": " << result.message();
+            return false;
+        }
+
+        for (std::size_t j = 0; j < result.bytes; ++j)
+        {
+            flow.buffer.push_back(buffer[j]);
+
+            if (buffer[j] == serial::rfc2217::telnet_iac)
+            {
+                flow.buffer.push_back(buffer[j]);
+            }
+        }
+
+        _copiedBytes += result.bytes;
+    }
+
+    return true;
+}
+
+
+void RFC2217Server::parse(Port& port, const uint8_t* data, std::size_t size)
+{
+    using namespace serial::rfc2217;
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        uint8_t byte = data[i];
+
+        switch (port.parseState)
+        {
+            case Port::PARSE_DATA:
+                if (byte == telnet_iac)
+                {
+                    port.parseState = Port::PARSE_IAC;
+                }
+                else
+                {
+                    port.toSerial.buffer.push_back(byte);
+                }
+                break;
+            case Port::PARSE_IAC:
+                if (byte == telnet_iac)
+                {
+                    port.toSerial.buffer.push_back(byte);
+                    port.parseState = Port::PARSE_DATA;
+                }
+                else if (byte >= telnet_will && byte <= telnet_dont)
+                {
+                    port.command = byte;
+                    port.parseState = Port::PARSE_OPTION;
+                }
+                else if (byte == telnet_sb)
+                {
+                    port.subnegotiation.clear();
+                    port.parseState = Port::PARSE_SUBNEGOTIATION;
+                }
+                else
+                {
+                    // NOP and the other commands have no meaning here.
+                    port.parseState = Port::PARSE_DATA;
+                }
+                break;
+            case Port::PARSE_OPTION:
+                negotiate(port, port.command, byte);
+                port.parseState = Port::PARSE_DATA;
+                break;
+            case Port::PARSE_SUBNEGOTIATION:
+                if (byte == telnet_iac)
+                {
+                    port.parseState = Port::PARSE_SUBNEGOTIATION_IAC;
+                }
+                else if (port.subnegotiation.size() < MAX_SUBNEGOTIATION_SIZE)
+                {
+                    port.subnegotiation.push_back(byte);
+                }
+                break;
+            case Port::PARSE_SUBNEGOTIATION_IAC:
+                if (byte == telnet_iac)
+                {
+                    if (port.subnegotiation.size() < MAX_SUBNEGOTIATION_SIZE)
+                    {
+                        port.subnegotiation.push_back(byte);
+                    }
+
+                    port.parseState = Port::PARSE_SUBNEGOTIATION;
+                }
+                else
+                {
+                    if (byte == telnet_se)
+                    {
+                        subnegotiate(port);
+                    }
+
+                    port.parseState = Port::PARSE_DATA;
+                }
+                break;
+        }
+    }
+}
+
+
+void RFC2217Server::negotiate(Port& port, uint8_t command, uint8_t option)
+{
+    using namespace serial::rfc2217;
+
+    bool supported = option == option_binary
+                  || option == option_suppress_go_ahead
+                  || option == option_com_port;
+
+    // Reply only when the state changes, so negotiations cannot loop.
+    uint8_t answer = 0;
+
+    switch (command)
+    {
+        case telnet_do:
+            if (!supported)
+            {
+                answer = telnet_wont;
+            }
+            else if (!port.local.test(option))
+            {
+                port.local.set(option);
+                answer = telnet_will;
+            }
+            break;
+        case telnet_dont:
+            if (port.local.test(option))
+            {
+                port.local.reset(option);
+                answer = telnet_wont;
+            }
+            break;
+        case telnet_will:
+            if (!supported)
+            {
+                answer = telnet_dont;
+            }
+            else if (!port.remote.test(option))
+            {
+                port.remote.set(option);
+                answer = telnet_do;
+            }
+            break;
+        case telnet_wont:
+            if (port.remote.test(option))
+            {
+                port.remote.reset(option);
+                answer = telnet_dont;
+            }
+            break;
+    }
+
+    if (answer != 0)
+    {
+        const uint8_t reply[] = { telnet_iac, answer, option };
+        port.toClient.buffer.insert(port.toClient.buffer.end(), reply, reply + sizeof(reply));
+    }
+}
+
+
+void RFC2217Server::subnegotiate(Port& port)
+{
+    using namespace serial::rfc2217;
+
+    const std::vector<uint8_t>& request = port.subnegotiation;
+
+    if (request.size() < 2 || request[0] != option_com_port)
+    {
+        return;
+    }
+
+    uint8_t command = request[1];
+    const uint8_t* value = request.data() + 2;
+    std::size_t size = request.size() - 2;
+    uint8_t byte = size > 0 ? value[0] : 0;
+
+    serial::Serial* device = port.device->serial();
+
+    if (device == nullptr)
+    {
+        return;
+    }
+
+    // Every request is answered with the resulting setting, so a change
+    // the port rejects is reported rather than left unanswered.
+    auto apply = [&](const std::function<void()>& change)
+    {
+        try
+        {
+            change();
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogWarning("RFC2217Server::subnegotiate") << "Unable to apply command " << int(command) << " to " << port.device->port() << ": " << exc.what();
+        }
+    };
+
+    switch (command)
+    {
+        case signature:
+        {
+            std::string text = "ofxSerial " + port.device->port();
+            reply(port, command, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+            break;
+        }
+        case set_baudrate:
+        {
+            uint32_t baudRate = size >= 4 ? uint32_t(value[0]) << 24 | uint32_t(value[1]) << 16 | uint32_t(value[2]) << 8 | value[3] : 0;
+
+            if (baudRate != 0)
+            {
+                apply([&] { device->setBaudrate(baudRate); });
+            }
+
+            baudRate = device->getBaudrate();
+            const uint8_t answer[] = {
+                uint8_t(baudRate >> 24), uint8_t(baudRate >> 16), uint8_t(baudRate >> 8), uint8_t(baudRate)
+            };
+            reply(port, command, answer, sizeof(answer));
+            break;
+        }
+        case set_datasize:
+        {
+            if (byte >= serial::fivebits && byte <= serial::eightbits)
+            {
+                apply([&] { device->setBytesize(static_cast<serial::bytesize_t>(byte)); });
+            }
+
+            uint8_t answer = static_cast<uint8_t>(device->getBytesize());
+            reply(port, command, &answer, 1);
+            break;
+        }
+        case set_parity:
+        {
+            if (byte != parity_request)
+            {
+                apply([&] { device->setParity(from_parity_value(byte)); });
+            }
+
+            uint8_t answer = to_parity_value(device->getParity());
+            reply(port, command, &answer, 1);
+            break;
+        }
+        case set_stopsize:
+        {
+            if (byte != stopsize_request)
+            {
+                apply([&] { device->setStopbits(from_stopsize_value(byte)); });
+            }
+
+            uint8_t answer = to_stopsize_value(device->getStopbits());
+            reply(port, command, &answer, 1);
+            break;
+        }
+        case set_control:
+        {
+            uint8_t answer = byte;
+
+            switch (byte)
+            {
+                case control_flow_none:
+                case control_flow_software:
+                case control_flow_hardware:
+                    apply([&] { device->setFlowcontrol(from_flow_value(byte)); });
+                    answer = to_flow_value(device->getFlowcontrol());
+                    break;
+                case control_flow_request:
+                    answer = to_flow_value(device->getFlowcontrol());
+                    break;
+                case control_break_on:
+                case control_break_off:
+                    apply([&] { device->setBreak(byte == control_break_on); port.breakState = byte == control_break_on; });
+                    answer = port.breakState ? control_break_on : control_break_off;
+                    break;
+                case control_break_request:
+                    answer = port.breakState ? control_break_on : control_break_off;
+                    break;
+                case control_dtr_on:
+                case control_dtr_off:
+                    apply([&] { device->setDTR(byte == control_dtr_on); port.dtrState = byte == control_dtr_on; });
+                    answer = port.dtrState ? control_dtr_on : control_dtr_off;
+                    break;
+                case control_dtr_request:
+                    answer = port.dtrState ? control_dtr_on : control_dtr_off;
+                    break;
+                case control_rts_on:
+                case control_rts_off:
+                    apply([&] { device->setRTS(byte == control_rts_on); port.rtsState = byte == control_rts_on; });
+                    answer = port.rtsState ? control_rts_on : control_rts_off;
+                    break;
+                case control_rts_request:
+                    answer = port.rtsState ? control_rts_on : control_rts_off;
+                    break;
+            }
+
+            reply(port, command, &answer, 1);
+            break;
+        }
+        case notify_linestate:
+        {
+            // Line state events are not reported.
+            uint8_t answer = 0;
+            reply(port, command, &answer, 1);
+            break;
+        }
+        case notify_modemstate:
+        {
+            // Some clients poll the modem lines with this request.
+            uint8_t answer = readModemState(port) & port.modemStateMask;
+            reply(port, command, &answer, 1);
+            break;
+        }
+        case flowcontrol_suspend:
+        case flowcontrol_resume:
+            port.suspended = command == flowcontrol_suspend;
+            reply(port, command, nullptr, 0);
+            break;
+        case set_linestate_mask:
+            port.lineStateMask = byte;
+            reply(port, command, &byte, 1);
+            break;
+        case set_modemstate_mask:
+            port.modemStateMask = byte;
+            reply(port, command, &byte, 1);
+            break;
+        case purge_data:
+            apply([&]
+            {
+                if (byte == purge_receive || byte == purge_both)
+                {
+                    device->flushInput();
+                }
+
+                if (byte == purge_transmit || byte == purge_both)
+                {
+                    device->flushOutput();
+                }
+            });
+
+            reply(port, command, &byte, 1);
+            break;
+    }
+}
+
+
+void RFC2217Server::reply(Port& port, uint8_t command, const uint8_t* value, std::size_t size)
+{
+    using namespace serial::rfc2217;
+
+    std::vector<uint8_t>& buffer = port.toClient.buffer;
+
+    const uint8_t header[] = { telnet_iac, telnet_sb, option_com_port, uint8_t(command + server_offset) };
+    buffer.insert(buffer.end(), header, header + sizeof(header));
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        buffer.push_back(value[i]);
+
+        if (value[i] == telnet_iac)
+        {
+            buffer.push_back(value[i]);
+        }
+    }
+
+    buffer.push_back(telnet_iac);
+    buffer.push_back(telnet_se);
+}
+
+
+void RFC2217Server::pollModemState()
+{
+    using namespace serial::rfc2217;
+
+    for (auto& shared: _ports)
+    {
+        Port& port = *shared;
+
+        if (port.client.fd == -1 || port.mode != MODE_RFC2217 || !port.modemSupported || port.modemStateMask == 0)
+        {
+            continue;
+        }
+
+        uint8_t state = readModemState(port);
+        uint8_t changed = (state ^ port.modemState) & 0xF0;
+
+        if (!port.modemSupported || changed == 0)
+        {
+            continue;
+        }
+
+        // The low bits report which lines changed, except for RI, which
+        // reports its trailing edge.
+        uint8_t delta = (changed >> 4) & ~modemstate_ri_trailing_edge;
+
+        if ((port.modemState & modemstate_ri) && !(state & modemstate_ri))
+        {
+            delta |= modemstate_ri_trailing_edge;
+        }
+
+        port.modemState = state;
+
+        uint8_t notification = (state | delta) & port.modemStateMask;
+
+        if (notification != 0)
+        {
+            // The loop sends it once the client is writable.
+            reply(port, notify_modemstate, &notification, 1);
+            updateInterest(port);
+        }
+    }
+}
+
+
+uint8_t RFC2217Server::readModemState(Port& port)
+{
+    using namespace serial::rfc2217;
+
+    serial::Serial* device = port.device->serial();
+    uint8_t state = 0;
+
+    if (!port.modemSupported || device == nullptr)
+    {
+        return state;
+    }
+
+    try
+    {
+        state |= device->getCTS() ? modemstate_cts : 0;
+        state |= device->getDSR() ? modemstate_dsr : 0;
+        state |= device->getRI() ? modemstate_ri : 0;
+        state |= device->getCD() ? modemstate_cd : 0;
+    }
+    catch (const std::exception& exc)
+    {
+        // E.g. pseudo terminals have no modem lines.
+        ofLogNotice("RFC2217Server::readModemState") << "Modem lines of " << port.device->port() << " are not available: " << exc.what();
+        port.modemSupported = false;
+    }
+
+    return state;
+}
+
+
+void RFC2217Server::updateInterest(Port& port)
+{
+    uint32_t serialEvents = 0;
+    uint32_t clientEvents = 0;
+
+    if (!port.toClient.pending() && !port.suspended)
+    {
+        serialEvents |= EPOLLIN;
+    }
+
+    if (port.toSerial.pending())
+    {
+        serialEvents |= EPOLLOUT;
+    }
+    else
+    {
+        clientEvents |= EPOLLIN;
+    }
+
+    if (port.toClient.pending())
+    {
+        clientEvents |= EPOLLOUT;
+    }
+
+    epoll_event event;
+
+    if (serialEvents != port.serial.events)
+    {
+        port.serial.events = serialEvents;
+        event.events = serialEvents;
+        event.data.ptr = &port.serial;
+        ::epoll_ctl(_epoll, EPOLL_CTL_MOD, port.serial.fd, &event);
+    }
+
+    if (clientEvents != port.client.events)
+    {
+        port.client.events = clientEvents;
+        event.events = clientEvents;
+        event.data.ptr = &port.client;
+        ::epoll_ctl(_epoll, EPOLL_CTL_MOD, port.client.fd, &event);
+    }
+}
+
+
+#endif
+
+
+} } // namespace ofx::IO
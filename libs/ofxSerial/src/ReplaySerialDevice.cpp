@@ -0,0 +1,493 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/ReplaySerialDevice.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+
+namespace ofx {
+namespace IO {
+
+
+constexpr double ReplaySerialDevice::SPEED_UNLIMITED;
+
+
+/// \brief The bytes buffered ahead when playing at SPEED_UNLIMITED.
+static const std::size_t UNLIMITED_PENDING_SIZE = 64 * 1024;
+
+
+/// \brief A port that plays a recording.
+class ReplaySerialDevice::Backend: public serial::SerialBackend
+{
+public:
+    Backend(const std::string& basePath, double speed):
+        _port(basePath),
+        _speed(speed)
+    {
+    }
+
+    void open() override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (!_replay.setup(_port, _speed))
+        {
+            throw serial::IOException(__FILE__, __LINE__, ("Unable to open the recording " + _port).c_str());
+        }
+
+        _isOpen = true;
+    }
+
+    void close() override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _replay.close();
+        _isOpen = false;
+        _condition.notify_all();
+    }
+
+    bool isOpen() const override { return _isOpen; }
+
+    std::size_t available() override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _replay.available();
+    }
+
+    std::size_t outWaiting() override { return 0; }
+
+    uint32_t getByteTime() const override
+    {
+        return serial::Serial::calculateByteTime(_baudrate, _bytesize, _parity, _stopbits);
+    }
+
+    bool waitReadable(uint32_t timeout) override
+    {
+        return wait(AbstractSerialTap::now() + uint64_t(timeout) * 1000000);
+    }
+
+    void waitByteTimes(std::size_t count) override
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(uint64_t(getByteTime()) * count));
+    }
+
+    serial::IOResult tryRead(uint8_t* buffer, std::size_t size) override
+    {
+        if (!_isOpen)
+        {
+            return serial::IOResult(0, serial::io_port_not_open);
+        }
+
+        // Calculate total timeout in milliseconds t_c + (t_m * N)
+        uint64_t now = AbstractSerialTap::now();
+        uint64_t totalMillis = _timeout.read_timeout_constant + uint64_t(_timeout.read_timeout_multiplier) * size;
+        uint64_t deadline = now + totalMillis * 1000000;
+        std::size_t bytesRead = 0;
+
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                bytesRead += _replay.readBytes(buffer + bytesRead, size - bytesRead);
+            }
+
+            now = AbstractSerialTap::now();
+
+            if (bytesRead == size || !_isOpen || now >= deadline)
+            {
+                break;
+            }
+
+            uint64_t interByte = now + uint64_t(_timeout.inter_byte_timeout) * 1000000;
+            wait(std::min(deadline, interByte));
+        }
+
+        return serial::IOResult(bytesRead);
+    }
+
+    serial::IOResult tryWrite(const uint8_t*, std::size_t size) override
+    {
+        if (!_isOpen)
+        {
+            return serial::IOResult(0, serial::io_port_not_open);
+        }
+
+        return serial::IOResult(size);
+    }
+
+    void flush() override {}
+
+    void flushInput() override
+    {
+        // Skip the bytes that are due.
+        std::unique_lock<std::mutex> lock(_mutex);
+        uint8_t buffer[1024];
+        while (_replay.readBytes(buffer, sizeof(buffer)) > 0);
+    }
+
+    void flushOutput() override {}
+
+    // A recording has no output and no modem lines to change.
+    void sendBreak(int) override {}
+    void setBreak(bool) override {}
+    void setRTS(bool) override {}
+    void setDTR(bool) override {}
+
+    bool waitForChange() override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [&]() { return !_isOpen; });
+        return false;
+    }
+
+    bool getCTS() override { return true; }
+    bool getDSR() override { return true; }
+    bool getRI() override { return false; }
+    bool getCD() override { return true; }
+
+    void setPort(const std::string& port) override { _port = port; }
+    std::string getPort() const override { return _port; }
+    int getFd() const override { return -1; }
+    void setTimeout(serial::Timeout& timeout) override { _timeout = timeout; }
+    serial::Timeout getTimeout() const override { return _timeout; }
+    void setBaudrate(unsigned long baudrate) override { _baudrate = baudrate; }
+    unsigned long getBaudrate() const override { return _baudrate; }
+    void setBytesize(serial::bytesize_t bytesize) override { _bytesize = bytesize; }
+    serial::bytesize_t getBytesize() const override { return _bytesize; }
+    void setParity(serial::parity_t parity) override { _parity = parity; }
+    serial::parity_t getParity() const override { return _parity; }
+    void setStopbits(serial::stopbits_t stopbits) override { _stopbits = stopbits; }
+    serial::stopbits_t getStopbits() const override { return _stopbits; }
+    void setFlowcontrol(serial::flowcontrol_t flowcontrol) override { _flowcontrol = flowcontrol; }
+    serial::flowcontrol_t getFlowcontrol() const override { return _flowcontrol; }
+    bool setLowLatency(bool) override { return false; }
+    bool getLowLatency() const override { return false; }
+    void readLock() override { _readMutex.lock(); }
+    void readUnlock() override { _readMutex.unlock(); }
+    void writeLock() override { _writeMutex.lock(); }
+    void writeUnlock() override { _writeMutex.unlock(); }
+
+private:
+    /// \brief Wait until recorded bytes are due or the port closes.
+    /// \param deadline The monotonic time to give up waiting.
+    /// \returns true if there is something to read.
+    bool wait(uint64_t deadline)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        for (;;)
+        {
+            uint64_t due = _replay.nanosUntilAvailable();
+            uint64_t now = AbstractSerialTap::now();
+
+            if (due == 0 || !_isOpen || now >= deadline)
+            {
+                return due == 0 && _isOpen;
+            }
+
+            // The lock is released while waiting, so closes go through.
+            _condition.wait_for(lock, std::chrono::nanoseconds(std::min(due, deadline - now)));
+        }
+    }
+
+    std::string _port;
+    double _speed = 1;
+    ReplaySerialDevice _replay;
+    std::atomic<bool> _isOpen { false };
+    serial::Timeout _timeout;
+    unsigned long _baudrate = 9600;
+    serial::bytesize_t _bytesize = serial::eightbits;
+    serial::parity_t _parity = serial::parity_none;
+    serial::stopbits_t _stopbits = serial::stopbits_one;
+    serial::flowcontrol_t _flowcontrol = serial::flowcontrol_none;
+
+    /// \brief Guards the recording.
+    std::mutex _mutex;
+
+    /// \brief Signalled when the port closes.
+    std::condition_variable _condition;
+
+    std::mutex _readMutex;
+    std::mutex _writeMutex;
+};
+
+
+ReplaySerialDevice::ReplaySerialDevice()
+{
+}
+
+
+ReplaySerialDevice::~ReplaySerialDevice()
+{
+}
+
+
+bool ReplaySerialDevice::setup(const std::vector<std::string>& paths,
+                               double speed)
+{
+    close();
+
+    _speed = std::max(speed, 0.0);
+
+    if (!_reader.setup(paths))
+    {
+        return false;
+    }
+
+    rewind();
+    return true;
+}
+
+
+bool ReplaySerialDevice::setup(const std::string& basePath, double speed)
+{
+    return setup(SerialCaptureLog::listFiles(basePath), speed);
+}
+
+
+void ReplaySerialDevice::close()
+{
+    _reader.close();
+    _hasRecord = false;
+    _pending.clear();
+    _pendingOffset = 0;
+    _bytesWritten = 0;
+}
+
+
+void ReplaySerialDevice::rewind()
+{
+    _reader.rewind();
+    _pending.clear();
+    _pendingOffset = 0;
+
+    nextRecord();
+
+    _baseTimestamp = _hasRecord ? _record.timestampNanos : 0;
+    _baseNanos = AbstractSerialTap::now();
+}
+
+
+void ReplaySerialDevice::setSpeed(double speed)
+{
+    if (_speed == SPEED_UNLIMITED)
+    {
+        // Continue from the next record rather than the end.
+        _baseTimestamp = _hasRecord ? _record.timestampNanos : _baseTimestamp;
+    }
+    else
+    {
+        _baseTimestamp = position();
+    }
+
+    _baseNanos = AbstractSerialTap::now();
+    _speed = std::max(speed, 0.0);
+}
+
+
+double ReplaySerialDevice::speed() const
+{
+    return _speed;
+}
+
+
+bool ReplaySerialDevice::isFinished() const
+{
+    return available() == 0 && !_hasRecord;
+}
+
+
+uint64_t ReplaySerialDevice::bytesWritten() const
+{
+    return _bytesWritten;
+}
+
+
+uint64_t ReplaySerialDevice::nanosUntilAvailable() const
+{
+    if (available() > 0)
+    {
+        return 0;
+    }
+
+    if (!_hasRecord)
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    // advance() took every record at SPEED_UNLIMITED, and every record
+    // up to the position otherwise, so the next one is in the future.
+    uint64_t recorded = _record.timestampNanos - position();
+    return static_cast<uint64_t>(recorded / _speed) + 1;
+}
+
+
+bool ReplaySerialDevice::waitReadable(uint32_t timeoutMillis)
+{
+    uint64_t due = nanosUntilAvailable();
+
+    if (due == 0)
+    {
+        return true;
+    }
+
+    std::this_thread::sleep_for(std::chrono::nanoseconds(std::min(due, uint64_t(timeoutMillis) * 1000000)));
+    return available() > 0;
+}
+
+
+std::shared_ptr<serial::Serial> ReplaySerialDevice::openPort(const std::string& basePath,
+                                                             double speed,
+                                                             SerialDevice::ThreadingMode threadingMode)
+{
+    try
+    {
+        auto port = std::make_shared<serial::Serial>(new Backend(basePath, speed),
+                                                     static_cast<serial::threadingmode_t>(threadingMode));
+        port->open();
+        return port;
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("ReplaySerialDevice::openPort") << exc.what();
+        return nullptr;
+    }
+}
+
+
+std::size_t ReplaySerialDevice::readBytes(uint8_t* buffer, std::size_t size)
+{
+    advance();
+
+    std::size_t count = std::min(size, _pending.size() - _pendingOffset);
+    std::memcpy(buffer, _pending.data() + _pendingOffset, count);
+    _pendingOffset += count;
+
+    if (_pendingOffset == _pending.size())
+    {
+        _pending.clear();
+        _pendingOffset = 0;
+    }
+
+    return count;
+}
+
+
+std::size_t ReplaySerialDevice::readByte(uint8_t& data)
+{
+    return readBytes(&data, 1);
+}
+
+
+std::size_t ReplaySerialDevice::available() const
+{
+    advance();
+    return _pending.size() - _pendingOffset;
+}
+
+
+std::size_t ReplaySerialDevice::writeByte(uint8_t data)
+{
+    return writeBytes(&data, 1);
+}
+
+
+std::size_t ReplaySerialDevice::writeBytes(const uint8_t*, std::size_t size)
+{
+    _bytesWritten += size;
+    return size;
+}
+
+
+std::size_t ReplaySerialDevice::writeBytes(const std::vector<uint8_t>& buffer)
+{
+    return writeBytes(buffer.data(), buffer.size());
+}
+
+
+std::size_t ReplaySerialDevice::writeBytes(const std::string& buffer)
+{
+    return writeBytes(reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size());
+}
+
+
+std::size_t ReplaySerialDevice::writeBytes(const AbstractByteSource& buffer)
+{
+    return writeBytes(buffer.readBytes());
+}
+
+
+void ReplaySerialDevice::advance() const
+{
+    if (!_hasRecord)
+    {
+        return;
+    }
+
+    // Drop the bytes already read before appending more.
+    if (_pendingOffset > 0)
+    {
+        _pending.erase(_pending.begin(), _pending.begin() + _pendingOffset);
+        _pendingOffset = 0;
+    }
+
+    if (_speed == SPEED_UNLIMITED)
+    {
+        while (_hasRecord && _pending.size() < UNLIMITED_PENDING_SIZE)
+        {
+            _pending.insert(_pending.end(), _record.data, _record.data + _record.size);
+            nextRecord();
+        }
+    }
+    else
+    {
+        uint64_t now = position();
+
+        while (_hasRecord && _record.timestampNanos <= now)
+        {
+            _pending.insert(_pending.end(), _record.data, _record.data + _record.size);
+            nextRecord();
+        }
+    }
+}
+
+
+bool ReplaySerialDevice::nextRecord() const
+{
+    // Only the bytes the recorded device read are played back.
+    while ((_hasRecord = _reader.next(_record)))
+    {
+        if (_record.direction == AbstractSerialTap::DIRECTION_RX)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+uint64_t ReplaySerialDevice::position() const
+{
+    if (_speed == SPEED_UNLIMITED)
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    uint64_t elapsed = AbstractSerialTap::now() - _baseNanos;
+    return _baseTimestamp + static_cast<uint64_t>(elapsed * _speed);
+}
+
+
+} } // namespace ofx::IO
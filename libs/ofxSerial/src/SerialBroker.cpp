@@ -0,0 +1,841 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/SerialBroker.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "ofLog.h"
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+
+namespace ofx {
+namespace IO {
+
+
+#if !defined(_WIN32)
+
+
+/// \brief The first page of the ring, written only by the broker.
+///
+/// Frames are written at increasing positions; the byte at a position is at
+/// data[position % capacity]. A frame is written in three steps: reserved
+/// moves past its end, the frame is copied, then head moves past its end.
+/// Readers copy a frame, then check that reserved is not a whole ring past
+/// it, much like a seqlock.
+struct RingHeader
+{
+    /// \brief Identifies the shared memory as a ring.
+    char magic[8];
+
+    /// \brief The version of this layout.
+    uint32_t version;
+
+    /// \brief Not zero once the broker closed the ring.
+    std::atomic<uint32_t> closed;
+
+    /// \brief The size of the data, a power of two.
+    uint64_t capacity;
+
+    /// \brief The end of the frame being written.
+    alignas(64) std::atomic<uint64_t> reserved;
+
+    /// \brief The oldest frame that was not overwritten.
+    std::atomic<uint64_t> tail;
+
+    /// \brief The end of the last frame written.
+    alignas(64) std::atomic<uint64_t> head;
+
+    /// \brief Incremented after each frame; readers wait on it.
+    std::atomic<uint32_t> sequence;
+};
+
+
+/// \brief The second page of the ring, written by readers.
+struct RingWaiters
+{
+    /// \brief The number of readers waiting for a frame.
+    std::atomic<uint32_t> count;
+};
+
+
+/// \brief The header in front of each frame.
+struct FrameHeader
+{
+    uint32_t size;
+    uint32_t direction;
+    uint64_t timestampNanos;
+};
+
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "The ring needs lock free atomics.");
+static_assert(sizeof(FrameHeader) == 16, "Unexpected FrameHeader padding.");
+
+
+static const char RING_MAGIC[8] = { 'O', 'F', 'X', 'S', 'R', 'N', 'G', '\0' };
+static const uint32_t RING_VERSION = 1;
+
+/// \brief Frames start at multiples of this.
+static const uint64_t FRAME_ALIGNMENT = 8;
+
+
+static uint64_t frameSpace(uint64_t size)
+{
+    return sizeof(FrameHeader) + (size + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+}
+
+
+static std::size_t pageSize()
+{
+    return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+
+struct SerialBroker::Ring
+{
+    /// \brief Map the shared memory.
+    ///
+    /// The data is mapped twice, back to back, so that frames wrapping
+    /// around the end of the ring can be used in place.
+    ///
+    /// \param fd The shared memory.
+    /// \param capacity The size of the data.
+    /// \param broker True to map everything writable.
+    /// \returns the ring or nullptr.
+    static Ring* map(int fd, uint64_t capacity, bool broker)
+    {
+        std::size_t page = pageSize();
+        std::size_t size = 2 * page + 2 * capacity;
+
+        void* mapping = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (mapping == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        uint8_t* base = static_cast<uint8_t*>(mapping);
+        int headerProtection = broker ? PROT_READ | PROT_WRITE : PROT_READ;
+        int dataProtection = headerProtection;
+
+        if (mmap(base, page, headerProtection, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+         || mmap(base + page, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, page) == MAP_FAILED
+         || mmap(base + 2 * page, capacity, dataProtection, MAP_SHARED | MAP_FIXED, fd, 2 * page) == MAP_FAILED
+         || mmap(base + 2 * page + capacity, capacity, dataProtection, MAP_SHARED | MAP_FIXED, fd, 2 * page) == MAP_FAILED)
+        {
+            munmap(mapping, size);
+            return nullptr;
+        }
+
+        Ring* ring = new Ring();
+        ring->mapping = mapping;
+        ring->mappingSize = size;
+        ring->header = reinterpret_cast<RingHeader*>(base);
+        ring->waiters = reinterpret_cast<RingWaiters*>(base + page);
+        ring->data = base + 2 * page;
+        ring->capacity = capacity;
+        return ring;
+    }
+
+    ~Ring()
+    {
+        munmap(mapping, mappingSize);
+    }
+
+    /// \returns the frame at a position.
+    FrameHeader frameAt(uint64_t position) const
+    {
+        FrameHeader frame;
+        std::memcpy(&frame, data + (position & (capacity - 1)), sizeof(frame));
+        return frame;
+    }
+
+    /// \brief Wake the readers waiting for a frame.
+    void notify()
+    {
+        header->sequence.fetch_add(1);
+
+        if (waiters->count.load() > 0)
+        {
+#if defined(__linux__)
+            syscall(SYS_futex, &header->sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+        }
+    }
+
+    /// \brief The whole mapping.
+    void* mapping = nullptr;
+
+    /// \brief The size of the mapping.
+    std::size_t mappingSize = 0;
+
+    /// \brief The first page.
+    RingHeader* header = nullptr;
+
+    /// \brief The second page.
+    RingWaiters* waiters = nullptr;
+
+    /// \brief The data, mapped twice.
+    uint8_t* data = nullptr;
+
+    /// \brief The size of the data.
+    uint64_t capacity = 0;
+};
+
+
+SerialBroker::SerialBroker(): _frameCount(0), _droppedBytes(0)
+{
+}
+
+
+SerialBroker::~SerialBroker()
+{
+    close();
+}
+
+
+bool SerialBroker::setup(const std::string& name, std::size_t capacity)
+{
+    close();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    uint64_t size = pageSize();
+
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+
+    std::string path = "/" + name;
+
+    // Replace a ring left behind by a broker that did not close.
+    shm_unlink(path.c_str());
+
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if (fd < 0)
+    {
+        ofLogError("SerialBroker::setup") << "Unable to create " << path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    Ring* ring = nullptr;
+
+    if (ftruncate(fd, 2 * pageSize() + size) == 0)
+    {
+        ring = Ring::map(fd, size, true);
+    }
+
+    int error = errno;
+    ::close(fd);
+
+    if (!ring)
+    {
+        ofLogError("SerialBroker::setup") << "Unable to map " << path << ": " << std::strerror(error);
+        shm_unlink(path.c_str());
+        return false;
+    }
+
+    // A new shared memory object is zeroed, so only the constants are set.
+    std::memcpy(ring->header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+    ring->header->version = RING_VERSION;
+    ring->header->capacity = size;
+
+    _ring = ring;
+    _name = name;
+    _frameCount = 0;
+    _droppedBytes = 0;
+    return true;
+}
+
+
+void SerialBroker::close()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_ring)
+    {
+        _ring->header->closed.store(1);
+        _ring->notify();
+        shm_unlink(("/" + _name).c_str());
+        delete _ring;
+        _ring = nullptr;
+    }
+}
+
+
+bool SerialBroker::isOpen() const
+{
+    return _ring != nullptr;
+}
+
+
+void SerialBroker::tap(Direction direction,
+                       uint64_t timestampNanos,
+                       const uint8_t* data,
+                       std::size_t size)
+{
+    publish(direction, timestampNanos, data, size);
+}
+
+
+bool SerialBroker::publish(Direction direction,
+                           uint64_t timestampNanos,
+                           const uint8_t* data,
+                           std::size_t size)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (!_ring)
+    {
+        return false;
+    }
+
+    if (size > maximumFrameSize())
+    {
+        _droppedBytes += size;
+        return false;
+    }
+
+    RingHeader* header = _ring->header;
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    uint64_t end = head + frameSpace(size);
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+
+    // Give up the oldest frames to make room.
+    while (end - tail > _ring->capacity)
+    {
+        tail += frameSpace(_ring->frameAt(tail).size);
+    }
+
+    header->tail.store(tail, std::memory_order_relaxed);
+    header->reserved.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    FrameHeader frame;
+    frame.size = static_cast<uint32_t>(size);
+    frame.direction = direction;
+    frame.timestampNanos = timestampNanos;
+
+    uint8_t* target = _ring->data + (head & (_ring->capacity - 1));
+    std::memcpy(target, &frame, sizeof(frame));
+    std::memcpy(target + sizeof(frame), data, size);
+
+    header->head.store(end, std::memory_order_release);
+    _ring->notify();
+
+    ++_frameCount;
+    return true;
+}
+
+
+std::size_t SerialBroker::maximumFrameSize() const
+{
+    return _ring ? _ring->capacity / 2 - sizeof(FrameHeader) : 0;
+}
+
+
+uint64_t SerialBroker::frameCount() const
+{
+    return _frameCount;
+}
+
+
+uint64_t SerialBroker::droppedBytes() const
+{
+    return _droppedBytes;
+}
+
+
+std::string SerialBroker::name() const
+{
+    return _name;
+}
+
+
+SerialBrokerReader::SerialBrokerReader()
+{
+}
+
+
+SerialBrokerReader::~SerialBrokerReader()
+{
+    close();
+}
+
+
+bool SerialBrokerReader::setup(const std::string& name, Filter filter)
+{
+    close();
+
+    std::string path = "/" + name;
+
+    // The second page is written to wait; the rest is mapped read only.
+    int fd = shm_open(path.c_str(), O_RDWR, 0);
+
+    if (fd < 0)
+    {
+        ofLogError("SerialBrokerReader::setup") << "Unable to open " << path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    struct stat status;
+    RingHeader header;
+    uint64_t page = pageSize();
+    bool valid = fstat(fd, &status) == 0
+              && static_cast<uint64_t>(status.st_size) > 2 * page
+              && pread(fd, &header, sizeof(header), 0) == sizeof(header)
+              && std::memcmp(header.magic, RING_MAGIC, sizeof(RING_MAGIC)) == 0
+              && header.version == RING_VERSION
+              && static_cast<uint64_t>(status.st_size) == 2 * page + header.capacity;
+
+    if (!valid)
+    {
+        ::close(fd);
+        ofLogError("SerialBrokerReader::setup") << path << " is not a broker ring.";
+        return false;
+    }
+
+    _ring = SerialBroker::Ring::map(fd, header.capacity, false);
+    ::close(fd);
+
+    if (!_ring)
+    {
+        ofLogError("SerialBrokerReader::setup") << "Unable to map " << path << ".";
+        return false;
+    }
+
+    _filter = filter;
+    _overrunCount = 0;
+    skipToEnd();
+    return true;
+}
+
+
+void SerialBrokerReader::close()
+{
+    delete _ring;
+    _ring = nullptr;
+}
+
+
+bool SerialBrokerReader::isOpen() const
+{
+    return _ring != nullptr;
+}
+
+
+bool SerialBrokerReader::isBrokerClosed() const
+{
+    return _ring && _ring->header->closed.load(std::memory_order_acquire) != 0;
+}
+
+
+std::size_t SerialBrokerReader::readBytes(uint8_t* buffer, std::size_t size)
+{
+    std::size_t count = 0;
+    Frame frame;
+
+    while (count < size && current(frame))
+    {
+        std::size_t n = std::min(size - count, frame.size);
+        std::memcpy(buffer + count, frame.data, n);
+
+        if (!isValid(_position))
+        {
+            resync();
+            continue;
+        }
+
+        count += n;
+
+        if (n == frame.size)
+        {
+            _position += frameSpace(_frameOffset + n);
+            _frameOffset = 0;
+        }
+        else
+        {
+            _frameOffset += n;
+        }
+    }
+
+    return count;
+}
+
+
+std::size_t SerialBrokerReader::readByte(uint8_t& data)
+{
+    return readBytes(&data, 1);
+}
+
+
+std::size_t SerialBrokerReader::available() const
+{
+    Frame frame;
+
+    if (!current(frame))
+    {
+        return 0;
+    }
+
+    std::size_t total = frame.size;
+    uint64_t position = _position + frameSpace(_frameOffset + frame.size);
+    uint64_t head = _ring->header->head.load(std::memory_order_acquire);
+    uint64_t maximumSize = _ring->capacity / 2;
+
+    while (position != head)
+    {
+        FrameHeader next = _ring->frameAt(position);
+
+        // The rest was overwritten; reading will resynchronize.
+        if (!isValid(position) || next.size > maximumSize)
+        {
+            break;
+        }
+
+        if (_filter & (1 << next.direction))
+        {
+            total += next.size;
+        }
+
+        position += frameSpace(next.size);
+    }
+
+    return total;
+}
+
+
+bool SerialBrokerReader::waitReadable(uint32_t timeoutMillis)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    Frame frame;
+
+    for (;;)
+    {
+        if (!_ring)
+        {
+            return false;
+        }
+
+        _ring->waiters->count.fetch_add(1);
+        uint32_t sequence = _ring->header->sequence.load();
+        bool ready = current(frame);
+        bool closed = isBrokerClosed();
+        auto remaining = deadline - std::chrono::steady_clock::now();
+
+        if (!ready && !closed && remaining > std::chrono::nanoseconds::zero())
+        {
+#if defined(__linux__)
+            auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+            struct timespec timeout;
+            timeout.tv_sec = nanos / 1000000000;
+            timeout.tv_nsec = nanos % 1000000000;
+            syscall(SYS_futex, &_ring->header->sequence, FUTEX_WAIT, sequence, &timeout, nullptr, 0);
+#else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+        }
+
+        _ring->waiters->count.fetch_sub(1);
+
+        if (ready || closed || remaining <= std::chrono::nanoseconds::zero())
+        {
+            return ready;
+        }
+    }
+}
+
+
+bool SerialBrokerReader::peek(Frame& frame)
+{
+    return current(frame);
+}
+
+
+bool SerialBrokerReader::next()
+{
+    if (!_ring || _position == _ring->header->head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    FrameHeader frame = _ring->frameAt(_position);
+
+    if (!isValid(_position))
+    {
+        resync();
+        return false;
+    }
+
+    _position += frameSpace(frame.size);
+    _frameOffset = 0;
+    return true;
+}
+
+
+uint64_t SerialBrokerReader::overrunCount() const
+{
+    return _overrunCount;
+}
+
+
+void SerialBrokerReader::skipToEnd()
+{
+    if (_ring)
+    {
+        _position = _ring->header->head.load(std::memory_order_acquire);
+        _frameOffset = 0;
+    }
+}
+
+
+bool SerialBrokerReader::current(Frame& frame) const
+{
+    if (!_ring)
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        uint64_t head = _ring->header->head.load(std::memory_order_acquire);
+
+        if (_position == head)
+        {
+            return false;
+        }
+
+        FrameHeader next = _ring->frameAt(_position);
+
+        if (head - _position > _ring->capacity
+         || !isValid(_position)
+         || next.size > _ring->capacity / 2)
+        {
+            resync();
+            continue;
+        }
+
+        if (!(_filter & (1 << next.direction)))
+        {
+            _position += frameSpace(next.size);
+            _frameOffset = 0;
+            continue;
+        }
+
+        frame.direction = static_cast<AbstractSerialTap::Direction>(next.direction);
+        frame.timestampNanos = next.timestampNanos;
+        frame.data = _ring->data + (_position & (_ring->capacity - 1)) + sizeof(FrameHeader) + _frameOffset;
+        frame.size = next.size - _frameOffset;
+        return true;
+    }
+}
+
+
+bool SerialBrokerReader::isValid(uint64_t position) const
+{
+    // Order the reads of the frame before the check.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return _ring->header->reserved.load(std::memory_order_relaxed) - position <= _ring->capacity;
+}
+
+
+void SerialBrokerReader::resync() const
+{
+    _position = _ring->header->tail.load(std::memory_order_acquire);
+    _frameOffset = 0;
+    ++_overrunCount;
+}
+
+
+#else
+
+
+struct SerialBroker::Ring
+{
+};
+
+
+SerialBroker::SerialBroker(): _frameCount(0), _droppedBytes(0)
+{
+}
+
+
+SerialBroker::~SerialBroker()
+{
+}
+
+
+bool SerialBroker::setup(const std::string&, std::size_t)
+{
+    ofLogError("SerialBroker::setup") << "Not available on Windows.";
+    return false;
+}
+
+
+void SerialBroker::close()
+{
+}
+
+
+bool SerialBroker::isOpen() const
+{
+    return false;
+}
+
+
+void SerialBroker::tap(Direction, uint64_t, const uint8_t*, std::size_t)
+{
+}
+
+
+bool SerialBroker::publish(Direction, uint64_t, const uint8_t*, std::size_t)
+{
+    return false;
+}
+
+
+std::size_t SerialBroker::maximumFrameSize() const
+{
+    return 0;
+}
+
+
+uint64_t SerialBroker::frameCount() const
+{
+    return 0;
+}
+
+
+uint64_t SerialBroker::droppedBytes() const
+{
+    return 0;
+}
+
+
+std::string SerialBroker::name() const
+{
+    return _name;
+}
+
+
+SerialBrokerReader::SerialBrokerReader()
+{
+}
+
+
+SerialBrokerReader::~SerialBrokerReader()
+{
+}
+
+
+bool SerialBrokerReader::setup(const std::string&, Filter)
+{
+    ofLogError("SerialBrokerReader::setup") << "Not available on Windows.";
+    return false;
+}
+
+
+void SerialBrokerReader::close()
+{
+}
+
+
+bool SerialBrokerReader::isOpen() const
+{
+    return false;
+}
+
+
+bool SerialBrokerReader::isBrokerClosed() const
+{
+    return false;
+}
+
+
+std::size_t SerialBrokerReader::readBytes(uint8_t*, std::size_t)
+{
+    return 0;
+}
+
+
+std::size_t SerialBrokerReader::readByte(uint8_t&)
+{
+    return 0;
+}
+
+
+std::size_t SerialBrokerReader::available() const
+{
+    return 0;
+}
+
+
+bool SerialBrokerReader::waitReadable(uint32_t)
+{
+    return false;
+}
+
+
+bool SerialBrokerReader::peek(Frame&)
+{
+    return false;
+}
+
+
+bool SerialBrokerReader::next()
+{
+    return false;
+}
+
+
+uint64_t SerialBrokerReader::overrunCount() const
+{
+    return 0;
+}
+
+
+void SerialBrokerReader::skipToEnd()
+{
+}
+
+
+bool SerialBrokerReader::current(Frame&) const
+{
+    return false;
+}
+
+
+bool SerialBrokerReader::isValid(uint64_t) const
+{
+    return false;
+}
+
+
+void SerialBrokerReader::resync() const
+{
+}
+
+
+#endif
+
+
+} } // namespace ofx::IO
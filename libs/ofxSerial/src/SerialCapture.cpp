@@ -0,0 +1,558 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/SerialCapture.h"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+#include "Poco/File.h"
+#include "Poco/Path.h"
+#include "ofLog.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+static_assert(sizeof(SerialCaptureLog::FileHeader) == 64, "Unexpected FileHeader padding.");
+static_assert(sizeof(SerialCaptureLog::RecordHeader) == 16, "Unexpected RecordHeader padding.");
+
+
+const char SerialCaptureLog::MAGIC[8] = { 'O', 'F', 'X', 'S', 'C', 'A', 'P', '\0' };
+
+
+SerialCaptureLog::SerialCaptureLog(): _droppedBytes(0)
+{
+}
+
+
+SerialCaptureLog::~SerialCaptureLog()
+{
+    close();
+}
+
+
+bool SerialCaptureLog::setup(const std::string& basePath,
+                             std::size_t fileSize,
+                             std::size_t maxFiles)
+{
+    close();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _basePath = basePath;
+    _fileSize = std::max<std::size_t>(fileSize, MIN_FILE_SIZE) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+    _maxFiles = maxFiles;
+    _droppedBytes = 0;
+
+    // Continue after the files of an earlier recording.
+    std::vector<std::string> files = listFiles(basePath);
+    _sequence = files.size();
+
+    if (!files.empty())
+    {
+        std::string last = files.back();
+        std::string sequence = last.substr(_basePath.size() + 1, last.size() - _basePath.size() - 6);
+        _sequence = std::stoull(sequence) + 1;
+    }
+
+    _stopping = false;
+    _thread = std::thread(&SerialCaptureLog::prepareFiles, this);
+
+    return openFile();
+}
+
+
+void SerialCaptureLog::close()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    stopPreparing();
+    _memory = Poco::SharedMemory();
+    _begin = nullptr;
+    _offset = 0;
+}
+
+
+bool SerialCaptureLog::isOpen() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _begin != nullptr;
+}
+
+
+void SerialCaptureLog::tap(Direction direction,
+                           uint64_t timestampNanos,
+                           const uint8_t* data,
+                           std::size_t size)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (size > 0)
+    {
+        if (_begin == nullptr)
+        {
+            _droppedBytes += size;
+            return;
+        }
+
+        std::size_t available = _fileSize - _offset;
+
+        if (available < sizeof(RecordHeader) + RECORD_ALIGNMENT)
+        {
+            ++_sequence;
+
+            if (!openFile())
+            {
+                _droppedBytes += size;
+                return;
+            }
+
+            continue;
+        }
+
+        // Split payloads that do not fit into the rest of the file.
+        std::size_t count = std::min(size, available - sizeof(RecordHeader));
+
+        RecordHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.direction = static_cast<uint8_t>(direction);
+        header.timestampNanos = timestampNanos;
+
+        uint8_t* record = _begin + _offset;
+        std::memcpy(record, &header, sizeof(header));
+        std::memcpy(record + sizeof(header), data, count);
+
+        // The size marks the record as complete, so write it last.
+        uint32_t recordSize = static_cast<uint32_t>(count);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(record + offsetof(RecordHeader, size), &recordSize, sizeof(recordSize));
+
+        _offset += (sizeof(header) + count + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+        data += count;
+        size -= count;
+    }
+}
+
+
+uint64_t SerialCaptureLog::droppedBytes() const
+{
+    return _droppedBytes;
+}
+
+
+std::vector<std::string> SerialCaptureLog::listFiles(const std::string& basePath)
+{
+    Poco::Path path(basePath);
+    std::string prefix = path.getFileName() + ".";
+    const std::string suffix = ".scap";
+
+    Poco::Path directory(path);
+    directory.makeParent();
+
+    std::vector<std::string> names;
+
+    try
+    {
+        Poco::File(directory.toString().empty() ? "." : directory.toString()).list(names);
+    }
+    catch (const Poco::Exception&)
+    {
+        return std::vector<std::string>();
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> files;
+
+    for (const auto& name: names)
+    {
+        if (name.size() <= prefix.size() + suffix.size()
+         || name.compare(0, prefix.size(), prefix) != 0
+         || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+        {
+            continue;
+        }
+
+        std::string sequence = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+
+        if (std::all_of(sequence.begin(), sequence.end(), ::isdigit))
+        {
+            files.push_back(std::make_pair(std::stoull(sequence), filePath(basePath, std::stoull(sequence))));
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::string> paths;
+
+    for (const auto& file: files)
+    {
+        paths.push_back(file.second);
+    }
+
+    return paths;
+}
+
+
+std::string SerialCaptureLog::filePath(const std::string& basePath, uint64_t sequence)
+{
+    std::stringstream ss;
+    ss << basePath << "." << std::setw(6) << std::setfill('0') << sequence << ".scap";
+    return ss.str();
+}
+
+
+bool SerialCaptureLog::openFile()
+{
+    Poco::SharedMemory memory;
+
+    {
+        std::unique_lock<std::mutex> spareLock(_spareMutex);
+
+        // The file thread unmaps the full file.
+        if (_begin != nullptr)
+        {
+            _retired.emplace_back();
+            _retired.back().swap(_memory);
+        }
+
+        _begin = nullptr;
+        _offset = 0;
+
+        // Only wait if the file thread is still preparing this file, i.e.
+        // if the files fill faster than they can be created.
+        _spareCondition.wait(spareLock, [&]() {
+            return !_spareWanted || _spareSequence != _sequence || !_thread.joinable();
+        });
+
+        if (_spareReady && _spareSequence == _sequence)
+        {
+            memory.swap(_spare);
+        }
+
+        _spare = Poco::SharedMemory();
+        _spareReady = false;
+        _spareSequence = _sequence + 1;
+        _spareWanted = _thread.joinable();
+    }
+
+    _spareCondition.notify_all();
+
+    if (memory.begin() == nullptr && !createFile(_sequence, memory))
+    {
+        return false;
+    }
+
+    _memory.swap(memory);
+    _begin = reinterpret_cast<uint8_t*>(_memory.begin());
+
+    // The file was prepared earlier, so it starts now.
+    uint64_t startNanos = now();
+    int64_t startWallMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::memcpy(_begin + offsetof(FileHeader, startNanos), &startNanos, sizeof(startNanos));
+    std::memcpy(_begin + offsetof(FileHeader, startWallMicros), &startWallMicros, sizeof(startWallMicros));
+
+    _offset = sizeof(FileHeader);
+    return true;
+}
+
+
+bool SerialCaptureLog::createFile(uint64_t sequence, Poco::SharedMemory& memory) const
+{
+    std::string path = filePath(_basePath, sequence);
+
+    try
+    {
+        Poco::File file(path);
+
+        if (file.exists())
+        {
+            file.remove();
+        }
+
+        file.createFile();
+        file.setSize(_fileSize);
+
+        memory = Poco::SharedMemory(file, Poco::SharedMemory::AM_WRITE);
+    }
+    catch (const Poco::Exception& exc)
+    {
+        ofLogError("SerialCaptureLog::createFile") << "Unable to create " << path << ": " << exc.displayText();
+        return false;
+    }
+
+    uint8_t* begin = reinterpret_cast<uint8_t*>(memory.begin());
+
+    // Touch every page now so that recording never waits for the file
+    // system to allocate one.
+    for (std::size_t offset = 0; offset < _fileSize; offset += MIN_FILE_SIZE)
+    {
+        begin[offset] = 0;
+    }
+
+    // A valid header without records, so readers skip a prepared file.
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.headerSize = sizeof(FileHeader);
+    header.capacity = _fileSize;
+    header.sequence = sequence;
+    std::memcpy(begin, &header, sizeof(header));
+
+    return true;
+}
+
+
+void SerialCaptureLog::removeOldFiles(uint64_t sequence) const
+{
+    if (_maxFiles == 0)
+    {
+        return;
+    }
+
+    // Every file that fell out of the rotation, also those left by a
+    // recording that kept more files.
+    const std::string prefix = _basePath + ".";
+
+    for (const auto& path: listFiles(_basePath))
+    {
+        uint64_t fileSequence = std::stoull(path.substr(prefix.size(), path.size() - prefix.size() - 5));
+
+        if (fileSequence + _maxFiles > sequence)
+        {
+            break;
+        }
+
+        try
+        {
+            Poco::File(path).remove();
+        }
+        catch (const Poco::Exception& exc)
+        {
+            ofLogWarning("SerialCaptureLog::removeOldFiles") << "Unable to remove an old file: " << exc.displayText();
+        }
+    }
+}
+
+
+void SerialCaptureLog::prepareFiles()
+{
+    std::unique_lock<std::mutex> lock(_spareMutex);
+
+    for (;;)
+    {
+        _spareCondition.wait(lock, [&]() {
+            return _stopping || _spareWanted || !_retired.empty();
+        });
+
+        if (_stopping)
+        {
+            return;
+        }
+
+        std::vector<Poco::SharedMemory> retired;
+        retired.swap(_retired);
+
+        bool prepare = _spareWanted;
+        uint64_t sequence = _spareSequence;
+
+        lock.unlock();
+
+        // Unmap full files off the recording path.
+        retired.clear();
+
+        Poco::SharedMemory memory;
+        bool created = false;
+
+        if (prepare)
+        {
+            created = createFile(sequence, memory);
+
+            // The newest recorded file is the one before the prepared one.
+            removeOldFiles(sequence - 1);
+        }
+
+        lock.lock();
+
+        if (prepare && _spareWanted && _spareSequence == sequence)
+        {
+            _spare.swap(memory);
+            _spareReady = created;
+            _spareWanted = false;
+            _spareCondition.notify_all();
+        }
+    }
+}
+
+
+void SerialCaptureLog::stopPreparing()
+{
+    {
+        std::unique_lock<std::mutex> lock(_spareMutex);
+        _stopping = true;
+    }
+
+    _spareCondition.notify_all();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    _retired.clear();
+    _spareWanted = false;
+
+    if (_spareReady)
+    {
+        // The prepared file was never recorded into.
+        _spare = Poco::SharedMemory();
+        _spareReady = false;
+
+        try
+        {
+            Poco::File(filePath(_basePath, _spareSequence)).remove();
+        }
+        catch (const Poco::Exception& exc)
+        {
+            ofLogWarning("SerialCaptureLog::stopPreparing") << "Unable to remove an unused file: " << exc.displayText();
+        }
+    }
+}
+
+
+SerialCaptureReader::SerialCaptureReader()
+{
+    std::memset(&_header, 0, sizeof(_header));
+}
+
+
+SerialCaptureReader::~SerialCaptureReader()
+{
+}
+
+
+bool SerialCaptureReader::setup(const std::string& path)
+{
+    return setup(std::vector<std::string>(1, path));
+}
+
+
+bool SerialCaptureReader::setup(const std::vector<std::string>& paths)
+{
+    close();
+    _paths = paths;
+    return rewind();
+}
+
+
+void SerialCaptureReader::close()
+{
+    _memory = Poco::SharedMemory();
+    _begin = nullptr;
+    _size = 0;
+    _offset = 0;
+}
+
+
+bool SerialCaptureReader::next(Record& record)
+{
+    while (_begin != nullptr)
+    {
+        if (_offset + sizeof(SerialCaptureLog::RecordHeader) <= _size)
+        {
+            SerialCaptureLog::RecordHeader header;
+            std::memcpy(&header, _begin + _offset, sizeof(header));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            std::size_t end = _offset + sizeof(header) + header.size;
+
+            if (header.size > 0 && end <= _size)
+            {
+                record.direction = static_cast<AbstractSerialTap::Direction>(header.direction);
+                record.timestampNanos = header.timestampNanos;
+                record.data = _begin + _offset + sizeof(header);
+                record.size = header.size;
+
+                _offset = (end + SerialCaptureLog::RECORD_ALIGNMENT - 1) / SerialCaptureLog::RECORD_ALIGNMENT * SerialCaptureLog::RECORD_ALIGNMENT;
+                return true;
+            }
+        }
+
+        // The end of this file, move on to the next one.
+        if (!openFile(_pathIndex + 1))
+        {
+            close();
+        }
+    }
+
+    return false;
+}
+
+
+bool SerialCaptureReader::rewind()
+{
+    return openFile(0);
+}
+
+
+const SerialCaptureLog::FileHeader& SerialCaptureReader::header() const
+{
+    return _header;
+}
+
+
+bool SerialCaptureReader::openFile(std::size_t index)
+{
+    close();
+
+    _pathIndex = index;
+
+    if (index >= _paths.size())
+    {
+        return false;
+    }
+
+    try
+    {
+        _memory = Poco::SharedMemory(Poco::File(_paths[index]), Poco::SharedMemory::AM_READ);
+    }
+    catch (const Poco::Exception& exc)
+    {
+        ofLogError("SerialCaptureReader::openFile") << "Unable to open " << _paths[index] << ": " << exc.displayText();
+        return false;
+    }
+
+    std::size_t size = _memory.end() - _memory.begin();
+
+    if (size < sizeof(SerialCaptureLog::FileHeader))
+    {
+        ofLogError("SerialCaptureReader::openFile") << _paths[index] << " is too small.";
+        _memory = Poco::SharedMemory();
+        return false;
+    }
+
+    std::memcpy(&_header, _memory.begin(), sizeof(_header));
+
+    if (std::memcmp(_header.magic, SerialCaptureLog::MAGIC, sizeof(_header.magic)) != 0
+     || _header.version != SerialCaptureLog::VERSION)
+    {
+        ofLogError("SerialCaptureReader::openFile") << _paths[index] << " is not a capture file.";
+        _memory = Poco::SharedMemory();
+        return false;
+    }
+
+    _begin = reinterpret_cast<const uint8_t*>(_memory.begin());
+    _size = std::min<std::size_t>(size, _header.capacity);
+    _offset = _header.headerSize;
+    return true;
+}
+
+
+} } // namespace ofx::IO
@@ -6,7 +6,11 @@
 
 
 #include "ofx/IO/SerialDevice.h"
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
+#include <thread>
 
 
 namespace ofx {
@@ -32,13 +36,107 @@ SerialDevice::~SerialDevice()
 
 bool SerialDevice::setup(const Settings& settings)
 {
-    return setup(settings.portName,
-                 settings.baudRate,
-                 settings.dataBits,
-                 settings.parity,
-                 settings.stopBits,
-                 settings.flowControl,
-                 settings.timeout);
+    try
+    {
+        _serial = std::make_shared<serial::Serial>(settings.portName,
+                                                   settings.baudRate,
+                                                   settings.timeout,
+                                                   static_cast<serial::bytesize_t>(settings.dataBits),
+                                                   static_cast<serial::parity_t>(settings.parity),
+                                                   static_cast<serial::stopbits_t>(settings.stopBits),
+                                                   static_cast<serial::flowcontrol_t>(settings.flowControl),
+                                                   static_cast<serial::threadingmode_t>(settings.threadingMode));
+
+    }
+    catch (const serial::IOException& exc)
+    {
+        if (exc.getErrorNumber() == EBUSY)
+        {
+            ofLogError("SerialDevice::setup") << settings.portName << " is busy -- is it in use by another application?";
+        }
+        else
+        {
+            ofLogError("SerialDevice::setup") << exc.what();
+        }
+
+        return false;
+    }
+    catch (const std::exception& exc)
+    {
+        // E.g. a malformed port name, or a port that is already open.
+        ofLogError("SerialDevice::setup") << settings.portName << ": " << exc.what();
+        return false;
+    }
+
+    if (!_serial->isOpen())
+    {
+        return false;
+    }
+
+    if (settings.lowLatency && !setLowLatency(true))
+    {
+        ofLogWarning("SerialDevice::setup") << "Low latency mode is not supported by " << settings.portName << ".";
+    }
+
+    return true;
+}
+
+
+std::future<SerialDevice::SetupResult> SerialDevice::setupAsync(const Settings& settings)
+{
+    return std::async(std::launch::async, [this, settings]() {
+        SetupResult result;
+        result.portName = settings.portName;
+
+        auto start = std::chrono::steady_clock::now();
+        result.success = setup(settings);
+        result.micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        return result;
+    });
+}
+
+
+std::vector<SerialDevice::SetupResult> SerialDevice::setupAll(const std::vector<SerialDevice*>& devices,
+                                                              const std::vector<Settings>& settings,
+                                                              std::size_t threadCount)
+{
+    std::vector<SetupResult> results(std::min(devices.size(), settings.size()));
+
+    if (devices.size() != settings.size())
+    {
+        ofLogError("SerialDevice::setupAll") << "Got " << devices.size() << " devices and " << settings.size() << " settings.";
+    }
+
+    // Each thread opens the next port that nobody has claimed yet.
+    std::atomic<std::size_t> next(0);
+
+    auto work = [&]() {
+        std::size_t i = 0;
+
+        while ((i = next++) < results.size())
+        {
+            results[i].portName = settings[i].portName;
+
+            auto start = std::chrono::steady_clock::now();
+            results[i].success = devices[i]->setup(settings[i]);
+            results[i].micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 0; i < std::min(std::max<std::size_t>(threadCount, 1), results.size()); ++i)
+    {
+        threads.push_back(std::thread(work));
+    }
+
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+
+    return results;
 }
 
 
@@ -95,28 +193,37 @@ bool SerialDevice::setup(const std::string& portName,
                          FlowControl flowControl,
                          serial::Timeout timeout)
 {
-    try
-    {
-        _serial = std::make_shared<serial::Serial>(portName,
-                                                   baudRate,
-                                                   timeout,
-                                                   static_cast<serial::bytesize_t>(dataBits),
-                                                   static_cast<serial::parity_t>(parity),
-                                                   static_cast<serial::stopbits_t>(stopBits),
-                                                   static_cast<serial::flowcontrol_t>(flowControl));
+    Settings settings;
+    settings.portName = portName;
+    settings.baudRate = baudRate;
+    settings.dataBits = dataBits;
+    settings.parity = parity;
+    settings.stopBits = stopBits;
+    settings.flowControl = flowControl;
+    settings.timeout = timeout;
+    return setup(settings);
+}
+
+
+bool SerialDevice::setup(std::shared_ptr<serial::Serial> serial)
+{
+    _serial = serial;
 
+    if (_serial == nullptr)
+    {
+        return false;
     }
-    catch (const serial::IOException& exc)
+
+    try
     {
-        if (exc.getErrorNumber() == EBUSY)
+        if (!_serial->isOpen())
         {
-            ofLogError("SerialDevice::setup") << portName << " is busy -- is it in use by another application?";
+            _serial->open();
         }
-        else
-        {
-            ofLogError("SerialDevice::setup") << exc.what();
-        }
-
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("SerialDevice::setup") << exc.what();
         return false;
     }
 
@@ -126,13 +233,41 @@ bool SerialDevice::setup(const std::string& portName,
 
 std::size_t SerialDevice::readBytes(uint8_t* buffer, std::size_t size)
 {
-    return _serial != nullptr ? _serial->read(buffer, size) : 0;
+    std::size_t count = _serial != nullptr ? _serial->read(buffer, size) : 0;
+    tapBytes(AbstractSerialTap::DIRECTION_RX, buffer, count);
+    return count;
 }
 
 
 std::size_t SerialDevice::readByte(uint8_t& data)
 {
-    return _serial != nullptr ? _serial->read(&data, 1) : 0;
+    return readBytes(&data, 1);
+}
+
+
+serial::IOResult SerialDevice::tryReadBytes(uint8_t* buffer, std::size_t size)
+{
+    if (_serial == nullptr)
+    {
+        return serial::IOResult(0, serial::io_port_not_open);
+    }
+
+    serial::IOResult result = _serial->tryRead(buffer, size);
+    tapBytes(AbstractSerialTap::DIRECTION_RX, buffer, result.bytes);
+    return result;
+}
+
+
+serial::IOResult SerialDevice::tryWriteBytes(const uint8_t* buffer, std::size_t size)
+{
+    if (_serial == nullptr)
+    {
+        return serial::IOResult(0, serial::io_port_not_open);
+    }
+
+    serial::IOResult result = _serial->tryWrite(buffer, size);
+    tapBytes(AbstractSerialTap::DIRECTION_TX, buffer, result.bytes);
+    return result;
 }
 
 
@@ -142,33 +277,47 @@ std::size_t SerialDevice::available() const
 }
 
 
+std::size_t SerialDevice::outWaiting() const
+{
+    return _serial != nullptr ? _serial->outWaiting() : 0;
+}
+
+
+uint32_t SerialDevice::byteTime() const
+{
+    return _serial != nullptr ? _serial->getByteTime() : 0;
+}
+
+
 std::size_t SerialDevice::writeByte(uint8_t data)
 {
-    return _serial != nullptr ? _serial->write(&data, 1) : 0;
+    return writeBytes(&data, 1);
 }
 
     
 std::size_t SerialDevice::writeBytes(const uint8_t* buffer, std::size_t size)
 {
-    return _serial != nullptr ? _serial->write(buffer, size) : 0;
+    std::size_t count = _serial != nullptr ? _serial->write(buffer, size) : 0;
+    tapBytes(AbstractSerialTap::DIRECTION_TX, buffer, count);
+    return count;
 }
 
 
 std::size_t SerialDevice::writeBytes(const std::vector<uint8_t>& buffer)
 {
-    return _serial != nullptr ? _serial->write(buffer) : 0;
+    return writeBytes(buffer.data(), buffer.size());
 }
 
 
 std::size_t SerialDevice::writeBytes(const std::string& buffer)
 {
-    return _serial != nullptr ? _serial->write(buffer) : 0;
+    return writeBytes(reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size());
 }
 
 
 std::size_t SerialDevice::writeBytes(const AbstractByteSource& buffer)
 {
-    return _serial != nullptr ? _serial->write(buffer.readBytes()) : 0;
+    return writeBytes(buffer.readBytes());
 }
 
 
@@ -293,6 +442,57 @@ SerialDevice::Timeout SerialDevice::getTimeout() const
 }
 
 
+bool SerialDevice::setLowLatency(bool lowLatency)
+{
+    if (_serial == nullptr)
+    {
+        return false;
+    }
+
+    try
+    {
+        return _serial->setLowLatency(lowLatency);
+    }
+    catch (const serial::IOException& exc)
+    {
+        ofLogError("SerialDevice::setLowLatency") << exc.what();
+    }
+
+    return false;
+}
+
+
+bool SerialDevice::lowLatency() const
+{
+    return _serial != nullptr && _serial->getLowLatency();
+}
+
+
+SerialDevice::ThreadingMode SerialDevice::threadingMode() const
+{
+    if (_serial != nullptr)
+    {
+        return static_cast<ThreadingMode>(_serial->getThreadingMode());
+    }
+    else
+    {
+        return THREADING_MULTI;
+    }
+}
+
+
+void SerialDevice::setTap(std::shared_ptr<AbstractSerialTap> tap)
+{
+    _tap = tap;
+}
+
+
+std::shared_ptr<AbstractSerialTap> SerialDevice::tap() const
+{
+    return _tap;
+}
+
+
 void SerialDevice::flush()
 {
     if (_serial != nullptr) _serial->flush();
@@ -343,7 +543,7 @@ bool SerialDevice::isClearToSend() const
 
 bool SerialDevice::isDataSetReady() const
 {
-    return _serial != nullptr && _serial->getCTS();
+    return _serial != nullptr && _serial->getDSR();
 }
 
 
@@ -0,0 +1,223 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/SerialDeviceGroup.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+
+
+namespace ofx {
+namespace IO {
+
+
+static int64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+bool SerialDeviceGroup::WriteResult::ok() const
+{
+    return std::all_of(ports.begin(), ports.end(), [](const PortResult& port) {
+        return port.result.ok();
+    });
+}
+
+
+SerialDeviceGroup::SerialDeviceGroup(): _arrived(0)
+{
+}
+
+
+SerialDeviceGroup::~SerialDeviceGroup()
+{
+    close();
+}
+
+
+void SerialDeviceGroup::setup(const std::vector<SerialDevice*>& devices,
+                              const ThreadPolicy& policy)
+{
+    close();
+
+    _devices = devices;
+    _policy = policy;
+    _result.ports.assign(_devices.size(), PortResult());
+    _starts.assign(_devices.size(), 0);
+    _ends.assign(_devices.size(), 0);
+    _running = true;
+
+    for (std::size_t i = 0; i < _devices.size(); ++i)
+    {
+        _threads.push_back(std::thread(&SerialDeviceGroup::threadedFunction, this, i));
+    }
+}
+
+
+void SerialDeviceGroup::close()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _start.notify_all();
+
+    for (auto& thread: _threads)
+    {
+        thread.join();
+    }
+
+    _threads.clear();
+    _devices.clear();
+}
+
+
+std::size_t SerialDeviceGroup::size() const
+{
+    return _devices.size();
+}
+
+
+const SerialDeviceGroup::WriteResult& SerialDeviceGroup::writeAll(const uint8_t* data,
+                                                                  std::size_t size)
+{
+    _data = data;
+    _size = size;
+    _slices = nullptr;
+    return run();
+}
+
+
+const SerialDeviceGroup::WriteResult& SerialDeviceGroup::writeEach(const std::vector<ByteBuffer>& slices)
+{
+    if (slices.size() != _devices.size())
+    {
+        ofLogError("SerialDeviceGroup::writeEach") << "Expected " << _devices.size() << " slices, got " << slices.size() << ".";
+
+        // Nothing was written, so don't leave the last write's outcome.
+        PortResult failed;
+        failed.result = serial::IOResult(0, serial::io_error, EINVAL);
+        _result.ports.assign(_devices.size(), failed);
+        _result.startSkewNanos = 0;
+        _result.endSkewNanos = 0;
+        return _result;
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _slices = &slices;
+    return run();
+}
+
+
+const SerialDeviceGroup::WriteResult& SerialDeviceGroup::lastResult() const
+{
+    return _result;
+}
+
+
+const SerialDeviceGroup::WriteResult& SerialDeviceGroup::run()
+{
+    if (_devices.empty())
+    {
+        return _result;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _arrived = _devices.size();
+        _remaining = _devices.size();
+        ++_generation;
+    }
+
+    _start.notify_all();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [&]() { return _remaining == 0; });
+    }
+
+    int64_t firstStart = *std::min_element(_starts.begin(), _starts.end());
+    int64_t lastStart = *std::max_element(_starts.begin(), _starts.end());
+    int64_t firstEnd = *std::min_element(_ends.begin(), _ends.end());
+    int64_t lastEnd = *std::max_element(_ends.begin(), _ends.end());
+
+    for (std::size_t i = 0; i < _devices.size(); ++i)
+    {
+        _result.ports[i].startNanos = _starts[i] - firstStart;
+        _result.ports[i].endNanos = _ends[i] - firstStart;
+    }
+
+    _result.startSkewNanos = lastStart - firstStart;
+    _result.endSkewNanos = lastEnd - firstEnd;
+
+    return _result;
+}
+
+
+void SerialDeviceGroup::threadedFunction(std::size_t index)
+{
+    std::string policyError;
+
+    if (!_policy.applyToCurrentThread(policyError))
+    {
+        ofLogWarning("SerialDeviceGroup::threadedFunction") << policyError;
+    }
+
+    uint64_t generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _start.wait(lock, [&]() { return !_running || _generation != generation; });
+
+            if (!_running)
+            {
+                return;
+            }
+
+            generation = _generation;
+        }
+
+        // Waking from the condition variable takes a different time on each
+        // thread, so hold everyone here until the last writer is awake.
+        _arrived.fetch_sub(1, std::memory_order_acq_rel);
+
+        while (_arrived.load(std::memory_order_acquire) > 0)
+        {
+            std::this_thread::yield();
+        }
+
+        const uint8_t* data = _data;
+        std::size_t size = _size;
+
+        if (_slices != nullptr)
+        {
+            data = (*_slices)[index].getPtr();
+            size = (*_slices)[index].size();
+        }
+
+        _starts[index] = nowNanos();
+        _result.ports[index].result = _devices[index]->tryWriteBytes(data, size);
+        _ends[index] = nowNanos();
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            if (--_remaining == 0)
+            {
+                _done.notify_one();
+            }
+        }
+    }
+}
+
+
+} } // namespace ofx::IO
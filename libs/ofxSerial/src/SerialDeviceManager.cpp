@@ -0,0 +1,425 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/SerialDeviceManager.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#if !defined(_WIN32)
+#include <errno.h>
+#include <poll.h>
+#endif
+
+
+namespace ofx {
+namespace IO {
+
+
+SerialDeviceManager::Device::Device(uint8_t marker, std::size_t maxBufferSize):
+    BufferedSerialDevice(marker, maxBufferSize),
+    pending(false),
+    failed(false),
+    overflowCount(0)
+{
+    // The manager frames this device, so it does not update itself.
+    ofRemoveListener(ofEvents().update, static_cast<BufferedSerialDevice*>(this), &BufferedSerialDevice::update);
+}
+
+
+void SerialDeviceManager::Device::notifyError(const std::string& message)
+{
+    Poco::Exception exc(message);
+    SerialBufferErrorEventArgs args(*this, _buffer, exc);
+    ofNotifyEvent(events.onSerialError, args, this);
+}
+
+
+SerialDeviceManager::SerialDeviceManager(uint8_t marker,
+                                         std::size_t maxBufferSize):
+    _marker(marker),
+    _maxBufferSize(maxBufferSize),
+    _running(false),
+    _updateBuffer(READ_BUFFER_SIZE)
+{
+    ofAddListener(ofEvents().update, this, &SerialDeviceManager::update);
+}
+
+
+SerialDeviceManager::~SerialDeviceManager()
+{
+    close();
+    ofRemoveListener(ofEvents().update, this, &SerialDeviceManager::update);
+}
+
+
+std::size_t SerialDeviceManager::setup(const std::vector<SerialDevice::Settings>& settings,
+                                       std::size_t workerCount,
+                                       const ThreadPolicy& policy,
+                                       std::size_t capacity)
+{
+    close();
+
+    for (std::size_t i = 0; i < settings.size(); ++i)
+    {
+        _devices.push_back(std::unique_ptr<Device>(new Device(_marker, _maxBufferSize)));
+        _devices.back()->ring.reset(new SerialRingBuffer(capacity));
+        _indices[_devices.back().get()] = i;
+    }
+
+    // Opening a port can block for hundreds of milliseconds on some USB
+    // drivers, so open them all at once.
+    std::vector<SerialDevice*> devices;
+
+    for (auto& device: _devices)
+    {
+        devices.push_back(device.get());
+    }
+
+    _setupResults = SerialDevice::setupAll(devices, settings, devices.size());
+
+    for (auto& device: _devices)
+    {
+        device->registerAllEvents(this);
+
+        if (policy.lockMemory && !ThreadPolicy::lock(device->ring->storage(), device->ring->capacity()))
+        {
+            ofLogWarning("SerialDeviceManager::setup") << "Unable to lock buffers in memory.";
+        }
+    }
+
+    // Each device is queued at most once, so the queues never grow.
+    _ready.reserve(_devices.size());
+    _readyUpdate.reserve(_devices.size());
+
+    _policy = policy;
+    _running = true;
+
+    workerCount = std::max<std::size_t>(1, std::min(workerCount, _devices.size()));
+
+    for (std::size_t worker = 0; worker < workerCount; ++worker)
+    {
+        _workers.push_back(std::thread(&SerialDeviceManager::threadedFunction, this, worker, workerCount));
+    }
+
+    return openCount();
+}
+
+
+void SerialDeviceManager::close()
+{
+    _running = false;
+
+    for (auto& worker: _workers)
+    {
+        worker.join();
+    }
+
+    _workers.clear();
+
+    for (auto& device: _devices)
+    {
+        device->unregisterAllEvents(this);
+
+        if (_policy.lockMemory)
+        {
+            ThreadPolicy::unlock(device->ring->storage(), device->ring->capacity());
+        }
+    }
+
+    _devices.clear();
+    _setupResults.clear();
+    _indices.clear();
+    _ready.clear();
+    _readyUpdate.clear();
+}
+
+
+void SerialDeviceManager::update(ofEventArgs& args)
+{
+    {
+        std::unique_lock<std::mutex> lock(_readyMutex);
+        _readyUpdate.swap(_ready);
+    }
+
+    for (std::size_t index: _readyUpdate)
+    {
+        Device& device = *_devices[index];
+
+        // Clear the flag before draining so that bytes written after the
+        // drain queue the device again.
+        device.pending = false;
+
+        std::size_t nBytes = 0;
+
+        while ((nBytes = device.ring->read(_updateBuffer.data(), _updateBuffer.size())) > 0)
+        {
+            device.processBytes(_updateBuffer.data(), nBytes);
+        }
+
+        if (!device.failureNotified && device.failed.load(std::memory_order_acquire))
+        {
+            device.failureNotified = true;
+            device.notifyError(device.error);
+        }
+    }
+
+    _readyUpdate.clear();
+}
+
+
+std::size_t SerialDeviceManager::size() const
+{
+    return _devices.size();
+}
+
+
+std::size_t SerialDeviceManager::openCount() const
+{
+    return std::count_if(_devices.begin(), _devices.end(), [](const std::unique_ptr<Device>& device) {
+        return device->isOpen();
+    });
+}
+
+
+std::size_t SerialDeviceManager::workerCount() const
+{
+    return _workers.size();
+}
+
+
+const std::vector<SerialDevice::SetupResult>& SerialDeviceManager::setupResults() const
+{
+    return _setupResults;
+}
+
+
+BufferedSerialDevice& SerialDeviceManager::device(std::size_t index)
+{
+    return *_devices.at(index);
+}
+
+
+const BufferedSerialDevice& SerialDeviceManager::device(std::size_t index) const
+{
+    return *_devices.at(index);
+}
+
+
+std::size_t SerialDeviceManager::index(const BufferedSerialDevice& device) const
+{
+    auto iter = _indices.find(&device);
+    return iter != _indices.end() ? iter->second : NO_INDEX;
+}
+
+
+uint64_t SerialDeviceManager::overflowCount(std::size_t index) const
+{
+    return _devices.at(index)->overflowCount;
+}
+
+
+void SerialDeviceManager::onSerialBuffer(const SerialBufferEventArgs& args)
+{
+    ofNotifyEvent(events.onSerialBuffer, args, this);
+}
+
+
+void SerialDeviceManager::onSerialError(const SerialBufferErrorEventArgs& args)
+{
+    ofNotifyEvent(events.onSerialError, args, this);
+}
+
+
+void SerialDeviceManager::threadedFunction(std::size_t worker, std::size_t workerCount)
+{
+    std::string policyError;
+
+    if (!_policy.applyToCurrentThread(policyError))
+    {
+        ofLogWarning("SerialDeviceManager::threadedFunction") << policyError;
+    }
+
+    if (_policy.lockMemory)
+    {
+        ThreadPolicy::prefaultStack();
+    }
+
+    std::vector<uint8_t> buffer(READ_BUFFER_SIZE);
+    std::vector<std::size_t> indices;
+
+    for (std::size_t index = worker; index < _devices.size(); index += workerCount)
+    {
+        if (_devices[index]->isOpen())
+        {
+            indices.push_back(index);
+        }
+    }
+
+#if defined(_WIN32)
+    // Serial ports have no file descriptors to wait on, so check each one.
+    while (_running && !indices.empty())
+    {
+        bool idle = true;
+
+        for (std::size_t i = 0; i < indices.size();)
+        {
+            bool ok = true;
+
+            try
+            {
+                if (_devices[indices[i]]->available() > 0)
+                {
+                    idle = false;
+                    ok = service(indices[i], buffer);
+                }
+            }
+            catch (const std::exception& exc)
+            {
+                fail(indices[i], exc.what());
+                ok = false;
+            }
+
+            if (ok)
+            {
+                ++i;
+            }
+            else
+            {
+                indices.erase(indices.begin() + i);
+            }
+        }
+
+        if (idle)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+#else
+    std::vector<pollfd> fds;
+
+    for (std::size_t index: indices)
+    {
+        pollfd fd;
+        fd.fd = _devices[index]->serial()->getFd();
+        fd.events = POLLIN;
+        fd.revents = 0;
+        fds.push_back(fd);
+    }
+
+    while (_running && !fds.empty())
+    {
+        int result = ::poll(fds.data(), fds.size(), WAKE_INTERVAL_MS);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            std::string message = std::strerror(errno);
+
+            for (std::size_t index: indices)
+            {
+                fail(index, message);
+            }
+
+            break;
+        }
+
+        for (std::size_t i = 0; result > 0 && i < fds.size();)
+        {
+            bool ok = true;
+
+            if (fds[i].revents & POLLNVAL)
+            {
+                fail(indices[i], "The port was closed.");
+                ok = false;
+            }
+            else if (fds[i].revents != 0)
+            {
+                try
+                {
+                    ok = service(indices[i], buffer);
+                }
+                catch (const std::exception& exc)
+                {
+                    fail(indices[i], exc.what());
+                    ok = false;
+                }
+            }
+
+            if (ok)
+            {
+                ++i;
+            }
+            else
+            {
+                fds.erase(fds.begin() + i);
+                indices.erase(indices.begin() + i);
+            }
+        }
+    }
+#endif
+}
+
+
+bool SerialDeviceManager::service(std::size_t index, std::vector<uint8_t>& buffer)
+{
+    Device& device = *_devices[index];
+
+    // Only read what is available so that a configured read timeout never
+    // blocks the other devices.
+    std::size_t count = std::min(device.available(), buffer.size());
+
+    if (count == 0)
+    {
+        // Disconnected devices, at least on Linux, are always readable but
+        // have nothing to read.
+        fail(index, "Device reports readiness to read but has no data (device disconnected?)");
+        return false;
+    }
+
+    serial::IOResult result = device.tryReadBytes(buffer.data(), count);
+
+    if (result.bytes > 0)
+    {
+        std::size_t written = device.ring->write(buffer.data(), result.bytes);
+        device.overflowCount += result.bytes - written;
+        markReady(index);
+    }
+
+    if (!result.ok())
+    {
+        fail(index, result.message());
+        return false;
+    }
+
+    return true;
+}
+
+
+void SerialDeviceManager::fail(std::size_t index, const std::string& message)
+{
+    Device& device = *_devices[index];
+    device.error = message;
+    device.failed.store(true, std::memory_order_release);
+    markReady(index);
+}
+
+
+void SerialDeviceManager::markReady(std::size_t index)
+{
+    if (!_devices[index]->pending.exchange(true))
+    {
+        std::unique_lock<std::mutex> lock(_readyMutex);
+        _ready.push_back(index);
+    }
+}
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,334 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/SerialPcapng.h"
+#include <chrono>
+#include <cstring>
+#include "ofLog.h"
+
+
+namespace ofx {
+namespace IO {
+
+
+namespace {
+
+
+/// \brief pcapng block types.
+enum
+{
+    BLOCK_SECTION_HEADER = 0x0A0D0D0A,
+    BLOCK_INTERFACE_DESCRIPTION = 0x00000001,
+    BLOCK_ENHANCED_PACKET = 0x00000006
+};
+
+
+/// \brief pcapng option codes.
+enum
+{
+    OPTION_END = 0,
+    OPTION_COMMENT = 1,
+    OPTION_IF_NAME = 2,
+    OPTION_SHB_USERAPPL = 4,
+    OPTION_IF_TSRESOL = 9
+};
+
+
+/// \brief Shows the byte order of the file to readers.
+const uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+
+
+/// \brief Append a value in the byte order of this machine.
+template<typename Type>
+void append(std::vector<uint8_t>& body, Type value)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    body.insert(body.end(), bytes, bytes + sizeof(value));
+}
+
+
+/// \brief Append bytes padded to 32 bits.
+void appendPadded(std::vector<uint8_t>& body, const uint8_t* data, std::size_t size)
+{
+    body.insert(body.end(), data, data + size);
+    body.resize(body.size() + (4 - size % 4) % 4, 0);
+}
+
+
+void appendOption(std::vector<uint8_t>& body, uint16_t code, const uint8_t* data, std::size_t size)
+{
+    append<uint16_t>(body, code);
+    append<uint16_t>(body, static_cast<uint16_t>(size));
+    appendPadded(body, data, size);
+}
+
+
+void appendOption(std::vector<uint8_t>& body, uint16_t code, const std::string& value)
+{
+    appendOption(body, code, reinterpret_cast<const uint8_t*>(value.data()), value.size());
+}
+
+
+void appendEndOfOptions(std::vector<uint8_t>& body)
+{
+    append<uint16_t>(body, OPTION_END);
+    append<uint16_t>(body, 0);
+}
+
+
+}
+
+
+PcapngSerialTap::PcapngSerialTap():
+    _running(false),
+    _droppedBytes(0),
+    _packetCount(0)
+{
+}
+
+
+PcapngSerialTap::~PcapngSerialTap()
+{
+    close();
+}
+
+
+bool PcapngSerialTap::setup(const std::string& path,
+                            const std::string& name,
+                            std::size_t bufferSize)
+{
+    close();
+
+    _fileBuffer.resize(FILE_BUFFER_SIZE);
+    _file.rdbuf()->pubsetbuf(_fileBuffer.data(), _fileBuffer.size());
+    _file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!_file.is_open())
+    {
+        ofLogError("PcapngSerialTap::setup") << "Unable to create " << path;
+        return false;
+    }
+
+    uint64_t wallNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    _epochOffsetNanos = wallNanos - now();
+
+    _droppedBytes = 0;
+    _packetCount = 0;
+
+    // The interface IDs are the directions.
+    writeSectionHeader();
+    writeInterface(name.empty() ? "rx" : name + " rx");
+    writeInterface(name.empty() ? "tx" : name + " tx");
+
+    reset();
+
+    {
+        std::unique_lock<std::mutex> lock(_tapMutex);
+        _ring.reset(new SerialRingBuffer(bufferSize));
+    }
+
+    _running = true;
+    _thread = std::thread(&PcapngSerialTap::run, this);
+    return true;
+}
+
+
+void PcapngSerialTap::close()
+{
+    if (_thread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _running = false;
+        }
+
+        _condition.notify_all();
+        _thread.join();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_tapMutex);
+        _ring.reset();
+    }
+
+    if (_file.is_open())
+    {
+        _file.close();
+    }
+}
+
+
+bool PcapngSerialTap::isOpen() const
+{
+    return _running;
+}
+
+
+void PcapngSerialTap::tap(Direction direction,
+                          uint64_t timestampNanos,
+                          const uint8_t* data,
+                          std::size_t size)
+{
+    std::unique_lock<std::mutex> lock(_tapMutex);
+
+    if (_ring == nullptr)
+    {
+        return;
+    }
+
+    if (_ring->free() < sizeof(Chunk) + size)
+    {
+        _droppedBytes += size;
+        return;
+    }
+
+    Chunk chunk;
+    chunk.timestampNanos = timestampNanos;
+    chunk.size = static_cast<uint32_t>(size);
+    chunk.direction = direction;
+
+    _ring->write(reinterpret_cast<const uint8_t*>(&chunk), sizeof(chunk));
+    _ring->write(data, size);
+}
+
+
+uint64_t PcapngSerialTap::droppedBytes() const
+{
+    return _droppedBytes;
+}
+
+
+uint64_t PcapngSerialTap::packetCount() const
+{
+    return _packetCount;
+}
+
+
+void PcapngSerialTap::process(Direction direction,
+                              uint64_t timestampNanos,
+                              const uint8_t* data,
+                              std::size_t size)
+{
+    writePacket(direction, timestampNanos, data, size);
+}
+
+
+void PcapngSerialTap::reset()
+{
+}
+
+
+void PcapngSerialTap::writePacket(Direction direction,
+                                  uint64_t timestampNanos,
+                                  const uint8_t* data,
+                                  std::size_t size,
+                                  const std::string& comment)
+{
+    uint64_t timestamp = timestampNanos + _epochOffsetNanos;
+
+    _body.clear();
+    append<uint32_t>(_body, direction);
+    append<uint32_t>(_body, static_cast<uint32_t>(timestamp >> 32));
+    append<uint32_t>(_body, static_cast<uint32_t>(timestamp));
+    append<uint32_t>(_body, static_cast<uint32_t>(size));
+    append<uint32_t>(_body, static_cast<uint32_t>(size));
+    appendPadded(_body, data, size);
+
+    if (!comment.empty())
+    {
+        appendOption(_body, OPTION_COMMENT, comment);
+        appendEndOfOptions(_body);
+    }
+
+    writeBlock(BLOCK_ENHANCED_PACKET, _body);
+    ++_packetCount;
+}
+
+
+void PcapngSerialTap::run()
+{
+    while (_running)
+    {
+        drain();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait_for(lock, std::chrono::milliseconds(1), [this] { return !_running; });
+    }
+
+    drain();
+    _file.flush();
+}
+
+
+void PcapngSerialTap::drain()
+{
+    Chunk chunk;
+
+    while (_ring->size() >= sizeof(Chunk))
+    {
+        _ring->read(reinterpret_cast<uint8_t*>(&chunk), sizeof(chunk));
+        _chunk.resize(chunk.size);
+
+        // The producer may still be copying the bytes of this chunk.
+        std::size_t offset = 0;
+
+        while (offset < chunk.size)
+        {
+            offset += _ring->read(_chunk.data() + offset, chunk.size - offset);
+
+            if (offset < chunk.size)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        process(static_cast<Direction>(chunk.direction), chunk.timestampNanos, _chunk.data(), _chunk.size());
+    }
+}
+
+
+void PcapngSerialTap::writeSectionHeader()
+{
+    _body.clear();
+    append<uint32_t>(_body, BYTE_ORDER_MAGIC);
+    append<uint16_t>(_body, 1);
+    append<uint16_t>(_body, 0);
+    append<int64_t>(_body, -1);
+    appendOption(_body, OPTION_SHB_USERAPPL, "ofxSerial");
+    appendEndOfOptions(_body);
+    writeBlock(BLOCK_SECTION_HEADER, _body);
+}
+
+
+void PcapngSerialTap::writeInterface(const std::string& name)
+{
+    // Timestamps are in nanoseconds, 10^-9 s.
+    const uint8_t resolution = 9;
+
+    _body.clear();
+    append<uint16_t>(_body, LINKTYPE_USER0);
+    append<uint16_t>(_body, 0);
+    append<uint32_t>(_body, 0);
+    appendOption(_body, OPTION_IF_NAME, name);
+    appendOption(_body, OPTION_IF_TSRESOL, &resolution, 1);
+    appendEndOfOptions(_body);
+    writeBlock(BLOCK_INTERFACE_DESCRIPTION, _body);
+}
+
+
+void PcapngSerialTap::writeBlock(uint32_t type, const std::vector<uint8_t>& body)
+{
+    uint32_t length = static_cast<uint32_t>(body.size() + 12);
+
+    _file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    _file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    _file.write(reinterpret_cast<const char*>(body.data()), body.size());
+    _file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+}
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/SerialReaderThread.h"
+#include "ofLog.h"
+#include <algorithm>
+#include <chrono>
+
+
+namespace ofx {
+namespace IO {
+
+
+SerialReaderThread::SerialReaderThread():
+    _overflowCount(0),
+    _running(false)
+{
+}
+
+
+SerialReaderThread::~SerialReaderThread()
+{
+    stop();
+}
+
+
+bool SerialReaderThread::start(std::shared_ptr<serial::Serial> serial,
+                               const ThreadPolicy& policy,
+                               std::size_t capacity)
+{
+    stop();
+
+    if (serial == nullptr || !serial->isOpen())
+    {
+        ofLogError("SerialReaderThread::start") << "The port is not open.";
+        return false;
+    }
+
+    _serial = serial;
+    _policy = policy;
+    _overflowCount = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(_errorMutex);
+        _error.clear();
+    }
+
+    if (_ring == nullptr || _ring->capacity() < capacity)
+    {
+        _ring.reset(new SerialRingBuffer(capacity));
+    }
+    else
+    {
+        _ring->clear();
+    }
+
+    _readBuffer.resize(READ_BUFFER_SIZE);
+
+    if (_policy.lockMemory)
+    {
+        if (!ThreadPolicy::lock(_ring->storage(), _ring->capacity())
+         || !ThreadPolicy::lock(_readBuffer.data(), _readBuffer.size()))
+        {
+            ofLogWarning("SerialReaderThread::start") << "Unable to lock buffers in memory.";
+        }
+    }
+
+    _running = true;
+    _thread = std::thread(&SerialReaderThread::threadedFunction, this);
+    return true;
+}
+
+
+void SerialReaderThread::stop()
+{
+    _running = false;
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    if (_policy.lockMemory && _ring != nullptr)
+    {
+        ThreadPolicy::unlock(_ring->storage(), _ring->capacity());
+        ThreadPolicy::unlock(_readBuffer.data(), _readBuffer.size());
+    }
+
+    _serial.reset();
+}
+
+
+void SerialReaderThread::setTap(std::shared_ptr<AbstractSerialTap> tap)
+{
+    _tap = tap;
+}
+
+
+bool SerialReaderThread::isRunning() const
+{
+    return _running;
+}
+
+
+SerialRingBuffer& SerialReaderThread::ring()
+{
+    if (_ring == nullptr)
+    {
+        _ring.reset(new SerialRingBuffer());
+    }
+
+    return *_ring;
+}
+
+
+uint64_t SerialReaderThread::overflowCount() const
+{
+    return _overflowCount;
+}
+
+
+bool SerialReaderThread::takeError(std::string& message)
+{
+    std::unique_lock<std::mutex> lock(_errorMutex);
+
+    if (_error.empty())
+    {
+        return false;
+    }
+
+    message.swap(_error);
+    _error.clear();
+    return true;
+}
+
+
+void SerialReaderThread::bytesRead(const uint8_t*, std::size_t)
+{
+}
+
+
+void SerialReaderThread::threadedFunction()
+{
+    std::string policyError;
+
+    if (!_policy.applyToCurrentThread(policyError))
+    {
+        ofLogWarning("SerialReaderThread::threadedFunction") << policyError;
+    }
+
+    if (_policy.lockMemory)
+    {
+        ThreadPolicy::prefaultStack();
+    }
+
+    try
+    {
+        while (_running)
+        {
+#if defined(_WIN32)
+            // waitReadable is not implemented on Windows.
+            if (_serial->available() == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+#else
+            if (!_serial->waitReadable(WAKE_INTERVAL_MS))
+            {
+                continue;
+            }
+#endif
+
+            // Only read what is available so that a configured read timeout
+            // never blocks the loop.
+            std::size_t count = std::min<std::size_t>(_serial->available(), _readBuffer.size());
+
+            if (count == 0)
+            {
+                // Disconnected devices, at least on Linux, are always
+                // readable but have nothing to read.
+                throw serial::SerialException("Device reports readiness to read but has no data (device disconnected?)");
+            }
+
+            serial::IOResult result = _serial->tryRead(_readBuffer.data(), count);
+
+            if (result.bytes > 0)
+            {
+                if (_tap != nullptr)
+                {
+                    _tap->tap(AbstractSerialTap::DIRECTION_RX, AbstractSerialTap::now(), _readBuffer.data(), result.bytes);
+                }
+
+                std::size_t written = _ring->write(_readBuffer.data(), result.bytes);
+                _overflowCount += result.bytes - written;
+                bytesRead(_readBuffer.data(), result.bytes);
+            }
+
+            if (!result.ok())
+            {
+                std::unique_lock<std::mutex> lock(_errorMutex);
+                _error = result.message();
+                _running = false;
+            }
+        }
+    }
+    catch (const std::exception& exc)
+    {
+        std::unique_lock<std::mutex> lock(_errorMutex);
+        _error = exc.what();
+        _running = false;
+    }
+}
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,904 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/SerialSimulator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+
+namespace ofx {
+namespace IO {
+
+
+#if !defined(_WIN32)
+
+
+/// \brief The most bytes moved per direction in one step of the thread.
+static const std::size_t MAX_STEP_SIZE = 4096;
+
+
+struct SerialSimulator::Lines
+{
+    std::mutex mutex;
+
+    /// \brief Signalled when a line set by the simulator changes.
+    std::condition_variable condition;
+
+    bool cts = true;
+    bool dsr = true;
+    bool ri = false;
+    bool cd = true;
+    bool rts = true;
+    bool dtr = true;
+
+    /// \brief The flow control set by the application.
+    serial::flowcontrol_t flowControl = serial::flowcontrol_none;
+
+    /// \brief Counts changes of the lines set by the simulator.
+    uint64_t changes = 0;
+
+    /// \brief True once the simulator closed.
+    bool closed = false;
+
+    /// \brief Wakes the simulation thread, or -1.
+    int wakeFd = -1;
+
+    /// \brief Wake the simulation thread. Called with the mutex held.
+    void wake()
+    {
+        if (wakeFd != -1)
+        {
+            uint8_t byte = 0;
+            ssize_t result = ::write(wakeFd, &byte, 1);
+            (void)result;
+        }
+    }
+};
+
+
+/// \brief A port on the pseudo terminal that takes its modem lines from the
+///        simulator.
+class SerialSimulator::Backend: public serial::SerialBackend
+{
+public:
+    Backend(const std::string& port, std::shared_ptr<Lines> lines):
+        _port(port),
+        _serial("", 9600, serial::Timeout(), serial::eightbits, serial::parity_none, serial::stopbits_one, serial::flowcontrol_none, serial::threading_single),
+        _lines(lines)
+    {
+    }
+
+    void open() override
+    {
+        _serial.setPort(_port);
+        _serial.open();
+    }
+
+    void close() override { _serial.close(); }
+    bool isOpen() const override { return _serial.isOpen(); }
+    std::size_t available() override { return _serial.available(); }
+    std::size_t outWaiting() override { return _serial.outWaiting(); }
+    uint32_t getByteTime() const override { return _serial.getByteTime(); }
+    bool waitReadable(uint32_t timeout) override { return _serial.waitReadable(timeout); }
+    void waitByteTimes(std::size_t count) override { _serial.waitByteTimes(count); }
+    serial::IOResult tryRead(uint8_t* buffer, std::size_t size) override { return _serial.tryRead(buffer, size); }
+    serial::IOResult tryWrite(const uint8_t* data, std::size_t size) override { return _serial.tryWrite(data, size); }
+    void flush() override { _serial.flush(); }
+    void flushInput() override { _serial.flushInput(); }
+    void flushOutput() override { _serial.flushOutput(); }
+
+    // A pseudo terminal has no break condition.
+    void sendBreak(int) override {}
+    void setBreak(bool) override {}
+
+    void setRTS(bool level) override { setLine(_lines->rts, level); }
+    void setDTR(bool level) override { setLine(_lines->dtr, level); }
+
+    bool waitForChange() override
+    {
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        uint64_t changes = _lines->changes;
+        _lines->condition.wait(lock, [&]() { return _lines->changes != changes || _lines->closed; });
+        return !_lines->closed;
+    }
+
+    bool getCTS() override { return getLine(_lines->cts); }
+    bool getDSR() override { return getLine(_lines->dsr); }
+    bool getRI() override { return getLine(_lines->ri); }
+    bool getCD() override { return getLine(_lines->cd); }
+
+    void setPort(const std::string& port) override
+    {
+        _port = port;
+        _serial.setPort(port);
+    }
+
+    std::string getPort() const override { return _port; }
+    int getFd() const override { return _serial.getFd(); }
+    void setTimeout(serial::Timeout& timeout) override { _serial.setTimeout(timeout); }
+    serial::Timeout getTimeout() const override { return _serial.getTimeout(); }
+    void setBaudrate(unsigned long baudrate) override { _serial.setBaudrate(baudrate); }
+    unsigned long getBaudrate() const override { return _serial.getBaudrate(); }
+    void setBytesize(serial::bytesize_t bytesize) override { _serial.setBytesize(bytesize); }
+    serial::bytesize_t getBytesize() const override { return _serial.getBytesize(); }
+    void setParity(serial::parity_t parity) override { _serial.setParity(parity); }
+    serial::parity_t getParity() const override { return _serial.getParity(); }
+    void setStopbits(serial::stopbits_t stopbits) override { _serial.setStopbits(stopbits); }
+    serial::stopbits_t getStopbits() const override { return _serial.getStopbits(); }
+
+    void setFlowcontrol(serial::flowcontrol_t flowcontrol) override
+    {
+        _serial.setFlowcontrol(flowcontrol);
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        _lines->flowControl = flowcontrol;
+        _lines->wake();
+    }
+
+    serial::flowcontrol_t getFlowcontrol() const override { return _serial.getFlowcontrol(); }
+    bool setLowLatency(bool) override { return false; }
+    bool getLowLatency() const override { return false; }
+    void readLock() override { _readMutex.lock(); }
+    void readUnlock() override { _readMutex.unlock(); }
+    void writeLock() override { _writeMutex.lock(); }
+    void writeUnlock() override { _writeMutex.unlock(); }
+
+private:
+    void setLine(bool& line, bool level)
+    {
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        line = level;
+        _lines->wake();
+    }
+
+    bool getLine(const bool& line) const
+    {
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        return line;
+    }
+
+    std::string _port;
+    serial::Serial _serial;
+    std::shared_ptr<Lines> _lines;
+    std::mutex _readMutex;
+    std::mutex _writeMutex;
+};
+
+
+SerialSimulator::SerialSimulator(): _stopping(false)
+{
+}
+
+
+SerialSimulator::~SerialSimulator()
+{
+    close();
+}
+
+
+bool SerialSimulator::setup(const Settings& settings)
+{
+    close();
+
+    _master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (_master == -1 || grantpt(_master) != 0 || unlockpt(_master) != 0)
+    {
+        ofLogError("SerialSimulator::setup") << "Unable to open a pseudo terminal: " << std::strerror(errno);
+        close();
+        return false;
+    }
+
+    _portName = ptsname(_master);
+
+    // Keep the slave open so the master never hangs up, and make it raw so
+    // nothing is echoed before the application configures it.
+    _slave = ::open(_portName.c_str(), O_RDWR | O_NOCTTY);
+
+    struct termios options;
+
+    if (_slave == -1
+     || tcgetattr(_slave, &options) != 0
+     || (cfmakeraw(&options), tcsetattr(_slave, TCSANOW, &options)) != 0
+     || pipe(_wakePipe) != 0)
+    {
+        ofLogError("SerialSimulator::setup") << "Unable to set up " << _portName << ": " << std::strerror(errno);
+        close();
+        return false;
+    }
+
+    fcntl(_master, F_SETFL, fcntl(_master, F_GETFL) | O_NONBLOCK);
+    fcntl(_wakePipe[0], F_SETFL, fcntl(_wakePipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(_wakePipe[1], F_SETFL, fcntl(_wakePipe[1], F_GETFL) | O_NONBLOCK);
+
+    _settings = settings;
+    _byteTime = std::max<uint32_t>(1, serial::Serial::calculateByteTime(settings.baudRate,
+                                                                         static_cast<serial::bytesize_t>(settings.dataBits),
+                                                                         static_cast<serial::parity_t>(settings.parity),
+                                                                         static_cast<serial::stopbits_t>(settings.stopBits)));
+    _dataMask = static_cast<uint8_t>((1 << settings.dataBits) - 1);
+    _random.seed(settings.seed);
+    _statistics = Statistics();
+    _txBusy = false;
+    setImpairments(settings.toApplication, settings.fromApplication);
+
+    _lines = std::make_shared<Lines>();
+    _lines->wakeFd = _wakePipe[1];
+
+    _stopping = false;
+    _thread = std::thread(&SerialSimulator::run, this);
+    return true;
+}
+
+
+void SerialSimulator::close()
+{
+    if (_thread.joinable())
+    {
+        _stopping = true;
+        wake();
+        _thread.join();
+    }
+
+    if (_lines)
+    {
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        _lines->closed = true;
+        _lines->wakeFd = -1;
+        _lines->condition.notify_all();
+    }
+
+    for (int* fd: { &_master, &_slave, &_wakePipe[0], &_wakePipe[1] })
+    {
+        if (*fd != -1)
+        {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _lines.reset();
+    _portName.clear();
+    _toApplication.clear();
+    _toApplicationOffset = 0;
+    _toPty.clear();
+    _received.clear();
+}
+
+
+bool SerialSimulator::isOpen() const
+{
+    return _thread.joinable();
+}
+
+
+std::string SerialSimulator::portName() const
+{
+    return _portName;
+}
+
+
+std::shared_ptr<serial::Serial> SerialSimulator::openPort(SerialDevice::ThreadingMode threadingMode)
+{
+    if (!isOpen())
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        auto port = std::make_shared<serial::Serial>(new Backend(_portName, _lines),
+                                                     static_cast<serial::threadingmode_t>(threadingMode));
+        port->setBaudrate(_settings.baudRate);
+        port->setBytesize(static_cast<serial::bytesize_t>(_settings.dataBits));
+        port->setParity(static_cast<serial::parity_t>(_settings.parity));
+        port->setStopbits(static_cast<serial::stopbits_t>(_settings.stopBits));
+        port->open();
+        return port;
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("SerialSimulator::openPort") << exc.what();
+        return nullptr;
+    }
+}
+
+
+void SerialSimulator::write(const uint8_t* buffer, std::size_t size)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // An idle line starts sending now.
+    if (_toApplicationOffset == _toApplication.size())
+    {
+        _rx.clockNanos = std::max(_rx.clockNanos, AbstractSerialTap::now());
+    }
+
+    _toApplication.insert(_toApplication.end(), buffer, buffer + size);
+    wake();
+}
+
+
+void SerialSimulator::write(const std::string& buffer)
+{
+    write(reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size());
+}
+
+
+std::size_t SerialSimulator::outWaiting() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _toApplication.size() - _toApplicationOffset;
+}
+
+
+std::size_t SerialSimulator::read(uint8_t* buffer, std::size_t size)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::size_t count = std::min(size, _received.size());
+    std::copy(_received.begin(), _received.begin() + count, buffer);
+    _received.erase(_received.begin(), _received.begin() + count);
+    return count;
+}
+
+
+std::size_t SerialSimulator::available() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _received.size();
+}
+
+
+bool SerialSimulator::waitReadable(uint32_t timeoutMillis)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _condition.wait_for(lock, std::chrono::milliseconds(timeoutMillis), [&]() { return !_received.empty(); });
+}
+
+
+void SerialSimulator::setImpairments(const Impairments& toApplication,
+                                     const Impairments& fromApplication)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _rx.impairments = toApplication;
+    _tx.impairments = fromApplication;
+
+    for (Direction* direction: { &_rx, &_tx })
+    {
+        direction->bitsUntilError = nextEvent(direction->impairments.bitErrorRate);
+        direction->bytesUntilDrop = nextEvent(direction->impairments.dropRate);
+        direction->bytesUntilBurst = nextEvent(direction->impairments.burstRate);
+        direction->burstLeft = 0;
+    }
+}
+
+
+void SerialSimulator::setClearToSend(bool level)
+{
+    if (_lines)
+    {
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        _lines->cts = level;
+        _lines->changes++;
+        _lines->condition.notify_all();
+        _lines->wake();
+    }
+}
+
+
+void SerialSimulator::setDataSetReady(bool level)
+{
+    if (_lines)
+    {
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        _lines->dsr = level;
+        _lines->changes++;
+        _lines->condition.notify_all();
+    }
+}
+
+
+void SerialSimulator::setRingIndicator(bool level)
+{
+    if (_lines)
+    {
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        _lines->ri = level;
+        _lines->changes++;
+        _lines->condition.notify_all();
+    }
+}
+
+
+void SerialSimulator::setCarrierDetect(bool level)
+{
+    if (_lines)
+    {
+        std::unique_lock<std::mutex> lock(_lines->mutex);
+        _lines->cd = level;
+        _lines->changes++;
+        _lines->condition.notify_all();
+    }
+}
+
+
+bool SerialSimulator::isRequestToSend() const
+{
+    if (!_lines)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(_lines->mutex);
+    return _lines->rts;
+}
+
+
+bool SerialSimulator::isDataTerminalReady() const
+{
+    if (!_lines)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(_lines->mutex);
+    return _lines->dtr;
+}
+
+
+uint32_t SerialSimulator::byteTime() const
+{
+    return _byteTime;
+}
+
+
+SerialSimulator::Statistics SerialSimulator::statistics() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _statistics;
+}
+
+
+void SerialSimulator::run()
+{
+    while (!_stopping)
+    {
+        uint64_t now = AbstractSerialTap::now();
+        uint64_t next = 0;
+        short events = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            uint64_t nextRx = sendToApplication(now);
+            uint64_t nextTx = receiveFromApplication(now);
+            next = nextRx == 0 ? nextTx : (nextTx == 0 ? nextRx : std::min(nextRx, nextTx));
+
+            if (!_toPty.empty())
+            {
+                events |= POLLOUT;
+            }
+
+            if (!_txBusy && !isHeld(false))
+            {
+                events |= POLLIN;
+            }
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = _wakePipe[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = _master;
+        fds[1].events = events;
+
+        int timeout = -1;
+
+        if (next != 0)
+        {
+            // Round up, so the thread wakes after the byte crossed the line.
+            timeout = next > now ? static_cast<int>((next - now + 999999) / 1000000) : 0;
+        }
+
+        if (::poll(fds, 2, timeout) < 0 && errno != EINTR)
+        {
+            ofLogError("SerialSimulator::run") << "Unable to poll: " << std::strerror(errno);
+            return;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            uint8_t buffer[64];
+
+            while (::read(_wakePipe[0], buffer, sizeof(buffer)) > 0)
+            {
+            }
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            // The application wrote to an idle line.
+            std::unique_lock<std::mutex> lock(_mutex);
+            _txBusy = true;
+            _tx.clockNanos = std::max(_tx.clockNanos, AbstractSerialTap::now());
+        }
+    }
+}
+
+
+uint64_t SerialSimulator::sendToApplication(uint64_t now)
+{
+    // Bytes that already crossed the line wait for room in the pty.
+    if (!_toPty.empty())
+    {
+        ssize_t written = ::write(_master, _toPty.data(), _toPty.size());
+
+        if (written > 0)
+        {
+            _toPty.erase(_toPty.begin(), _toPty.begin() + written);
+        }
+
+        if (!_toPty.empty())
+        {
+            _rx.clockNanos = now;
+            return 0;
+        }
+    }
+
+    std::size_t queued = _toApplication.size() - _toApplicationOffset;
+
+    if (queued == 0 || isHeld(true))
+    {
+        _rx.clockNanos = now;
+        return 0;
+    }
+
+    uint64_t due = (now - std::min(now, _rx.clockNanos)) / _byteTime;
+
+    if (due == 0)
+    {
+        return _rx.clockNanos + _byteTime;
+    }
+
+    std::size_t count = static_cast<std::size_t>(std::min<uint64_t>({ due, queued, MAX_STEP_SIZE }));
+    _rx.clockNanos += count * _byteTime;
+
+    std::size_t offset = _toPty.size();
+    _toPty.insert(_toPty.end(),
+                  _toApplication.begin() + _toApplicationOffset,
+                  _toApplication.begin() + _toApplicationOffset + count);
+    _toApplicationOffset += count;
+
+    if (_toApplicationOffset == _toApplication.size())
+    {
+        _toApplication.clear();
+        _toApplicationOffset = 0;
+    }
+    else if (_toApplicationOffset > _toApplication.size() / 2)
+    {
+        _toApplication.erase(_toApplication.begin(), _toApplication.begin() + _toApplicationOffset);
+        _toApplicationOffset = 0;
+    }
+
+    std::size_t kept = impair(_rx, _toPty.data() + offset, count);
+    _toPty.resize(offset + kept);
+    _statistics.bytesToApplication += kept;
+
+    ssize_t written = ::write(_master, _toPty.data(), _toPty.size());
+
+    if (written > 0)
+    {
+        _toPty.erase(_toPty.begin(), _toPty.begin() + written);
+    }
+
+    return _toApplicationOffset < _toApplication.size() ? _rx.clockNanos + _byteTime : 0;
+}
+
+
+uint64_t SerialSimulator::receiveFromApplication(uint64_t now)
+{
+    if (!_txBusy)
+    {
+        return 0;
+    }
+
+    // The application may not send; its bytes wait in the pty.
+    if (isHeld(false))
+    {
+        _txBusy = false;
+        return 0;
+    }
+
+    uint64_t due = (now - std::min(now, _tx.clockNanos)) / _byteTime;
+
+    if (due == 0)
+    {
+        return _tx.clockNanos + _byteTime;
+    }
+
+    uint8_t buffer[MAX_STEP_SIZE];
+    std::size_t wanted = static_cast<std::size_t>(std::min<uint64_t>(due, MAX_STEP_SIZE));
+    ssize_t count = ::read(_master, buffer, wanted);
+
+    if (count <= 0)
+    {
+        _txBusy = false;
+        return 0;
+    }
+
+    _tx.clockNanos += count * _byteTime;
+
+    std::size_t kept = impair(_tx, buffer, count);
+    _statistics.bytesFromApplication += kept;
+
+    if (_settings.echo)
+    {
+        if (_toApplicationOffset == _toApplication.size())
+        {
+            _rx.clockNanos = std::max(_rx.clockNanos, now);
+        }
+
+        _toApplication.insert(_toApplication.end(), buffer, buffer + kept);
+    }
+    else if (kept > 0)
+    {
+        _received.insert(_received.end(), buffer, buffer + kept);
+        _condition.notify_all();
+    }
+
+    // Reading less than was due means the application stopped writing.
+    if (static_cast<std::size_t>(count) < wanted)
+    {
+        _txBusy = false;
+        return 0;
+    }
+
+    return _tx.clockNanos + _byteTime;
+}
+
+
+std::size_t SerialSimulator::impair(Direction& direction, uint8_t* data, std::size_t size)
+{
+    std::size_t dataBits = _settings.dataBits;
+    std::size_t kept = 0;
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        uint8_t original = data[i] & _dataMask;
+        uint8_t byte = original;
+
+        if (direction.bytesUntilDrop-- == 0)
+        {
+            direction.bytesUntilDrop = nextEvent(direction.impairments.dropRate);
+            _statistics.droppedBytes++;
+            continue;
+        }
+
+        if (direction.burstLeft > 0)
+        {
+            direction.burstLeft--;
+            byte = static_cast<uint8_t>(_random());
+        }
+        else if (direction.bytesUntilBurst-- == 0)
+        {
+            direction.bytesUntilBurst = nextEvent(direction.impairments.burstRate);
+            direction.burstLeft = std::max<std::size_t>(direction.impairments.burstLength, 1) - 1;
+            byte = static_cast<uint8_t>(_random());
+        }
+
+        // Flip the data bits the error counter lands on.
+        std::size_t bit = 0;
+
+        while (direction.bitsUntilError < dataBits - bit)
+        {
+            bit += direction.bitsUntilError;
+            byte ^= 1 << bit;
+            bit++;
+            direction.bitsUntilError = nextEvent(direction.impairments.bitErrorRate);
+        }
+
+        direction.bitsUntilError -= dataBits - bit;
+
+        byte &= _dataMask;
+
+        if (byte != original)
+        {
+            _statistics.corruptedBytes++;
+        }
+
+        data[kept++] = byte;
+    }
+
+    return kept;
+}
+
+
+uint64_t SerialSimulator::nextEvent(double probability)
+{
+    if (probability <= 0)
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    if (probability >= 1)
+    {
+        return 0;
+    }
+
+    return std::geometric_distribution<uint64_t>(probability)(_random);
+}
+
+
+void SerialSimulator::wake()
+{
+    if (_wakePipe[1] != -1)
+    {
+        uint8_t byte = 0;
+        ssize_t result = ::write(_wakePipe[1], &byte, 1);
+        (void)result;
+    }
+}
+
+
+bool SerialSimulator::isHeld(bool toApplication) const
+{
+    std::unique_lock<std::mutex> lock(_lines->mutex);
+
+    if (_lines->flowControl != serial::flowcontrol_hardware)
+    {
+        return false;
+    }
+
+    return toApplication ? !_lines->rts : !_lines->cts;
+}
+
+
+#else
+
+
+struct SerialSimulator::Lines
+{
+};
+
+
+SerialSimulator::SerialSimulator(): _stopping(false)
+{
+}
+
+
+SerialSimulator::~SerialSimulator()
+{
+}
+
+
+bool SerialSimulator::setup(const Settings&)
+{
+    ofLogError("SerialSimulator::setup") << "Pseudo terminals are not available on Windows.";
+    return false;
+}
+
+
+void SerialSimulator::close()
+{
+}
+
+
+bool SerialSimulator::isOpen() const
+{
+    return false;
+}
+
+
+std::string SerialSimulator::portName() const
+{
+    return _portName;
+}
+
+
+std::shared_ptr<serial::Serial> SerialSimulator::openPort(SerialDevice::ThreadingMode)
+{
+    return nullptr;
+}
+
+
+void SerialSimulator::write(const uint8_t*, std::size_t)
+{
+}
+
+
+void SerialSimulator::write(const std::string&)
+{
+}
+
+
+std::size_t SerialSimulator::outWaiting() const
+{
+    return 0;
+}
+
+
+std::size_t SerialSimulator::read(uint8_t*, std::size_t)
+{
+    return 0;
+}
+
+
+std::size_t SerialSimulator::available() const
+{
+    return 0;
+}
+
+
+bool SerialSimulator::waitReadable(uint32_t)
+{
+    return false;
+}
+
+
+void SerialSimulator::setImpairments(const Impairments&, const Impairments&)
+{
+}
+
+
+void SerialSimulator::setClearToSend(bool)
+{
+}
+
+
+void SerialSimulator::setDataSetReady(bool)
+{
+}
+
+
+void SerialSimulator::setRingIndicator(bool)
+{
+}
+
+
+void SerialSimulator::setCarrierDetect(bool)
+{
+}
+
+
+bool SerialSimulator::isRequestToSend() const
+{
+    return false;
+}
+
+
+bool SerialSimulator::isDataTerminalReady() const
+{
+    return false;
+}
+
+
+uint32_t SerialSimulator::byteTime() const
+{
+    return 0;
+}
+
+
+SerialSimulator::Statistics SerialSimulator::statistics() const
+{
+    return Statistics();
+}
+
+
+#endif
+
+
+} } // namespace ofx::IO
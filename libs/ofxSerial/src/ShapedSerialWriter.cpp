@@ -0,0 +1,183 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/ShapedSerialWriter.h"
+#include <algorithm>
+#include <chrono>
+
+
+namespace ofx {
+namespace IO {
+
+
+ShapedSerialWriter::ShapedSerialWriter(): _running(false)
+{
+}
+
+
+ShapedSerialWriter::~ShapedSerialWriter()
+{
+    close();
+}
+
+
+void ShapedSerialWriter::setup(SerialDevice& device, uint64_t maxLatencyMicros)
+{
+    close();
+
+    _device = &device;
+
+    uint64_t byteTime = std::max<uint64_t>(_device->byteTime(), 1);
+
+    _maxBytesInFlight = std::max<std::size_t>(maxLatencyMicros * 1000 / byteTime,
+                                              MIN_BYTES_IN_FLIGHT);
+
+    _running = true;
+    _thread = std::thread(&ShapedSerialWriter::threadedFunction, this);
+}
+
+
+void ShapedSerialWriter::close()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+        _queue.clear();
+        _queuedBytes = 0;
+    }
+
+    _condition.notify_all();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+
+bool ShapedSerialWriter::write(const uint8_t* data, std::size_t size, int priority)
+{
+    if (!_running)
+    {
+        return false;
+    }
+
+    Message message;
+    message.priority = priority;
+    message.data.assign(data, data + size);
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        message.sequence = _sequence++;
+        _queuedBytes += size;
+        _queue.push_back(std::move(message));
+        std::push_heap(_queue.begin(), _queue.end());
+    }
+
+    _condition.notify_one();
+    return true;
+}
+
+
+bool ShapedSerialWriter::write(const ByteBuffer& buffer, int priority)
+{
+    return write(buffer.getPtr(), buffer.size(), priority);
+}
+
+
+std::size_t ShapedSerialWriter::queuedBytes() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _queuedBytes;
+}
+
+
+std::size_t ShapedSerialWriter::maxBytesInFlight() const
+{
+    return _maxBytesInFlight;
+}
+
+
+void ShapedSerialWriter::threadedFunction()
+{
+    while (_running)
+    {
+        Message message;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _condition.wait(lock, [&]() { return !_running || !_queue.empty(); });
+
+            if (!_running)
+            {
+                return;
+            }
+
+            std::pop_heap(_queue.begin(), _queue.end());
+            message = std::move(_queue.back());
+            _queue.pop_back();
+            _queuedBytes -= message.data.size();
+        }
+
+        std::size_t offset = 0;
+
+        try
+        {
+            while (_running && offset < message.data.size())
+            {
+                if (!_device->isOpen())
+                {
+                    ofLogError("ShapedSerialWriter::threadedFunction") << "Dropping message, the port is closed.";
+                    break;
+                }
+
+                std::size_t pending = _device->outWaiting();
+
+                if (pending >= _maxBytesInFlight)
+                {
+                    // Wait until about half of the bytes in flight are sent.
+                    std::size_t drain = pending - _maxBytesInFlight / 2;
+                    waitFor(uint64_t(drain) * _device->byteTime());
+                    continue;
+                }
+
+                std::size_t count = std::min(_maxBytesInFlight - pending,
+                                             message.data.size() - offset);
+
+                std::size_t written = _device->writeBytes(message.data.data() + offset, count);
+                offset += written;
+
+                if (written == 0)
+                {
+                    // The write timed out.
+                    waitFor(0);
+                }
+            }
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogError("ShapedSerialWriter::threadedFunction") << "Dropping message: " << exc.what();
+        }
+    }
+}
+
+
+void ShapedSerialWriter::waitFor(uint64_t nanos)
+{
+    // A byte time of 0 means the line speed is unknown, not infinite.
+    if (nanos == 0)
+    {
+        nanos = uint64_t(RETRY_MICROS) * 1000;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait_for(lock, std::chrono::nanoseconds(nanos), [&]() { return !_running; });
+}
+
+
+} } // namespace ofx::IO
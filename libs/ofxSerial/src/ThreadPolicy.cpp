@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2010 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:    MIT
+//
+
+
+#include "ofx/IO/ThreadPolicy.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+
+namespace ofx {
+namespace IO {
+
+
+ThreadPolicy ThreadPolicy::realtime(int priority, int cpu)
+{
+    ThreadPolicy policy;
+    policy.scheduler = SCHEDULER_FIFO;
+    policy.priority = priority;
+    policy.cpu = cpu;
+    policy.lockMemory = true;
+    return policy;
+}
+
+
+bool ThreadPolicy::applyToCurrentThread(std::string& errorMessage) const
+{
+    std::stringstream ss;
+
+#if defined(_WIN32)
+    if (scheduler != SCHEDULER_DEFAULT)
+    {
+        if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+        {
+            ss << "Unable to set thread priority: " << GetLastError() << ". ";
+        }
+    }
+
+    if (cpu != CPU_ANY)
+    {
+        if (cpu >= int(sizeof(DWORD_PTR) * 8) || !SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu))
+        {
+            ss << "Unable to pin thread to CPU " << cpu << ": " << GetLastError() << ". ";
+        }
+    }
+#else
+    if (scheduler != SCHEDULER_DEFAULT)
+    {
+        int policy = (scheduler == SCHEDULER_FIFO) ? SCHED_FIFO : SCHED_RR;
+
+        sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        param.sched_priority = std::max(sched_get_priority_min(policy),
+                                        std::min(priority, sched_get_priority_max(policy)));
+
+        int result = pthread_setschedparam(pthread_self(), policy, &param);
+
+        if (result != 0)
+        {
+            ss << "Unable to set real-time scheduling: " << std::strerror(result) << ". ";
+        }
+    }
+
+    if (cpu != CPU_ANY)
+    {
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+        {
+            ss << "Invalid CPU " << cpu << ". ";
+        }
+        else
+        {
+            CPU_SET(cpu, &cpus);
+
+            int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+            if (result != 0)
+            {
+                ss << "Unable to pin thread to CPU " << cpu << ": " << std::strerror(result) << ". ";
+            }
+        }
+#else
+        // macOS only supports affinity hints between threads, not pinning.
+        ss << "CPU pinning is not supported on this platform. ";
+#endif
+    }
+#endif
+
+    errorMessage = ss.str();
+    return errorMessage.empty();
+}
+
+
+bool ThreadPolicy::lock(void* data, std::size_t size)
+{
+    if (data == nullptr || size == 0)
+    {
+        return true;
+    }
+
+#if defined(_WIN32)
+    bool locked = VirtualLock(data, size) != 0;
+#else
+    bool locked = mlock(data, size) == 0;
+#endif
+
+    // Touch every page so that none fault on first use.
+    volatile uint8_t* bytes = static_cast<volatile uint8_t*>(data);
+
+    for (std::size_t i = 0; i < size; i += 4096)
+    {
+        bytes[i] = bytes[i];
+    }
+
+    return locked;
+}
+
+
+void ThreadPolicy::unlock(void* data, std::size_t size)
+{
+    if (data == nullptr || size == 0)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+    VirtualUnlock(data, size);
+#else
+    munlock(data, size);
+#endif
+}
+
+
+void ThreadPolicy::prefaultStack(std::size_t size)
+{
+    // Touch a local buffer one page at a time. It is volatile so the writes
+    // are not optimized away.
+    const std::size_t pageSize = 4096;
+    volatile uint8_t stack[DEFAULT_PREFAULT_STACK_SIZE];
+
+    size = std::min<std::size_t>(size, sizeof(stack));
+
+    for (std::size_t i = 0; i < size; i += pageSize)
+    {
+        stack[i] = 0;
+    }
+}
+
+
+} } // namespace ofx::IO
@@ -0,0 +1,253 @@
+/*!
+ * \file serial/impl/loopback.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Copyright (c) 2012 William Woodall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides an in-memory backend for the Serial class, used for ports
+ * named loop://.  Nothing touches the operating system: written bytes are
+ * copied straight into the receive buffer of the other end, so tests and
+ * benchmarks run at memory speed and always see the same bytes.
+ *
+ * "loop://" is a loopback plug; the port reads what it writes.  Ports named
+ * "loop://name" are the two ends of a null modem cable; the first two ports
+ * opened with the same name are connected, and what one writes the other
+ * reads.  Bytes written while the other end is closed are lost.
+ *
+ * The modem lines are wired like the plug or cable: RTS drives CTS and DTR
+ * drives DSR and CD of the receiving end.  RI stays low and breaks are not
+ * carried.  The settings are kept and determine getByteTime(), but never
+ * change the bytes, and waitByteTimes() does not wait.
+ *
+ * A full receive buffer holds writers back until the write timeout.
+ * getFd() creates a pipe that is readable while bytes are waiting, so the
+ * port can be polled like a local one; until then no system calls are made.
+ */
+
+#if !defined(_WIN32)
+
+#ifndef SERIAL_IMPL_LOOPBACK_H
+#define SERIAL_IMPL_LOOPBACK_H
+
+#include "serial/serial.h"
+
+#include <map>
+#include <pthread.h>
+
+namespace serial {
+
+using std::size_t;
+using std::string;
+
+class LoopbackImpl : public SerialBackend {
+public:
+  LoopbackImpl (const string &port,
+                unsigned long baudrate,
+                bytesize_t bytesize,
+                parity_t parity,
+                stopbits_t stopbits,
+                flowcontrol_t flowcontrol);
+
+  virtual ~LoopbackImpl ();
+
+  void
+  open ();
+
+  void
+  close ();
+
+  bool
+  isOpen () const;
+
+  size_t
+  available ();
+
+  size_t
+  outWaiting ();
+
+  uint32_t
+  getByteTime () const;
+
+  bool
+  waitReadable (uint32_t timeout);
+
+  void
+  waitByteTimes (size_t count);
+
+  IOResult
+  tryRead (uint8_t *buf, size_t size = 1);
+
+  IOResult
+  tryWrite (const uint8_t *data, size_t length);
+
+  void
+  flush ();
+
+  void
+  flushInput ();
+
+  void
+  flushOutput ();
+
+  void
+  sendBreak (int duration);
+
+  void
+  setBreak (bool level);
+
+  void
+  setRTS (bool level);
+
+  void
+  setDTR (bool level);
+
+  bool
+  waitForChange ();
+
+  bool
+  getCTS ();
+
+  bool
+  getDSR ();
+
+  bool
+  getRI ();
+
+  bool
+  getCD ();
+
+  void
+  setPort (const string &port);
+
+  string
+  getPort () const;
+
+  int
+  getFd () const;
+
+  void
+  setTimeout (Timeout &timeout);
+
+  Timeout
+  getTimeout () const;
+
+  void
+  setBaudrate (unsigned long baudrate);
+
+  unsigned long
+  getBaudrate () const;
+
+  void
+  setBytesize (bytesize_t bytesize);
+
+  bytesize_t
+  getBytesize () const;
+
+  void
+  setParity (parity_t parity);
+
+  parity_t
+  getParity () const;
+
+  void
+  setStopbits (stopbits_t stopbits);
+
+  stopbits_t
+  getStopbits () const;
+
+  void
+  setFlowcontrol (flowcontrol_t flowcontrol);
+
+  flowcontrol_t
+  getFlowcontrol () const;
+
+  bool
+  setLowLatency (bool low_latency);
+
+  bool
+  getLowLatency () const;
+
+  void
+  readLock ();
+
+  void
+  readUnlock ();
+
+  void
+  writeLock ();
+
+  void
+  writeUnlock ();
+
+  // Bytes waiting at one end before writes to it wait.
+  static const size_t receive_buffer_size = 1048576;
+
+private:
+  // The plug or cable, shared by the ports on it.
+  struct Link;
+
+  // The cables by name, guarded by a global mutex.  A cable stays here
+  // while any port holds it.
+  static std::map<string, Link *> &
+  cables ();
+
+  // Detaches from the link and deletes it if this was the last port.
+  void
+  release ();
+
+  // The end this port writes to.
+  int
+  peer () const;
+
+  // Waits up to timeout_ms for link_->condition.  Called with the link
+  // mutex held.
+  void
+  wait (int64_t timeout_ms);
+
+  string port_;               // The loop:// name
+  Link *link_;                // The plug or cable, or NULL
+  int end_;                   // The end of the link this port uses
+  bool is_open_;
+
+  Timeout timeout_;           // Timeout for read operations
+  unsigned long baudrate_;    // Baudrate
+  parity_t parity_;           // Parity
+  bytesize_t bytesize_;       // Size of the bytes
+  stopbits_t stopbits_;       // Stop Bits
+  flowcontrol_t flowcontrol_; // Flow Control
+  bool low_latency_;          // Low latency mode requested
+
+  // Mutex used to lock the read functions
+  pthread_mutex_t read_mutex;
+  // Mutex used to lock the write functions
+  pthread_mutex_t write_mutex;
+};
+
+}
+
+#endif // SERIAL_IMPL_LOOPBACK_H
+
+#endif // !defined(_WIN32)
@@ -0,0 +1,328 @@
+/*!
+ * \file serial/impl/rfc2217.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Copyright (c) 2012 William Woodall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides an RFC 2217 client backend for the Serial class, used for
+ * ports named rfc2217://host:port.  The port is reached over a TCP
+ * connection with Nagle's algorithm disabled.
+ *
+ * Nothing waits for the server once the port is open.  Data and com port
+ * commands share one send queue, in order, and every call sends all that
+ * is queued with a single send(), so writes made while the socket is busy
+ * leave together.  Settings are sent without waiting for their answers and
+ * read back from a local copy, which the answers correct if the server
+ * rejects a change.  Opening the port waits for one round trip while the
+ * options and settings are negotiated together.
+ *
+ * A receive thread parses the Telnet stream, keeps the received bytes and
+ * the modem lines reported by the server.  getFd() returns a pipe that is
+ * readable while received bytes are waiting, so the port can be polled
+ * like a local one.
+ */
+
+#if !defined(_WIN32)
+
+#ifndef SERIAL_IMPL_RFC2217_H
+#define SERIAL_IMPL_RFC2217_H
+
+#include "serial/serial.h"
+#include "serial/rfc2217.h"
+
+#include <pthread.h>
+
+namespace serial {
+
+using std::size_t;
+using std::string;
+
+class RFC2217Impl : public SerialBackend {
+public:
+  RFC2217Impl (const string &port,
+               unsigned long baudrate,
+               bytesize_t bytesize,
+               parity_t parity,
+               stopbits_t stopbits,
+               flowcontrol_t flowcontrol);
+
+  virtual ~RFC2217Impl ();
+
+  void
+  open ();
+
+  void
+  close ();
+
+  bool
+  isOpen () const;
+
+  size_t
+  available ();
+
+  size_t
+  outWaiting ();
+
+  uint32_t
+  getByteTime () const;
+
+  bool
+  waitReadable (uint32_t timeout);
+
+  void
+  waitByteTimes (size_t count);
+
+  IOResult
+  tryRead (uint8_t *buf, size_t size = 1);
+
+  IOResult
+  tryWrite (const uint8_t *data, size_t length);
+
+  void
+  flush ();
+
+  void
+  flushInput ();
+
+  void
+  flushOutput ();
+
+  void
+  sendBreak (int duration);
+
+  void
+  setBreak (bool level);
+
+  void
+  setRTS (bool level);
+
+  void
+  setDTR (bool level);
+
+  bool
+  waitForChange ();
+
+  bool
+  getCTS ();
+
+  bool
+  getDSR ();
+
+  bool
+  getRI ();
+
+  bool
+  getCD ();
+
+  void
+  setPort (const string &port);
+
+  string
+  getPort () const;
+
+  int
+  getFd () const;
+
+  void
+  setTimeout (Timeout &timeout);
+
+  Timeout
+  getTimeout () const;
+
+  void
+  setBaudrate (unsigned long baudrate);
+
+  unsigned long
+  getBaudrate () const;
+
+  void
+  setBytesize (bytesize_t bytesize);
+
+  bytesize_t
+  getBytesize () const;
+
+  void
+  setParity (parity_t parity);
+
+  parity_t
+  getParity () const;
+
+  void
+  setStopbits (stopbits_t stopbits);
+
+  stopbits_t
+  getStopbits () const;
+
+  void
+  setFlowcontrol (flowcontrol_t flowcontrol);
+
+  flowcontrol_t
+  getFlowcontrol () const;
+
+  bool
+  setLowLatency (bool low_latency);
+
+  bool
+  getLowLatency () const;
+
+  void
+  readLock ();
+
+  void
+  readUnlock ();
+
+  void
+  writeLock ();
+
+  void
+  writeUnlock ();
+
+  // How long open waits for the connection and the server's answers.
+  static const uint32_t open_timeout_ms = 5000;
+  // Bytes queued for sending before writes wait for the socket.
+  static const size_t send_queue_size = 65536;
+  // Bytes received before the receive thread stops reading the socket.
+  static const size_t receive_buffer_size = 1048576;
+
+private:
+  typedef enum {
+    parse_data,
+    parse_iac,
+    parse_option,
+    parse_subnegotiation,
+    parse_subnegotiation_iac
+  } parse_state_t;
+
+  // Connects to host_:service_ within the open timeout.
+  void
+  connect ();
+
+  // The receive thread.
+  static void *
+  receiveThread (void *impl);
+
+  void
+  receive ();
+
+  // Handles bytes from the server.  Called with state_mutex_ held.
+  void
+  parse (const uint8_t *data, size_t size);
+
+  void
+  negotiate (uint8_t command, uint8_t option);
+
+  void
+  subnegotiate ();
+
+  // Queues a com port command and sends the queue.
+  void
+  sendCommand (uint8_t command, const uint8_t *value, size_t size);
+
+  void
+  sendCommand (uint8_t command, uint8_t value);
+
+  // Sends as much of the queue as the socket takes without blocking.
+  // Returns false with errno set if the connection failed.  Called with
+  // send_mutex_ held.
+  bool
+  sendQueue ();
+
+  // Waits up to timeout_ms for the socket to take more bytes.
+  bool
+  waitWritable (int64_t timeout_ms);
+
+  // Moves up to size received bytes into buf.
+  size_t
+  take (uint8_t *buf, size_t size);
+
+  // Updates the ready pipe after rx_ changed.  Called with state_mutex_
+  // held.
+  void
+  updateReady ();
+
+  // Wakes the receive thread.
+  void
+  wake ();
+
+  void
+  updateByteTime ();
+
+  string port_;               // The rfc2217:// URL
+  string host_;               // Host of the server
+  string service_;            // TCP port of the server
+
+  int socket_;                // The connection, or -1
+  int ready_pipe_[2];         // Readable while bytes are waiting
+  int wake_pipe_[2];          // Wakes the receive thread
+  bool ready_;                // True while ready_pipe_ holds a byte
+  bool is_open_;
+  pthread_t thread_;          // The receive thread
+
+  Timeout timeout_;           // Timeout for read operations
+  unsigned long baudrate_;    // Baudrate
+  uint32_t byte_time_ns_;     // Nanoseconds to transmit/receive a single byte
+  parity_t parity_;           // Parity
+  bytesize_t bytesize_;       // Size of the bytes
+  stopbits_t stopbits_;       // Stop Bits
+  flowcontrol_t flowcontrol_; // Flow Control
+  bool low_latency_;          // Low latency mode requested
+
+  // Guards the state shared with the receive thread, below.
+  mutable pthread_mutex_t state_mutex_;
+  // Signalled when answers or modem line changes arrive.
+  pthread_cond_t state_cond_;
+
+  std::vector<uint8_t> rx_;   // Received bytes, from rx_offset_ on
+  size_t rx_offset_;
+  bool stopping_;             // Asks the receive thread to exit
+  bool connected_;            // False once the connection is gone
+  uint8_t modem_state_;       // The last notify_modemstate value
+  unsigned long modem_changes_; // Counts modem state changes
+  unsigned outstanding_[rfc2217::purge_data + 1]; // Unanswered commands
+  bool com_port_answered_;    // The server answered WILL COM-PORT-OPTION
+  bool com_port_refused_;     // The server does not speak RFC 2217
+  uint64_t local_options_;    // Telnet options enabled on our side
+  uint64_t remote_options_;   // Telnet options enabled on the server
+
+  parse_state_t parse_state_; // Telnet parser state
+  uint8_t parse_command_;     // The WILL, WONT, DO or DONT being parsed
+  std::vector<uint8_t> subnegotiation_;
+
+  // Guards the send queue.
+  pthread_mutex_t send_mutex_;
+  std::vector<uint8_t> tx_;   // Escaped bytes and commands to send
+
+  // Mutex used to lock the read functions
+  pthread_mutex_t read_mutex;
+  // Mutex used to lock the write functions
+  pthread_mutex_t write_mutex;
+};
+
+}
+
+#endif // SERIAL_IMPL_RFC2217_H
+
+#endif // !defined(_WIN32)
@@ -0,0 +1,82 @@
+/*!
+ * \file serial/impl/termios2_linux.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Copyright (c) 2012 William Woodall, John Harrison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * Arbitrary baudrates on Linux using the termios2 TCGETS2 / TCSETS2 ioctls
+ * and the BOTHER speed flag.
+ *
+ * The kernel's struct termios2 and glibc's struct termios cannot be declared
+ * in the same translation unit, so these helpers are kept apart from
+ * unix.cc and only deal in plain integers.
+ *
+ */
+
+#if defined(__linux__)
+
+#ifndef SERIAL_IMPL_TERMIOS2_LINUX_H
+#define SERIAL_IMPL_TERMIOS2_LINUX_H
+
+#include <stdint.h>
+
+namespace serial {
+namespace termios2 {
+
+/*!
+ * Sets the input and output speed of an open port to an arbitrary rate.
+ *
+ * All other settings of the port are left unchanged.
+ *
+ * \param fd The file descriptor of the open port.
+ * \param baudrate The requested rate in bits per second.
+ *
+ * \return 0 on success, otherwise the errno of the failed ioctl. ENOTTY or
+ * EINVAL mean the kernel or driver does not support termios2.
+ */
+int
+set_baudrate (int fd, uint32_t baudrate);
+
+/*!
+ * Reads back the output speed of an open port.
+ *
+ * Drivers round the requested rate to the nearest one their clock can
+ * generate, so this may differ from the rate passed to set_baudrate.
+ *
+ * \param fd The file descriptor of the open port.
+ * \param baudrate Set to the current output rate in bits per second.
+ *
+ * \return 0 on success, otherwise the errno of the failed ioctl.
+ */
+int
+get_baudrate (int fd, uint32_t &baudrate);
+
+} // namespace termios2
+} // namespace serial
+
+#endif // SERIAL_IMPL_TERMIOS2_LINUX_H
+
+#endif // defined(__linux__)
@@ -31,7 +31,8 @@
  * \section DESCRIPTION
  *
  * This provides a unix based pimpl for the Serial class. This implementation is
- * based off termios.h and uses select for multiplexing the IO ports.
+ * based off termios.h and uses ppoll for multiplexing the IO ports (select on
+ * OS X, where poll does not support devices).
  *
  */
 
@@ -43,6 +44,7 @@
 #include "serial/serial.h"
 
 #include <pthread.h>
+#include <termios.h>
 
 namespace serial {
 
@@ -53,17 +55,30 @@ using std::invalid_argument;
 using serial::SerialException;
 using serial::IOException;
 
+#if defined(__linux__)
+/*
+ * Returns the sysfs latency_timer attribute of an FTDI adapter, or an empty
+ * string if the port is not an FTDI adapter.  Implemented alongside the
+ * sysfs walk in list_ports_linux.cc.
+ */
+string
+ftdi_latency_timer_path (const string &port);
+#endif
+
 class MillisecondTimer {
 public:
-  MillisecondTimer(const uint32_t millis);         
+  MillisecondTimer(const uint32_t millis);
   int64_t remaining();
+  int64_t remaining_ns();
+
+  // Monotonic time in nanoseconds.
+  static int64_t now_ns();
 
 private:
-  static timespec timespec_now();
-  timespec expiry;
+  int64_t expiry_ns;
 };
 
-class serial::Serial::SerialImpl {
+class serial::Serial::SerialImpl : public SerialBackend {
 public:
   SerialImpl (const string &port,
               unsigned long baudrate,
@@ -86,17 +101,29 @@ public:
   size_t
   available ();
 
+  size_t
+  outWaiting ();
+
+  uint32_t
+  getByteTime () const;
+
   bool
   waitReadable (uint32_t timeout);
 
   void
   waitByteTimes (size_t count);
 
-  size_t
-  read (uint8_t *buf, size_t size = 1);
+  // Waits for the port to become readable or writable, or for timeout_ns
+  // nanoseconds. Returns 1 when ready, 0 on timeout or interruption and -1
+  // on error with errno set. Never throws.
+  int
+  waitReady (bool write, int64_t timeout_ns);
 
-  size_t
-  write (const uint8_t *data, size_t length);
+  IOResult
+  tryRead (uint8_t *buf, size_t size = 1);
+
+  IOResult
+  tryWrite (const uint8_t *data, size_t length);
 
   void
   flush ();
@@ -140,6 +167,9 @@ public:
   string
   getPort () const;
 
+  int
+  getFd () const;
+
   void
   setTimeout (Timeout &timeout);
 
@@ -176,6 +206,12 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  bool
+  setLowLatency (bool low_latency);
+
+  bool
+  getLowLatency () const;
+
   void
   readLock ();
 
@@ -192,6 +228,11 @@ protected:
   void reconfigurePort ();
 
 private:
+#if defined(__linux__)
+  // Sets a baudrate without a B* constant. Returns the rate actually set.
+  unsigned long setCustomBaudrate (termios &options);
+#endif
+
   string port_;               // Path to the file descriptor
   int fd_;                    // The current file descriptor
 
@@ -208,6 +249,17 @@ private:
   stopbits_t stopbits_;       // Stop Bits
   flowcontrol_t flowcontrol_; // Flow Control
 
+  bool low_latency_;          // Low latency mode requested
+#if defined(__linux__)
+  // Applies or restores the low latency settings of the open port.
+  bool applyLowLatency ();
+  void restoreLowLatency ();
+
+  int original_serial_flags_; // ASYNC_* flags before low latency, or -1
+  string latency_timer_path_; // FTDI latency_timer sysfs attribute, if any
+  string original_latency_timer_; // latency_timer before low latency
+#endif
+
   // Mutex used to lock the read functions
   pthread_mutex_t read_mutex;
   // Mutex used to lock the write functions
@@ -52,7 +52,7 @@ using std::invalid_argument;
 using serial::SerialException;
 using serial::IOException;
 
-class serial::Serial::SerialImpl {
+class serial::Serial::SerialImpl : public SerialBackend {
 public:
   SerialImpl (const string &port,
               unsigned long baudrate,
@@ -74,6 +74,12 @@ public:
 
   size_t
   available ();
+
+  size_t
+  outWaiting ();
+
+  uint32_t
+  getByteTime () const;
   
   bool
   waitReadable (uint32_t timeout);
@@ -81,11 +87,11 @@ public:
   void
   waitByteTimes (size_t count);
 
-  size_t
-  read (uint8_t *buf, size_t size = 1);
+  IOResult
+  tryRead (uint8_t *buf, size_t size = 1);
 
-  size_t
-  write (const uint8_t *data, size_t length);
+  IOResult
+  tryWrite (const uint8_t *data, size_t length);
 
   void
   flush ();
@@ -129,6 +135,9 @@ public:
   string
   getPort () const;
 
+  int
+  getFd () const;
+
   void
   setTimeout (Timeout &timeout);
 
@@ -165,6 +174,12 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  bool
+  setLowLatency (bool low_latency);
+
+  bool
+  getLowLatency () const;
+
   void
   readLock ();
 
@@ -194,6 +209,8 @@ private:
   stopbits_t stopbits_;       // Stop Bits
   flowcontrol_t flowcontrol_; // Flow Control
 
+  bool low_latency_;          // Low latency mode requested
+
   // Mutex used to lock the read functions
   HANDLE read_mutex;
   // Mutex used to lock the write functions
@@ -0,0 +1,258 @@
+/*!
+ * \file serial/rfc2217.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Copyright (c) 2012 William Woodall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * Telnet and RFC 2217 (Telnet Com Port Control Option) constants shared by
+ * the RFC 2217 server and client, and the mapping between the RFC 2217 wire
+ * values and the serial port settings.
+ */
+
+#ifndef SERIAL_RFC2217_H
+#define SERIAL_RFC2217_H
+
+#include <serial/serial.h>
+
+namespace serial {
+namespace rfc2217 {
+
+/*!
+ * Telnet commands, RFC 854.
+ */
+typedef enum {
+  telnet_se = 240,
+  telnet_nop = 241,
+  telnet_sb = 250,
+  telnet_will = 251,
+  telnet_wont = 252,
+  telnet_do = 253,
+  telnet_dont = 254,
+  telnet_iac = 255
+} telnet_command_t;
+
+/*!
+ * Telnet options used by RFC 2217 connections.
+ */
+typedef enum {
+  option_binary = 0,
+  option_suppress_go_ahead = 3,
+  option_com_port = 44
+} telnet_option_t;
+
+/*!
+ * Com port subnegotiation commands sent by the client. The server answers
+ * each with the command plus server_offset.
+ */
+typedef enum {
+  signature = 0,
+  set_baudrate = 1,
+  set_datasize = 2,
+  set_parity = 3,
+  set_stopsize = 4,
+  set_control = 5,
+  notify_linestate = 6,
+  notify_modemstate = 7,
+  flowcontrol_suspend = 8,
+  flowcontrol_resume = 9,
+  set_linestate_mask = 10,
+  set_modemstate_mask = 11,
+  purge_data = 12
+} command_t;
+
+/*!
+ * Added to a command in the answers from the server.
+ */
+const uint8_t server_offset = 100;
+
+/*!
+ * Values of the set_parity command. Zero asks for the current value.
+ */
+typedef enum {
+  parity_request = 0,
+  parity_value_none = 1,
+  parity_value_odd = 2,
+  parity_value_even = 3,
+  parity_value_mark = 4,
+  parity_value_space = 5
+} parity_value_t;
+
+/*!
+ * Values of the set_stopsize command. Zero asks for the current value.
+ */
+typedef enum {
+  stopsize_request = 0,
+  stopsize_value_one = 1,
+  stopsize_value_two = 2,
+  stopsize_value_one_point_five = 3
+} stopsize_value_t;
+
+/*!
+ * Values of the set_control command.
+ */
+typedef enum {
+  control_flow_request = 0,
+  control_flow_none = 1,
+  control_flow_software = 2,
+  control_flow_hardware = 3,
+  control_break_request = 4,
+  control_break_on = 5,
+  control_break_off = 6,
+  control_dtr_request = 7,
+  control_dtr_on = 8,
+  control_dtr_off = 9,
+  control_rts_request = 10,
+  control_rts_on = 11,
+  control_rts_off = 12
+} control_value_t;
+
+/*!
+ * Values of the purge_data command.
+ */
+typedef enum {
+  purge_receive = 1,
+  purge_transmit = 2,
+  purge_both = 3
+} purge_value_t;
+
+/*!
+ * Bits of the notify_modemstate command.
+ */
+typedef enum {
+  modemstate_cts_delta = 0x01,
+  modemstate_dsr_delta = 0x02,
+  modemstate_ri_trailing_edge = 0x04,
+  modemstate_cd_delta = 0x08,
+  modemstate_cts = 0x10,
+  modemstate_dsr = 0x20,
+  modemstate_ri = 0x40,
+  modemstate_cd = 0x80
+} modemstate_t;
+
+/*!
+ * The default TCP port of RFC 2217 servers.
+ */
+const uint16_t default_port = 2217;
+
+/*!
+ * Converts a parity to its set_parity value.
+ */
+inline uint8_t
+to_parity_value (parity_t parity)
+{
+  return static_cast<uint8_t>(parity) + parity_value_none;
+}
+
+/*!
+ * Converts a set_parity value to a parity.
+ *
+ * \throw std::invalid_argument for unknown values.
+ */
+inline parity_t
+from_parity_value (uint8_t value)
+{
+  if (value < parity_value_none || value > parity_value_space) {
+    throw std::invalid_argument ("invalid RFC 2217 parity value");
+  }
+  return static_cast<parity_t>(value - parity_value_none);
+}
+
+/*!
+ * Converts stop bits to their set_stopsize value.
+ */
+inline uint8_t
+to_stopsize_value (stopbits_t stopbits)
+{
+  switch (stopbits) {
+    case stopbits_two:
+      return stopsize_value_two;
+    case stopbits_one_point_five:
+      return stopsize_value_one_point_five;
+    default:
+      return stopsize_value_one;
+  }
+}
+
+/*!
+ * Converts a set_stopsize value to stop bits.
+ *
+ * \throw std::invalid_argument for unknown values.
+ */
+inline stopbits_t
+from_stopsize_value (uint8_t value)
+{
+  switch (value) {
+    case stopsize_value_one:
+      return stopbits_one;
+    case stopsize_value_two:
+      return stopbits_two;
+    case stopsize_value_one_point_five:
+      return stopbits_one_point_five;
+    default:
+      throw std::invalid_argument ("invalid RFC 2217 stop size value");
+  }
+}
+
+/*!
+ * Converts a flow control to its set_control value.
+ */
+inline uint8_t
+to_flow_value (flowcontrol_t flowcontrol)
+{
+  switch (flowcontrol) {
+    case flowcontrol_software:
+      return control_flow_software;
+    case flowcontrol_hardware:
+      return control_flow_hardware;
+    default:
+      return control_flow_none;
+  }
+}
+
+/*!
+ * Converts a set_control flow value to a flow control.
+ *
+ * \throw std::invalid_argument for values that are not flow settings.
+ */
+inline flowcontrol_t
+from_flow_value (uint8_t value)
+{
+  switch (value) {
+    case control_flow_none:
+      return flowcontrol_none;
+    case control_flow_software:
+      return flowcontrol_software;
+    case control_flow_hardware:
+      return flowcontrol_hardware;
+    default:
+      throw std::invalid_argument ("invalid RFC 2217 flow control value");
+  }
+}
+
+} // namespace rfc2217
+} // namespace serial
+
+#endif
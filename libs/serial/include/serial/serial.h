@@ -36,6 +36,7 @@
 #ifndef SERIAL_H
 #define SERIAL_H
 
+#include <atomic>
 #include <limits>
 #include <vector>
 #include <string>
@@ -89,6 +90,60 @@ typedef enum {
   flowcontrol_hardware
 } flowcontrol_t;
 
+/*!
+ * Enumeration defines how a serial port may be shared between threads.
+ *
+ * With threading_multi every read and write takes a lock so that any
+ * number of threads may use the port.  With threading_single the locks are
+ * skipped; reads and writes may still happen on two different threads, but
+ * never two reads or two writes at the same time.
+ */
+typedef enum {
+  threading_multi = 0,
+  threading_single
+} threadingmode_t;
+
+/*!
+ * Enumeration defines the possible outcomes of a non-throwing read or write.
+ */
+typedef enum {
+  io_ok = 0,
+  io_port_not_open,
+  io_disconnected,
+  io_error
+} io_status_t;
+
+/*!
+ * The result of Serial::tryRead or Serial::tryWrite.
+ *
+ * Errors are reported without exceptions or allocation, so these can be
+ * used in real-time loops.  A timeout is not an error; it is an io_ok
+ * result with fewer bytes than requested.
+ */
+struct IOResult {
+  /*! Number of bytes transferred, including before an error. */
+  size_t bytes;
+  /*! The outcome of the call. */
+  io_status_t status;
+  /*! errno, or GetLastError() on Windows, when status is io_error. */
+  int error_number;
+
+  IOResult (size_t bytes_ = 0, io_status_t status_ = io_ok,
+            int error_number_ = 0)
+    : bytes (bytes_), status (status_), error_number (error_number_) {}
+
+  /*! Returns true if the call succeeded. */
+  bool
+  ok () const
+  {
+    return status == io_ok;
+  }
+
+  /*! Describes the error.  Allocates, so only call on the error path. */
+  std::string
+  message () const;
+};
+
 /*!
  * Structure for setting the timeout of the serial port, times are
  * in milliseconds.
@@ -141,6 +196,153 @@ struct Timeout {
   {}
 };
 
+/*!
+ * The interface behind serial::Serial.
+ *
+ * Serial forwards every call to a backend, taking the read and write locks
+ * through readLock() and friends in threading_multi mode.  The local ports
+ * of each platform, the RFC 2217 client used for "rfc2217://host:port"
+ * ports and the in-memory loopback used for "loop://" ports are backends;
+ * others can be passed to Serial::Serial(SerialBackend*).
+ *
+ * The semantics of each method are those of the Serial method of the same
+ * name.  getFd() returns a descriptor that polls readable while bytes are
+ * waiting to be read, or -1 if there is none.
+ */
+class SerialBackend {
+public:
+  virtual ~SerialBackend () {}
+
+  virtual void
+  open () = 0;
+
+  virtual void
+  close () = 0;
+
+  virtual bool
+  isOpen () const = 0;
+
+  virtual size_t
+  available () = 0;
+
+  virtual size_t
+  outWaiting () = 0;
+
+  virtual uint32_t
+  getByteTime () const = 0;
+
+  virtual bool
+  waitReadable (uint32_t timeout) = 0;
+
+  virtual void
+  waitByteTimes (size_t count) = 0;
+
+  virtual IOResult
+  tryRead (uint8_t *buf, size_t size = 1) = 0;
+
+  virtual IOResult
+  tryWrite (const uint8_t *data, size_t length) = 0;
+
+  virtual void
+  flush () = 0;
+
+  virtual void
+  flushInput () = 0;
+
+  virtual void
+  flushOutput () = 0;
+
+  virtual void
+  sendBreak (int duration) = 0;
+
+  virtual void
+  setBreak (bool level) = 0;
+
+  virtual void
+  setRTS (bool level) = 0;
+
+  virtual void
+  setDTR (bool level) = 0;
+
+  virtual bool
+  waitForChange () = 0;
+
+  virtual bool
+  getCTS () = 0;
+
+  virtual bool
+  getDSR () = 0;
+
+  virtual bool
+  getRI () = 0;
+
+  virtual bool
+  getCD () = 0;
+
+  virtual void
+  setPort (const std::string &port) = 0;
+
+  virtual std::string
+  getPort () const = 0;
+
+  virtual int
+  getFd () const = 0;
+
+  virtual void
+  setTimeout (Timeout &timeout) = 0;
+
+  virtual Timeout
+  getTimeout () const = 0;
+
+  virtual void
+  setBaudrate (unsigned long baudrate) = 0;
+
+  virtual unsigned long
+  getBaudrate () const = 0;
+
+  virtual void
+  setBytesize (bytesize_t bytesize) = 0;
+
+  virtual bytesize_t
+  getBytesize () const = 0;
+
+  virtual void
+  setParity (parity_t parity) = 0;
+
+  virtual parity_t
+  getParity () const = 0;
+
+  virtual void
+  setStopbits (stopbits_t stopbits) = 0;
+
+  virtual stopbits_t
+  getStopbits () const = 0;
+
+  virtual void
+  setFlowcontrol (flowcontrol_t flowcontrol) = 0;
+
+  virtual flowcontrol_t
+  getFlowcontrol () const = 0;
+
+  virtual bool
+  setLowLatency (bool low_latency) = 0;
+
+  virtual bool
+  getLowLatency () const = 0;
+
+  virtual void
+  readLock () = 0;
+
+  virtual void
+  readUnlock () = 0;
+
+  virtual void
+  writeLock () = 0;
+
+  virtual void
+  writeUnlock () = 0;
+};
+
 /*!
  * Class that provides a portable serial port interface.
  */
@@ -152,7 +354,10 @@ public:
    *
    * \param port A std::string containing the address of the serial port,
    *        which would be something like 'COM1' on Windows and '/dev/ttyS0'
-   *        on Linux.
+   *        on Linux, 'rfc2217://host:port' for a port shared by an
+   *        RFC 2217 server, or 'loop://' and 'loop://name' for an in-memory
+   *        loopback plug or cable, see serial/impl/loopback.h.  Remote and
+   *        loopback ports are not supported on Windows.
    *
    * \param baudrate An unsigned 32-bit integer that represents the baudrate
    *
@@ -173,6 +378,10 @@ public:
    * flowcontrol_none, possible values are: flowcontrol_none,
    * flowcontrol_software, flowcontrol_hardware
    *
+   * \param threading How the port is shared between threads, default is
+   * threading_multi, possible values are: threading_multi, threading_single.
+   * \see serial::threadingmode_t
+   *
    * \throw serial::PortNotOpenedException
    * \throw serial::IOException
    * \throw std::invalid_argument
@@ -183,7 +392,21 @@ public:
           bytesize_t bytesize = eightbits,
           parity_t parity = parity_none,
           stopbits_t stopbits = stopbits_one,
-          flowcontrol_t flowcontrol = flowcontrol_none);
+          flowcontrol_t flowcontrol = flowcontrol_none,
+          threadingmode_t threading = threading_multi);
+
+  /*!
+   * Creates a Serial object that uses the given backend, e.g. a port that
+   * is not a local device.  The backend is not opened.
+   *
+   * \param backend The backend, which is deleted with the Serial object.
+   *
+   * \param threading How the port is shared between threads.
+   *
+   * \throw std::invalid_argument if backend is NULL.
+   */
+  explicit Serial (SerialBackend *backend,
+                   threadingmode_t threading = threading_multi);
 
   /*! Destructor */
   virtual ~Serial ();
@@ -219,6 +442,32 @@ public:
   size_t
   available ();
 
+  /*! Return the number of characters written but not yet transmitted.
+   *
+   * This is the amount of data queued in the operating system and driver
+   * output buffers, e.g. via TIOCOUTQ.  It can be used to keep only a small
+   * amount of data in flight so that later writes are not delayed behind a
+   * large backlog.
+   *
+   * \throw serial::IOException
+   */
+  size_t
+  outWaiting ();
+
+  /*! Return the time in nanoseconds needed to transmit a single character
+   * at the present serial settings, including start, parity and stop bits.
+   */
+  uint32_t
+  getByteTime () const;
+
+  /*! Return the time in nanoseconds needed to transmit a single character
+   * at the given settings, including start, parity and stop bits, or 0 if
+   * the baudrate is 0.
+   */
+  static uint32_t
+  calculateByteTime (unsigned long baudrate, bytesize_t bytesize,
+                     parity_t parity, stopbits_t stopbits);
+
   /*! Block until there is serial data to read or read_timeout_constant
    * number of milliseconds have elapsed. The return value is true when
    * the function exits with the port in a readable state, false otherwise
@@ -226,6 +475,12 @@ public:
   bool
   waitReadable ();
 
+  /*! Block until there is serial data to read or timeout milliseconds have
+   * elapsed, regardless of the configured read timeout.  Useful for reader
+   * threads that must wake up periodically to check for shutdown. */
+  bool
+  waitReadable (uint32_t timeout);
+
   /*! Block for a period of time corresponding to the transmission time of
    * count characters at present serial settings. This may be used in con-
    * junction with waitReadable to read larger blocks of data from the
@@ -264,6 +519,16 @@ public:
   size_t
   read (uint8_t *buffer, size_t size);
 
+  /*! Read like Serial::read, but report errors instead of throwing.
+   *
+   * \param buffer An uint8_t array of at least the requested size.
+   * \param size A size_t defining how many bytes to be read.
+   *
+   * \return A serial::IOResult with the number of bytes read.
+   */
+  IOResult
+  tryRead (uint8_t *buffer, size_t size);
+
   /*! Read a given amount of bytes from the serial port into a give buffer.
    *
    * \param buffer A reference to a std::vector of uint8_t.
@@ -371,6 +636,16 @@ public:
   size_t
   write (const uint8_t *data, size_t size);
 
+  /*! Write like Serial::write, but report errors instead of throwing.
+   *
+   * \param data A const pointer to the data to be written.
+   * \param size The number of bytes to write.
+   *
+   * \return A serial::IOResult with the number of bytes written.
+   */
+  IOResult
+  tryWrite (const uint8_t *data, size_t size);
+
   /*! Write a string to the serial port.
    *
    * \param data A const reference containing the data to be written
@@ -405,7 +680,11 @@ public:
    *
    * \param port A const std::string reference containing the address of the
    * serial port, which would be something like 'COM1' on Windows and
-   * '/dev/ttyS0' on Linux.
+   * '/dev/ttyS0' on Linux, 'rfc2217://host:port' or 'loop://name'.
+   * Switching between local, remote and loopback ports replaces the backend
+   * and keeps the settings.  The replaced backend is closed but kept, since
+   * other threads may still be waiting on it, and is reused if the port
+   * switches back to its kind.
    *
    * \throw std::invalid_argument
    */
@@ -421,6 +700,16 @@ public:
   std::string
   getPort () const;
 
+  /*! Gets the file descriptor of the open port, for use with poll or
+   * select when servicing many ports from one thread.  Reading or writing
+   * the descriptor directly bypasses the port's locks.
+   *
+   * \return The file descriptor, or -1 if the port is not open.  Always -1
+   * on Windows.
+   */
+  int
+  getFd () const;
+
   /*! Sets the timeout for reads and writes using the Timeout struct.
    *
    * There are two timeout conditions described here:
@@ -586,6 +875,40 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  /*! Gets the threading mode chosen when the port was constructed.
+   *
+   * \see serial::threadingmode_t
+   */
+  threadingmode_t
+  getThreadingMode () const;
+
+  /*! Sets the low latency mode of the serial port.
+   *
+   * On Linux this sets the ASYNC_LOW_LATENCY flag with TIOCSSERIAL, and for
+   * FTDI adapters lowers the driver's latency_timer from its default of
+   * 16 ms to 1 ms.  The original values are restored when the port is
+   * closed or low latency is disabled.  Writing the latency timer usually
+   * requires a udev rule granting write access to the sysfs attribute.
+   *
+   * The setting is kept across close and open.
+   *
+   * \param low_latency true to enable low latency mode.
+   *
+   * \return true if the port supports any of the low latency settings.
+   * Other platforms always return false.
+   *
+   * \throw serial::IOException
+   */
+  bool
+  setLowLatency (bool low_latency);
+
+  /*! Gets the requested low latency mode of the serial port.
+   *
+   * \see Serial::setLowLatency
+   */
+  bool
+  getLowLatency () const;
+
   /*! Flush the input and output buffers */
   void
   flush ();
@@ -652,9 +975,32 @@ private:
   Serial(const Serial&);
   Serial& operator=(const Serial&);
 
-  // Pimpl idiom, d_pointer
+  // Pimpl idiom, d_pointer.  setPort may replace it while other threads
+  // use the port, so it is only read through backend_ ().
   class SerialImpl;
-  SerialImpl *pimpl_;
+  std::atomic<SerialBackend *> pimpl_;
+
+  // Backends replaced by setPort, at most one of each kind, reused when the
+  // port switches back and deleted with the Serial
+  std::vector<SerialBackend *> retired_;
+
+  // The current backend
+  SerialBackend *
+  backend_ () const
+  {
+    return pimpl_.load (std::memory_order_acquire);
+  }
+
+  // Whether reads and writes take locks
+  threadingmode_t threading_;
+
+  // Creates a local, RFC 2217 or loopback backend, opened if port is not
+  // empty
+  static SerialBackend *
+  createBackend_ (int backend, const std::string &port,
+                  unsigned long baudrate, bytesize_t bytesize,
+                  parity_t parity, stopbits_t stopbits,
+                  flowcontrol_t flowcontrol);
 
   // Scoped Lock Classes
   class ScopedReadLock;
@@ -23,6 +23,7 @@
 #include <unistd.h>
 
 #include "serial/serial.h"
+#include "serial/impl/unix.h"
 
 using serial::PortInfo;
 using std::istringstream;
@@ -294,6 +295,28 @@ usb_sysfs_hw_string(const string& sysfs_path)
     return format("USB VID:PID=%s:%s %s", vid.c_str(), pid.c_str(), serial_number.c_str() );
 }
 
+string
+serial::ftdi_latency_timer_path(const string& port)
+{
+    // Resolve links such as /dev/serial/by-id/... to the ttyUSB node.
+    string device_name = basename( realpath( port ) );
+
+    if( device_name.compare(0,6,"ttyUSB") != 0 )
+        return "";
+
+    string sys_device_path = realpath( format( "/sys/class/tty/%s/device", device_name.c_str() ) );
+
+    if( basename( realpath( sys_device_path + "/driver" ) ) != "ftdi_sio" )
+        return "";
+
+    string latency_timer_path = sys_device_path + "/latency_timer";
+
+    if( !path_exists( latency_timer_path ) )
+        return "";
+
+    return latency_timer_path;
+}
+
 vector<PortInfo>
 serial::list_ports()
 {
@@ -0,0 +1,727 @@
+/* Copyright 2012 William Woodall and John Harrison
+ *
+ * In-memory loopback backend, see serial/impl/loopback.h.
+ */
+
+#if !defined(_WIN32)
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "serial/impl/loopback.h"
+#include "serial/impl/unix.h"
+
+using std::invalid_argument;
+using std::string;
+using serial::MillisecondTimer;
+using serial::LoopbackImpl;
+using serial::Serial;
+using serial::SerialException;
+using serial::PortNotOpenedException;
+using serial::IOException;
+using serial::IOResult;
+
+namespace {
+
+// Received bytes already read are dropped once this many have gathered.
+const size_t compact_size = 65536;
+
+// One end of a plug or cable.
+struct End {
+  End () : open (false), rx_offset (0), rts (false), dtr (false),
+           changes (0), ready (false)
+  {
+    ready_pipe[0] = ready_pipe[1] = -1;
+  }
+
+  bool open;
+  std::vector<uint8_t> rx;    // Received bytes, from rx_offset on
+  size_t rx_offset;
+  bool rts;                   // Drives CTS of the other end
+  bool dtr;                   // Drives DSR and CD of the other end
+  unsigned long changes;      // Counts changes of the lines this end reads
+  int ready_pipe[2];          // Readable while bytes are waiting, once used
+  bool ready;                 // True while ready_pipe holds a byte
+
+  size_t
+  pending () const
+  {
+    return rx.size () - rx_offset;
+  }
+
+  // Makes the ready pipe match the received bytes.
+  void
+  updateReady ()
+  {
+    if (ready_pipe[0] == -1 || ready == (pending () > 0)) {
+      return;
+    }
+    uint8_t byte = 0;
+    ssize_t r = ready ? ::read (ready_pipe[0], &byte, 1)
+                      : ::write (ready_pipe[1], &byte, 1);
+    if (r == 1) {
+      ready = !ready;
+    }
+  }
+
+  void
+  closePipe ()
+  {
+    for (int i = 0; i < 2; ++i) {
+      if (ready_pipe[i] != -1) {
+        ::close (ready_pipe[i]);
+        ready_pipe[i] = -1;
+      }
+    }
+    ready = false;
+  }
+};
+
+bool
+make_pipe (int fds[2])
+{
+  if (::pipe (fds) == -1) {
+    return false;
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (fcntl (fds[i], F_SETFL, fcntl (fds[i], F_GETFL) | O_NONBLOCK) == -1
+        || fcntl (fds[i], F_SETFD, FD_CLOEXEC) == -1) {
+      int error = errno;
+      ::close (fds[0]);
+      ::close (fds[1]);
+      fds[0] = fds[1] = -1;
+      errno = error;
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+struct LoopbackImpl::Link {
+  Link (const string &name_, bool cable_)
+    : name (name_), cable (cable_), refs (0)
+  {
+    pthread_mutex_init (&mutex, NULL);
+    pthread_cond_init (&condition, NULL);
+  }
+
+  ~Link ()
+  {
+    ends[0].closePipe ();
+    ends[1].closePipe ();
+    pthread_mutex_destroy (&mutex);
+    pthread_cond_destroy (&condition);
+  }
+
+  string name;                // The name after loop://
+  bool cable;                 // Two ends rather than a plug
+  unsigned refs;              // Ports holding the link
+  End ends[2];
+
+  // Guards the ends.
+  pthread_mutex_t mutex;
+  // Signalled when bytes arrive or are read, or a line changes.
+  pthread_cond_t condition;
+};
+
+namespace {
+
+pthread_mutex_t cables_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+class ScopedLinkLock {
+public:
+  ScopedLinkLock (pthread_mutex_t *mutex) : mutex_ (mutex) {
+    pthread_mutex_lock (mutex_);
+  }
+  ~ScopedLinkLock () {
+    pthread_mutex_unlock (mutex_);
+  }
+private:
+  // Disable copy constructors
+  ScopedLinkLock (const ScopedLinkLock&);
+  const ScopedLinkLock& operator= (ScopedLinkLock);
+  pthread_mutex_t *mutex_;
+};
+
+}
+
+LoopbackImpl::LoopbackImpl (const string &port, unsigned long baudrate,
+                            bytesize_t bytesize,
+                            parity_t parity, stopbits_t stopbits,
+                            flowcontrol_t flowcontrol)
+  : port_ (port), link_ (NULL), end_ (0), is_open_ (false),
+    baudrate_ (baudrate), parity_ (parity), bytesize_ (bytesize),
+    stopbits_ (stopbits), flowcontrol_ (flowcontrol), low_latency_ (false)
+{
+  pthread_mutex_init(&this->read_mutex, NULL);
+  pthread_mutex_init(&this->write_mutex, NULL);
+  if (port_.empty () == false)
+    open ();
+}
+
+LoopbackImpl::~LoopbackImpl ()
+{
+  close();
+  release ();
+  pthread_mutex_destroy(&this->read_mutex);
+  pthread_mutex_destroy(&this->write_mutex);
+}
+
+void
+LoopbackImpl::open ()
+{
+  if (port_.empty ()) {
+    throw invalid_argument ("Empty port is invalid.");
+  }
+  if (is_open_ == true) {
+    throw SerialException ("Serial port already open.");
+  }
+  if (port_.compare (0, 7, "loop://") != 0) {
+    throw invalid_argument ("Invalid loop:// port: " + port_);
+  }
+
+  string name = port_.substr (7);
+
+  // The link of a previous open may belong to another name.
+  release ();
+
+  if (name.empty ()) {
+    link_ = new Link (name, false);
+    link_->refs = 1;
+    end_ = 0;
+  } else {
+    ScopedLinkLock cables_lock (&cables_mutex);
+    Link *&link = cables ()[name];
+    if (link == NULL) {
+      link = new Link (name, true);
+    }
+    ScopedLinkLock lock (&link->mutex);
+    if (link->ends[0].open && link->ends[1].open) {
+      throw IOException (__FILE__, __LINE__,
+                         ("Both ends of " + port_ + " are open.").c_str ());
+    }
+    end_ = link->ends[0].open ? 1 : 0;
+    ++link->refs;
+    link_ = link;
+  }
+
+  // Like a local port, RTS and DTR are raised on open.
+  ScopedLinkLock lock (&link_->mutex);
+  End &end = link_->ends[end_];
+  end.open = true;
+  end.rx.clear ();
+  end.rx_offset = 0;
+  end.rts = true;
+  end.dtr = true;
+  ++link_->ends[peer ()].changes;
+  pthread_cond_broadcast (&link_->condition);
+  is_open_ = true;
+}
+
+void
+LoopbackImpl::close ()
+{
+  if (is_open_ == true) {
+    ScopedLinkLock lock (&link_->mutex);
+    End &end = link_->ends[end_];
+    end.open = false;
+    end.rx.clear ();
+    end.rx_offset = 0;
+    end.rts = false;
+    end.dtr = false;
+    end.closePipe ();
+    ++link_->ends[peer ()].changes;
+    is_open_ = false;
+    // Wake readers and writers of this port, and the other end.
+    pthread_cond_broadcast (&link_->condition);
+  }
+}
+
+bool
+LoopbackImpl::isOpen () const
+{
+  return is_open_;
+}
+
+size_t
+LoopbackImpl::available ()
+{
+  if (!is_open_) {
+    return 0;
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  return link_->ends[end_].pending ();
+}
+
+size_t
+LoopbackImpl::outWaiting ()
+{
+  // Bytes are delivered as they are written.
+  return 0;
+}
+
+uint32_t
+LoopbackImpl::getByteTime () const
+{
+  return Serial::calculateByteTime (baudrate_, bytesize_, parity_, stopbits_);
+}
+
+bool
+LoopbackImpl::waitReadable (uint32_t timeout)
+{
+  if (!is_open_) {
+    return false;
+  }
+  MillisecondTimer total_timeout(timeout);
+  ScopedLinkLock lock (&link_->mutex);
+  const End &end = link_->ends[end_];
+  for (;;) {
+    if (end.pending () > 0) {
+      return true;
+    }
+    int64_t timeout_remaining_ms = total_timeout.remaining ();
+    if (!is_open_ || timeout_remaining_ms <= 0) {
+      return false;
+    }
+    wait (timeout_remaining_ms);
+  }
+}
+
+void
+LoopbackImpl::waitByteTimes (size_t /*count*/)
+{
+  // Bytes move at memory speed.
+}
+
+IOResult
+LoopbackImpl::tryRead (uint8_t *buf, size_t size)
+{
+  if (!is_open_) {
+    return IOResult (0, serial::io_port_not_open);
+  }
+  // Calculate total timeout in milliseconds t_c + (t_m * N)
+  long total_timeout_ms = timeout_.read_timeout_constant;
+  total_timeout_ms += timeout_.read_timeout_multiplier * static_cast<long> (size);
+  MillisecondTimer total_timeout(total_timeout_ms);
+  size_t bytes_read = 0;
+  ScopedLinkLock lock (&link_->mutex);
+  End &end = link_->ends[end_];
+  for (;;) {
+    size_t count = std::min (size - bytes_read, end.pending ());
+    if (count > 0) {
+      memcpy (buf + bytes_read, &end.rx[end.rx_offset], count);
+      end.rx_offset += count;
+      bytes_read += count;
+      if (end.rx_offset == end.rx.size ()) {
+        end.rx.clear ();
+        end.rx_offset = 0;
+      } else if (end.rx_offset >= compact_size) {
+        end.rx.erase (end.rx.begin (), end.rx.begin () + end.rx_offset);
+        end.rx_offset = 0;
+      }
+      end.updateReady ();
+      // Writers may be waiting for room.
+      pthread_cond_broadcast (&link_->condition);
+    }
+    if (bytes_read == size || !is_open_) {
+      break;
+    }
+    int64_t timeout_remaining_ms = total_timeout.remaining ();
+    if (timeout_remaining_ms <= 0) {
+      // Timed out
+      break;
+    }
+    wait (std::min (timeout_remaining_ms,
+                    static_cast<int64_t> (timeout_.inter_byte_timeout)));
+  }
+  return IOResult (bytes_read);
+}
+
+IOResult
+LoopbackImpl::tryWrite (const uint8_t *data, size_t length)
+{
+  if (is_open_ == false) {
+    return IOResult (0, serial::io_port_not_open);
+  }
+  size_t bytes_written = 0;
+  // Calculate total timeout in milliseconds t_c + (t_m * N)
+  long total_timeout_ms = timeout_.write_timeout_constant;
+  total_timeout_ms += timeout_.write_timeout_multiplier * static_cast<long> (length);
+  MillisecondTimer total_timeout(total_timeout_ms);
+  ScopedLinkLock lock (&link_->mutex);
+  End &end = link_->ends[peer ()];
+  bool first_iteration = true;
+  for (;;) {
+    if (!end.open) {
+      // Nothing is connected; the bytes are lost on the line.
+      bytes_written = length;
+      break;
+    }
+    size_t pending = end.pending ();
+    size_t room = pending < receive_buffer_size ? receive_buffer_size - pending : 0;
+    size_t count = std::min (length - bytes_written, room);
+    if (count > 0) {
+      end.rx.insert (end.rx.end (), data + bytes_written,
+                     data + bytes_written + count);
+      bytes_written += count;
+      end.updateReady ();
+      pthread_cond_broadcast (&link_->condition);
+    }
+    if (bytes_written == length || !is_open_) {
+      break;
+    }
+    int64_t timeout_remaining_ms = total_timeout.remaining ();
+    // Only consider the timeout if it's not the first iteration of the loop
+    // otherwise a timeout of 0 won't be allowed through
+    if (!first_iteration && timeout_remaining_ms <= 0) {
+      // Timed out
+      break;
+    }
+    first_iteration = false;
+    wait (timeout_remaining_ms);
+  }
+  return IOResult (bytes_written);
+}
+
+void
+LoopbackImpl::flush ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::flush");
+  }
+  // Bytes are delivered as they are written.
+}
+
+void
+LoopbackImpl::flushInput ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::flushInput");
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  End &end = link_->ends[end_];
+  end.rx.clear ();
+  end.rx_offset = 0;
+  end.updateReady ();
+  pthread_cond_broadcast (&link_->condition);
+}
+
+void
+LoopbackImpl::flushOutput ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::flushOutput");
+  }
+  // Bytes are delivered as they are written.
+}
+
+void
+LoopbackImpl::sendBreak (int /*duration*/)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::sendBreak");
+  }
+}
+
+void
+LoopbackImpl::setBreak (bool /*level*/)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::setBreak");
+  }
+}
+
+void
+LoopbackImpl::setRTS (bool level)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::setRTS");
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  End &end = link_->ends[end_];
+  if (end.rts != level) {
+    end.rts = level;
+    ++link_->ends[peer ()].changes;
+    pthread_cond_broadcast (&link_->condition);
+  }
+}
+
+void
+LoopbackImpl::setDTR (bool level)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::setDTR");
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  End &end = link_->ends[end_];
+  if (end.dtr != level) {
+    end.dtr = level;
+    ++link_->ends[peer ()].changes;
+    pthread_cond_broadcast (&link_->condition);
+  }
+}
+
+bool
+LoopbackImpl::waitForChange ()
+{
+  if (is_open_ == false) {
+    return false;
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  const End &end = link_->ends[end_];
+  unsigned long changes = end.changes;
+  while (is_open_ && end.changes == changes) {
+    pthread_cond_wait (&link_->condition, &link_->mutex);
+  }
+  return end.changes != changes;
+}
+
+bool
+LoopbackImpl::getCTS ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getCTS");
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  return link_->ends[peer ()].rts;
+}
+
+bool
+LoopbackImpl::getDSR ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getDSR");
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  return link_->ends[peer ()].dtr;
+}
+
+bool
+LoopbackImpl::getRI ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getRI");
+  }
+  return false;
+}
+
+bool
+LoopbackImpl::getCD ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getCD");
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  return link_->ends[peer ()].dtr;
+}
+
+void
+LoopbackImpl::setPort (const string &port)
+{
+  port_ = port;
+}
+
+string
+LoopbackImpl::getPort () const
+{
+  return port_;
+}
+
+int
+LoopbackImpl::getFd () const
+{
+  if (!is_open_) {
+    return -1;
+  }
+  ScopedLinkLock lock (&link_->mutex);
+  End &end = link_->ends[end_];
+  if (end.ready_pipe[0] == -1) {
+    if (!make_pipe (end.ready_pipe)) {
+      return -1;
+    }
+    end.updateReady ();
+  }
+  return end.ready_pipe[0];
+}
+
+void
+LoopbackImpl::setTimeout (serial::Timeout &timeout)
+{
+  timeout_ = timeout;
+}
+
+serial::Timeout
+LoopbackImpl::getTimeout () const
+{
+  return timeout_;
+}
+
+void
+LoopbackImpl::setBaudrate (unsigned long baudrate)
+{
+  baudrate_ = baudrate;
+}
+
+unsigned long
+LoopbackImpl::getBaudrate () const
+{
+  return baudrate_;
+}
+
+void
+LoopbackImpl::setBytesize (serial::bytesize_t bytesize)
+{
+  bytesize_ = bytesize;
+}
+
+serial::bytesize_t
+LoopbackImpl::getBytesize () const
+{
+  return bytesize_;
+}
+
+void
+LoopbackImpl::setParity (serial::parity_t parity)
+{
+  parity_ = parity;
+}
+
+serial::parity_t
+LoopbackImpl::getParity () const
+{
+  return parity_;
+}
+
+void
+LoopbackImpl::setStopbits (serial::stopbits_t stopbits)
+{
+  stopbits_ = stopbits;
+}
+
+serial::stopbits_t
+LoopbackImpl::getStopbits () const
+{
+  return stopbits_;
+}
+
+void
+LoopbackImpl::setFlowcontrol (serial::flowcontrol_t flowcontrol)
+{
+  flowcontrol_ = flowcontrol;
+}
+
+serial::flowcontrol_t
+LoopbackImpl::getFlowcontrol () const
+{
+  return flowcontrol_;
+}
+
+bool
+LoopbackImpl::setLowLatency (bool low_latency)
+{
+  // Nothing delays the bytes.
+  low_latency_ = low_latency;
+  return true;
+}
+
+bool
+LoopbackImpl::getLowLatency () const
+{
+  return low_latency_;
+}
+
+void
+LoopbackImpl::readLock ()
+{
+  int result = pthread_mutex_lock(&this->read_mutex);
+  if (result) {
+    THROW (IOException, result);
+  }
+}
+
+void
+LoopbackImpl::readUnlock ()
+{
+  int result = pthread_mutex_unlock(&this->read_mutex);
+  if (result) {
+    THROW (IOException, result);
+  }
+}
+
+void
+LoopbackImpl::writeLock ()
+{
+  int result = pthread_mutex_lock(&this->write_mutex);
+  if (result) {
+    THROW (IOException, result);
+  }
+}
+
+void
+LoopbackImpl::writeUnlock ()
+{
+  int result = pthread_mutex_unlock(&this->write_mutex);
+  if (result) {
+    THROW (IOException, result);
+  }
+}
+
+std::map<string, LoopbackImpl::Link *> &
+LoopbackImpl::cables ()
+{
+  // Never destroyed, so ports closed during exit still find it.
+  static std::map<string, Link *> *cables = new std::map<string, Link *> ();
+  return *cables;
+}
+
+void
+LoopbackImpl::release ()
+{
+  if (link_ == NULL) {
+    return;
+  }
+  if (link_->cable) {
+    ScopedLinkLock cables_lock (&cables_mutex);
+    pthread_mutex_lock (&link_->mutex);
+    bool last = --link_->refs == 0;
+    pthread_mutex_unlock (&link_->mutex);
+    if (last) {
+      cables ().erase (link_->name);
+      delete link_;
+    }
+  } else {
+    delete link_;
+  }
+  link_ = NULL;
+}
+
+int
+LoopbackImpl::peer () const
+{
+  return link_->cable ? 1 - end_ : end_;
+}
+
+void
+LoopbackImpl::wait (int64_t timeout_ms)
+{
+  timeval now;
+  gettimeofday (&now, NULL);
+  int64_t timeout_ns = std::min<int64_t> (timeout_ms, INT_MAX) * 1000000
+                     + static_cast<int64_t> (now.tv_usec) * 1000;
+  timespec deadline;
+  deadline.tv_sec = now.tv_sec + timeout_ns / 1000000000;
+  deadline.tv_nsec = timeout_ns % 1000000000;
+  pthread_cond_timedwait (&link_->condition, &link_->mutex, &deadline);
+}
+
+#endif // !defined(_WIN32)
@@ -0,0 +1,1338 @@
+/* Copyright 2012 William Woodall and John Harrison
+ *
+ * RFC 2217 client backend, see serial/impl/rfc2217.h.
+ */
+
+#if !defined(_WIN32)
+
+#include <algorithm>
+#include <climits>
+#include <sstream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "serial/impl/rfc2217.h"
+#include "serial/impl/unix.h"
+
+using std::invalid_argument;
+using std::string;
+using std::stringstream;
+using serial::MillisecondTimer;
+using serial::RFC2217Impl;
+using serial::SerialException;
+using serial::PortNotOpenedException;
+using serial::IOException;
+using serial::IOResult;
+
+using namespace serial::rfc2217;
+
+namespace {
+
+#if defined(MSG_NOSIGNAL)
+const int send_flags = MSG_NOSIGNAL;
+#else
+const int send_flags = 0;
+#endif
+
+// Subnegotiations longer than this are truncated; answers are short.
+const size_t max_subnegotiation_size = 64;
+
+// Splits rfc2217://host[:port] into the host and the TCP port.
+void
+parse_url (const string &url, string &host, string &service)
+{
+  const string scheme ("rfc2217://");
+  if (url.compare (0, scheme.size (), scheme) != 0) {
+    throw invalid_argument ("Not an rfc2217:// port: " + url);
+  }
+  string address = url.substr (scheme.size ());
+  // pyserial style ?options are ignored.
+  address = address.substr (0, address.find_first_of ("/?"));
+
+  string rest;
+  if (!address.empty () && address[0] == '[') {
+    size_t end = address.find (']');
+    if (end == string::npos) {
+      throw invalid_argument ("Invalid rfc2217:// port: " + url);
+    }
+    host = address.substr (1, end - 1);
+    rest = address.substr (end + 1);
+  } else {
+    size_t colon = address.rfind (':');
+    host = address.substr (0, colon);
+    rest = colon == string::npos ? "" : address.substr (colon);
+  }
+
+  if (rest.empty ()) {
+    stringstream ss;
+    ss << default_port;
+    service = ss.str ();
+  } else if (rest.size () > 1 && rest[0] == ':') {
+    service = rest.substr (1);
+  } else {
+    throw invalid_argument ("Invalid rfc2217:// port: " + url);
+  }
+
+  if (host.empty ()) {
+    throw invalid_argument ("Invalid rfc2217:// port: " + url);
+  }
+}
+
+bool
+set_nonblocking (int fd)
+{
+  int flags = fcntl (fd, F_GETFL);
+  return flags != -1
+      && fcntl (fd, F_SETFL, flags | O_NONBLOCK) != -1
+      && fcntl (fd, F_SETFD, FD_CLOEXEC) != -1;
+}
+
+bool
+make_pipe (int fds[2])
+{
+  if (::pipe (fds) == -1) {
+    return false;
+  }
+  if (!set_nonblocking (fds[0]) || !set_nonblocking (fds[1])) {
+    int error = errno;
+    ::close (fds[0]);
+    ::close (fds[1]);
+    fds[0] = fds[1] = -1;
+    errno = error;
+    return false;
+  }
+  return true;
+}
+
+void
+close_pipe (int fds[2])
+{
+  for (int i = 0; i < 2; ++i) {
+    if (fds[i] != -1) {
+      ::close (fds[i]);
+      fds[i] = -1;
+    }
+  }
+}
+
+// Converts a millisecond timeout to a poll timeout, -1 meaning forever.
+int
+poll_timeout (int64_t timeout_ms)
+{
+  if (timeout_ms < 0) {
+    return 0;
+  }
+  return timeout_ms > INT_MAX ? -1 : static_cast<int> (timeout_ms);
+}
+
+// Waits for one descriptor. Returns 1 when ready, 0 on timeout or
+// interruption and -1 on error with errno set.
+int
+wait_for (int fd, short events, int64_t timeout_ms)
+{
+  pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = events;
+  pfd.revents = 0;
+  int r = ::poll (&pfd, 1, poll_timeout (timeout_ms));
+  if (r < 0) {
+    return errno == EINTR ? 0 : -1;
+  }
+  return r > 0 ? 1 : 0;
+}
+
+uint64_t
+option_bit (uint8_t option)
+{
+  return option < 64 ? uint64_t (1) << option : 0;
+}
+
+// Appends IAC SB COM-PORT-OPTION command value IAC SE, doubling IAC bytes
+// in the value.
+void
+append_command (std::vector<uint8_t> &tx, uint8_t command,
+                const uint8_t *value, size_t size)
+{
+  const uint8_t begin[] = { telnet_iac, telnet_sb, option_com_port, command };
+  tx.insert (tx.end (), begin, begin + sizeof (begin));
+  for (size_t i = 0; i < size; ++i) {
+    tx.push_back (value[i]);
+    if (value[i] == telnet_iac) {
+      tx.push_back (telnet_iac);
+    }
+  }
+  tx.push_back (telnet_iac);
+  tx.push_back (telnet_se);
+}
+
+}
+
+RFC2217Impl::RFC2217Impl (const string &port, unsigned long baudrate,
+                          bytesize_t bytesize,
+                          parity_t parity, stopbits_t stopbits,
+                          flowcontrol_t flowcontrol)
+  : port_ (port), socket_ (-1), ready_ (false), is_open_ (false),
+    baudrate_ (baudrate), byte_time_ns_ (0), parity_ (parity),
+    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol),
+    low_latency_ (false), rx_offset_ (0), stopping_ (false),
+    connected_ (false), modem_state_ (0), modem_changes_ (0),
+    com_port_answered_ (false), com_port_refused_ (false),
+    local_options_ (0), remote_options_ (0), parse_state_ (parse_data),
+    parse_command_ (0)
+{
+  ready_pipe_[0] = ready_pipe_[1] = -1;
+  wake_pipe_[0] = wake_pipe_[1] = -1;
+  std::fill (outstanding_, outstanding_ + purge_data + 1, 0u);
+  pthread_mutex_init(&this->state_mutex_, NULL);
+  pthread_cond_init(&this->state_cond_, NULL);
+  pthread_mutex_init(&this->send_mutex_, NULL);
+  pthread_mutex_init(&this->read_mutex, NULL);
+  pthread_mutex_init(&this->write_mutex, NULL);
+  updateByteTime ();
+  if (port_.empty () == false)
+    open ();
+}
+
+RFC2217Impl::~RFC2217Impl ()
+{
+  close();
+  pthread_mutex_destroy(&this->state_mutex_);
+  pthread_cond_destroy(&this->state_cond_);
+  pthread_mutex_destroy(&this->send_mutex_);
+  pthread_mutex_destroy(&this->read_mutex);
+  pthread_mutex_destroy(&this->write_mutex);
+}
+
+void
+RFC2217Impl::open ()
+{
+  if (port_.empty ()) {
+    throw invalid_argument ("Empty port is invalid.");
+  }
+  if (is_open_ == true) {
+    throw SerialException ("Serial port already open.");
+  }
+
+  parse_url (port_, host_, service_);
+  connect ();
+
+  if (!make_pipe (ready_pipe_) || !make_pipe (wake_pipe_)) {
+    int error = errno;
+    close_pipe (ready_pipe_);
+    ::close (socket_);
+    socket_ = -1;
+    THROW (IOException, error);
+  }
+
+  rx_.clear ();
+  rx_offset_ = 0;
+  ready_ = false;
+  stopping_ = false;
+  connected_ = true;
+  modem_state_ = 0;
+  modem_changes_ = 0;
+  std::fill (outstanding_, outstanding_ + purge_data + 1, 0u);
+  com_port_answered_ = false;
+  com_port_refused_ = false;
+  parse_state_ = parse_data;
+  subnegotiation_.clear ();
+
+  // Offer the options and send the settings in the same segment rather
+  // than waiting for each answer.
+  const uint8_t negotiation[] = {
+    telnet_iac, telnet_will, option_binary,
+    telnet_iac, telnet_do, option_binary,
+    telnet_iac, telnet_will, option_suppress_go_ahead,
+    telnet_iac, telnet_do, option_suppress_go_ahead,
+    telnet_iac, telnet_will, option_com_port
+  };
+  local_options_ = option_bit (option_binary)
+                 | option_bit (option_suppress_go_ahead)
+                 | option_bit (option_com_port);
+  remote_options_ = option_bit (option_binary)
+                  | option_bit (option_suppress_go_ahead);
+
+  const uint8_t baudrate[] = {
+    uint8_t (baudrate_ >> 24), uint8_t (baudrate_ >> 16),
+    uint8_t (baudrate_ >> 8), uint8_t (baudrate_)
+  };
+  const uint8_t bytesize = static_cast<uint8_t> (bytesize_);
+  const uint8_t parity = to_parity_value (parity_);
+  const uint8_t stopsize = to_stopsize_value (stopbits_);
+  const uint8_t flow = to_flow_value (flowcontrol_);
+  const uint8_t modemstate_mask = 0xff;
+
+  tx_.assign (negotiation, negotiation + sizeof (negotiation));
+  append_command (tx_, set_baudrate, baudrate, sizeof (baudrate));
+  append_command (tx_, set_datasize, &bytesize, 1);
+  append_command (tx_, set_parity, &parity, 1);
+  append_command (tx_, set_stopsize, &stopsize, 1);
+  append_command (tx_, set_control, &flow, 1);
+  append_command (tx_, set_modemstate_mask, &modemstate_mask, 1);
+  outstanding_[set_baudrate] = 1;
+  outstanding_[set_datasize] = 1;
+  outstanding_[set_parity] = 1;
+  outstanding_[set_stopsize] = 1;
+  outstanding_[set_control] = 1;
+  outstanding_[set_modemstate_mask] = 1;
+
+  int error = 0;
+  if (!sendQueue ()) {
+    error = errno;
+  } else {
+    error = pthread_create (&thread_, NULL, &RFC2217Impl::receiveThread, this);
+  }
+  if (error != 0) {
+    close_pipe (ready_pipe_);
+    close_pipe (wake_pipe_);
+    ::close (socket_);
+    socket_ = -1;
+    THROW (IOException, error);
+  }
+  is_open_ = true;
+
+  // Wait for the server to accept the com port option and answer the
+  // settings, one round trip.
+  timeval now;
+  gettimeofday (&now, NULL);
+  timespec deadline;
+  deadline.tv_sec = now.tv_sec + open_timeout_ms / 1000;
+  deadline.tv_nsec = now.tv_usec * 1000 + (open_timeout_ms % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec += 1;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  const char *failure = NULL;
+  pthread_mutex_lock (&state_mutex_);
+  for (;;) {
+    bool answered = com_port_answered_;
+    for (int command = 0; command <= purge_data; ++command) {
+      answered = answered && outstanding_[command] == 0;
+    }
+    if (com_port_refused_) {
+      failure = "the server does not support RFC 2217";
+    } else if (!connected_) {
+      failure = "the server closed the connection";
+    } else if (!answered
+               && pthread_cond_timedwait (&state_cond_, &state_mutex_,
+                                          &deadline) == ETIMEDOUT) {
+      failure = "the server did not answer";
+    } else if (!answered) {
+      continue;
+    }
+    break;
+  }
+  pthread_mutex_unlock (&state_mutex_);
+
+  if (failure != NULL) {
+    close ();
+    stringstream ss;
+    ss << "Unable to open " << port_ << ": " << failure;
+    THROW (IOException, ss.str ().c_str ());
+  }
+}
+
+void
+RFC2217Impl::connect ()
+{
+  addrinfo hints;
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo *addresses = NULL;
+  int r = getaddrinfo (host_.c_str (), service_.c_str (), &hints, &addresses);
+  if (r != 0) {
+    stringstream ss;
+    ss << "Unable to resolve " << host_ << ": " << gai_strerror (r);
+    THROW (IOException, ss.str ().c_str ());
+  }
+
+  MillisecondTimer timer (open_timeout_ms);
+  int error = ETIMEDOUT;
+
+  for (addrinfo *address = addresses; address != NULL;
+       address = address->ai_next) {
+    int fd = ::socket (address->ai_family, address->ai_socktype,
+                       address->ai_protocol);
+    if (fd == -1) {
+      error = errno;
+      continue;
+    }
+    if (!set_nonblocking (fd)
+        || (::connect (fd, address->ai_addr, address->ai_addrlen) == -1
+            && errno != EINPROGRESS)) {
+      error = errno;
+      ::close (fd);
+      continue;
+    }
+    int ready = wait_for (fd, POLLOUT, timer.remaining ());
+    int so_error = 0;
+    socklen_t length = sizeof (so_error);
+    if (ready <= 0) {
+      error = ready == 0 ? ETIMEDOUT : errno;
+    } else if (getsockopt (fd, SOL_SOCKET, SO_ERROR, &so_error, &length) == -1) {
+      error = errno;
+    } else {
+      error = so_error;
+    }
+    if (error != 0) {
+      ::close (fd);
+      continue;
+    }
+    socket_ = fd;
+    break;
+  }
+  freeaddrinfo (addresses);
+
+  if (socket_ == -1) {
+    THROW (IOException, error);
+  }
+
+  // Commands and small writes must not wait for the previous segment to be
+  // acknowledged.
+  int on = 1;
+  setsockopt (socket_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof (on));
+#if defined(SO_NOSIGPIPE)
+  setsockopt (socket_, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof (on));
+#endif
+}
+
+void
+RFC2217Impl::close ()
+{
+  if (is_open_ == true) {
+    pthread_mutex_lock (&send_mutex_);
+    sendQueue ();
+    pthread_mutex_unlock (&send_mutex_);
+
+    pthread_mutex_lock (&state_mutex_);
+    stopping_ = true;
+    pthread_mutex_unlock (&state_mutex_);
+    wake ();
+    pthread_join (thread_, NULL);
+
+    ::close (socket_);
+    socket_ = -1;
+    close_pipe (ready_pipe_);
+    close_pipe (wake_pipe_);
+    ready_ = false;
+    tx_.clear ();
+    is_open_ = false;
+  }
+}
+
+bool
+RFC2217Impl::isOpen () const
+{
+  return is_open_;
+}
+
+size_t
+RFC2217Impl::available ()
+{
+  if (!is_open_) {
+    return 0;
+  }
+  pthread_mutex_lock (&state_mutex_);
+  size_t count = rx_.size () - rx_offset_;
+  pthread_mutex_unlock (&state_mutex_);
+  return count;
+}
+
+size_t
+RFC2217Impl::outWaiting ()
+{
+  if (!is_open_) {
+    return 0;
+  }
+  pthread_mutex_lock (&send_mutex_);
+  size_t count = tx_.size ();
+  pthread_mutex_unlock (&send_mutex_);
+  return count;
+}
+
+uint32_t
+RFC2217Impl::getByteTime () const
+{
+  pthread_mutex_lock (&state_mutex_);
+  uint32_t byte_time_ns = byte_time_ns_;
+  pthread_mutex_unlock (&state_mutex_);
+  return byte_time_ns;
+}
+
+bool
+RFC2217Impl::waitReadable (uint32_t timeout)
+{
+  int r = wait_for (ready_pipe_[0], POLLIN, timeout);
+  if (r < 0) {
+    THROW (IOException, errno);
+  }
+  return r > 0;
+}
+
+void
+RFC2217Impl::waitByteTimes (size_t count)
+{
+  int64_t wait_ns = static_cast<int64_t> (getByteTime ()) * count;
+  timespec wait_time;
+  wait_time.tv_sec = wait_ns / 1000000000;
+  wait_time.tv_nsec = wait_ns % 1000000000;
+  while (::nanosleep (&wait_time, &wait_time) == -1 && errno == EINTR) {
+  }
+}
+
+IOResult
+RFC2217Impl::tryRead (uint8_t *buf, size_t size)
+{
+  if (!is_open_) {
+    return IOResult (0, serial::io_port_not_open);
+  }
+
+  // Calculate total timeout in milliseconds t_c + (t_m * N)
+  long total_timeout_ms = timeout_.read_timeout_constant;
+  total_timeout_ms += timeout_.read_timeout_multiplier * static_cast<long> (size);
+  MillisecondTimer total_timeout(total_timeout_ms);
+
+  size_t bytes_read = take (buf, size);
+
+  while (bytes_read < size) {
+    int64_t timeout_remaining_ms = total_timeout.remaining ();
+    if (timeout_remaining_ms <= 0) {
+      // Timed out
+      break;
+    }
+    int64_t timeout_ms = std::min (timeout_remaining_ms,
+                                   static_cast<int64_t> (timeout_.inter_byte_timeout));
+    int r = wait_for (ready_pipe_[0], POLLIN, timeout_ms);
+    if (r < 0) {
+      return IOResult (bytes_read, serial::io_error, errno);
+    }
+    if (r == 0) {
+      continue;
+    }
+    size_t bytes_read_now = take (buf + bytes_read, size - bytes_read);
+    if (bytes_read_now == 0) {
+      // The pipe stays readable once the connection is gone.
+      return IOResult (bytes_read, serial::io_disconnected);
+    }
+    bytes_read += bytes_read_now;
+  }
+  return IOResult (bytes_read);
+}
+
+IOResult
+RFC2217Impl::tryWrite (const uint8_t *data, size_t length)
+{
+  if (is_open_ == false) {
+    return IOResult (0, serial::io_port_not_open);
+  }
+  size_t bytes_written = 0;
+
+  // Calculate total timeout in milliseconds t_c + (t_m * N)
+  long total_timeout_ms = timeout_.write_timeout_constant;
+  total_timeout_ms += timeout_.write_timeout_multiplier * static_cast<long> (length);
+  MillisecondTimer total_timeout(total_timeout_ms);
+
+  pthread_mutex_lock (&send_mutex_);
+
+  bool first_iteration = true;
+  for (;;) {
+    // Escape as much as fits behind whatever is still queued, so that it
+    // all leaves with one send.
+    while (bytes_written < length && tx_.size () < send_queue_size) {
+      size_t count = std::min (length - bytes_written,
+                               send_queue_size - tx_.size ());
+      const uint8_t *begin = data + bytes_written;
+      const uint8_t *iac =
+        static_cast<const uint8_t *> (memchr (begin, telnet_iac, count));
+      if (iac == NULL) {
+        tx_.insert (tx_.end (), begin, begin + count);
+        bytes_written += count;
+      } else {
+        tx_.insert (tx_.end (), begin, iac + 1);
+        tx_.push_back (telnet_iac);
+        bytes_written += iac - begin + 1;
+      }
+    }
+
+    if (!sendQueue ()) {
+      int error = errno;
+      pthread_mutex_unlock (&send_mutex_);
+      if (error == EPIPE || error == ECONNRESET) {
+        return IOResult (bytes_written, serial::io_disconnected);
+      }
+      return IOResult (bytes_written, serial::io_error, error);
+    }
+
+    if (bytes_written == length) {
+      break;
+    }
+
+    int64_t timeout_remaining_ms = total_timeout.remaining ();
+    // Only consider the timeout if it's not the first iteration of the loop
+    // otherwise a timeout of 0 won't be allowed through
+    if (!first_iteration && timeout_remaining_ms <= 0) {
+      // Timed out
+      break;
+    }
+    first_iteration = false;
+
+    pthread_mutex_unlock (&send_mutex_);
+    waitWritable (timeout_remaining_ms);
+    pthread_mutex_lock (&send_mutex_);
+  }
+
+  bool queued = !tx_.empty ();
+  pthread_mutex_unlock (&send_mutex_);
+
+  // The receive thread sends the rest as the socket drains.
+  if (queued) {
+    wake ();
+  }
+  return IOResult (bytes_written);
+}
+
+void
+RFC2217Impl::flush ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::flush");
+  }
+  for (;;) {
+    pthread_mutex_lock (&send_mutex_);
+    bool sent = sendQueue ();
+    int error = errno;
+    bool empty = tx_.empty ();
+    pthread_mutex_unlock (&send_mutex_);
+    if (!sent) {
+      THROW (IOException, error);
+    }
+    if (empty) {
+      break;
+    }
+    waitWritable (100);
+  }
+}
+
+void
+RFC2217Impl::flushInput ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::flushInput");
+  }
+  pthread_mutex_lock (&state_mutex_);
+  bool was_full = rx_.size () - rx_offset_ >= receive_buffer_size;
+  rx_.clear ();
+  rx_offset_ = 0;
+  updateReady ();
+  pthread_mutex_unlock (&state_mutex_);
+  if (was_full) {
+    wake ();
+  }
+  sendCommand (purge_data, purge_receive);
+}
+
+void
+RFC2217Impl::flushOutput ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::flushOutput");
+  }
+  // Bytes still queued here may be half sent, so they stay; the purge
+  // discards them and the rest at the server.
+  sendCommand (purge_data, purge_transmit);
+}
+
+void
+RFC2217Impl::sendBreak (int duration)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::sendBreak");
+  }
+  sendCommand (set_control, control_break_on);
+  timespec wait_time;
+  wait_time.tv_sec = duration / 1000;
+  wait_time.tv_nsec = (duration % 1000) * 1000000;
+  while (::nanosleep (&wait_time, &wait_time) == -1 && errno == EINTR) {
+  }
+  sendCommand (set_control, control_break_off);
+}
+
+void
+RFC2217Impl::setBreak (bool level)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::setBreak");
+  }
+  sendCommand (set_control, level ? control_break_on : control_break_off);
+}
+
+void
+RFC2217Impl::setRTS (bool level)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::setRTS");
+  }
+  sendCommand (set_control, level ? control_rts_on : control_rts_off);
+}
+
+void
+RFC2217Impl::setDTR (bool level)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::setDTR");
+  }
+  sendCommand (set_control, level ? control_dtr_on : control_dtr_off);
+}
+
+bool
+RFC2217Impl::waitForChange ()
+{
+  if (is_open_ == false) {
+    return false;
+  }
+  pthread_mutex_lock (&state_mutex_);
+  unsigned long changes = modem_changes_;
+  while (connected_ && !stopping_ && modem_changes_ == changes) {
+    pthread_cond_wait (&state_cond_, &state_mutex_);
+  }
+  bool changed = modem_changes_ != changes;
+  pthread_mutex_unlock (&state_mutex_);
+  return changed;
+}
+
+bool
+RFC2217Impl::getCTS ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getCTS");
+  }
+  pthread_mutex_lock (&state_mutex_);
+  bool level = (modem_state_ & modemstate_cts) != 0;
+  pthread_mutex_unlock (&state_mutex_);
+  return level;
+}
+
+bool
+RFC2217Impl::getDSR ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getDSR");
+  }
+  pthread_mutex_lock (&state_mutex_);
+  bool level = (modem_state_ & modemstate_dsr) != 0;
+  pthread_mutex_unlock (&state_mutex_);
+  return level;
+}
+
+bool
+RFC2217Impl::getRI ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getRI");
+  }
+  pthread_mutex_lock (&state_mutex_);
+  bool level = (modem_state_ & modemstate_ri) != 0;
+  pthread_mutex_unlock (&state_mutex_);
+  return level;
+}
+
+bool
+RFC2217Impl::getCD ()
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getCD");
+  }
+  pthread_mutex_lock (&state_mutex_);
+  bool level = (modem_state_ & modemstate_cd) != 0;
+  pthread_mutex_unlock (&state_mutex_);
+  return level;
+}
+
+void
+RFC2217Impl::setPort (const string &port)
+{
+  port_ = port;
+}
+
+string
+RFC2217Impl::getPort () const
+{
+  return port_;
+}
+
+int
+RFC2217Impl::getFd () const
+{
+  return is_open_ ? ready_pipe_[0] : -1;
+}
+
+void
+RFC2217Impl::setTimeout (serial::Timeout &timeout)
+{
+  timeout_ = timeout;
+}
+
+serial::Timeout
+RFC2217Impl::getTimeout () const
+{
+  return timeout_;
+}
+
+void
+RFC2217Impl::setBaudrate (unsigned long baudrate)
+{
+  pthread_mutex_lock (&state_mutex_);
+  baudrate_ = baudrate;
+  updateByteTime ();
+  pthread_mutex_unlock (&state_mutex_);
+  if (is_open_) {
+    const uint8_t value[] = {
+      uint8_t (baudrate >> 24), uint8_t (baudrate >> 16),
+      uint8_t (baudrate >> 8), uint8_t (baudrate)
+    };
+    sendCommand (set_baudrate, value, sizeof (value));
+  }
+}
+
+unsigned long
+RFC2217Impl::getBaudrate () const
+{
+  pthread_mutex_lock (&state_mutex_);
+  unsigned long baudrate = baudrate_;
+  pthread_mutex_unlock (&state_mutex_);
+  return baudrate;
+}
+
+void
+RFC2217Impl::setBytesize (serial::bytesize_t bytesize)
+{
+  pthread_mutex_lock (&state_mutex_);
+  bytesize_ = bytesize;
+  updateByteTime ();
+  pthread_mutex_unlock (&state_mutex_);
+  if (is_open_) {
+    sendCommand (set_datasize, static_cast<uint8_t> (bytesize));
+  }
+}
+
+serial::bytesize_t
+RFC2217Impl::getBytesize () const
+{
+  pthread_mutex_lock (&state_mutex_);
+  bytesize_t bytesize = bytesize_;
+  pthread_mutex_unlock (&state_mutex_);
+  return bytesize;
+}
+
+void
+RFC2217Impl::setParity (serial::parity_t parity)
+{
+  pthread_mutex_lock (&state_mutex_);
+  parity_ = parity;
+  updateByteTime ();
+  pthread_mutex_unlock (&state_mutex_);
+  if (is_open_) {
+    sendCommand (set_parity, to_parity_value (parity));
+  }
+}
+
+serial::parity_t
+RFC2217Impl::getParity () const
+{
+  pthread_mutex_lock (&state_mutex_);
+  parity_t parity = parity_;
+  pthread_mutex_unlock (&state_mutex_);
+  return parity;
+}
+
+void
+RFC2217Impl::setStopbits (serial::stopbits_t stopbits)
+{
+  pthread_mutex_lock (&state_mutex_);
+  stopbits_ = stopbits;
+  updateByteTime ();
+  pthread_mutex_unlock (&state_mutex_);
+  if (is_open_) {
+    sendCommand (set_stopsize, to_stopsize_value (stopbits));
+  }
+}
+
+serial::stopbits_t
+RFC2217Impl::getStopbits () const
+{
+  pthread_mutex_lock (&state_mutex_);
+  stopbits_t stopbits = stopbits_;
+  pthread_mutex_unlock (&state_mutex_);
+  return stopbits;
+}
+
+void
+RFC2217Impl::setFlowcontrol (serial::flowcontrol_t flowcontrol)
+{
+  pthread_mutex_lock (&state_mutex_);
+  flowcontrol_ = flowcontrol;
+  pthread_mutex_unlock (&state_mutex_);
+  if (is_open_) {
+    sendCommand (set_control, to_flow_value (flowcontrol));
+  }
+}
+
+serial::flowcontrol_t
+RFC2217Impl::getFlowcontrol () const
+{
+  pthread_mutex_lock (&state_mutex_);
+  flowcontrol_t flowcontrol = flowcontrol_;
+  pthread_mutex_unlock (&state_mutex_);
+  return flowcontrol;
+}
+
+bool
+RFC2217Impl::setLowLatency (bool low_latency)
+{
+  // The connection never delays small writes; the latency of the remote
+  // port is a setting of the server.
+  low_latency_ = low_latency;
+  return false;
+}
+
+bool
+RFC2217Impl::getLowLatency () const
+{
+  return low_latency_;
+}
+
+void
+RFC2217Impl::readLock ()
+{
+  int result = pthread_mutex_lock(&this->read_mutex);
+  if (result) {
+    THROW (IOException, result);
+  }
+}
+
+void
+RFC2217Impl::readUnlock ()
+{
+  int result = pthread_mutex_unlock(&this->read_mutex);
+  if (result) {
+    THROW (IOException, result);
+  }
+}
+
+void
+RFC2217Impl::writeLock ()
+{
+  int result = pthread_mutex_lock(&this->write_mutex);
+  if (result) {
+    THROW (IOException, result);
+  }
+}
+
+void
+RFC2217Impl::writeUnlock ()
+{
+  int result = pthread_mutex_unlock(&this->write_mutex);
+  if (result) {
+    THROW (IOException, result);
+  }
+}
+
+void *
+RFC2217Impl::receiveThread (void *impl)
+{
+  static_cast<RFC2217Impl *> (impl)->receive ();
+  return NULL;
+}
+
+void
+RFC2217Impl::receive ()
+{
+  uint8_t buffer[4096];
+
+  for (;;) {
+    pthread_mutex_lock (&state_mutex_);
+    bool stopping = stopping_;
+    bool full = rx_.size () - rx_offset_ >= receive_buffer_size;
+    pthread_mutex_unlock (&state_mutex_);
+
+    if (stopping) {
+      break;
+    }
+
+    pthread_mutex_lock (&send_mutex_);
+    bool sending = !tx_.empty ();
+    pthread_mutex_unlock (&send_mutex_);
+
+    // Stop reading while the buffer is full, so that TCP flow control
+    // holds back the server.
+    pollfd fds[2];
+    fds[0].fd = socket_;
+    fds[0].events = (full ? 0 : POLLIN) | (sending ? POLLOUT : 0);
+    fds[0].revents = 0;
+    fds[1].fd = wake_pipe_[0];
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    if (::poll (fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      while (::read (wake_pipe_[0], buffer, sizeof (buffer)) > 0) {
+      }
+    }
+
+    if (fds[0].revents & POLLOUT) {
+      pthread_mutex_lock (&send_mutex_);
+      sendQueue ();
+      pthread_mutex_unlock (&send_mutex_);
+    }
+
+    if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      ssize_t count = ::recv (socket_, buffer, sizeof (buffer), 0);
+      if (count < 0
+          && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        continue;
+      }
+      if (count <= 0) {
+        break;
+      }
+      pthread_mutex_lock (&state_mutex_);
+      parse (buffer, static_cast<size_t> (count));
+      updateReady ();
+      pthread_cond_broadcast (&state_cond_);
+      pthread_mutex_unlock (&state_mutex_);
+    }
+  }
+
+  pthread_mutex_lock (&state_mutex_);
+  connected_ = false;
+  updateReady ();
+  pthread_cond_broadcast (&state_cond_);
+  pthread_mutex_unlock (&state_mutex_);
+}
+
+void
+RFC2217Impl::parse (const uint8_t *data, size_t size)
+{
+  size_t i = 0;
+  while (i < size) {
+    uint8_t byte = data[i];
+    switch (parse_state_) {
+    case parse_data:
+      {
+        // Copy the run up to the next IAC at once.
+        const uint8_t *iac = static_cast<const uint8_t *> (
+          memchr (data + i, telnet_iac, size - i));
+        size_t end = iac == NULL ? size : static_cast<size_t> (iac - data);
+        rx_.insert (rx_.end (), data + i, data + end);
+        if (iac != NULL) {
+          parse_state_ = parse_iac;
+          ++end;
+        }
+        i = end;
+        continue;
+      }
+    case parse_iac:
+      if (byte == telnet_iac) {
+        rx_.push_back (byte);
+        parse_state_ = parse_data;
+      } else if (byte >= telnet_will && byte <= telnet_dont) {
+        parse_command_ = byte;
+        parse_state_ = parse_option;
+      } else if (byte == telnet_sb) {
+        subnegotiation_.clear ();
+        parse_state_ = parse_subnegotiation;
+      } else {
+        // NOP and the other commands have no meaning here.
+        parse_state_ = parse_data;
+      }
+      break;
+    case parse_option:
+      negotiate (parse_command_, byte);
+      parse_state_ = parse_data;
+      break;
+    case parse_subnegotiation:
+      if (byte == telnet_iac) {
+        parse_state_ = parse_subnegotiation_iac;
+      } else if (subnegotiation_.size () < max_subnegotiation_size) {
+        subnegotiation_.push_back (byte);
+      }
+      break;
+    case parse_subnegotiation_iac:
+      if (byte == telnet_iac) {
+        if (subnegotiation_.size () < max_subnegotiation_size) {
+          subnegotiation_.push_back (byte);
+        }
+        parse_state_ = parse_subnegotiation;
+      } else {
+        if (byte == telnet_se) {
+          subnegotiate ();
+        }
+        parse_state_ = parse_data;
+      }
+      break;
+    }
+    ++i;
+  }
+}
+
+void
+RFC2217Impl::negotiate (uint8_t command, uint8_t option)
+{
+  uint64_t bit = option_bit (option);
+  bool local_supported = option == option_binary
+                      || option == option_suppress_go_ahead
+                      || option == option_com_port;
+  bool remote_supported = option == option_binary
+                       || option == option_suppress_go_ahead;
+
+  // Reply only when the state changes, so negotiations cannot loop.
+  uint8_t answer = 0;
+
+  switch (command) {
+  case telnet_do:
+    if (!local_supported) {
+      answer = telnet_wont;
+    } else if ((local_options_ & bit) == 0) {
+      local_options_ |= bit;
+      answer = telnet_will;
+    }
+    if (option == option_com_port) {
+      com_port_answered_ = true;
+    }
+    break;
+  case telnet_dont:
+    if ((local_options_ & bit) != 0) {
+      local_options_ &= ~bit;
+      answer = telnet_wont;
+    }
+    if (option == option_com_port) {
+      com_port_refused_ = true;
+    }
+    break;
+  case telnet_will:
+    if (!remote_supported) {
+      answer = telnet_dont;
+    } else if ((remote_options_ & bit) == 0) {
+      remote_options_ |= bit;
+      answer = telnet_do;
+    }
+    break;
+  case telnet_wont:
+    if ((remote_options_ & bit) != 0) {
+      remote_options_ &= ~bit;
+      answer = telnet_dont;
+    }
+    break;
+  }
+
+  if (answer != 0) {
+    const uint8_t reply[] = { telnet_iac, answer, option };
+    pthread_mutex_lock (&send_mutex_);
+    tx_.insert (tx_.end (), reply, reply + sizeof (reply));
+    sendQueue ();
+    pthread_mutex_unlock (&send_mutex_);
+  }
+}
+
+void
+RFC2217Impl::subnegotiate ()
+{
+  if (subnegotiation_.size () < 2
+      || subnegotiation_[0] != option_com_port
+      || subnegotiation_[1] < server_offset
+      || subnegotiation_[1] > server_offset + purge_data) {
+    return;
+  }
+
+  uint8_t command = subnegotiation_[1] - server_offset;
+  const uint8_t *value = &subnegotiation_[0] + 2;
+  size_t size = subnegotiation_.size () - 2;
+  uint8_t byte = size > 0 ? value[0] : 0;
+
+  if (outstanding_[command] > 0) {
+    --outstanding_[command];
+  }
+
+  // An answer to an older request must not undo a newer one, so the local
+  // settings only take the server's value once all requests are answered.
+  bool settled = outstanding_[command] == 0;
+
+  switch (command) {
+  case set_baudrate:
+    if (settled && size >= 4) {
+      unsigned long baudrate = (unsigned long) value[0] << 24
+                             | (unsigned long) value[1] << 16
+                             | (unsigned long) value[2] << 8
+                             | value[3];
+      if (baudrate != 0) {
+        baudrate_ = baudrate;
+        updateByteTime ();
+      }
+    }
+    break;
+  case set_datasize:
+    if (settled && byte >= fivebits && byte <= eightbits) {
+      bytesize_ = static_cast<bytesize_t> (byte);
+      updateByteTime ();
+    }
+    break;
+  case set_parity:
+    if (settled && byte >= parity_value_none && byte <= parity_value_space) {
+      parity_ = from_parity_value (byte);
+      updateByteTime ();
+    }
+    break;
+  case set_stopsize:
+    if (settled && byte >= stopsize_value_one
+        && byte <= stopsize_value_one_point_five) {
+      stopbits_ = from_stopsize_value (byte);
+      updateByteTime ();
+    }
+    break;
+  case set_control:
+    if (settled && byte >= control_flow_none
+        && byte <= control_flow_hardware) {
+      flowcontrol_ = from_flow_value (byte);
+    }
+    break;
+  case notify_modemstate:
+    if ((byte & 0xf0) != (modem_state_ & 0xf0)) {
+      ++modem_changes_;
+    }
+    modem_state_ = byte;
+    break;
+  default:
+    break;
+  }
+}
+
+void
+RFC2217Impl::sendCommand (uint8_t command, const uint8_t *value, size_t size)
+{
+  pthread_mutex_lock (&state_mutex_);
+  ++outstanding_[command];
+  pthread_mutex_unlock (&state_mutex_);
+
+  // Commands go out at once, in order with the data, without waiting for
+  // the answer.  A failed send shows up as a disconnect on the next read.
+  pthread_mutex_lock (&send_mutex_);
+  append_command (tx_, command, value, size);
+  sendQueue ();
+  bool queued = !tx_.empty ();
+  pthread_mutex_unlock (&send_mutex_);
+
+  if (queued) {
+    wake ();
+  }
+}
+
+void
+RFC2217Impl::sendCommand (uint8_t command, uint8_t value)
+{
+  sendCommand (command, &value, 1);
+}
+
+bool
+RFC2217Impl::sendQueue ()
+{
+  size_t sent = 0;
+  while (sent < tx_.size ()) {
+    ssize_t count = ::send (socket_, &tx_[sent], tx_.size () - sent,
+                            send_flags);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      int error = errno;
+      tx_.erase (tx_.begin (), tx_.begin () + sent);
+      errno = error;
+      return false;
+    }
+    sent += static_cast<size_t> (count);
+  }
+  tx_.erase (tx_.begin (), tx_.begin () + sent);
+  return true;
+}
+
+bool
+RFC2217Impl::waitWritable (int64_t timeout_ms)
+{
+  return wait_for (socket_, POLLOUT, timeout_ms) > 0;
+}
+
+size_t
+RFC2217Impl::take (uint8_t *buf, size_t size)
+{
+  pthread_mutex_lock (&state_mutex_);
+  size_t waiting = rx_.size () - rx_offset_;
+  size_t count = std::min (size, waiting);
+  if (count > 0) {
+    memcpy (buf, &rx_[rx_offset_], count);
+    rx_offset_ += count;
+  }
+  if (rx_offset_ == rx_.size ()) {
+    rx_.clear ();
+    rx_offset_ = 0;
+  } else if (rx_offset_ >= receive_buffer_size) {
+    rx_.erase (rx_.begin (), rx_.begin () + rx_offset_);
+    rx_offset_ = 0;
+  }
+  updateReady ();
+  bool resume = waiting >= receive_buffer_size
+             && waiting - count < receive_buffer_size;
+  pthread_mutex_unlock (&state_mutex_);
+
+  if (resume) {
+    wake ();
+  }
+  return count;
+}
+
+void
+RFC2217Impl::updateReady ()
+{
+  bool ready = rx_.size () > rx_offset_ || !connected_;
+  uint8_t byte = 0;
+  if (ready && !ready_) {
+    ready_ = ::write (ready_pipe_[1], &byte, 1) == 1;
+  } else if (!ready && ready_) {
+    ready_ = ::read (ready_pipe_[0], &byte, 1) != 1;
+  }
+}
+
+void
+RFC2217Impl::wake ()
+{
+  uint8_t byte = 0;
+  ssize_t r = ::write (wake_pipe_[1], &byte, 1);
+  (void) r;
+}
+
+void
+RFC2217Impl::updateByteTime ()
+{
+  byte_time_ns_ = Serial::calculateByteTime (baudrate_, bytesize_, parity_,
+                                             stopbits_);
+}
+
+#endif // !defined(_WIN32)
@@ -0,0 +1,54 @@
+#if defined(__linux__)
+
+/* Copyright 2012 William Woodall and John Harrison
+ *
+ * Additional Contributors: Christopher Baker @bakercp
+ */
+
+// Only the kernel's termios definitions may be used in this file. Including
+// <termios.h> here would redefine struct termios and the B* constants.
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+#include "serial/impl/termios2_linux.h"
+
+int
+serial::termios2::set_baudrate (int fd, uint32_t baudrate)
+{
+  struct ::termios2 options;
+
+  if (-1 == ioctl (fd, TCGETS2, &options)) {
+    return errno;
+  }
+
+  options.c_cflag &= ~CBAUD;
+  options.c_cflag |= BOTHER;
+  options.c_ospeed = baudrate;
+  options.c_ispeed = baudrate;
+#ifdef IBSHIFT
+  options.c_cflag &= ~(CBAUD << IBSHIFT);
+  options.c_cflag |= BOTHER << IBSHIFT;
+#endif
+
+  if (-1 == ioctl (fd, TCSETS2, &options)) {
+    return errno;
+  }
+
+  return 0;
+}
+
+int
+serial::termios2::get_baudrate (int fd, uint32_t &baudrate)
+{
+  struct ::termios2 options;
+
+  if (-1 == ioctl (fd, TCGETS2, &options)) {
+    return errno;
+  }
+
+  baudrate = options.c_ospeed;
+  return 0;
+}
+
+#endif // defined(__linux__)
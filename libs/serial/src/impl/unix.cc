@@ -21,9 +21,11 @@
 
 #if defined(__linux__)
 # include <linux/serial.h>
+# include "serial/impl/termios2_linux.h"
 #endif
 
 #include <sys/select.h>
+#include <poll.h>
 #include <sys/time.h>
 #include <time.h>
 #ifdef __MACH__
@@ -54,32 +56,31 @@ using serial::Serial;
 using serial::SerialException;
 using serial::PortNotOpenedException;
 using serial::IOException;
+using serial::IOResult;
 
 
+static const int64_t NS_PER_MS = 1000000;
+static const int64_t NS_PER_S = 1000000000;
+
 MillisecondTimer::MillisecondTimer (const uint32_t millis)
-  : expiry(timespec_now())
+  : expiry_ns(now_ns() + static_cast<int64_t> (millis) * NS_PER_MS)
 {
-  int64_t tv_nsec = expiry.tv_nsec + (millis * 1e6);
-  if (tv_nsec >= 1e9) {
-    int64_t sec_diff = tv_nsec / static_cast<int> (1e9);
-    expiry.tv_nsec = tv_nsec % static_cast<int>(1e9);
-    expiry.tv_sec += sec_diff;
-  } else {
-    expiry.tv_nsec = tv_nsec;
-  }
 }
 
 int64_t
 MillisecondTimer::remaining ()
 {
-  timespec now(timespec_now());
-  int64_t millis = (expiry.tv_sec - now.tv_sec) * 1e3;
-  millis += (expiry.tv_nsec - now.tv_nsec) / 1e6;
-  return millis;
+  return remaining_ns() / NS_PER_MS;
 }
 
-timespec
-MillisecondTimer::timespec_now ()
+int64_t
+MillisecondTimer::remaining_ns ()
+{
+  return expiry_ns - now_ns();
+}
+
+int64_t
+MillisecondTimer::now_ns ()
 {
   timespec time;
 # ifdef __MACH__ // OS X does not have clock_gettime, use clock_get_time
@@ -93,15 +94,18 @@ MillisecondTimer::timespec_now ()
 # else
   clock_gettime(CLOCK_MONOTONIC, &time);
 # endif
-  return time;
+  return static_cast<int64_t> (time.tv_sec) * NS_PER_S + time.tv_nsec;
 }
 
-timespec
-timespec_from_ms (const uint32_t millis)
+static timespec
+timespec_from_ns (int64_t nanos)
 {
+  if (nanos < 0) {
+    nanos = 0;
+  }
   timespec time;
-  time.tv_sec = millis / 1e3;
-  time.tv_nsec = (millis - (time.tv_sec * 1e3)) * 1e6;
+  time.tv_sec = static_cast<time_t> (nanos / NS_PER_S);
+  time.tv_nsec = static_cast<long> (nanos % NS_PER_S);
   return time;
 }
 
@@ -111,7 +115,11 @@ Serial::SerialImpl::SerialImpl (const string &port, unsigned long baudrate,
                                 flowcontrol_t flowcontrol)
   : port_ (port), fd_ (-1), is_open_ (false), xonxoff_ (false), rtscts_ (false),
     baudrate_ (baudrate), parity_ (parity),
-    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol)
+    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol),
+    low_latency_ (false)
+#if defined(__linux__)
+    , original_serial_flags_ (-1)
+#endif
 {
   pthread_mutex_init(&this->read_mutex, NULL);
   pthread_mutex_init(&this->write_mutex, NULL);
@@ -154,6 +162,12 @@ Serial::SerialImpl::open ()
 
   reconfigurePort();
   is_open_ = true;
+
+#if defined(__linux__)
+  if (low_latency_) {
+    applyLowLatency ();
+  }
+#endif
 }
 
 void
@@ -315,22 +329,9 @@ Serial::SerialImpl::reconfigurePort ()
       THROW (IOException, errno);
     }
     // Linux Support
-#elif defined(__linux__) && defined (TIOCSSERIAL)
-    struct serial_struct ser;
-
-    if (-1 == ioctl (fd_, TIOCGSERIAL, &ser)) {
-      THROW (IOException, errno);
-    }
-
-    // set custom divisor
-    ser.custom_divisor = ser.baud_base / static_cast<int> (baudrate_);
-    // update flags
-    ser.flags &= ~ASYNC_SPD_MASK;
-    ser.flags |= ASYNC_SPD_CUST;
-
-    if (-1 == ioctl (fd_, TIOCSSERIAL, &ser)) {
-      THROW (IOException, errno);
-    }
+#elif defined(__linux__)
+    // The rate is set with termios2 after tcsetattr below, which would
+    // otherwise overwrite it.
 #else
     throw invalid_argument ("OS does not currently support custom bauds");
 #endif
@@ -435,7 +436,7 @@ Serial::SerialImpl::reconfigurePort ()
 
   // http://www.unixwiz.net/techtips/termios-vmin-vtime.html
   // this basically sets the read call up to be a polling read,
-  // but we are using select to ensure there is data available
+  // but we are using poll to ensure there is data available
   // to read before each call, so we should never needlessly poll
   options.c_cc[VMIN] = 0;
   options.c_cc[VTIME] = 0;
@@ -443,21 +444,94 @@ Serial::SerialImpl::reconfigurePort ()
   // activate settings
   ::tcsetattr (fd_, TCSANOW, &options);
 
+  unsigned long actual_baudrate = baudrate_;
+
+#if defined(__linux__)
+  if (custom_baud) {
+    actual_baudrate = setCustomBaudrate (options);
+  }
+#endif
+
   // Update byte_time_ based on the new settings.
-  uint32_t bit_time_ns = 1e9 / baudrate_;
-  byte_time_ns_ = bit_time_ns * (1 + bytesize_ + parity_ + stopbits_);
+  byte_time_ns_ = Serial::calculateByteTime (actual_baudrate, bytesize_,
+                                             parity_, stopbits_);
+}
+
+#if defined(__linux__)
+unsigned long
+Serial::SerialImpl::setCustomBaudrate (termios &options)
+{
+  // Prefer termios2 with BOTHER, which sets the exact rate and is supported
+  // by USB serial drivers such as cp210x, ch341 and cdc-acm.
+  int err = termios2::set_baudrate (fd_, static_cast<uint32_t> (baudrate_));
+
+  if (err == 0) {
+    uint32_t actual = 0;
+    err = termios2::get_baudrate (fd_, actual);
+    if (err != 0) {
+      THROW (IOException, err);
+    }
+
+    // Drivers round to the nearest rate their clock can generate. Accept
+    // anything within the 3% a UART receiver can tolerate.
+    unsigned long difference = (actual > baudrate_) ? actual - baudrate_ : baudrate_ - actual;
+    if (actual == 0 || difference * 100 > baudrate_ * 3) {
+      stringstream ss;
+      ss << "Requested baudrate " << baudrate_ << " but the driver set " << actual << ".";
+      THROW (IOException, ss.str ().c_str ());
+    }
+
+    return actual;
+  }
+
+  if (err != ENOTTY && err != EINVAL) {
+    THROW (IOException, err);
+  }
+
+#if defined (TIOCSSERIAL)
+  // Fall back to the deprecated custom divisor, which requires the port to
+  // be set to 38400.
+  struct serial_struct ser;
+
+  if (-1 == ioctl (fd_, TIOCGSERIAL, &ser)) {
+    THROW (IOException, errno);
+  }
+
+  if (ser.baud_base <= 0) {
+    throw invalid_argument ("OS does not currently support custom bauds");
+  }
 
-  // Compensate for the stopbits_one_point_five enum being equal to int 3,
-  // and not 1.5.
-  if (stopbits_ == stopbits_one_point_five) {
-    byte_time_ns_ += ((1.5 - stopbits_one_point_five) * bit_time_ns);
+  // set custom divisor
+  ser.custom_divisor = ser.baud_base / static_cast<int> (baudrate_);
+  if (ser.custom_divisor <= 0) {
+    ser.custom_divisor = 1;
   }
+  // update flags
+  ser.flags &= ~ASYNC_SPD_MASK;
+  ser.flags |= ASYNC_SPD_CUST;
+
+  if (-1 == ioctl (fd_, TIOCSSERIAL, &ser)) {
+    THROW (IOException, errno);
+  }
+
+  ::cfsetispeed(&options, B38400);
+  ::cfsetospeed(&options, B38400);
+  ::tcsetattr (fd_, TCSANOW, &options);
+
+  return ser.baud_base / ser.custom_divisor;
+#else
+  throw invalid_argument ("OS does not currently support custom bauds");
+#endif
 }
+#endif
 
 void
 Serial::SerialImpl::close ()
 {
   if (is_open_ == true) {
+#if defined(__linux__)
+    restoreLowLatency ();
+#endif
     if (fd_ != -1) {
       int ret;
       ret = ::close (fd_);
@@ -491,50 +565,96 @@ Serial::SerialImpl::available ()
   }
 }
 
-bool
-Serial::SerialImpl::waitReadable (uint32_t timeout)
+size_t
+Serial::SerialImpl::outWaiting ()
+{
+  if (!is_open_) {
+    return 0;
+  }
+  int count = 0;
+  if (-1 == ioctl (fd_, TIOCOUTQ, &count)) {
+      THROW (IOException, errno);
+  } else {
+      return static_cast<size_t> (count);
+  }
+}
+
+uint32_t
+Serial::SerialImpl::getByteTime () const
+{
+  return byte_time_ns_;
+}
+
+int
+Serial::SerialImpl::waitReady (bool write, int64_t timeout_ns)
 {
-  // Setup a select call to block for serial data or a timeout
-  fd_set readfds;
-  FD_ZERO (&readfds);
-  FD_SET (fd_, &readfds);
-  timespec timeout_ts (timespec_from_ms (timeout));
-  int r = pselect (fd_ + 1, &readfds, NULL, NULL, &timeout_ts, NULL);
+  timespec timeout_ts (timespec_from_ns (timeout_ns));
+#if defined(__APPLE__)
+  // poll does not support devices on OS X, so use select there. Unlike
+  // poll, select can not watch descriptors at or above FD_SETSIZE.
+  if (fd_ >= FD_SETSIZE) {
+    errno = EBADF;
+    return -1;
+  }
+  fd_set fds;
+  FD_ZERO (&fds);
+  FD_SET (fd_, &fds);
+  int r = pselect (fd_ + 1, write ? NULL : &fds, write ? &fds : NULL, NULL,
+                   &timeout_ts, NULL);
+#else
+  pollfd pfd;
+  pfd.fd = fd_;
+  pfd.events = write ? POLLOUT : POLLIN;
+  pfd.revents = 0;
+  int r = ppoll (&pfd, 1, &timeout_ts, NULL);
+#endif
 
   if (r < 0) {
-    // Select was interrupted
+    // Interrupted
     if (errno == EINTR) {
-      return false;
+      return 0;
     }
     // Otherwise there was some error
-    THROW (IOException, errno);
+    return -1;
   }
   // Timeout occurred
   if (r == 0) {
-    return false;
+    return 0;
   }
-  // This shouldn't happen, if r > 0 our fd has to be in the list!
-  if (!FD_ISSET (fd_, &readfds)) {
-    THROW (IOException, "select reports ready to read, but our fd isn't"
-           " in the list, this shouldn't happen!");
+#if !defined(__APPLE__)
+  if (pfd.revents & POLLNVAL) {
+    errno = EBADF;
+    return -1;
   }
-  // Data available to read.
-  return true;
+  // POLLERR and POLLHUP are reported as ready so that the following read
+  // or write reports the disconnect.
+#endif
+  return 1;
+}
+
+bool
+Serial::SerialImpl::waitReadable (uint32_t timeout)
+{
+  int r = waitReady (false, static_cast<int64_t> (timeout) * NS_PER_MS);
+  if (r < 0) {
+    THROW (IOException, errno);
+  }
+  return r > 0;
 }
 
 void
 Serial::SerialImpl::waitByteTimes (size_t count)
 {
-  timespec wait_time = { 0, static_cast<long>(byte_time_ns_ * count)};
-  pselect (0, NULL, NULL, NULL, &wait_time, NULL);
+  timespec wait_time (timespec_from_ns (static_cast<int64_t> (byte_time_ns_) * count));
+  while (::nanosleep (&wait_time, &wait_time) == -1 && errno == EINTR) {
+  }
 }
 
-size_t
-Serial::SerialImpl::read (uint8_t *buf, size_t size)
+IOResult
+Serial::SerialImpl::tryRead (uint8_t *buf, size_t size)
 {
-  // If the port is not open, throw
   if (!is_open_) {
-    throw PortNotOpenedException ("Serial::read");
+    return IOResult (0, io_port_not_open);
   }
   size_t bytes_read = 0;
 
@@ -552,67 +672,50 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
   }
 
   while (bytes_read < size) {
-    int64_t timeout_remaining_ms = total_timeout.remaining();
-    if (timeout_remaining_ms <= 0) {
+    int64_t timeout_remaining_ns = total_timeout.remaining_ns();
+    if (timeout_remaining_ns <= 0) {
       // Timed out
       break;
     }
-    // Timeout for the next select is whichever is less of the remaining
+    // Timeout for the next wait is whichever is less of the remaining
     // total read timeout and the inter-byte timeout.
-    uint32_t timeout = std::min(static_cast<uint32_t> (timeout_remaining_ms),
-                                timeout_.inter_byte_timeout);
-    // Wait for the device to be readable, and then attempt to read.
-    if (waitReadable(timeout)) {
-      // If it's a fixed-length multi-byte read, insert a wait here so that
-      // we can attempt to grab the whole thing in a single IO call. Skip
-      // this wait if a non-max inter_byte_timeout is specified.
-      if (size > 1 && timeout_.inter_byte_timeout == Timeout::max()) {
-        size_t bytes_available = available();
-        if (bytes_available + bytes_read < size) {
-          waitByteTimes(size - (bytes_available + bytes_read));
-        }
-      }
-      // This should be non-blocking returning only what is available now
-      //  Then returning so that select can block again.
-      ssize_t bytes_read_now =
-        ::read (fd_, buf + bytes_read, size - bytes_read);
-      // read should always return some data as select reported it was
-      // ready to read when we get to this point.
-      if (bytes_read_now < 1) {
-        // Disconnected devices, at least on Linux, show the
-        // behavior that they are always ready to read immediately
-        // but reading returns nothing.
-        throw SerialException ("device reports readiness to read but "
-                               "returned no data (device disconnected?)");
-      }
-      // Update bytes_read
-      bytes_read += static_cast<size_t> (bytes_read_now);
-      // If bytes_read == size then we have read everything we need
-      if (bytes_read == size) {
-        break;
-      }
-      // If bytes_read < size then we have more to read
-      if (bytes_read < size) {
-        continue;
-      }
-      // If bytes_read > size then we have over read, which shouldn't happen
-      if (bytes_read > size) {
-        throw SerialException ("read over read, too many bytes where "
-                               "read, this shouldn't happen, might be "
-                               "a logical error!");
-      }
+    int64_t timeout_ns = std::min(timeout_remaining_ns,
+                                  static_cast<int64_t> (timeout_.inter_byte_timeout) * NS_PER_MS);
+    // Wait for the device to be readable, and then attempt to read. Partial
+    // reads are accumulated as they arrive, so the call returns as soon as
+    // the last requested byte is received rather than after an estimate of
+    // the transmit time.
+    int r = waitReady (false, timeout_ns);
+    if (r < 0) {
+      return IOResult (bytes_read, io_error, errno);
+    }
+    if (r == 0) {
+      continue;
+    }
+    // This should be non-blocking returning only what is available now
+    //  Then returning so that poll can block again.
+    ssize_t bytes_read_now =
+      ::read (fd_, buf + bytes_read, size - bytes_read);
+    // read should always return some data as poll reported it was
+    // ready to read when we get to this point.
+    if (bytes_read_now < 1) {
+      // Disconnected devices, at least on Linux, show the
+      // behavior that they are always ready to read immediately
+      // but reading returns nothing.
+      return IOResult (bytes_read, io_disconnected);
     }
+    // Update bytes_read
+    bytes_read += static_cast<size_t> (bytes_read_now);
   }
-  return bytes_read;
+  return IOResult (bytes_read);
 }
 
-size_t
-Serial::SerialImpl::write (const uint8_t *data, size_t length)
+IOResult
+Serial::SerialImpl::tryWrite (const uint8_t *data, size_t length)
 {
   if (is_open_ == false) {
-    throw PortNotOpenedException ("Serial::write");
+    return IOResult (0, io_port_not_open);
   }
-  fd_set writefds;
   size_t bytes_written = 0;
 
   // Calculate total timeout in milliseconds t_c + (t_m * N)
@@ -622,76 +725,40 @@ Serial::SerialImpl::write (const uint8_t *data, size_t length)
 
   bool first_iteration = true;
   while (bytes_written < length) {
-    int64_t timeout_remaining_ms = total_timeout.remaining();
+    int64_t timeout_remaining_ns = total_timeout.remaining_ns();
     // Only consider the timeout if it's not the first iteration of the loop
     // otherwise a timeout of 0 won't be allowed through
-    if (!first_iteration && (timeout_remaining_ms <= 0)) {
+    if (!first_iteration && (timeout_remaining_ns <= 0)) {
       // Timed out
       break;
     }
     first_iteration = false;
 
-    timespec timeout(timespec_from_ms(timeout_remaining_ms));
-
-    FD_ZERO (&writefds);
-    FD_SET (fd_, &writefds);
-
-    // Do the select
-    int r = pselect (fd_ + 1, NULL, &writefds, NULL, &timeout, NULL);
-
-    // Figure out what happened by looking at select's response 'r'
-    /** Error **/
+    // Wait for the port to be writable. On a timeout or interruption go
+    // around again, which ends the loop once the total timeout expires.
+    int r = waitReady (true, timeout_remaining_ns);
     if (r < 0) {
-      // Select was interrupted, try again
-      if (errno == EINTR) {
-        continue;
-      }
-      // Otherwise there was some error
-      THROW (IOException, errno);
+      return IOResult (bytes_written, io_error, errno);
     }
-    /** Timeout **/
     if (r == 0) {
-      break;
+      continue;
     }
-    /** Port ready to write **/
-    if (r > 0) {
-      // Make sure our file descriptor is in the ready to write list
-      if (FD_ISSET (fd_, &writefds)) {
-        // This will write some
-        ssize_t bytes_written_now =
-          ::write (fd_, data + bytes_written, length - bytes_written);
-        // write should always return some data as select reported it was
-        // ready to write when we get to this point.
-        if (bytes_written_now < 1) {
-          // Disconnected devices, at least on Linux, show the
-          // behavior that they are always ready to write immediately
-          // but writing returns nothing.
-          throw SerialException ("device reports readiness to write but "
-                                 "returned no data (device disconnected?)");
-        }
-        // Update bytes_written
-        bytes_written += static_cast<size_t> (bytes_written_now);
-        // If bytes_written == size then we have written everything we need to
-        if (bytes_written == length) {
-          break;
-        }
-        // If bytes_written < size then we have more to write
-        if (bytes_written < length) {
-          continue;
-        }
-        // If bytes_written > size then we have over written, which shouldn't happen
-        if (bytes_written > length) {
-          throw SerialException ("write over wrote, too many bytes where "
-                                 "written, this shouldn't happen, might be "
-                                 "a logical error!");
-        }
-      }
-      // This shouldn't happen, if r > 0 our fd has to be in the list!
-      THROW (IOException, "select reports ready to write, but our fd isn't"
-                          " in the list, this shouldn't happen!");
+
+    // This will write some
+    ssize_t bytes_written_now =
+      ::write (fd_, data + bytes_written, length - bytes_written);
+    // write should always return some data as poll reported it was
+    // ready to write when we get to this point.
+    if (bytes_written_now < 1) {
+      // Disconnected devices, at least on Linux, show the
+      // behavior that they are always ready to write immediately
+      // but writing returns nothing.
+      return IOResult (bytes_written, io_disconnected);
     }
+    // Update bytes_written
+    bytes_written += static_cast<size_t> (bytes_written_now);
   }
-  return bytes_written;
+  return IOResult (bytes_written);
 }
 
 void
@@ -706,6 +773,12 @@ Serial::SerialImpl::getPort () const
   return port_;
 }
 
+int
+Serial::SerialImpl::getFd () const
+{
+  return is_open_ ? fd_ : -1;
+}
+
 void
 Serial::SerialImpl::setTimeout (serial::Timeout &timeout)
 {
@@ -788,6 +861,118 @@ Serial::SerialImpl::getFlowcontrol () const
   return flowcontrol_;
 }
 
+bool
+Serial::SerialImpl::setLowLatency (bool low_latency)
+{
+  low_latency_ = low_latency;
+#if defined(__linux__)
+  if (!is_open_) {
+    return true;
+  }
+  if (low_latency_) {
+    return applyLowLatency ();
+  }
+  restoreLowLatency ();
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool
+Serial::SerialImpl::getLowLatency () const
+{
+  return low_latency_;
+}
+
+#if defined(__linux__)
+static string
+read_sysfs_attribute (const string &path)
+{
+  string value;
+  int fd = ::open (path.c_str (), O_RDONLY);
+  if (fd != -1) {
+    char buffer[32];
+    ssize_t count = ::read (fd, buffer, sizeof (buffer) - 1);
+    if (count > 0) {
+      value.assign (buffer, static_cast<size_t> (count));
+      value.erase (value.find_last_not_of (" \n") + 1);
+    }
+    ::close (fd);
+  }
+  return value;
+}
+
+static bool
+write_sysfs_attribute (const string &path, const string &value)
+{
+  int fd = ::open (path.c_str (), O_WRONLY);
+  if (fd == -1) {
+    return false;
+  }
+  ssize_t count = ::write (fd, value.c_str (), value.size ());
+  ::close (fd);
+  return count == static_cast<ssize_t> (value.size ());
+}
+
+bool
+Serial::SerialImpl::applyLowLatency ()
+{
+  bool applied = false;
+
+#if defined (TIOCSSERIAL) && defined (ASYNC_LOW_LATENCY)
+  struct serial_struct ser;
+  if (0 == ioctl (fd_, TIOCGSERIAL, &ser)) {
+    if (original_serial_flags_ == -1) {
+      original_serial_flags_ = ser.flags;
+    }
+    ser.flags |= ASYNC_LOW_LATENCY;
+    if (0 == ioctl (fd_, TIOCSSERIAL, &ser)) {
+      applied = true;
+    } else if (errno != ENOTTY && errno != EINVAL && errno != EPERM) {
+      THROW (IOException, errno);
+    }
+  }
+#endif
+
+  if (latency_timer_path_.empty ()) {
+    latency_timer_path_ = ftdi_latency_timer_path (port_);
+  }
+
+  if (!latency_timer_path_.empty ()) {
+    if (original_latency_timer_.empty ()) {
+      original_latency_timer_ = read_sysfs_attribute (latency_timer_path_);
+    }
+    if (write_sysfs_attribute (latency_timer_path_, "1")) {
+      applied = true;
+    }
+  }
+
+  return applied;
+}
+
+void
+Serial::SerialImpl::restoreLowLatency ()
+{
+#if defined (TIOCSSERIAL) && defined (ASYNC_LOW_LATENCY)
+  if (original_serial_flags_ != -1) {
+    struct serial_struct ser;
+    if (0 == ioctl (fd_, TIOCGSERIAL, &ser)) {
+      ser.flags = (ser.flags & ~ASYNC_LOW_LATENCY)
+                | (original_serial_flags_ & ASYNC_LOW_LATENCY);
+      ioctl (fd_, TIOCSSERIAL, &ser);
+    }
+    original_serial_flags_ = -1;
+  }
+#endif
+
+  if (!original_latency_timer_.empty ()) {
+    write_sysfs_attribute (latency_timer_path_, original_latency_timer_);
+    original_latency_timer_.clear ();
+  }
+}
+#endif
+
 void
 Serial::SerialImpl::flush ()
 {
@@ -19,6 +19,7 @@ using serial::flowcontrol_t;
 using serial::SerialException;
 using serial::PortNotOpenedException;
 using serial::IOException;
+using serial::IOResult;
 
 inline wstring
 _prefix_port_if_needed(const wstring &input)
@@ -37,7 +38,8 @@ Serial::SerialImpl::SerialImpl (const string &port, unsigned long baudrate,
                                 flowcontrol_t flowcontrol)
   : port_ (port.begin(), port.end()), fd_ (INVALID_HANDLE_VALUE), is_open_ (false),
     baudrate_ (baudrate), parity_ (parity),
-    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol)
+    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol),
+    low_latency_ (false)
 {
   if (port_.empty () == false)
     open ();
@@ -314,6 +316,27 @@ Serial::SerialImpl::available ()
   return static_cast<size_t>(cs.cbInQue);
 }
 
+size_t
+Serial::SerialImpl::outWaiting ()
+{
+  if (!is_open_) {
+    return 0;
+  }
+  COMSTAT cs;
+  if (!ClearCommError(fd_, NULL, &cs)) {
+    stringstream ss;
+    ss << "Error while checking status of the serial port: " << GetLastError();
+    THROW (IOException, ss.str().c_str());
+  }
+  return static_cast<size_t>(cs.cbOutQue);
+}
+
+uint32_t
+Serial::SerialImpl::getByteTime () const
+{
+  return Serial::calculateByteTime (baudrate_, bytesize_, parity_, stopbits_);
+}
+
 bool
 Serial::SerialImpl::waitReadable (uint32_t /*timeout*/)
 {
@@ -327,34 +350,30 @@ Serial::SerialImpl::waitByteTimes (size_t /*count*/)
   THROW (IOException, "waitByteTimes is not implemented on Windows.");
 }
 
-size_t
-Serial::SerialImpl::read (uint8_t *buf, size_t size)
+IOResult
+Serial::SerialImpl::tryRead (uint8_t *buf, size_t size)
 {
   if (!is_open_) {
-    throw PortNotOpenedException ("Serial::read");
+    return IOResult (0, io_port_not_open);
   }
   DWORD bytes_read;
   if (!ReadFile(fd_, buf, static_cast<DWORD>(size), &bytes_read, NULL)) {
-    stringstream ss;
-    ss << "Error while reading from the serial port: " << GetLastError();
-    THROW (IOException, ss.str().c_str());
+    return IOResult (0, io_error, static_cast<int> (GetLastError()));
   }
-  return (size_t) (bytes_read);
+  return IOResult (static_cast<size_t> (bytes_read));
 }
 
-size_t
-Serial::SerialImpl::write (const uint8_t *data, size_t length)
+IOResult
+Serial::SerialImpl::tryWrite (const uint8_t *data, size_t length)
 {
   if (is_open_ == false) {
-    throw PortNotOpenedException ("Serial::write");
+    return IOResult (0, io_port_not_open);
   }
   DWORD bytes_written;
   if (!WriteFile(fd_, data, static_cast<DWORD>(length), &bytes_written, NULL)) {
-    stringstream ss;
-    ss << "Error while writing to the serial port: " << GetLastError();
-    THROW (IOException, ss.str().c_str());
+    return IOResult (0, io_error, static_cast<int> (GetLastError()));
   }
-  return (size_t) (bytes_written);
+  return IOResult (static_cast<size_t> (bytes_written));
 }
 
 void
@@ -369,6 +388,12 @@ Serial::SerialImpl::getPort () const
   return string(port_.begin(), port_.end());
 }
 
+int
+Serial::SerialImpl::getFd () const
+{
+  return -1;
+}
+
 void
 Serial::SerialImpl::setTimeout (serial::Timeout &timeout)
 {
@@ -459,6 +484,21 @@ Serial::SerialImpl::getFlowcontrol () const
   return flowcontrol_;
 }
 
+bool
+Serial::SerialImpl::setLowLatency (bool low_latency)
+{
+  // The FTDI latency timer is a driver setting on Windows, configured in the
+  // device manager, and there is no ASYNC_LOW_LATENCY equivalent.
+  low_latency_ = low_latency;
+  return false;
+}
+
+bool
+Serial::SerialImpl::getLowLatency () const
+{
+  return low_latency_;
+}
+
 void
 Serial::SerialImpl::flush ()
 {
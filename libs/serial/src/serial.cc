@@ -1,13 +1,7 @@
 /* Copyright 2012 William Woodall and John Harrison */
 #include <algorithm>
-
-#if !defined(_WIN32) && !defined(__OpenBSD__) && !defined(__FreeBSD__)
-# include <alloca.h>
-#endif
-
-#if defined (__MINGW32__)
-# define alloca __builtin_alloca
-#endif
+#include <cstring>
+#include <sstream>
 
 #include "serial/serial.h"
 
@@ -15,6 +9,8 @@
 #include "serial/impl/win.h"
 #else
 #include "serial/impl/unix.h"
+#include "serial/impl/rfc2217.h"
+#include "serial/impl/loopback.h"
 #endif
 
 using std::invalid_argument;
@@ -25,117 +21,301 @@ using std::size_t;
 using std::string;
 
 using serial::Serial;
+using serial::SerialBackend;
 using serial::SerialException;
 using serial::IOException;
+using serial::IOResult;
+using serial::PortNotOpenedException;
 using serial::bytesize_t;
 using serial::parity_t;
 using serial::stopbits_t;
 using serial::flowcontrol_t;
+using serial::threadingmode_t;
 
+// The scoped locks do nothing for ports constructed with threading_single.
+// setPort() may replace the backend while a lock waits on the old one, so
+// the locks retry until they hold the lock of the current backend.  Replaced
+// backends are kept for reuse until the Serial is destroyed.
 class Serial::ScopedReadLock {
 public:
-  ScopedReadLock(SerialImpl *pimpl) : pimpl_(pimpl) {
-    this->pimpl_->readLock();
+  ScopedReadLock(Serial *serial)
+   : pimpl_(serial->threading_ == threading_multi ? serial->backend_ ()
+                                                  : NULL) {
+    if (this->pimpl_) this->pimpl_->readLock();
+    while (this->pimpl_ && this->pimpl_ != serial->backend_ ()) {
+      this->pimpl_->readUnlock();
+      this->pimpl_ = serial->backend_ ();
+      this->pimpl_->readLock();
+    }
   }
   ~ScopedReadLock() {
-    this->pimpl_->readUnlock();
+    if (this->pimpl_) this->pimpl_->readUnlock();
   }
 private:
   // Disable copy constructors
   ScopedReadLock(const ScopedReadLock&);
   const ScopedReadLock& operator=(ScopedReadLock);
 
-  SerialImpl *pimpl_;
+  SerialBackend *pimpl_;
 };
 
 class Serial::ScopedWriteLock {
 public:
-  ScopedWriteLock(SerialImpl *pimpl) : pimpl_(pimpl) {
-    this->pimpl_->writeLock();
+  ScopedWriteLock(Serial *serial)
+   : pimpl_(serial->threading_ == threading_multi ? serial->backend_ ()
+                                                  : NULL) {
+    if (this->pimpl_) this->pimpl_->writeLock();
+    while (this->pimpl_ && this->pimpl_ != serial->backend_ ()) {
+      this->pimpl_->writeUnlock();
+      this->pimpl_ = serial->backend_ ();
+      this->pimpl_->writeLock();
+    }
   }
   ~ScopedWriteLock() {
-    this->pimpl_->writeUnlock();
+    if (this->pimpl_) this->pimpl_->writeUnlock();
   }
 private:
   // Disable copy constructors
   ScopedWriteLock(const ScopedWriteLock&);
   const ScopedWriteLock& operator=(ScopedWriteLock);
-  SerialImpl *pimpl_;
+  SerialBackend *pimpl_;
 };
 
+// Ports named rfc2217://host:port are served by an RFC 2217 server, ports
+// named loop:// are in memory.
+typedef enum {
+  backend_local,
+  backend_rfc2217,
+  backend_loopback
+} backend_t;
+
+static int
+backend_for_port (const string &port)
+{
+  if (port.compare (0, 10, "rfc2217://") == 0) {
+    return backend_rfc2217;
+  }
+  if (port.compare (0, 7, "loop://") == 0) {
+    return backend_loopback;
+  }
+  return backend_local;
+}
+
+SerialBackend *
+Serial::createBackend_ (int backend, const string &port,
+                        unsigned long baudrate, bytesize_t bytesize,
+                        parity_t parity, stopbits_t stopbits,
+                        flowcontrol_t flowcontrol)
+{
+  switch (backend) {
+  case backend_rfc2217:
+#ifdef _WIN32
+    throw invalid_argument ("rfc2217:// ports are not supported on Windows.");
+#else
+    return new serial::RFC2217Impl (port, baudrate, bytesize, parity,
+                                    stopbits, flowcontrol);
+#endif
+  case backend_loopback:
+#ifdef _WIN32
+    throw invalid_argument ("loop:// ports are not supported on Windows.");
+#else
+    return new serial::LoopbackImpl (port, baudrate, bytesize, parity,
+                                     stopbits, flowcontrol);
+#endif
+  default:
+    return new SerialImpl (port, baudrate, bytesize, parity, stopbits,
+                           flowcontrol);
+  }
+}
+
 Serial::Serial (const string &port, uint32_t baudrate, serial::Timeout timeout,
                 bytesize_t bytesize, parity_t parity, stopbits_t stopbits,
-                flowcontrol_t flowcontrol)
- : pimpl_(new SerialImpl (port, baudrate, bytesize, parity,
-                                           stopbits, flowcontrol))
+                flowcontrol_t flowcontrol, threadingmode_t threading)
+ : pimpl_(createBackend_ (backend_for_port (port), port, baudrate, bytesize,
+                          parity, stopbits, flowcontrol)),
+   threading_(threading)
+{
+  backend_ ()->setTimeout(timeout);
+}
+
+Serial::Serial (SerialBackend *backend, threadingmode_t threading)
+ : pimpl_(backend), threading_(threading)
 {
-  pimpl_->setTimeout(timeout);
+  if (backend == NULL) {
+    throw invalid_argument ("The backend must not be NULL.");
+  }
 }
 
 Serial::~Serial ()
 {
-  delete pimpl_;
+  delete backend_ ();
+  for (size_t i = 0; i < retired_.size (); ++i) {
+    delete retired_[i];
+  }
 }
 
 void
 Serial::open ()
 {
-  pimpl_->open ();
+  backend_ ()->open ();
 }
 
 void
 Serial::close ()
 {
-  pimpl_->close ();
+  backend_ ()->close ();
 }
 
 bool
 Serial::isOpen () const
 {
-  return pimpl_->isOpen ();
+  return backend_ ()->isOpen ();
 }
 
 size_t
 Serial::available ()
 {
-  return pimpl_->available ();
+  return backend_ ()->available ();
+}
+
+size_t
+Serial::outWaiting ()
+{
+  return backend_ ()->outWaiting ();
+}
+
+uint32_t
+Serial::getByteTime () const
+{
+  return backend_ ()->getByteTime ();
+}
+
+uint32_t
+Serial::calculateByteTime (unsigned long baudrate, bytesize_t bytesize,
+                           parity_t parity, stopbits_t stopbits)
+{
+  if (baudrate == 0) {
+    return 0;
+  }
+
+  // Every parity mode other than none adds a single bit.
+  uint32_t bit_time_ns = 1e9 / baudrate;
+  uint32_t parity_bits = (parity == parity_none) ? 0 : 1;
+  uint32_t byte_time_ns = bit_time_ns * (1 + bytesize + parity_bits + stopbits);
+
+  // Compensate for the stopbits_one_point_five enum being equal to int 3,
+  // and not 1.5.
+  if (stopbits == stopbits_one_point_five) {
+    byte_time_ns -= bit_time_ns * 3 / 2;
+  }
+
+  return byte_time_ns;
 }
 
 bool
 Serial::waitReadable ()
 {
-  serial::Timeout timeout(pimpl_->getTimeout ());
-  return pimpl_->waitReadable(timeout.read_timeout_constant);
+  serial::Timeout timeout(backend_ ()->getTimeout ());
+  return backend_ ()->waitReadable(timeout.read_timeout_constant);
+}
+
+bool
+Serial::waitReadable (uint32_t timeout)
+{
+  return backend_ ()->waitReadable(timeout);
 }
 
 void
 Serial::waitByteTimes (size_t count)
 {
-  pimpl_->waitByteTimes(count);
+  backend_ ()->waitByteTimes(count);
+}
+
+// Turns a failed IOResult into the exception the throwing API has always
+// raised for it.
+static size_t
+check_io_result (const IOResult &result, bool write)
+{
+  switch (result.status) {
+  case serial::io_ok:
+    return result.bytes;
+  case serial::io_port_not_open:
+    throw PortNotOpenedException (write ? "Serial::write" : "Serial::read");
+  case serial::io_disconnected:
+    if (write) {
+      throw SerialException ("device reports readiness to write but "
+                             "returned no data (device disconnected?)");
+    }
+    throw SerialException ("device reports readiness to read but "
+                           "returned no data (device disconnected?)");
+  default:
+#if defined(_WIN32)
+    {
+      std::stringstream ss;
+      ss << (write ? "Error while writing to the serial port: "
+                   : "Error while reading from the serial port: ")
+         << result.error_number;
+      THROW (IOException, ss.str().c_str());
+    }
+#else
+    THROW (IOException, result.error_number);
+#endif
+  }
+}
+
+string
+IOResult::message () const
+{
+  switch (status) {
+  case io_ok:
+    return "ok";
+  case io_port_not_open:
+    return "serial port not opened";
+  case io_disconnected:
+    return "device reports readiness but returned no data "
+           "(device disconnected?)";
+  default:
+    {
+      std::stringstream ss;
+#if defined(_WIN32)
+      ss << "I/O error: " << error_number;
+#else
+      ss << "I/O error: " << error_number << ", " << strerror (error_number);
+#endif
+      return ss.str();
+    }
+  }
 }
 
 size_t
 Serial::read_ (uint8_t *buffer, size_t size)
 {
-  return this->pimpl_->read (buffer, size);
+  return check_io_result (backend_ ()->tryRead (buffer, size), false);
 }
 
 size_t
 Serial::read (uint8_t *buffer, size_t size)
 {
-  ScopedReadLock lock(this->pimpl_);
-  return this->pimpl_->read (buffer, size);
+  ScopedReadLock lock(this);
+  return this->read_ (buffer, size);
+}
+
+IOResult
+Serial::tryRead (uint8_t *buffer, size_t size)
+{
+  ScopedReadLock lock(this);
+  return backend_ ()->tryRead (buffer, size);
 }
 
 size_t
 Serial::read (std::vector<uint8_t> &buffer, size_t size)
 {
-  ScopedReadLock lock(this->pimpl_);
+  ScopedReadLock lock(this);
   uint8_t *buffer_ = new uint8_t[size];
   size_t bytes_read = 0;
 
   try {
-    bytes_read = this->pimpl_->read (buffer_, size);
+    bytes_read = this->read_ (buffer_, size);
   }
   catch (const std::exception &e) {
     delete[] buffer_;
@@ -150,11 +330,11 @@ Serial::read (std::vector<uint8_t> &buffer, size_t size)
 size_t
 Serial::read (std::string &buffer, size_t size)
 {
-  ScopedReadLock lock(this->pimpl_);
+  ScopedReadLock lock(this);
   uint8_t *buffer_ = new uint8_t[size];
   size_t bytes_read = 0;
   try {
-    bytes_read = this->pimpl_->read (buffer_, size);
+    bytes_read = this->read_ (buffer_, size);
   }
   catch (const std::exception &e) {
     delete[] buffer_;
@@ -176,27 +356,25 @@ Serial::read (size_t size)
 size_t
 Serial::readline (string &buffer, size_t size, string eol)
 {
-  ScopedReadLock lock(this->pimpl_);
+  ScopedReadLock lock(this);
   size_t eol_len = eol.length ();
-  uint8_t *buffer_ = static_cast<uint8_t*>
-                              (alloca (size * sizeof (uint8_t)));
+  size_t start = buffer.length ();
   size_t read_so_far = 0;
-  while (true)
+  // Read straight into the caller's string; size is only a limit and may
+  // be far larger than the line.
+  while (read_so_far < size)
   {
-    size_t bytes_read = this->read_ (buffer_ + read_so_far, 1);
-    read_so_far += bytes_read;
-    if (bytes_read == 0) {
+    uint8_t byte;
+    if (this->read_ (&byte, 1) == 0) {
       break; // Timeout occured on reading 1 byte
     }
-    if (string (reinterpret_cast<const char*>
-         (buffer_ + read_so_far - eol_len), eol_len) == eol) {
+    buffer.push_back (static_cast<char> (byte));
+    ++read_so_far;
+    if (read_so_far >= eol_len &&
+        buffer.compare (start + read_so_far - eol_len, eol_len, eol) == 0) {
       break; // EOL found
     }
-    if (read_so_far == size) {
-      break; // Reached the maximum read length
-    }
   }
-  buffer.append(reinterpret_cast<const char*> (buffer_), read_so_far);
   return read_so_far;
 }
 
@@ -211,48 +389,36 @@ Serial::readline (size_t size, string eol)
 vector<string>
 Serial::readlines (size_t size, string eol)
 {
-  ScopedReadLock lock(this->pimpl_);
+  ScopedReadLock lock(this);
   std::vector<std::string> lines;
   size_t eol_len = eol.length ();
-  uint8_t *buffer_ = static_cast<uint8_t*>
-    (alloca (size * sizeof (uint8_t)));
+  std::string line;
   size_t read_so_far = 0;
-  size_t start_of_line = 0;
   while (read_so_far < size) {
-    size_t bytes_read = this->read_ (buffer_+read_so_far, 1);
-    read_so_far += bytes_read;
-    if (bytes_read == 0) {
-      if (start_of_line != read_so_far) {
-        lines.push_back (
-          string (reinterpret_cast<const char*> (buffer_ + start_of_line),
-            read_so_far - start_of_line));
-      }
+    uint8_t byte;
+    if (this->read_ (&byte, 1) == 0) {
       break; // Timeout occured on reading 1 byte
     }
-    if (string (reinterpret_cast<const char*>
-         (buffer_ + read_so_far - eol_len), eol_len) == eol) {
+    line.push_back (static_cast<char> (byte));
+    ++read_so_far;
+    if (line.length () >= eol_len &&
+        line.compare (line.length () - eol_len, eol_len, eol) == 0) {
       // EOL found
-      lines.push_back(
-        string(reinterpret_cast<const char*> (buffer_ + start_of_line),
-          read_so_far - start_of_line));
-      start_of_line = read_so_far;
-    }
-    if (read_so_far == size) {
-      if (start_of_line != read_so_far) {
-        lines.push_back(
-          string(reinterpret_cast<const char*> (buffer_ + start_of_line),
-            read_so_far - start_of_line));
-      }
-      break; // Reached the maximum read length
+      lines.push_back (line);
+      line.clear ();
     }
   }
+  // Timeout or maximum read length, keep the partial line
+  if (!line.empty ()) {
+    lines.push_back (line);
+  }
   return lines;
 }
 
 size_t
 Serial::write (const string &data)
 {
-  ScopedWriteLock lock(this->pimpl_);
+  ScopedWriteLock lock(this);
   return this->write_ (reinterpret_cast<const uint8_t*>(data.c_str()),
                        data.length());
 }
@@ -260,171 +426,235 @@ Serial::write (const string &data)
 size_t
 Serial::write (const std::vector<uint8_t> &data)
 {
-  ScopedWriteLock lock(this->pimpl_);
+  ScopedWriteLock lock(this);
   return this->write_ (&data[0], data.size());
 }
 
 size_t
 Serial::write (const uint8_t *data, size_t size)
 {
-  ScopedWriteLock lock(this->pimpl_);
+  ScopedWriteLock lock(this);
   return this->write_(data, size);
 }
 
+IOResult
+Serial::tryWrite (const uint8_t *data, size_t size)
+{
+  ScopedWriteLock lock(this);
+  return backend_ ()->tryWrite (data, size);
+}
+
 size_t
 Serial::write_ (const uint8_t *data, size_t length)
 {
-  return pimpl_->write (data, length);
+  return check_io_result (backend_ ()->tryWrite (data, length), true);
 }
 
 void
 Serial::setPort (const string &port)
 {
-  ScopedReadLock rlock(this->pimpl_);
-  ScopedWriteLock wlock(this->pimpl_);
-  bool was_open = pimpl_->isOpen ();
+  ScopedReadLock rlock(this);
+  ScopedWriteLock wlock(this);
+  SerialBackend *current = backend_ ();
+  bool was_open = current->isOpen ();
   if (was_open) close();
-  pimpl_->setPort (port);
+  int kind = backend_for_port (port);
+  if (kind != backend_for_port (current->getPort ())) {
+    // Other threads may be waiting on the old backend's locks, so it is kept
+    // rather than deleted, and reused when the port switches back to its
+    // kind.  At most one backend of each kind is kept.
+    SerialBackend *backend = NULL;
+    for (size_t i = 0; i < retired_.size (); ++i) {
+      if (backend_for_port (retired_[i]->getPort ()) == kind) {
+        backend = retired_[i];
+        retired_[i] = current;
+        break;
+      }
+    }
+    if (backend == NULL) {
+      retired_.reserve (retired_.size () + 1);
+      backend = createBackend_ (kind, "", current->getBaudrate (),
+                                current->getBytesize (),
+                                current->getParity (),
+                                current->getStopbits (),
+                                current->getFlowcontrol ());
+      retired_.push_back (current);
+    } else {
+      backend->setBaudrate (current->getBaudrate ());
+      backend->setBytesize (current->getBytesize ());
+      backend->setParity (current->getParity ());
+      backend->setStopbits (current->getStopbits ());
+      backend->setFlowcontrol (current->getFlowcontrol ());
+    }
+    serial::Timeout timeout (current->getTimeout ());
+    backend->setTimeout (timeout);
+    pimpl_.store (backend, std::memory_order_release);
+  }
+  backend_ ()->setPort (port);
   if (was_open) open ();
 }
 
 string
 Serial::getPort () const
 {
-  return pimpl_->getPort ();
+  return backend_ ()->getPort ();
+}
+
+int
+Serial::getFd () const
+{
+  return backend_ ()->getFd ();
 }
 
 void
 Serial::setTimeout (serial::Timeout &timeout)
 {
-  pimpl_->setTimeout (timeout);
+  backend_ ()->setTimeout (timeout);
 }
 
 serial::Timeout
 Serial::getTimeout () const {
-  return pimpl_->getTimeout ();
+  return backend_ ()->getTimeout ();
 }
 
 void
 Serial::setBaudrate (uint32_t baudrate)
 {
-  pimpl_->setBaudrate (baudrate);
+  backend_ ()->setBaudrate (baudrate);
 }
 
 uint32_t
 Serial::getBaudrate () const
 {
-  return uint32_t(pimpl_->getBaudrate ());
+  return uint32_t(backend_ ()->getBaudrate ());
 }
 
 void
 Serial::setBytesize (bytesize_t bytesize)
 {
-  pimpl_->setBytesize (bytesize);
+  backend_ ()->setBytesize (bytesize);
 }
 
 bytesize_t
 Serial::getBytesize () const
 {
-  return pimpl_->getBytesize ();
+  return backend_ ()->getBytesize ();
 }
 
 void
 Serial::setParity (parity_t parity)
 {
-  pimpl_->setParity (parity);
+  backend_ ()->setParity (parity);
 }
 
 parity_t
 Serial::getParity () const
 {
-  return pimpl_->getParity ();
+  return backend_ ()->getParity ();
 }
 
 void
 Serial::setStopbits (stopbits_t stopbits)
 {
-  pimpl_->setStopbits (stopbits);
+  backend_ ()->setStopbits (stopbits);
 }
 
 stopbits_t
 Serial::getStopbits () const
 {
-  return pimpl_->getStopbits ();
+  return backend_ ()->getStopbits ();
 }
 
 void
 Serial::setFlowcontrol (flowcontrol_t flowcontrol)
 {
-  pimpl_->setFlowcontrol (flowcontrol);
+  backend_ ()->setFlowcontrol (flowcontrol);
 }
 
 flowcontrol_t
 Serial::getFlowcontrol () const
 {
-  return pimpl_->getFlowcontrol ();
+  return backend_ ()->getFlowcontrol ();
+}
+
+threadingmode_t
+Serial::getThreadingMode () const
+{
+  return threading_;
+}
+
+bool
+Serial::setLowLatency (bool low_latency)
+{
+  return backend_ ()->setLowLatency (low_latency);
+}
+
+bool
+Serial::getLowLatency () const
+{
+  return backend_ ()->getLowLatency ();
 }
 
 void Serial::flush ()
 {
-  ScopedReadLock rlock(this->pimpl_);
-  ScopedWriteLock wlock(this->pimpl_);
-  pimpl_->flush ();
+  ScopedReadLock rlock(this);
+  ScopedWriteLock wlock(this);
+  backend_ ()->flush ();
 }
 
 void Serial::flushInput ()
 {
-  ScopedReadLock lock(this->pimpl_);
-  pimpl_->flushInput ();
+  ScopedReadLock lock(this);
+  backend_ ()->flushInput ();
 }
 
 void Serial::flushOutput ()
 {
-  ScopedWriteLock lock(this->pimpl_);
-  pimpl_->flushOutput ();
+  ScopedWriteLock lock(this);
+  backend_ ()->flushOutput ();
 }
 
 void Serial::sendBreak (int duration)
 {
-  pimpl_->sendBreak (duration);
+  backend_ ()->sendBreak (duration);
 }
 
 void Serial::setBreak (bool level)
 {
-  pimpl_->setBreak (level);
+  backend_ ()->setBreak (level);
 }
 
 void Serial::setRTS (bool level)
 {
-  pimpl_->setRTS (level);
+  backend_ ()->setRTS (level);
 }
 
 void Serial::setDTR (bool level)
 {
-  pimpl_->setDTR (level);
+  backend_ ()->setDTR (level);
 }
 
 bool Serial::waitForChange()
 {
-  return pimpl_->waitForChange();
+  return backend_ ()->waitForChange();
 }
 
 bool Serial::getCTS ()
 {
-  return pimpl_->getCTS ();
+  return backend_ ()->getCTS ();
 }
 
 bool Serial::getDSR ()
 {
-  return pimpl_->getDSR ();
+  return backend_ ()->getDSR ();
 }
 
 bool Serial::getRI ()
 {
-  return pimpl_->getRI ();
+  return backend_ ()->getRI ();
 }
 
 bool Serial::getCD ()
 {
-  return pimpl_->getCD ();
+  return backend_ ()->getCD ();
 }
@@ -11,9 +11,29 @@
 #include "serial/serial.h"
 #include "ofxIO.h"
 #include "ofx/IO/SerialDevice.h"
+#include "ofx/IO/AsyncSerialDevice.h"
 #include "ofx/IO/BufferedSerialDevice.h"
+#include "ofx/IO/CBOR.h"
 //#include "ofx/IO/OSCSerialDevice.h"
 #include "ofx/IO/PacketSerialDevice.h"
+#include "ofx/IO/PacketSerialDeviceGroup.h"
+#include "ofx/IO/MultiplexedPacketSerialDevice.h"
+#include "ofx/IO/PacketCompression.h"
+#include "ofx/IO/RFC2217Server.h"
+#include "ofx/IO/ReplaySerialDevice.h"
+#include "ofx/IO/SerialBroker.h"
+#include "ofx/IO/SerialCapture.h"
 #include "ofx/IO/SerialEvents.h"
+#include "ofx/IO/SerialFraming.h"
+#include "ofx/IO/SerialMessage.h"
+#include "ofx/IO/SerialPcapng.h"
+#include "ofx/IO/SerialReaderThread.h"
+#include "ofx/IO/SerialRingBuffer.h"
+#include "ofx/IO/SerialSimulator.h"
+#include "ofx/IO/SerialTap.h"
+#include "ofx/IO/ShapedSerialWriter.h"
+#include "ofx/IO/ThreadPolicy.h"
+#include "ofx/IO/SerialDeviceGroup.h"
+#include "ofx/IO/SerialDeviceManager.h"
 #include "ofx/IO/SerialDeviceUtils.h"
 